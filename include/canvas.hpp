@@ -8,14 +8,53 @@
 #include <wx/graphics.h>
 #include <wx/bitmap.h>
 #include <wx/image.h>
+#include <wx/rawbmp.h>
 #include <vector>
 #include <memory>
+#include <string>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include "raster_surface.hpp"
+#include "level_meter.hpp"
+#include "triple_buffer.hpp"
+
+typedef struct _cairo cairo_t;      // see AudioVisualizer's vector modes
+
+namespace utils {
+class AudioEngine;
+class PcmTap;
+class SpectrumAnalyzer;
+}
 
 namespace gui {
 
 // Forward declarations
 class AudioVisualizer;
 class WaveformGenerator;
+class VisualizationRenderer;
+class LevelMeterCtrl;
+
+// A visualization frame in the pixel layout of a 32-bit wxBitmap's
+// wxAlphaPixelData (its channel order, premultiplied where the platform
+// premultiplies), so it goes into the bitmap with one memcpy per row.
+// Rows outside [content_top, content_bottom) are transparent; an empty
+// range is kept as [height, 0), so ranges combine with min and max.
+struct VisualizationFrame
+{
+    int width = 0;
+    int height = 0;
+    std::vector<uint32_t> pixels;
+    int content_top = 0;
+    int content_bottom = 0;
+
+    void Resize(int new_width, int new_height);     // transparent afterwards
+    uint32_t* GetRow(int y) { return &pixels[static_cast<size_t>(y) * width]; }
+    const uint32_t* GetRow(int y) const { return &pixels[static_cast<size_t>(y) * width]; }
+};
 
 class PlayerCanvas : public wxPanel
 {
@@ -30,7 +69,7 @@ public:
     ~PlayerCanvas();
 
     // Main functionality
-    // void SetMediaCtrl(wxMediaCtrl* ctrl);
+    void SetMediaCtrl(wxMediaCtrl* ctrl);
     void SetDisplayMode(DisplayMode mode);
     DisplayMode GetDisplayMode() const { return current_mode; }
 
@@ -40,6 +79,15 @@ public:
     void PauseAudioVisualization();
     void UpdateVisualizationData(const std::vector<float>& frequency_data);
 
+    // A-B loop for the PCM path, in milliseconds; end -1 clears it. Kept
+    // across StartAudioVisualization() so a reopened engine loops too.
+    void SetLoopRegion(wxFileOffset start_ms, wxFileOffset end_ms);
+
+    // Level meters, advanced by the frame clock; the control-bar meter (if
+    // any) is fed from here too
+    void SetLevelMeterCtrl(LevelMeterCtrl* ctrl);
+    const utils::LevelMeter& GetLevelMeter() const { return level_meter; }
+
     // Video display
     void OptimizeVideoDisplay();
      // 0=fit, 1=fill, 2=stretch
@@ -53,13 +101,17 @@ public:
     void SetBackgroundColor(const wxColour& color);
     void SetTextColor(const wxColour& color);
     void SetAccentColor(const wxColour& color);
-    void SetVisualizationStyle(int style); // 0=waveform, 1=spectrum, 2=oscilloscope
+    void SetVisualizationStyle(int style); // 0=waveform, 1=spectrum, 2=oscilloscope, 3=bars, 4=circle, 5=spectrogram
 
     // Animation control
     void StartAnimations();
     void StopAnimations();
     void SetAnimationSpeed(double speed);
 
+    // Paint once to reflect a state change and resume the frame clock if
+    // the canvas is animating; call when playback starts or stops
+    void InvalidateFrame();
+
     // Canvas management
     void Clear();
     void Refresh();
@@ -71,7 +123,9 @@ protected:
     void OnSize(wxSizeEvent& event);
     void OnEraseBackground(wxEraseEvent& event);
     void OnTimer(wxTimerEvent& event);
-    void OnIdle(wxIdleEvent& event);
+    void OnShow(wxShowEvent& event);
+    void OnIconize(wxIconizeEvent& event);
+    void OnFrameReady(wxThreadEvent& event);
 
     // Drawing methods
     void DrawVideoContent(wxGraphicsContext* gc, const wxRect& rect);
@@ -88,26 +142,64 @@ protected:
 
     // Helper methods
     void InitializeGraphics();
+    void SyncAudioClock();
     void UpdateCanvasSize();
+    wxRect GetVisualizationRect(const wxRect& rect) const;
+    void RequestVisualizationFrame();
+    void UpdateLevelMeter();
+    void ResetLevelMeter();
+    void StoreTrackTempo();
+    bool UploadFrame(const VisualizationFrame& frame);
+    void LoadCoverArt();
+    void DrawCoverArt(wxGraphicsContext* gc, const wxRect& rect);
+
+    // Static layers: rendered on demand, dropped on resize or when their
+    // colours or text change
+    void InvalidateLayers();
+    void EnsureLayers(const wxSize& size);
+    wxBitmap CreateLayerBitmap(const wxSize& size) const;
     void CalculateVideoRect(const wxRect& canvas_rect, wxRect& video_rect);
-    void GenerateTestFrequencyData();
     wxRect CalculateCenteredRect(const wxSize& content_size, const wxRect& container);
 
-    // Animation helpers
-    void UpdateAnimations();
-    double GetAnimationProgress() const;
+    // Frame scheduling
+    bool IsFrameVisible() const;
+    bool WantsFrames() const;
+    void ScheduleFrame();
+    void UpdateFrameInterval();
 
 private:
     // Core components
-    // wxMediaCtrl* media_ctrl;
+    wxMediaCtrl* media_ctrl;
     DisplayMode current_mode;
 
-    // Audio visualization
-    std::unique_ptr<AudioVisualizer> audio_visualizer;
-    std::unique_ptr<WaveformGenerator> waveform_generator;
-    std::vector<float> frequency_data;
-    std::vector<float> waveform_data;
+    // Audio visualization: frames are drawn by the renderer's thread and
+    // only blitted here
+    std::unique_ptr<utils::AudioEngine> audio_engine;
+    std::unique_ptr<VisualizationRenderer> renderer;
+    wxBitmap frame_bitmap;
+    int frame_bitmap_top;           // rows of frame_bitmap that may hold content
+    int frame_bitmap_bottom;
     int visualization_style;
+    std::string audio_path;         // file the engine decodes, for the tempo cache
+
+    // Album art of the track playing, converted from utils::ArtCache's
+    // scaled images once they are ready; behind the visualization and
+    // beside the now-playing text
+    std::string art_path;
+    wxBitmap cover_art;
+    wxBitmap cover_thumbnail;
+
+    // Level meters: ballistics run on the GUI thread from the engine's
+    // per-block levels up to the playback position
+    utils::LevelMeter level_meter;
+    long long meter_frame;
+    std::chrono::steady_clock::time_point meter_time;
+    bool show_meters;
+    LevelMeterCtrl* meter_ctrl;
+
+    // A-B loop handed to the engine
+    wxFileOffset loop_start_ms;
+    wxFileOffset loop_end_ms;
 
     // Video display
     double video_aspect_ratio;
@@ -118,6 +210,7 @@ private:
     wxString now_playing_text;
     bool show_now_playing;
     wxFont now_playing_font;
+    wxFont title_font;
     wxRect text_rect;
 
     // Visual properties
@@ -126,18 +219,24 @@ private:
     wxColour accent_color;
     wxColour secondary_color;
 
-    // Animation
-    wxTimer animation_timer;
-    wxTimer visualization_timer;
+    // Animation: one frame clock drives both animation and data updates.
+    // Ticks land on a grid of display refresh periods from frame_epoch.
+    wxTimer frame_timer;
+    std::chrono::steady_clock::time_point frame_epoch;
+    double frame_interval_ms;
+    wxTopLevelWindow* top_level;
     double animation_speed;
-    long long animation_start_time;
     bool animations_enabled;
 
     // Graphics
     wxGraphicsRenderer* graphics_renderer;
-    wxBitmap buffer_bitmap;
     bool double_buffered;
 
+    // Cached layers
+    wxBitmap background_layer;      // gradient, full canvas
+    wxBitmap idle_layer;            // complete idle screen, full canvas
+    wxBitmap now_playing_layer;     // translucent strip, NOW_PLAYING_HEIGHT tall
+
     // Layout
     wxSize canvas_size;
     bool size_changed;
@@ -145,13 +244,13 @@ private:
     // Performance
     bool enable_smooth_rendering;
     int fps_limit;
-    long long last_frame_time;
 
     // Constants
     static const int DEFAULT_FPS = 30;
-    static const int VISUALIZATION_UPDATE_MS = 33; // ~30fps
-    static const int WAVEFORM_POINTS = 256;
-    static const int SPECTRUM_BARS = 64;
+    static const int NOW_PLAYING_HEIGHT = 80;
+    static const int METER_WIDTH = 13;
+    static const int METER_MARGIN = 8;
+    static constexpr float MIN_TEMPO_CONFIDENCE = 0.3f;   // for showing a BPM
 
     DECLARE_EVENT_TABLE()
 };
@@ -165,7 +264,8 @@ public:
         SPECTRUM,
         OSCILLOSCOPE,
         BARS,
-        CIRCLE
+        CIRCLE,
+        SPECTROGRAM
     };
 
     AudioVisualizer();
@@ -173,16 +273,29 @@ public:
 
     void SetType(VisualizationType type);
     void SetData(const std::vector<float>& frequency_data, const std::vector<float>& waveform_data);
-    void Draw(wxGraphicsContext* gc, const wxRect& rect, const wxColour& color);
-    void Update();
+    bool CapturePcm(const utils::PcmTap& tap, long long end_frame);
+    void ClearPcm();
+    // Advances the animation; beat_phase is the position within the current
+    // beat (0 on the beat) and beat_confidence how far to follow it
+    void Update(double beat_phase, float beat_confidence);
+
+    // Draws the plot into frame, already sized. Drawing goes only through
+    // RasterSurface or cairo, never through wx pens, brushes or graphics
+    // contexts, so it may run off the main thread.
+    void Render(VisualizationFrame& frame, const wxColour& color);
 
     // Configuration
     void SetSensitivity(double sensitivity);
     void SetSmoothness(double smoothness);
     void SetBarCount(int count);
     void SetAmplification(double amp);
+    // Off draws the bar, line and dot modes as antialiased vectors, in
+    // builds with cairo; without it they are always rasterized
+    void SetSoftwareRendering(bool enable) { software_rendering = enable; }
 
 private:
+    struct VectorTarget;
+
     VisualizationType vis_type;
     std::vector<float> current_freq_data;
     std::vector<float> current_wave_data;
@@ -196,13 +309,169 @@ private:
 
     // Animation
     double phase_offset;
+    double beat_pulse;      // 1 on a confident beat, decaying towards the next
+
+    // Decoded PCM window (preallocated, refreshed each frame)
+    std::vector<float> pcm_snapshot;
+    std::vector<float> column_min;
+    std::vector<float> column_max;
+    bool has_pcm;
+    long long pcm_end_frame;
+    int pcm_sample_rate;
+
+    // Spectrogram: a ring of columns in an image the size of the plot. The
+    // next column is written at spectrogram_column, which is also the oldest.
+    std::unique_ptr<utils::SpectrumAnalyzer> spectrum_analyzer;
+    std::vector<float> spectrum_magnitudes;
+    std::vector<int> row_bin_begin;
+    std::vector<int> row_bin_end;
+    unsigned char colormap[256][3];
+    wxImage spectrogram_image;
+    int spectrogram_column;
+    int spectrogram_rate;           // sample rate the row mapping was built for
+    long long spectrogram_frame;    // end frame of the newest analysed column
+
+    // Software rasterizer for every mode but the spectrogram: drawn into a
+    // CPU surface and copied into the frame
+    bool software_rendering;
+    utils::RasterSurface raster;
+    std::vector<utils::RasterSurface::Bar> raster_bars;
+    uint32_t bar_gradient[256];
+    wxColour bar_gradient_color;
+
+    // Where the vector modes draw with cairo, kept from frame to frame
+    std::unique_ptr<VectorTarget> vector_target;
 
     // Drawing helpers
-    void DrawWaveformVis(wxGraphicsContext* gc, const wxRect& rect, const wxColour& color);
-    void DrawSpectrumVis(wxGraphicsContext* gc, const wxRect& rect, const wxColour& color);
-    void DrawBarsVis(wxGraphicsContext* gc, const wxRect& rect, const wxColour& color);
-    void DrawCircleVis(wxGraphicsContext* gc, const wxRect& rect, const wxColour& color);
+    bool DrawVector(VisualizationFrame& frame, const wxColour& color);
+    void DrawWaveformVis(cairo_t* cr, const wxRect& rect, const wxColour& color);
+    void DrawSpectrumVis(cairo_t* cr, const wxRect& rect, const wxColour& color);
+    void DrawBarsVis(cairo_t* cr, const wxRect& rect, const wxColour& color);
+    void DrawCircleVis(cairo_t* cr, const wxRect& rect, const wxColour& color);
+    void DrawOscilloscopeVis(cairo_t* cr, const wxRect& rect, const wxColour& color);
+    void DrawSpectrogramVis(VisualizationFrame& frame);
+    void EnsureSpectrogramSize(int width, int height, int sample_rate);
+    void AdvanceSpectrogram();
+    void WriteSpectrogramColumn();
+    void DrawRasterized(VisualizationFrame& frame, const wxColour& color);
+    void RasterizeBars(const wxRect& rect, const wxColour& color, bool gradient);
+    void RasterizeWaveform(const wxRect& rect, const wxColour& color);
+    void RasterizeCircle(const wxRect& rect, const wxColour& color);
+    void RasterizeOscilloscope(const wxRect& rect, const wxColour& color);
+    void RasterizePcmEnvelope(const wxRect& rect, const wxColour& color, const float* samples, size_t count);
+    void CopyRaster(VisualizationFrame& frame) const;
+    cairo_t* BeginVectorFrame(int width, int height);
+    void EndVectorFrame(VisualizationFrame& frame);
+    static void ClearFrame(VisualizationFrame& frame);
+    void DrawPcmEnvelope(cairo_t* cr, const wxRect& rect, const wxColour& color, const float* samples, size_t count);
+    size_t FindTrigger(const float* samples, size_t search) const;
+    size_t DecimateMinMax(const float* samples, size_t count, size_t columns);
     void SmoothData();
+
+    // PCM window geometry (frames)
+    static const size_t SCOPE_WINDOW = 2048;
+    static const size_t SCOPE_SEARCH = 2048;
+    static const size_t PCM_SNAPSHOT_FRAMES = SCOPE_WINDOW + SCOPE_SEARCH;
+
+    // Spectrogram analysis (frames)
+    static const size_t SPECTROGRAM_FFT = 2048;
+    static const size_t SPECTROGRAM_HOP = 512;
+};
+
+// Runs an AudioVisualizer on its own thread.
+//
+// The GUI thread only posts settings and frame requests. The worker owns all
+// visualizer state, draws each frame into one of three VisualizationFrames
+// and hands it over through a TripleBuffer, then posts a wxThreadEvent to
+// the owner, which picks up the newest frame when it paints. The worker
+// sleeps while the canvas is hidden and while the previous frame has not
+// been picked up, so it never runs ahead of what can be shown.
+class VisualizationRenderer
+{
+public:
+    VisualizationRenderer(wxEvtHandler* owner, const utils::PcmTap& tap);
+    ~VisualizationRenderer();
+
+    void Start();
+    void Stop();
+
+    // Settings (GUI thread), applied from the next frame on
+    void SetType(AudioVisualizer::VisualizationType type);
+    void SetColor(const wxColour& color);
+    void SetSoftwareRendering(bool enable);
+    void SetAnimationSpeed(double speed);
+    void SetFrequencyData(const std::vector<float>& frequency_data);
+    void ResetTrack();          // drop PCM history and synthetic data
+    void RestartAnimation();
+
+    // Parks the worker; pending requests are served once reactivated
+    void SetActive(bool active);
+
+    // Asks for one frame of the given size, showing the PCM window that ends
+    // at pcm_end_frame (negative when nothing is decoded), animated to the
+    // beat phase at that frame
+    void RequestFrame(const wxSize& size, long long pcm_end_frame, double beat_phase = 0.0, float beat_confidence = 0.0f);
+
+    // GUI side of the handoff. AcquireFrame() returns the newest finished
+    // frame (nullptr before the first one) and sets updated when it changed
+    // since the last call; the frame stays valid until the next call.
+    const VisualizationFrame* AcquireFrame(bool& updated);
+    void AcknowledgeFrame();    // call on each frame-ready event
+    long long GetLastRenderTime() const { return render_time_ms.load(std::memory_order_relaxed); }
+
+private:
+    struct Settings {
+        AudioVisualizer::VisualizationType type;
+        unsigned char red;
+        unsigned char green;
+        unsigned char blue;
+        bool software_rendering;
+        double animation_speed;
+        unsigned track_generation;
+        unsigned animation_generation;
+        wxSize size;
+        long long pcm_end_frame;
+        double beat_phase;
+        float beat_confidence;
+    };
+
+    wxEvtHandler* owner;
+    const utils::PcmTap& tap;
+
+    // Shared with the GUI thread, guarded by mutex
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool running;
+    bool active;
+    bool frame_requested;
+    bool frame_in_flight;       // frame-ready event not acknowledged yet
+    Settings pending;
+    std::vector<float> pending_frequency;
+    bool frequency_pending;
+
+    // Worker state
+    std::unique_ptr<AudioVisualizer> visualizer;
+    std::unique_ptr<WaveformGenerator> waveform_generator;
+    std::vector<float> frequency_data;
+    std::vector<float> waveform_data;
+    std::vector<float> frequency_update;
+    std::mt19937 rng;
+    unsigned track_generation;
+    unsigned animation_generation;
+    std::chrono::steady_clock::time_point animation_start;
+
+    // Frames
+    VisualizationFrame frames[3];
+    utils::TripleBuffer exchange;
+    std::atomic<long long> render_time_ms;
+
+    void Run();
+    void RenderFrame(const Settings& settings, bool frequency_updated);
+    void GenerateTestFrequencyData(const Settings& settings);
+
+    static const int WAVEFORM_POINTS = 256;
+    static const int SPECTRUM_BARS = 64;
 };
 
 // Waveform generator for creating animated waveforms
@@ -0,0 +1,38 @@
+#ifndef __LEVEL_METER_CTRL_HPP
+#define __LEVEL_METER_CTRL_HPP
+
+#include <wx/wx.h>
+#include <wx/graphics.h>
+#include "level_meter.hpp"
+
+namespace gui {
+
+// Compact stereo peak/RMS meter for the control bar.
+//
+// Holds a copy of the levels it was last given; the canvas pushes new ones
+// from its frame clock. DrawMeters() is shared with the canvas overlay.
+class LevelMeterCtrl : public wxWindow
+{
+public:
+    LevelMeterCtrl(wxWindow* parent, wxWindowID id = wxID_ANY, const wxSize& size = wxSize(160, 16));
+
+    void SetLevels(const utils::LevelMeter& meter);
+
+    // Two meters (left, then right) filling rect; horizontal meters grow to
+    // the right, vertical ones upwards
+    static void DrawMeters(wxGraphicsContext* gc, const wxRect& rect, const utils::LevelMeter& meter, bool vertical);
+
+    // Scale shown, in dBFS
+    static constexpr float RANGE_DB = 60.0f;
+
+private:
+    utils::LevelMeter levels;
+
+    void OnPaint(wxPaintEvent& event);
+
+    static void DrawChannel(wxGraphicsContext* gc, const wxRect& rect, const utils::LevelMeter& meter, int channel, bool vertical);
+};
+
+}
+
+#endif // __LEVEL_METER_CTRL_HPP
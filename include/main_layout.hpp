@@ -10,6 +10,7 @@
 #include "player_ui_control.hpp"
 
 #include <wx/simplebook.h>
+#include <wx/srchctrl.h>
 
 namespace gui {
 
@@ -23,6 +24,7 @@ private:
     wxPanel* playlist_pane;
     wxPanel* video_canvas_pane;
     wxButton* toggle_playlist_btn;
+    wxSearchCtrl* playlist_search;
     
     // GUI styling properties
     wxColour background_color;
@@ -42,6 +44,7 @@ private:
     bool playlist_visible;
     int minimum_pane_size;
     double sash_gravity;
+    bool fuzzy_search;
 
 public:
     MainLayout(wxFrame* parent);
@@ -85,6 +88,9 @@ public:
     void OnTogglePlaylist(wxCommandEvent& event);
     void OnSplitterSashPosChanged(wxSplitterEvent& event);
     void OnPlaylistPaneSize(wxSizeEvent& event);
+    void OnPlaylistSearch(wxCommandEvent& event);
+    void OnPlaylistSearchNext(wxCommandEvent& event);
+    void OnToggleFuzzySearch(wxCommandEvent& event);
     
     // Utility methods
     void ConnectComponents();
@@ -104,6 +110,7 @@ public:
 private:
     // Helper methods
     void CreateToggleButton();
+    void CreateSearchBox();
     void SetupPlaylistSizer();
     void SetupVideoSizer();
     void ApplyButtonStyling(wxButton* button);
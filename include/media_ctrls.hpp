@@ -1,9 +1,13 @@
 #ifndef __MEDIA_CONTROLS__HPP
 #define __MEDIA_CONTROLS__HPP
 #include "widgets.hpp"
+#include <cstdint>
 
 namespace gui {
 class StatusBar; // Forward declaration
+class LevelMeterCtrl;
+class PlayerCanvas;
+class RegionMarkerCtrl;
 }
 
 namespace gui::player {
@@ -19,6 +23,27 @@ public:
   void UpdateDuration();
   void SetPlaylist(Playlist* playlist);
   void SetStatusBar(gui::StatusBar* status_bar);
+  void SetPlaybackRate(double rate);
+  double GetPlaybackRate() const { return playback_rate; }
+
+  // Ends the current track early (trailing silence), moving on as if it had
+  // finished; -1 plays to the real end. An A-B loop takes precedence.
+  void SetTrackEnd(wxFileOffset end_ms);
+
+  // Records the position of path in the resume store while it plays;
+  // identity 0 turns recording off
+  void SetResumeFile(const wxString& path, uint64_t identity);
+
+  // A-B loop in milliseconds. The end is only accepted at least
+  // AudioEngine::MIN_LOOP_MS after the start; setting it starts looping.
+  // Seeking outside the region clears it.
+  void SetAudioCanvas(gui::PlayerCanvas* canvas);
+  void SetLoopStart(wxFileOffset start_ms);
+  bool SetLoopEnd(wxFileOffset end_ms);
+  void ClearLoop();
+
+  // Stereo level meter, or nullptr when disabled in the preferences
+  gui::LevelMeterCtrl* GetLevelMeter() const { return level_meter; }
 
 private:
   wxButton* btn_play;
@@ -26,9 +51,15 @@ private:
   wxButton* btn_stop;
   wxButton* btn_next;
   wxButton* btn_prev;
+  wxButton* btn_loop_start;
+  wxButton* btn_loop_end;
+  wxButton* btn_loop_clear;
 
   wxSlider* slider_volume;
   wxSlider* slider_playback_position;
+  gui::RegionMarkerCtrl* loop_markers;
+  wxChoice* choice_playback_rate;
+  gui::LevelMeterCtrl* level_meter;
   
   // Duration display
   wxStaticText* label_current_time;
@@ -37,6 +68,22 @@ private:
   
   // Timer for updating playback position
   wxTimer* update_timer;
+
+  // One-shot timer that lands on track_end between position updates
+  wxTimer* end_timer;
+  wxFileOffset track_end;
+
+  // File whose position is being remembered
+  wxString resume_path;
+  uint64_t resume_identity;
+
+  // A-B loop, -1 when unset. The backend is sought back to loop_start when
+  // end_timer or a position update finds it at loop_end, so the audible
+  // loop is as tight as those timers; the canvas's PCM engine wraps the
+  // visualizer samples to match
+  wxFileOffset loop_start;
+  wxFileOffset loop_end;
+  gui::PlayerCanvas* audio_canvas;
   
   // Playlist reference for navigation
   Playlist* playlist;
@@ -48,6 +95,10 @@ private:
   wxFileOffset media_duration;
   wxFileOffset media_position;
 
+  // Playback speed (0.5x - 3x, TimeStretcher's range) as passed to
+  // wxMediaCtrl::SetPlaybackRate; whether pitch is kept is the backend's doing
+  double playback_rate;
+
   void OnPlay(wxCommandEvent& event);
   void OnStop(wxCommandEvent& event);
   void OnPause(wxCommandEvent& event);
@@ -56,7 +107,12 @@ private:
   void OnPrevious(wxCommandEvent& event);
   void OnPositionSliderChange(wxCommandEvent& event);
   void OnPositionSliderSeek(wxMouseEvent& event);
+  void OnPlaybackRateChange(wxCommandEvent& event);
   void OnUpdateTimer(wxTimerEvent& event);
+  void OnEndTimer(wxTimerEvent& event);
+  void OnLoopStart(wxCommandEvent& event);
+  void OnLoopEnd(wxCommandEvent& event);
+  void OnLoopClear(wxCommandEvent& event);
 
 private:
   void OnVideoCanvasHover(wxMouseEvent& event);
@@ -66,6 +122,10 @@ private:
   wxString FormatTime(wxFileOffset milliseconds);
   void UpdateTimeDisplay();
   void UpdatePositionSlider();
+  void ApplyPlaybackRate();
+  void CheckTrackEnd();
+  void RecordResumePosition();
+  void ApplyLoop();
 };
 }
 #endif // !__MEDIA_CONTROLS__HPP
@@ -16,6 +16,7 @@ public:
     void ShowVideoCanvas();
     void ShowAudioCanvas();
     wxMediaCtrl* GetMediaCtrl() const { return media_ctrl; }
+    PlayerCanvas* GetAudioCanvas() const { return audio_canvas; }
 
 private:
     wxSimplebook* book;
@@ -2,11 +2,18 @@
 #define __PLAYLIST__HPP
 
 #include "wanjplayer.hpp"
+#include <unordered_map>
 
 // Forward declarations
 namespace utils {
     class QueueManager;
     class FileUtils;
+    class SearchIndex;
+    class SortDictionary;
+    class TrackTable;
+    class SmartPlaylist;
+    class TagReader;
+    struct LibraryChange;
 }
 
 namespace gui::player {
@@ -22,13 +29,21 @@ public:
     void AddItem(const wxString& path);
     void AddMultipleItems(const wxArrayString& paths);
     void RemoveItem(size_t index);
+    // Removes every item whose flag is set in one pass; returns how many
+    size_t RemoveItems(const std::vector<bool>& removed);
     void RemoveCurrentItem();
     void ClearPlayQueue();
     void MoveItem(size_t from, size_t to);
     
+    // Brings the playlist in line with a batch of changes on disk: renamed
+    // items keep their place and data, deleted ones go, files added under
+    // a watched folder are queued. One list update for the whole batch.
+    virtual void ApplyLibraryChanges(const std::vector<utils::LibraryChange>& changes);
+    
     // Queue management
     wxString GetItem(size_t index) const;
     wxString GetCurrentItem() const;
+    wxString GetNextItem() const;   // what PlayNextItem() would load, or empty
     unsigned int GetCount() const override;
     bool IsEmpty() const;
     
@@ -67,11 +82,26 @@ public:
     void ExportPlaylist(const wxString& filepath, const wxString& format = "m3u");
     
     // Search and sorting
-    void SearchItems(const wxString& query);
+    void SearchItems(const wxString& query);   // selects the best match
+    bool SelectNextMatch();                     // cycles through the matches, best first
+    size_t GetMatchCount() const;
+    void SetFuzzySearch(bool enabled);          // tolerate typos in search terms
+    bool IsFuzzySearch() const { return fuzzy_search; }
     void SortByName(bool ascending = true);
     void SortByDuration(bool ascending = true);
     void SortByDateAdded(bool ascending = true);
     
+    // Multi-key sorting; the first key decides, the rest break ties, and
+    // items that still tie keep their order. Repeating the last sort after
+    // a few edits only moves the edited items.
+    enum class SortField { NAME, ARTIST, ALBUM, DISC, TRACK, DATE_ADDED, DURATION };
+    struct SortKey {
+        SortField field;
+        bool ascending;
+        bool operator==(const SortKey&) const = default;
+    };
+    void SortBy(const std::vector<SortKey>& keys);
+    
     // Statistics
     wxTimeSpan GetTotalDuration() const;
     unsigned int GetVideoCount() const;
@@ -82,12 +112,46 @@ public:
     void OnMediaLoaded(wxMediaEvent& event);
     void OnMediaError(wxMediaEvent& event);
 
+protected:
+    // Re-index an item once its tags are known; the file name stays indexed
+    void IndexItem(size_t index, const wxString& title, const wxString& artist, const wxString& album);
+    
+    // Sort columns for an item once its tags are known
+    void SetItemTags(size_t index, const wxString& artist, const wxString& album,
+                     unsigned int disc, unsigned int track, const wxTimeSpan& duration);
+    
+    // Puts the item at order[i] in position i; subclasses keeping their
+    // own per-item data reorder it here too
+    virtual void ReorderItems(const std::vector<uint32_t>& order);
+    
+    // Drops the flagged items from every per-item column, the list and the
+    // shuffle order; subclasses drop their own per-item data here too
+    virtual void CompactItems(const std::vector<bool>& removed);
+    
+    // An item's file was renamed or moved, or rewritten in place;
+    // subclasses update their own per-item data here too
+    virtual void RenameItem(size_t index, const wxString& path);
+    virtual void RefreshItem(size_t index);
+
 private:
     // Internal data
     std::vector<wxString> play_queue;
     std::vector<wxTimeSpan> item_durations;
     std::vector<wxDateTime> date_added;
     std::vector<bool> is_video_file;
+    std::vector<std::string> name_keys;         // natural sort keys of the file names
+    std::vector<uint32_t> name_ranks;           // natural order of name_keys, rebuilt on demand
+    bool name_ranks_valid;
+    std::vector<uint32_t> item_artists;         // ids in artist_names
+    std::vector<uint32_t> item_albums;          // ids in album_names
+    std::vector<uint16_t> item_discs;
+    std::vector<uint16_t> item_tracks;
+    utils::SortDictionary* artist_names;
+    utils::SortDictionary* album_names;
+    
+    // The last SortBy() and the items edited since, to repair it cheaply
+    std::vector<SortKey> sort_keys;
+    std::vector<uint32_t> sort_changed;
     
     size_t current_index;
     wxMediaCtrl* media_ctrl_ref;
@@ -95,6 +159,15 @@ private:
     // Queue management utility
     utils::QueueManager* queue_manager;
     
+    // Search index; item_ids runs parallel to play_queue
+    utils::SearchIndex* search_index;
+    std::vector<uint32_t> item_ids;
+    std::vector<size_t> item_positions;         // by id, rebuilt on demand
+    bool item_positions_valid;
+    std::vector<uint32_t> search_matches;       // ids, best first
+    size_t search_cursor;
+    bool fuzzy_search;
+    
     // Playback state
     bool auto_play_next;
     bool crossfade_enabled;
@@ -122,9 +195,21 @@ private:
     // File operations
     void RefreshItemDurations();
     void CacheItemInfo(size_t index, const wxString& path);
+    bool AppendQueueItem(const wxString& path);     // every column but the list
+    
+    // Search index maintenance
+    uint32_t AddToIndex(const wxString& path, const wxString& title,
+                        const wxString& artist, const wxString& album);
+    size_t GetItemPosition(uint32_t id);
+    void InvalidateItemPositions();
+    
+    // Sorting
+    void MarkSortChanged(size_t index);
+    const std::vector<uint32_t>& GetNameRanks();
     
     // Constants
     static const int MAX_QUEUE_SIZE = 10000;
+    static const size_t MAX_LIST_DELETES = 8;   // per removal, before refilling the list instead
     static const int DEFAULT_CROSSFADE_DURATION = 3000; // 3 seconds
 };
 
@@ -161,13 +246,18 @@ struct PlaylistItem
     wxString title;
     wxString artist;
     wxString album;
+    wxString genre;
+    unsigned int disc_number;
+    unsigned int track_number;
+    unsigned int play_count;
     wxTimeSpan duration;
     wxDateTime date_added;
     bool is_video;
     wxULongLong file_size;
     
-    PlaylistItem() : is_video(false), file_size(0) {}
-    PlaylistItem(const wxString& path) : filepath(path), is_video(false), file_size(0)
+    PlaylistItem() : disc_number(0), track_number(0), play_count(0), is_video(false), file_size(0) {}
+    PlaylistItem(const wxString& path)
+        : filepath(path), disc_number(0), track_number(0), play_count(0), is_video(false), file_size(0)
     {
         date_added = wxDateTime::Now();
         // File utilities will be called in the implementation
@@ -179,6 +269,7 @@ class EnhancedPlaylist : public Playlist
 {
 public:
     EnhancedPlaylist(wxWindow* parent, wxWindowID id);
+    ~EnhancedPlaylist();
     
     // Metadata operations
     void SetItemMetadata(size_t index, const PlaylistItem& metadata);
@@ -186,7 +277,12 @@ public:
     void RefreshAllMetadata();
     
     // Advanced features
-    void CreateSmartPlaylist(const wxString& criteria);
+    // CreateSmartPlaylist() replaces the queue with the known tracks
+    // matching a query (see utils::SmartQuery) and keeps it matching as
+    // their metadata changes: tracks that stop matching are removed and
+    // new matches appended, leaving the rest of the queue alone; false if
+    // the query does not parse
+    bool CreateSmartPlaylist(const wxString& criteria);
     void AddFromDirectory(const wxString& directory, bool recursive = false);
     void RemoveDuplicates();
     void RemoveMissingFiles();
@@ -194,10 +290,36 @@ public:
     // Library integration
     void SyncWithMusicLibrary();
     void UpdateFromLastFM();
+    void ApplyLibraryChanges(const std::vector<utils::LibraryChange>& changes) override;
+    
+protected:
+    void ReorderItems(const std::vector<uint32_t>& order) override;
+    void CompactItems(const std::vector<bool>& removed) override;
+    void RenameItem(size_t index, const wxString& path) override;
+    void RefreshItem(size_t index) override;
     
 private:
     std::vector<PlaylistItem> item_metadata;
     
+    // Every track whose metadata has been seen, by path, for smart playlists.
+    // Rows come from the playlist, with their PlaylistItem, or from the
+    // library store, which is read again for the few a smart playlist lists.
+    utils::TrackTable* library;
+    std::unordered_map<std::string, uint32_t> library_rows;
+    std::unordered_map<uint32_t, PlaylistItem> library_items;  // by library row
+    std::vector<uint32_t> library_tracks;       // by library row: its store track, as of the last sync
+    utils::SmartPlaylist* smart_playlist;
+    std::unordered_map<uint32_t, wxString> smart_items;   // by library row: the path it was queued under
+    bool loading_smart_playlist;
+    bool smart_playlist_stale;                  // reload once the current batch is applied
+    utils::TagReader* tag_reader;
+    
+    bool AddToLibrary(const PlaylistItem& item);    // true if the smart playlist changed
+    PlaylistItem GetLibraryItem(uint32_t row) const;
+    void LoadSmartPlaylist();                   // replaces the queue
+    void UpdateSmartPlaylist();                 // applies what changed since
+    void AppendSmartRows(const std::vector<uint32_t>& rows);
+    
     void ExtractMetadataFromFile(const wxString& filepath, PlaylistItem& item);
     bool MatchesCriteria(const PlaylistItem& item, const wxString& criteria) const;
 };
@@ -44,6 +44,10 @@ private:
     wxCheckBox* remember_geometry_checkbox;
     wxChoice* theme_choice;
     wxSlider* transparency_slider;
+    wxCheckBox* canvas_meters_checkbox;
+    wxCheckBox* control_bar_meters_checkbox;
+    wxCheckBox* trim_silence_checkbox;
+    wxCheckBox* resume_playback_checkbox;
 
     // Logging Page
     wxChoice* log_level_choice;
@@ -54,6 +58,7 @@ private:
 
     // Performance Page
     wxCheckBox* performance_profiling_checkbox;
+    wxCheckBox* software_visualizer_checkbox;
     wxSpinCtrl* cache_size_spin;
 
     wxConfigBase* config;
@@ -0,0 +1,34 @@
+#ifndef __REGION_MARKER_CTRL_HPP
+#define __REGION_MARKER_CTRL_HPP
+
+#include <wx/wx.h>
+
+namespace gui {
+
+// Thin strip under the position slider marking the A-B loop points.
+//
+// Positions are in milliseconds of a track of the given duration; -1 hides
+// a marker. With both set, the span between them is shaded.
+class RegionMarkerCtrl : public wxWindow
+{
+public:
+    RegionMarkerCtrl(wxWindow* parent, wxWindowID id = wxID_ANY);
+
+    void SetDuration(wxFileOffset duration_ms);
+    void SetRegion(wxFileOffset start_ms, wxFileOffset end_ms);
+
+    // Horizontal margin matching the slider's thumb travel
+    static const int TRACK_INSET = 8;
+
+private:
+    wxFileOffset duration;
+    wxFileOffset region_start;
+    wxFileOffset region_end;
+
+    void OnPaint(wxPaintEvent& event);
+    double PositionToX(wxFileOffset position_ms, const wxRect& track) const;
+};
+
+}
+
+#endif // __REGION_MARKER_CTRL_HPP
@@ -17,10 +17,16 @@ namespace gui::player {
 class Playlist; // Forward declaration to avoid circular reference
 }
 
+namespace utils {
+class ThreadPool;
+class LibraryWatcher;
+}
+
 class WanjPlayer : public wxApp
 {
 public:
   bool OnInit() override;
+  int OnExit() override;
   
 private:
 };
@@ -45,9 +51,19 @@ private: // UI Components
 
   std::size_t current_index;
 
+  // Background file analysis (silence trim) for the current and next track
+  std::unique_ptr<utils::ThreadPool> analysis_pool;
+
+  // Watched library folders; changes on disk are applied to the playlist
+  std::unique_ptr<utils::LibraryWatcher> library_watcher;
+
 private: // Helper methods
   void BindMenuEvents();
   void BindMediaEvents();
+  bool ApplyResumePosition(const wxString& path);
+  void ApplySilenceTrim(const wxString& path, bool seek_start);
+  void StartLibraryWatcher();
+  void SaveWatchedFolders();
 
 private: // Events
   // UI Events
@@ -55,6 +71,7 @@ private: // Events
   void OnAbout(wxCommandEvent& event);
   void OnFileOpen(wxCommandEvent& event);
   void OnFilesOpen(wxCommandEvent& event);
+  void OnWatchFolder(wxCommandEvent& event);
   void OnLicense(wxCommandEvent& event);
   void OnPreferences(wxCommandEvent& event);
 
@@ -67,6 +84,12 @@ private: // Events
   
   // Playlist toggle functionality
   void OnTogglePlaylist(wxCommandEvent& event);
+
+  // Audio visualization style
+  void OnVisualizationStyle(wxCommandEvent& event);
+
+  // Tools
+  void OnAnalyzeTempo(wxCommandEvent& event);
 };
 
 enum
@@ -82,7 +105,17 @@ enum
   ID_MEDIA_FINISHED,
   ID_MEDIA_CANVAS,
   ID_MEDIA_CTRL,
-  ID_TOGGLE_PLAYLIST
+  ID_TOGGLE_PLAYLIST,
+  // Keep in PlayerCanvas::SetVisualizationStyle order
+  ID_VIS_WAVEFORM,
+  ID_VIS_SPECTRUM,
+  ID_VIS_OSCILLOSCOPE,
+  ID_VIS_BARS,
+  ID_VIS_CIRCLE,
+  ID_VIS_SPECTROGRAM,
+  ID_ANALYZE_TEMPO,
+  ID_FUZZY_SEARCH,
+  ID_WATCH_FOLDER
 };
 
 #endif // !__WANJPLAYER__HPP
\ No newline at end of file
@@ -1,29 +1,152 @@
 #include "../include/canvas.hpp"
+#include "../include/level_meter_ctrl.hpp"
 #include "utils.hpp"
 #include <wx/dcbuffer.h>
 #include <wx/graphics.h>
 #include <wx/filename.h>
+#include <wx/config.h>
+#include <wx/display.h>
+#include <wx/rawbmp.h>
+#ifdef WANJPLAYER_HAVE_CAIRO
+#include <cairo.h>
+#endif
 #include <cmath>
+#include <cstring>
 #include <algorithm>
 #include <random>
 
 namespace gui {
 
+namespace {
+
+wxBitmap MakeArtBitmap(const utils::ArtCache::Image& art)
+{
+    // The pixels are only borrowed for the conversion
+    wxImage image(art.width, art.height, const_cast<unsigned char*>(art.rgb.data()), true);
+    if (!art.alpha.empty()) {
+        image.SetAlpha(const_cast<unsigned char*>(art.alpha.data()), true);
+    }
+    return wxBitmap(image);
+}
+
+// Pixels of VisualizationFrame, laid out as wxAlphaPixelData expects
+#ifdef wxHAS_PREMULTIPLIED_ALPHA
+constexpr bool NATIVE_PREMULTIPLIED = true;
+#else
+constexpr bool NATIVE_PREMULTIPLIED = false;
+#endif
+
+inline uint32_t PackPixel(unsigned r, unsigned g, unsigned b, unsigned a)
+{
+    uint32_t pixel;
+    unsigned char* bytes = reinterpret_cast<unsigned char*>(&pixel);
+    bytes[wxAlphaPixelFormat::RED] = r;
+    bytes[wxAlphaPixelFormat::GREEN] = g;
+    bytes[wxAlphaPixelFormat::BLUE] = b;
+    bytes[wxAlphaPixelFormat::ALPHA] = a;
+    return pixel;
+}
+
+inline uint32_t PackPremultiplied(unsigned r, unsigned g, unsigned b, unsigned a)
+{
+    if (!NATIVE_PREMULTIPLIED && a != 0 && a != 255) {
+        r = r * 255 / a;
+        g = g * 255 / a;
+        b = b * 255 / a;
+    }
+    return PackPixel(r, g, b, a);
+}
+
+inline uint32_t PackStraight(unsigned r, unsigned g, unsigned b, unsigned a)
+{
+    if (NATIVE_PREMULTIPLIED && a != 255) {
+        r = r * a / 255;
+        g = g * a / 255;
+        b = b * a / 255;
+    }
+    return PackPixel(r, g, b, a);
+}
+
+// True when pixels packed as 0xAABBGGRR (RasterSurface) or 0xAARRGGBB
+// (cairo's ARGB32), both premultiplied, already are in the bitmap's layout
+constexpr bool IsNativeLayout(int red_shift, int green_shift, int blue_shift)
+{
+    const bool little_endian = wxBYTE_ORDER == wxLITTLE_ENDIAN;
+    auto byte = [little_endian](int shift) { return little_endian ? shift / 8 : 3 - shift / 8; };
+    return NATIVE_PREMULTIPLIED &&
+           byte(red_shift) == wxAlphaPixelFormat::RED &&
+           byte(green_shift) == wxAlphaPixelFormat::GREEN &&
+           byte(blue_shift) == wxAlphaPixelFormat::BLUE &&
+           byte(24) == wxAlphaPixelFormat::ALPHA;
+}
+
+// One row of premultiplied pixels with the given channel positions
+template <int RED_SHIFT, int GREEN_SHIFT, int BLUE_SHIFT>
+void ConvertRow(const uint32_t* src, uint32_t* dest, int width)
+{
+    if constexpr (IsNativeLayout(RED_SHIFT, GREEN_SHIFT, BLUE_SHIFT)) {
+        std::memcpy(dest, src, static_cast<size_t>(width) * sizeof(uint32_t));
+    } else {
+        for (int x = 0; x < width; x++) {
+            uint32_t p = src[x];
+            dest[x] = p == 0 ? 0 : PackPremultiplied((p >> RED_SHIFT) & 0xFF, (p >> GREEN_SHIFT) & 0xFF,
+                                                     (p >> BLUE_SHIFT) & 0xFF, p >> 24);
+        }
+    }
+}
+
+void ClearRows(VisualizationFrame& frame, int top, int bottom)
+{
+    if (top < bottom) {
+        std::memset(frame.GetRow(top), 0, static_cast<size_t>(bottom - top) * frame.width * sizeof(uint32_t));
+    }
+}
+
+#ifdef WANJPLAYER_HAVE_CAIRO
+void SetSourceColor(cairo_t* cr, const wxColour& color, unsigned alpha)
+{
+    cairo_set_source_rgba(cr, color.Red() / 255.0, color.Green() / 255.0, color.Blue() / 255.0, alpha / 255.0);
+}
+#endif
+
+}
+
+void VisualizationFrame::Resize(int new_width, int new_height)
+{
+    if (width == new_width && height == new_height) {
+        return;
+    }
+    width = new_width;
+    height = new_height;
+    pixels.assign(static_cast<size_t>(width) * height, 0);
+    content_top = height;
+    content_bottom = 0;
+}
+
 // Event table
 wxBEGIN_EVENT_TABLE(PlayerCanvas, wxPanel)
     EVT_PAINT(PlayerCanvas::OnPaint)
     EVT_SIZE(PlayerCanvas::OnSize)
     EVT_ERASE_BACKGROUND(PlayerCanvas::OnEraseBackground)
     EVT_TIMER(wxID_ANY, PlayerCanvas::OnTimer)
-    EVT_IDLE(PlayerCanvas::OnIdle)
+    EVT_SHOW(PlayerCanvas::OnShow)
+    EVT_THREAD(wxID_ANY, PlayerCanvas::OnFrameReady)
 wxEND_EVENT_TABLE()
 
 PlayerCanvas::PlayerCanvas(wxWindow* parent, wxWindowID id)
     : wxPanel(parent, id, wxDefaultPosition, wxDefaultSize, wxWANTS_CHARS)
+    , media_ctrl(nullptr)
     , current_mode(DisplayMode::IDLE)
-    , audio_visualizer(std::make_unique<AudioVisualizer>())
-    , waveform_generator(std::make_unique<WaveformGenerator>())
+    , audio_engine(std::make_unique<utils::AudioEngine>())
+    , frame_bitmap_top(0)
+    , frame_bitmap_bottom(0)
     , visualization_style(0)
+    , meter_frame(0)
+    , meter_time(std::chrono::steady_clock::now())
+    , show_meters(true)
+    , meter_ctrl(nullptr)
+    , loop_start_ms(0)
+    , loop_end_ms(-1)
     , video_aspect_ratio(16.0 / 9.0)
     , video_scale_mode(0)
     , show_now_playing(false)
@@ -31,43 +154,65 @@ PlayerCanvas::PlayerCanvas(wxWindow* parent, wxWindowID id)
     , text_color(*wxWHITE)
     , accent_color(wxColour(0, 150, 136))
     , secondary_color(wxColour(76, 175, 80))
-    , animation_timer(this, wxID_ANY)
-    , visualization_timer(this, wxID_ANY)
+    , frame_timer(this, wxID_ANY)
+    , frame_epoch(std::chrono::steady_clock::now())
+    , frame_interval_ms(1000.0 / DEFAULT_FPS)
+    , top_level(nullptr)
     , animation_speed(1.0)
-    , animation_start_time(0)
     , animations_enabled(true)
     , graphics_renderer(nullptr)
     , double_buffered(true)
     , size_changed(true)
     , enable_smooth_rendering(true)
     , fps_limit(DEFAULT_FPS)
-    , last_frame_time(0)
 {
     SetBackgroundStyle(wxBG_STYLE_CUSTOM);
     InitializeGraphics();
 
-    // Initialize frequency and waveform data
-    frequency_data.resize(SPECTRUM_BARS, 0.0f);
-    waveform_data.resize(WAVEFORM_POINTS, 0.0f);
+    renderer = std::make_unique<VisualizationRenderer>(this, audio_engine->GetTap());
+    renderer->SetColor(accent_color);
+    renderer->Start();
+
+    // Art is decoded off the GUI thread; pending calls die with the canvas
+    utils::ArtCache::Get().SetCallback([this](const std::string& path) {
+        CallAfter([this, path] {
+            if (path == art_path) {
+                LoadCoverArt();
+            }
+        });
+    });
 
     // Setup fonts
     now_playing_font = wxFont(16, wxFONTFAMILY_DEFAULT, wxFONTSTYLE_NORMAL, wxFONTWEIGHT_BOLD);
+    title_font = wxFont(24, wxFONTFAMILY_DEFAULT, wxFONTSTYLE_NORMAL, wxFONTWEIGHT_LIGHT);
 
-    // Start animation timer
-    if (animations_enabled) {
-        animation_timer.Start(1000 / fps_limit);
+    // Minimizing the frame pauses the frame clock
+    top_level = wxDynamicCast(wxGetTopLevelParent(parent), wxTopLevelWindow);
+    if (top_level) {
+        top_level->Bind(wxEVT_ICONIZE, &PlayerCanvas::OnIconize, this);
     }
-
-    // Generate initial test data
-    GenerateTestFrequencyData();
+    UpdateFrameInterval();
 }
 
 PlayerCanvas::~PlayerCanvas()
 {
+    utils::ArtCache::Get().SetCallback(nullptr);
+    if (top_level) {
+        top_level->Unbind(wxEVT_ICONIZE, &PlayerCanvas::OnIconize, this);
+    }
+    // The control bar may already be gone
+    meter_ctrl = nullptr;
     StopAnimations();
     StopAudioVisualization();
+
+    // No frame-ready events may be queued once the canvas starts going away
+    renderer->Stop();
 }
 
+void PlayerCanvas::SetMediaCtrl(wxMediaCtrl* ctrl)
+{
+    media_ctrl = ctrl;
+}
 
 void PlayerCanvas::SetDisplayMode(DisplayMode mode)
 {
@@ -91,7 +236,7 @@ void PlayerCanvas::SetDisplayMode(DisplayMode mode)
                 break;
         }
 
-        wxPanel::Refresh();
+        InvalidateFrame();
     }
 }
 
@@ -99,55 +244,98 @@ void PlayerCanvas::StartAudioVisualization(const wxString& filename)
 {
     SetDisplayMode(DisplayMode::AUDIO_VIS);
 
-    // Extract filename for display
+    // Extract filename for display, with the tempo when it is known
     wxFileName fn(filename);
-    SetNowPlayingText("Now Playing: " + fn.GetName());
+    StoreTrackTempo();
+    audio_path = std::string(filename.utf8_str());
+    art_path = audio_path;
+    LoadCoverArt();
+    double bpm;
+    float bpm_confidence;
+    if (utils::BpmCache::Get().Lookup(audio_path, bpm, bpm_confidence) && bpm_confidence >= MIN_TEMPO_CONFIDENCE) {
+        SetNowPlayingText(wxString::Format("Now Playing: %s  -  %.0f BPM", fn.GetName(), bpm));
+    } else {
+        SetNowPlayingText("Now Playing: " + fn.GetName());
+    }
 
-    // Start visualization timer
-    if (!visualization_timer.IsRunning()) {
-        visualization_timer.Start(VISUALIZATION_UPDATE_MS);
+    wxConfigBase* config = wxConfigBase::Get();
+    renderer->SetSoftwareRendering(config->Read("/Performance/SoftwareVisualizer", true));
+    show_meters = config->Read("/General/CanvasLevelMeters", true);
+    ResetLevelMeter();
+
+    // Decode the same file for PCM-driven visuals; without a decoder for the
+    // format the visualizer keeps its synthetic fallback
+    renderer->ResetTrack();
+    if (audio_engine->Open(audio_path)) {
+        SetLoopRegion(loop_start_ms, loop_end_ms);
+        SyncAudioClock();
+    } else {
+        utils::LogUtils::LogDebug("No PCM decoder for " + fn.GetFullName() + ", using synthetic visuals");
     }
 
     // Initialize animation
-    animation_start_time = wxGetLocalTimeMillis().GetValue();
+    renderer->RestartAnimation();
+    InvalidateFrame();
 }
 
 void PlayerCanvas::StopAudioVisualization()
 {
-    if (visualization_timer.IsRunning()) {
-        visualization_timer.Stop();
-    }
+    frame_timer.Stop();
+
+    StoreTrackTempo();
+    audio_engine->Close();
 
-    // Clear visualization data
-    std::fill(frequency_data.begin(), frequency_data.end(), 0.0f);
-    std::fill(waveform_data.begin(), waveform_data.end(), 0.0f);
+    // Clears the PCM window and the visualization data
+    renderer->ResetTrack();
+    ResetLevelMeter();
 }
 
 void PlayerCanvas::PauseAudioVisualization()
 {
-    if (visualization_timer.IsRunning()) {
-        visualization_timer.Stop();
-    }
+    // Resumes on the next InvalidateFrame()
+    frame_timer.Stop();
 }
 
 void PlayerCanvas::UpdateVisualizationData(const std::vector<float>& freq_data)
 {
     if (current_mode == DisplayMode::AUDIO_VIS) {
-        // Update frequency data
-        size_t copy_size = std::min(freq_data.size(), frequency_data.size());
-        std::copy(freq_data.begin(), freq_data.begin() + copy_size, frequency_data.begin());
+        // Picked up by the next frame
+        renderer->SetFrequencyData(freq_data);
+        RequestVisualizationFrame();
+    }
+}
 
-        // Update visualizer
-        audio_visualizer->SetData(frequency_data, waveform_data);
 
-        wxPanel::Refresh();
+
+void PlayerCanvas::SetLoopRegion(wxFileOffset start_ms, wxFileOffset end_ms)
+{
+    loop_start_ms = start_ms;
+    loop_end_ms = end_ms;
+    if (!audio_engine->IsOpen()) {
+        return;
     }
-}
 
+    if (end_ms < 0) {
+        audio_engine->ClearLoop();
+    } else {
+        long long rate = audio_engine->GetSampleRate();
+        audio_engine->SetLoop(start_ms * rate / 1000, end_ms * rate / 1000);
+    }
+}
 
+void PlayerCanvas::SetLevelMeterCtrl(LevelMeterCtrl* ctrl)
+{
+    meter_ctrl = ctrl;
+    if (meter_ctrl) {
+        meter_ctrl->SetLevels(level_meter);
+    }
+}
 
 void PlayerCanvas::SetNowPlayingText(const wxString& text)
 {
+    if (text != now_playing_text) {
+        now_playing_layer = wxNullBitmap;
+    }
     now_playing_text = text;
     if (show_now_playing) {
         wxPanel::Refresh();
@@ -156,25 +344,35 @@ void PlayerCanvas::SetNowPlayingText(const wxString& text)
 
 void PlayerCanvas::ShowNowPlayingInfo(bool show)
 {
+    if (show == show_now_playing) {
+        return;
+    }
+    // The strip moves the visualization rect, and the cover in the cached
+    // background layer with it
     show_now_playing = show;
+    InvalidateLayers();
     wxPanel::Refresh();
 }
 
 void PlayerCanvas::SetBackgroundColor(const wxColour& color)
 {
     background_color = color;
+    InvalidateLayers();
     wxPanel::Refresh();
 }
 
 void PlayerCanvas::SetTextColor(const wxColour& color)
 {
     text_color = color;
+    InvalidateLayers();
     wxPanel::Refresh();
 }
 
 void PlayerCanvas::SetAccentColor(const wxColour& color)
 {
     accent_color = color;
+    renderer->SetColor(color);
+    InvalidateLayers();
     wxPanel::Refresh();
 }
 
@@ -197,35 +395,50 @@ void PlayerCanvas::SetVisualizationStyle(int style)
         case 4:
             vis_type = AudioVisualizer::VisualizationType::CIRCLE;
             break;
+        case 5:
+            vis_type = AudioVisualizer::VisualizationType::SPECTROGRAM;
+            break;
         default:
             vis_type = AudioVisualizer::VisualizationType::WAVEFORM;
             break;
     }
 
-    audio_visualizer->SetType(vis_type);
-    wxPanel::Refresh();
+    renderer->SetType(vis_type);
+    InvalidateFrame();
 }
 
 void PlayerCanvas::StartAnimations()
 {
     animations_enabled = true;
-    if (!animation_timer.IsRunning()) {
-        animation_timer.Start(1000 / fps_limit);
-    }
-    animation_start_time = wxGetLocalTimeMillis().GetValue();
+    renderer->RestartAnimation();
+    InvalidateFrame();
 }
 
 void PlayerCanvas::StopAnimations()
 {
     animations_enabled = false;
-    if (animation_timer.IsRunning()) {
-        animation_timer.Stop();
+    frame_timer.Stop();
+}
+
+void PlayerCanvas::InvalidateFrame()
+{
+    // Hidden or minimized: OnShow/OnIconize pick things up again
+    if (!IsFrameVisible()) {
+        return;
+    }
+
+    renderer->SetActive(true);
+    RequestVisualizationFrame();
+    wxPanel::Refresh();
+    if (WantsFrames()) {
+        ScheduleFrame();
     }
 }
 
 void PlayerCanvas::SetAnimationSpeed(double speed)
 {
     animation_speed = std::max(0.1, std::min(5.0, speed));
+    renderer->SetAnimationSpeed(animation_speed);
 }
 
 void PlayerCanvas::Clear()
@@ -249,38 +462,40 @@ void PlayerCanvas::OnPaint(wxPaintEvent& event)
 {
     utils::PerformanceTimer timer("OnPaint");
     wxAutoBufferedPaintDC dc(this);
-    wxGraphicsContext* gc = wxGraphicsContext::Create(dc);
 
-    if (!gc) {
+    wxRect rect = GetClientRect();
+    if (rect.IsEmpty()) {
         return;
     }
+    EnsureLayers(rect.GetSize());
 
-    wxRect rect = GetClientRect();
+    // Idle is fully static: one blit
+    if (current_mode == DisplayMode::IDLE) {
+        dc.DrawBitmap(idle_layer, 0, 0);
+    } else {
+        if (current_mode == DisplayMode::AUDIO_VIS) {
+            dc.DrawBitmap(background_layer, 0, 0);
+        }
 
-    // Clear background
-    DrawBackground(gc, rect);
+        wxGraphicsContext* gc = wxGraphicsContext::Create(dc);
+        if (!gc) {
+            return;
+        }
 
-    // Draw content based on current mode
-    switch (current_mode) {
-        case DisplayMode::VIDEO:
+        // Dynamic layer
+        if (current_mode == DisplayMode::VIDEO) {
+            DrawBackground(gc, rect);
             DrawVideoContent(gc, rect);
-            break;
-
-        case DisplayMode::AUDIO_VIS:
+        } else {
             DrawAudioVisualization(gc, rect);
-            break;
+        }
 
-        case DisplayMode::IDLE:
-            DrawIdleScreen(gc, rect);
-            break;
+        delete gc;
     }
 
-    // Draw now playing info if enabled
-    if (show_now_playing) {
-        DrawNowPlayingInfo(gc, rect);
+    if (show_now_playing && now_playing_layer.IsOk()) {
+        dc.DrawBitmap(now_playing_layer, 0, rect.height - NOW_PLAYING_HEIGHT, true);
     }
-
-    delete gc;
 }
 
 void PlayerCanvas::OnSize(wxSizeEvent& event)
@@ -298,27 +513,98 @@ void PlayerCanvas::OnEraseBackground(wxEraseEvent& event)
 
 void PlayerCanvas::OnTimer(wxTimerEvent& event)
 {
-    if (event.GetTimer().GetId() == animation_timer.GetId()) {
-        UpdateAnimations();
-        if (current_mode == DisplayMode::AUDIO_VIS || current_mode == DisplayMode::IDLE) {
-            wxPanel::Refresh();
-        }
-    } else if (event.GetTimer().GetId() == visualization_timer.GetId()) {
-        // Generate test data for visualization
-        GenerateTestFrequencyData();
-        audio_visualizer->Update();
-        wxPanel::Refresh();
+    // The clock stops here while hidden; nothing reschedules it until the
+    // canvas is shown or restored
+    if (!IsFrameVisible()) {
+        return;
+    }
+
+    // The renderer advances animation and data together; its frame-ready
+    // event triggers the paint
+    SyncAudioClock();
+    UpdateLevelMeter();
+    RequestVisualizationFrame();
+
+    if (WantsFrames()) {
+        ScheduleFrame();
+    }
+}
+
+void PlayerCanvas::OnShow(wxShowEvent& event)
+{
+    // wxSimplebook shows and hides its pages as the selection changes
+    if (event.IsShown()) {
+        UpdateFrameInterval();
+        InvalidateFrame();
+    } else {
+        frame_timer.Stop();
+        renderer->SetActive(false);
+    }
+    event.Skip();
+}
+
+void PlayerCanvas::OnIconize(wxIconizeEvent& event)
+{
+    if (event.IsIconized()) {
+        frame_timer.Stop();
+        renderer->SetActive(false);
+    } else {
+        InvalidateFrame();
+    }
+    event.Skip();
+}
+
+void PlayerCanvas::OnFrameReady(wxThreadEvent& event)
+{
+    // Render time is measured on the worker; the statistics are GUI-only
+    renderer->AcknowledgeFrame();
+    utils::PerformanceUtils::RecordOperation("VisualizationRenderer::RenderFrame", renderer->GetLastRenderTime());
+    wxPanel::Refresh();
+}
+
+bool PlayerCanvas::IsFrameVisible() const
+{
+    return IsShownOnScreen() && !(top_level && top_level->IsIconized());
+}
+
+bool PlayerCanvas::WantsFrames() const
+{
+    // The idle screen and a paused track do not change between frames
+    if (!animations_enabled || current_mode != DisplayMode::AUDIO_VIS) {
+        return false;
+    }
+    return !media_ctrl || media_ctrl->GetState() == wxMEDIASTATE_PLAYING;
+}
+
+void PlayerCanvas::ScheduleFrame()
+{
+    if (frame_timer.IsRunning()) {
+        return;
     }
+
+    // Aim for the next grid point rather than "now + interval" so timer
+    // latency does not accumulate into drift against the display
+    double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frame_epoch).count();
+    double next = (std::floor(elapsed / frame_interval_ms) + 1.0) * frame_interval_ms;
+    frame_timer.StartOnce(std::max(1, static_cast<int>(std::ceil(next - elapsed))));
 }
 
-void PlayerCanvas::OnIdle(wxIdleEvent& event)
+void PlayerCanvas::UpdateFrameInterval()
 {
-    // Limit frame rate
-    long long current_time = wxGetLocalTimeMillis().GetValue();
-    if (current_time - last_frame_time >= (1000 / fps_limit)) {
-        last_frame_time = current_time;
-        event.RequestMore();
+    // Whole refresh periods of the display the canvas is on, at or below
+    // the frame-rate limit (60 Hz assumed when the mode is unknown)
+    int refresh = 0;
+    int display = wxDisplay::GetFromWindow(this);
+    if (display != wxNOT_FOUND) {
+        refresh = wxDisplay(static_cast<unsigned>(display)).GetCurrentMode().refresh;
+    }
+    if (refresh <= 0) {
+        refresh = 60;
     }
+
+    double period = 1000.0 / refresh;
+    int periods_per_frame = std::max(1, static_cast<int>(std::ceil(static_cast<double>(refresh) / fps_limit)));
+    frame_interval_ms = period * periods_per_frame;
 }
 
 void PlayerCanvas::DrawVideoContent(wxGraphicsContext* gc, const wxRect& rect)
@@ -341,19 +627,31 @@ void PlayerCanvas::DrawVideoContent(wxGraphicsContext* gc, const wxRect& rect)
 
 void PlayerCanvas::DrawAudioVisualization(wxGraphicsContext* gc, const wxRect& rect)
 {
-    // Create visualization area (leave space for text)
-    wxRect vis_rect = rect;
-    if (show_now_playing) {
-        vis_rect.height -= 80; // Leave space at bottom for text
+    wxRect vis_rect = GetVisualizationRect(rect);
+
+    // Newest finished frame; repaints without a new frame reuse the bitmap.
+    // During a resize the last frame is stretched until a new one arrives.
+    bool updated = false;
+    const VisualizationFrame* frame = renderer->AcquireFrame(updated);
+    if (frame && (updated || !frame_bitmap.IsOk())) {
+        UploadFrame(*frame);
+    }
+    if (frame_bitmap.IsOk()) {
+        gc->DrawBitmap(frame_bitmap, vis_rect.x, vis_rect.y, vis_rect.width, vis_rect.height);
     }
-
-    // Draw visualization
-    audio_visualizer->Draw(gc, vis_rect, accent_color);
 
     // Add subtle glow effect with simple gradient
     wxColour glow_color(accent_color.Red(), accent_color.Green(), accent_color.Blue(), 30);
     gc->SetBrush(wxBrush(glow_color));
     gc->DrawRectangle(vis_rect.x, vis_rect.y, vis_rect.width, vis_rect.height);
+
+    // Meters change every frame but are only a few rectangles, so they are
+    // drawn here rather than in the rendered frame
+    if (show_meters && audio_engine->IsOpen() && vis_rect.height > 4 * METER_MARGIN) {
+        wxRect meter_rect(vis_rect.GetRight() - METER_MARGIN - METER_WIDTH, vis_rect.y + METER_MARGIN,
+                          METER_WIDTH, vis_rect.height - 2 * METER_MARGIN);
+        LevelMeterCtrl::DrawMeters(gc, meter_rect, level_meter, true);
+    }
 }
 
 void PlayerCanvas::DrawIdleScreen(wxGraphicsContext* gc, const wxRect& rect)
@@ -362,8 +660,9 @@ void PlayerCanvas::DrawIdleScreen(wxGraphicsContext* gc, const wxRect& rect)
     gc->SetBrush(wxBrush(wxColour(16, 16, 16)));
     gc->DrawRectangle(rect.x, rect.y, rect.width, rect.height);
 
-    // Draw animated circles
-    double progress = GetAnimationProgress();
+    // Concentric circles; the idle screen is cached, so they are drawn at
+    // a fixed phase
+    double progress = 0.0;
     int num_circles = 5;
 
     for (int i = 0; i < num_circles; i++) {
@@ -382,8 +681,7 @@ void PlayerCanvas::DrawIdleScreen(wxGraphicsContext* gc, const wxRect& rect)
     }
 
     // Draw application name
-    gc->SetFont(wxFont(24, wxFONTFAMILY_DEFAULT, wxFONTSTYLE_NORMAL, wxFONTWEIGHT_LIGHT),
-                wxColour(text_color.Red(), text_color.Green(), text_color.Blue(), 128));
+    gc->SetFont(title_font, wxColour(text_color.Red(), text_color.Green(), text_color.Blue(), 128));
 
     wxString app_name = "WanjPlayer";
     wxDouble text_width, text_height;
@@ -403,8 +701,8 @@ void PlayerCanvas::DrawNowPlayingInfo(wxGraphicsContext* gc, const wxRect& rect)
 
     // Create text area at bottom
     wxRect text_area = rect;
-    text_area.y = rect.y + rect.height - 80;
-    text_area.height = 80;
+    text_area.y = rect.y + rect.height - NOW_PLAYING_HEIGHT;
+    text_area.height = NOW_PLAYING_HEIGHT;
 
     // Draw semi-transparent background
     wxColour bg_color(0, 0, 0, 180);
@@ -422,6 +720,12 @@ void PlayerCanvas::DrawNowPlayingInfo(wxGraphicsContext* gc, const wxRect& rect)
 
     gc->DrawText(now_playing_text, x, y);
 
+    if (cover_thumbnail.IsOk()) {
+        double art_y = text_area.y + (text_area.height - cover_thumbnail.GetHeight()) / 2.0;
+        gc->DrawBitmap(cover_thumbnail, text_area.x + METER_MARGIN, art_y,
+                       cover_thumbnail.GetWidth(), cover_thumbnail.GetHeight());
+    }
+
     // Draw decorative line
     gc->SetPen(wxPen(accent_color, 2));
     double line_width = text_width * 0.8;
@@ -453,19 +757,221 @@ void PlayerCanvas::InitializeGraphics()
     graphics_renderer = wxGraphicsRenderer::GetDefaultRenderer();
 }
 
+void PlayerCanvas::SyncAudioClock()
+{
+    if (!media_ctrl || !audio_engine->IsOpen()) {
+        return;
+    }
+
+    bool playing = media_ctrl->GetState() == wxMEDIASTATE_PLAYING;
+    double rate = media_ctrl->GetPlaybackRate();
+    audio_engine->SetClock(media_ctrl->Tell(), playing, rate > 0.0 ? rate : 1.0);
+}
+
+wxRect PlayerCanvas::GetVisualizationRect(const wxRect& rect) const
+{
+    // Leave space at the bottom for the now playing strip
+    wxRect vis_rect = rect;
+    if (show_now_playing) {
+        vis_rect.height = std::max(0, vis_rect.height - NOW_PLAYING_HEIGHT);
+    }
+    return vis_rect;
+}
+
+void PlayerCanvas::UpdateLevelMeter()
+{
+    auto now = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(now - meter_time).count();
+    meter_time = now;
+    if (!audio_engine->IsOpen()) {
+        return;
+    }
+
+    // Blocks played since the last tick; after a pause the first tick
+    // should not age the meters by the whole pause
+    seconds = std::min(seconds, 0.1);
+    long long frame = audio_engine->GetPlaybackFrame();
+    utils::LevelReading reading;
+    if (audio_engine->GetLevels().Read(meter_frame, frame, reading)) {
+        level_meter.Update(reading, seconds);
+    } else {
+        level_meter.Decay(seconds);
+    }
+    meter_frame = frame;
+
+    if (meter_ctrl) {
+        meter_ctrl->SetLevels(level_meter);
+    }
+}
+
+void PlayerCanvas::ResetLevelMeter()
+{
+    level_meter.Reset();
+    meter_frame = 0;
+    meter_time = std::chrono::steady_clock::now();
+    if (meter_ctrl) {
+        meter_ctrl->SetLevels(level_meter);
+    }
+}
+
+void PlayerCanvas::RequestVisualizationFrame()
+{
+    if (current_mode != DisplayMode::AUDIO_VIS) {
+        return;
+    }
+
+    // The clock and beat grid are read here so the worker never touches the
+    // engine, which the GUI thread opens and closes
+    long long end_frame = -1;
+    double beat_phase = 0.0;
+    float beat_confidence = 0.0f;
+    if (audio_engine->IsOpen()) {
+        end_frame = audio_engine->GetPlaybackFrame();
+        if (!audio_engine->GetBeats().GetBeat(end_frame, beat_phase, beat_confidence)) {
+            beat_confidence = 0.0f;
+        }
+    }
+    renderer->RequestFrame(GetVisualizationRect(GetClientRect()).GetSize(), end_frame, beat_phase, beat_confidence);
+}
+
+void PlayerCanvas::StoreTrackTempo()
+{
+    // Live estimates only cover what was played; the cache keeps whichever
+    // estimate of a file is the most confident
+    double bpm;
+    float confidence;
+    if (audio_engine->IsOpen() && !audio_path.empty() && audio_engine->GetBeats().GetTrackBpm(bpm, confidence)) {
+        utils::BpmCache::Get().Store(audio_path, bpm, confidence);
+    }
+}
+
+bool PlayerCanvas::UploadFrame(const VisualizationFrame& frame)
+{
+    const int width = frame.width;
+    const int height = frame.height;
+
+    if (!frame_bitmap.IsOk() || frame_bitmap.GetWidth() != width || frame_bitmap.GetHeight() != height) {
+        frame_bitmap.Create(width, height, 32);
+        frame_bitmap_top = 0;
+        frame_bitmap_bottom = height;
+    }
+
+    wxAlphaPixelData data(frame_bitmap);
+    if (!data) return false;
+
+    // The worker already packed the pixels for the bitmap. Only rows that
+    // hold content now, or held it in the bitmap, need copying; the rest
+    // are transparent on both sides.
+    const int top = std::min(frame_bitmap_top, frame.content_top);
+    const int bottom = std::max(frame_bitmap_bottom, frame.content_bottom);
+    const size_t row_bytes = static_cast<size_t>(width) * sizeof(uint32_t);
+    wxAlphaPixelData::Iterator row(data);
+    row.OffsetY(data, top);
+    for (int y = top; y < bottom; y++) {
+        std::memcpy(&row.Data(), frame.GetRow(y), row_bytes);
+        row.OffsetY(data, 1);
+    }
+
+    frame_bitmap_top = frame.content_top;
+    frame_bitmap_bottom = frame.content_bottom;
+    return true;
+}
+
+void PlayerCanvas::LoadCoverArt()
+{
+    // Whatever is not in memory yet arrives through the cache's callback
+    utils::ArtCache& cache = utils::ArtCache::Get();
+    auto cover = cache.Find(art_path, utils::ArtCache::COVER);
+    auto thumbnail = cache.Find(art_path, utils::ArtCache::THUMBNAIL);
+    cover_art = cover ? MakeArtBitmap(*cover) : wxNullBitmap;
+    cover_thumbnail = thumbnail ? MakeArtBitmap(*thumbnail) : wxNullBitmap;
+
+    InvalidateLayers();
+    wxPanel::Refresh();
+}
+
+void PlayerCanvas::DrawCoverArt(wxGraphicsContext* gc, const wxRect& rect)
+{
+    if (!cover_art.IsOk()) {
+        return;
+    }
+
+    // Fitted to the visualization area and dimmed so the plot stays legible
+    wxRect area = GetVisualizationRect(rect);
+    if (area.IsEmpty()) {
+        return;
+    }
+    double scale = std::min(static_cast<double>(area.width) / cover_art.GetWidth(),
+                            static_cast<double>(area.height) / cover_art.GetHeight());
+    double width = cover_art.GetWidth() * scale;
+    double height = cover_art.GetHeight() * scale;
+    double x = area.x + (area.width - width) / 2.0;
+    double y = area.y + (area.height - height) / 2.0;
+    gc->DrawBitmap(cover_art, x, y, width, height);
+
+    gc->SetBrush(wxBrush(wxColour(background_color.Red(), background_color.Green(), background_color.Blue(), 160)));
+    gc->DrawRectangle(x, y, width, height);
+}
+
 void PlayerCanvas::UpdateCanvasSize()
 {
     if (size_changed) {
-        // Update buffer bitmap if using double buffering
-        if (double_buffered) {
-            if (canvas_size.x > 0 && canvas_size.y > 0) {
-                buffer_bitmap = wxBitmap(canvas_size);
-            }
-        }
+        InvalidateLayers();
         size_changed = false;
     }
 }
 
+void PlayerCanvas::InvalidateLayers()
+{
+    background_layer = wxNullBitmap;
+    idle_layer = wxNullBitmap;
+    now_playing_layer = wxNullBitmap;
+}
+
+wxBitmap PlayerCanvas::CreateLayerBitmap(const wxSize& size) const
+{
+    // Start fully transparent so translucent layers composite correctly
+    wxImage image(size);
+    image.InitAlpha();
+    std::fill_n(image.GetAlpha(), static_cast<size_t>(size.x) * size.y, 0);
+    return wxBitmap(image, 32);
+}
+
+void PlayerCanvas::EnsureLayers(const wxSize& size)
+{
+    wxRect full(size);
+
+    if (current_mode == DisplayMode::AUDIO_VIS && !background_layer.IsOk()) {
+        background_layer = CreateLayerBitmap(size);
+        wxMemoryDC mdc(background_layer);
+        std::unique_ptr<wxGraphicsContext> gc(wxGraphicsContext::Create(mdc));
+        if (gc) {
+            DrawBackground(gc.get(), full);
+            DrawCoverArt(gc.get(), full);
+        }
+    }
+
+    if (current_mode == DisplayMode::IDLE && !idle_layer.IsOk()) {
+        idle_layer = CreateLayerBitmap(size);
+        wxMemoryDC mdc(idle_layer);
+        std::unique_ptr<wxGraphicsContext> gc(wxGraphicsContext::Create(mdc));
+        if (gc) {
+            DrawBackground(gc.get(), full);
+            DrawIdleScreen(gc.get(), full);
+        }
+    }
+
+    if (show_now_playing && !now_playing_layer.IsOk() && !now_playing_text.IsEmpty()) {
+        wxSize strip(size.x, NOW_PLAYING_HEIGHT);
+        now_playing_layer = CreateLayerBitmap(strip);
+        wxMemoryDC mdc(now_playing_layer);
+        std::unique_ptr<wxGraphicsContext> gc(wxGraphicsContext::Create(mdc));
+        if (gc) {
+            DrawNowPlayingInfo(gc.get(), wxRect(strip));
+        }
+    }
+}
+
 void PlayerCanvas::CalculateVideoRect(const wxRect& canvas_rect, wxRect& video_rect)
 {
     if (video_scale_mode == 0) { // Fit
@@ -494,30 +1000,6 @@ void PlayerCanvas::CalculateVideoRect(const wxRect& canvas_rect, wxRect& video_r
     }
 }
 
-void PlayerCanvas::GenerateTestFrequencyData()
-{
-    if (current_mode != DisplayMode::AUDIO_VIS) {
-        return;
-    }
-
-    // Use a simple random generator to create more dynamic-looking test data
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_real_distribution<float> dis(0.0f, 1.0f);
-
-    // Generate random frequency data to simulate a lively audio track
-    for (size_t i = 0; i < frequency_data.size(); ++i) {
-        // Introduce some randomness and smooth transitions
-        float random_val = dis(gen);
-        frequency_data[i] = (frequency_data[i] * 0.7f) + (random_val * 0.3f);
-    }
-
-    // Generate a more complex waveform than a simple sine wave
-    double time = GetAnimationProgress() * animation_speed;
-    waveform_generator->GenerateWaveform(waveform_data, WAVEFORM_POINTS, 220.0 + 110.0 * sin(time * 2), 0.6, time);
-    waveform_generator->AddNoise(waveform_data, 0.1);
-}
-
 wxRect PlayerCanvas::CalculateCenteredRect(const wxSize& content_size, const wxRect& container)
 {
     wxRect centered;
@@ -528,37 +1010,318 @@ wxRect PlayerCanvas::CalculateCenteredRect(const wxSize& content_size, const wxR
     return centered;
 }
 
-void PlayerCanvas::UpdateAnimations()
+// VisualizationRenderer implementation
+
+VisualizationRenderer::VisualizationRenderer(wxEvtHandler* owner, const utils::PcmTap& tap)
+    : owner(owner)
+    , tap(tap)
+    , running(false)
+    , active(true)
+    , frame_requested(false)
+    , frame_in_flight(false)
+    , frequency_pending(false)
+    , visualizer(std::make_unique<AudioVisualizer>())
+    , waveform_generator(std::make_unique<WaveformGenerator>())
+    , rng(std::random_device()())
+    , track_generation(0)
+    , animation_generation(0)
+    , animation_start(std::chrono::steady_clock::now())
+    , render_time_ms(0)
+{
+    pending.type = AudioVisualizer::VisualizationType::WAVEFORM;
+    pending.red = 0;
+    pending.green = 150;
+    pending.blue = 136;
+    pending.software_rendering = true;
+    pending.animation_speed = 1.0;
+    pending.track_generation = 0;
+    pending.animation_generation = 0;
+    pending.size = wxSize(0, 0);
+    pending.pcm_end_frame = -1;
+    pending.beat_phase = 0.0;
+    pending.beat_confidence = 0.0f;
+
+    frequency_data.resize(SPECTRUM_BARS, 0.0f);
+    waveform_data.resize(WAVEFORM_POINTS, 0.0f);
+}
+
+VisualizationRenderer::~VisualizationRenderer()
+{
+    Stop();
+}
+
+void VisualizationRenderer::Start()
 {
-    if (animations_enabled && audio_visualizer) {
-        audio_visualizer->Update();
+    std::lock_guard<std::mutex> lock(mutex);
+    if (running) {
+        return;
     }
+    running = true;
+    worker = std::thread(&VisualizationRenderer::Run, this);
 }
 
-double PlayerCanvas::GetAnimationProgress() const
+void VisualizationRenderer::Stop()
 {
-    if (animation_start_time == 0) {
-        return 0.0;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+    }
+    wake.notify_all();
+    if (worker.joinable()) {
+        worker.join();
     }
+}
 
-    long long current_time = wxGetLocalTimeMillis().GetValue();
-    double elapsed = (current_time - animation_start_time) / 1000.0; // Convert to seconds
-    return fmod(elapsed * animation_speed, 1.0);
+void VisualizationRenderer::SetType(AudioVisualizer::VisualizationType type)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    pending.type = type;
 }
 
-// AudioVisualizer implementation
+void VisualizationRenderer::SetColor(const wxColour& color)
+{
+    // Plain channels: wxColour copies are not safe to share across threads
+    std::lock_guard<std::mutex> lock(mutex);
+    pending.red = color.Red();
+    pending.green = color.Green();
+    pending.blue = color.Blue();
+}
 
-AudioVisualizer::AudioVisualizer()
-    : vis_type(VisualizationType::WAVEFORM)
-    , sensitivity(1.0)
+void VisualizationRenderer::SetSoftwareRendering(bool enable)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    pending.software_rendering = enable;
+}
+
+void VisualizationRenderer::SetAnimationSpeed(double speed)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    pending.animation_speed = speed;
+}
+
+void VisualizationRenderer::SetFrequencyData(const std::vector<float>& data)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    pending_frequency.assign(data.begin(), data.end());
+    frequency_pending = true;
+}
+
+void VisualizationRenderer::ResetTrack()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    pending.track_generation++;
+    pending.pcm_end_frame = -1;
+    pending.beat_confidence = 0.0f;
+}
+
+void VisualizationRenderer::RestartAnimation()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    pending.animation_generation++;
+}
+
+void VisualizationRenderer::SetActive(bool enable)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        active = enable;
+    }
+    wake.notify_one();
+}
+
+void VisualizationRenderer::RequestFrame(const wxSize& size, long long pcm_end_frame, double beat_phase, float beat_confidence)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.size = size;
+        pending.pcm_end_frame = pcm_end_frame;
+        pending.beat_phase = beat_phase;
+        pending.beat_confidence = beat_confidence;
+        frame_requested = true;
+    }
+    wake.notify_one();
+}
+
+const VisualizationFrame* VisualizationRenderer::AcquireFrame(bool& updated)
+{
+    updated = exchange.Acquire();
+    return exchange.HasFrame() ? &frames[exchange.GetReadIndex()] : nullptr;
+}
+
+void VisualizationRenderer::AcknowledgeFrame()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        frame_in_flight = false;
+    }
+    wake.notify_one();
+}
+
+void VisualizationRenderer::Run()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        // Requests arrive at the canvas frame rate; a hidden canvas or a GUI
+        // thread that is still busy with the last frame holds them back
+        wake.wait(lock, [this] {
+            return !running || (active && frame_requested && !frame_in_flight);
+        });
+        if (!running) {
+            break;
+        }
+
+        frame_requested = false;
+        Settings settings = pending;
+        bool frequency_updated = frequency_pending;
+        if (frequency_pending) {
+            frequency_update.swap(pending_frequency);
+            frequency_pending = false;
+        }
+
+        // Rendering itself runs unlocked
+        lock.unlock();
+        RenderFrame(settings, frequency_updated);
+        lock.lock();
+    }
+}
+
+void VisualizationRenderer::RenderFrame(const Settings& settings, bool frequency_updated)
+{
+    if (settings.track_generation != track_generation) {
+        track_generation = settings.track_generation;
+        visualizer->ClearPcm();
+        std::fill(frequency_data.begin(), frequency_data.end(), 0.0f);
+        std::fill(waveform_data.begin(), waveform_data.end(), 0.0f);
+    }
+    if (settings.animation_generation != animation_generation) {
+        animation_generation = settings.animation_generation;
+        animation_start = std::chrono::steady_clock::now();
+    }
+    if (settings.size.x <= 0 || settings.size.y <= 0) {
+        return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    visualizer->SetType(settings.type);
+    visualizer->SetSoftwareRendering(settings.software_rendering);
+
+    // Animation and data advance together, once per frame
+    GenerateTestFrequencyData(settings);
+    if (frequency_updated) {
+        size_t copy_size = std::min(frequency_update.size(), frequency_data.size());
+        std::copy(frequency_update.begin(), frequency_update.begin() + copy_size, frequency_data.begin());
+        visualizer->SetData(frequency_data, waveform_data);
+    }
+    visualizer->Update(settings.beat_phase, settings.beat_confidence);
+
+    // Pick up the PCM window ending at the playback position of the request
+    if (settings.pcm_end_frame >= 0) {
+        visualizer->CapturePcm(tap, settings.pcm_end_frame);
+    }
+
+    VisualizationFrame& frame = frames[exchange.GetWriteIndex()];
+    frame.Resize(settings.size.x, settings.size.y);
+    visualizer->Render(frame, wxColour(settings.red, settings.green, settings.blue));
+
+    render_time_ms.store(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
+
+    exchange.Publish();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        frame_in_flight = true;
+    }
+    wxQueueEvent(owner, new wxThreadEvent());
+}
+
+void VisualizationRenderer::GenerateTestFrequencyData(const Settings& settings)
+{
+    const double animation_speed = settings.animation_speed;
+    std::uniform_real_distribution<float> dis(0.0f, 1.0f);
+
+    // Generate random frequency data to simulate a lively audio track
+    for (size_t i = 0; i < frequency_data.size(); ++i) {
+        // Introduce some randomness and smooth transitions
+        float random_val = dis(rng);
+        frequency_data[i] = (frequency_data[i] * 0.7f) + (random_val * 0.3f);
+    }
+
+    // Generate a more complex waveform than a simple sine wave
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - animation_start).count();
+    double time = fmod(elapsed * animation_speed, 1.0) * animation_speed;
+
+    // Sweep the pitch once per beat when the tempo is known, otherwise drift
+    double sweep = settings.beat_confidence * cos(2 * M_PI * settings.beat_phase)
+                 + (1.0 - settings.beat_confidence) * sin(time * 2);
+    waveform_generator->GenerateWaveform(waveform_data, WAVEFORM_POINTS, 220.0 + 110.0 * sweep, 0.6, time);
+    waveform_generator->AddNoise(waveform_data, 0.1);
+}
+
+// AudioVisualizer implementation
+
+#ifdef WANJPLAYER_HAVE_CAIRO
+// The vector modes draw with cairo on pixels of their own, through one
+// context that is made again only when the plot is resized
+struct AudioVisualizer::VectorTarget
+{
+    int width = 0;
+    int height = 0;
+    std::vector<uint32_t> pixels;       // cairo ARGB32
+    cairo_t* cairo = nullptr;
+
+    ~VectorTarget()
+    {
+        if (cairo) {
+            cairo_destroy(cairo);
+        }
+    }
+};
+#else
+// Without cairo the vector modes are rasterized as well
+struct AudioVisualizer::VectorTarget
+{
+};
+#endif
+
+AudioVisualizer::AudioVisualizer()
+    : vis_type(VisualizationType::WAVEFORM)
+    , sensitivity(1.0)
     , smoothness(0.8)
     , bar_count(64)
     , amplification(1.5)
     , phase_offset(0.0)
+    , beat_pulse(0.0)
+    , has_pcm(false)
+    , pcm_end_frame(0)
+    , pcm_sample_rate(0)
+    , spectrum_analyzer(std::make_unique<utils::SpectrumAnalyzer>())
+    , spectrogram_column(0)
+    , spectrogram_rate(0)
+    , spectrogram_frame(-1)
+    , software_rendering(true)
 {
     current_freq_data.resize(bar_count, 0.0f);
     current_wave_data.resize(256, 0.0f);
     smoothed_data.resize(bar_count, 0.0f);
+    pcm_snapshot.resize(PCM_SNAPSHOT_FRAMES, 0.0f);
+    column_min.resize(1024, 0.0f);
+    column_max.resize(1024, 0.0f);
+
+    spectrum_analyzer->Configure(SPECTROGRAM_FFT);
+    spectrum_magnitudes.resize(spectrum_analyzer->GetBinCount(), 0.0f);
+
+    // Dark-to-bright colormap, interpolated once into a lookup table
+    static const unsigned char stops[5][3] = {
+        {0, 0, 4}, {87, 16, 110}, {188, 55, 84}, {249, 142, 9}, {252, 255, 164}
+    };
+    for (int i = 0; i < 256; i++) {
+        double pos = i / 255.0 * 4.0;
+        int stop = std::min(3, static_cast<int>(pos));
+        double t = pos - stop;
+        for (int c = 0; c < 3; c++) {
+            colormap[i][c] = static_cast<unsigned char>(stops[stop][c] + (stops[stop + 1][c] - stops[stop][c]) * t + 0.5);
+        }
+    }
 }
 
 AudioVisualizer::~AudioVisualizer() = default;
@@ -581,30 +1344,45 @@ void AudioVisualizer::SetData(const std::vector<float>& frequency_data, const st
     SmoothData();
 }
 
-void AudioVisualizer::Draw(wxGraphicsContext* gc, const wxRect& rect, const wxColour& color)
+bool AudioVisualizer::CapturePcm(const utils::PcmTap& tap, long long end_frame)
 {
-    switch (vis_type) {
-        case VisualizationType::WAVEFORM:
-            DrawWaveformVis(gc, rect, color);
-            break;
-        case VisualizationType::SPECTRUM:
-            DrawSpectrumVis(gc, rect, color);
-            break;
-        case VisualizationType::BARS:
-            DrawBarsVis(gc, rect, color);
-            break;
-        case VisualizationType::CIRCLE:
-            DrawCircleVis(gc, rect, color);
-            break;
-        default:
-            DrawWaveformVis(gc, rect, color);
-            break;
+    // A failed snapshot (seek in progress, not decoded yet) keeps the last
+    // good window on screen rather than flashing the fallback
+    if (tap.Snapshot(end_frame, pcm_snapshot.data(), pcm_snapshot.size())) {
+        has_pcm = true;
+        pcm_end_frame = end_frame;
+        pcm_sample_rate = tap.GetSampleRate();
     }
+    return has_pcm;
 }
 
-void AudioVisualizer::Update()
+void AudioVisualizer::ClearPcm()
 {
-    phase_offset += 0.05;
+    has_pcm = false;
+    spectrogram_frame = -1;
+    std::fill(pcm_snapshot.begin(), pcm_snapshot.end(), 0.0f);
+}
+
+void AudioVisualizer::Render(VisualizationFrame& frame, const wxColour& color)
+{
+    if (vis_type == VisualizationType::SPECTROGRAM) {
+        DrawSpectrogramVis(frame);
+        return;
+    }
+#ifdef WANJPLAYER_HAVE_CAIRO
+    if (!software_rendering && DrawVector(frame, color)) {
+        return;
+    }
+#endif
+    DrawRasterized(frame, color);
+}
+
+void AudioVisualizer::Update(double beat_phase, float beat_confidence)
+{
+    // Without a tempo the rotation runs at a constant rate; with one it
+    // slows between beats and kicks forward on each beat
+    beat_pulse = beat_confidence * std::exp(-5.0 * beat_phase);
+    phase_offset += 0.05 * (1.0 - beat_confidence) + 0.15 * beat_pulse;
     if (phase_offset > 2 * M_PI) {
         phase_offset -= 2 * M_PI;
     }
@@ -630,35 +1408,116 @@ void AudioVisualizer::SetAmplification(double amp)
     amplification = std::max(0.1, std::min(10.0, amp));
 }
 
-void AudioVisualizer::DrawWaveformVis(wxGraphicsContext* gc, const wxRect& rect, const wxColour& color)
+#ifdef WANJPLAYER_HAVE_CAIRO
+bool AudioVisualizer::DrawVector(VisualizationFrame& frame, const wxColour& color)
+{
+    cairo_t* cr = BeginVectorFrame(frame.width, frame.height);
+    if (!cr) {
+        return false;
+    }
+    wxRect rect(0, 0, frame.width, frame.height);
+
+    switch (vis_type) {
+        case VisualizationType::WAVEFORM:
+            if (has_pcm) {
+                DrawPcmEnvelope(cr, rect, color, pcm_snapshot.data(), pcm_snapshot.size());
+            } else {
+                DrawWaveformVis(cr, rect, color);
+            }
+            break;
+        case VisualizationType::OSCILLOSCOPE:
+            if (has_pcm) {
+                DrawOscilloscopeVis(cr, rect, color);
+            } else {
+                DrawWaveformVis(cr, rect, color);
+            }
+            break;
+        case VisualizationType::SPECTRUM:
+            DrawSpectrumVis(cr, rect, color);
+            break;
+        case VisualizationType::BARS:
+            DrawBarsVis(cr, rect, color);
+            break;
+        case VisualizationType::CIRCLE:
+            DrawCircleVis(cr, rect, color);
+            break;
+        default:
+            DrawWaveformVis(cr, rect, color);
+            break;
+    }
+    EndVectorFrame(frame);
+    return true;
+}
+
+cairo_t* AudioVisualizer::BeginVectorFrame(int width, int height)
 {
-    if (current_wave_data.empty()) return;
+    if (!vector_target) {
+        vector_target = std::make_unique<VectorTarget>();
+    }
+    VectorTarget& target = *vector_target;
 
-    gc->SetPen(wxPen(color, 2));
+    if (!target.cairo || target.width != width || target.height != height) {
+        if (target.cairo) {
+            cairo_destroy(target.cairo);
+            target.cairo = nullptr;
+        }
+        target.width = width;
+        target.height = height;
+        target.pixels.assign(static_cast<size_t>(width) * height, 0);
+
+        // The context holds the only reference to the surface
+        cairo_surface_t* surface = cairo_image_surface_create_for_data(
+            reinterpret_cast<unsigned char*>(target.pixels.data()), CAIRO_FORMAT_ARGB32,
+            width, height, width * static_cast<int>(sizeof(uint32_t)));
+        cairo_t* cairo = cairo_create(surface);
+        cairo_surface_destroy(surface);
+        if (cairo_status(cairo) != CAIRO_STATUS_SUCCESS) {
+            cairo_destroy(cairo);
+            return nullptr;
+        }
+        target.cairo = cairo;
+    }
+
+    // Every frame starts transparent, with the default state
+    cairo_save(target.cairo);
+    cairo_set_operator(target.cairo, CAIRO_OPERATOR_CLEAR);
+    cairo_paint(target.cairo);
+    cairo_set_operator(target.cairo, CAIRO_OPERATOR_OVER);
+    return target.cairo;
+}
 
-    wxGraphicsPath path = gc->CreatePath();
+void AudioVisualizer::EndVectorFrame(VisualizationFrame& frame)
+{
+    VectorTarget& target = *vector_target;
+    cairo_restore(target.cairo);
+    cairo_surface_flush(cairo_get_target(target.cairo));
+
+    for (int y = 0; y < frame.height; y++) {
+        ConvertRow<16, 8, 0>(&target.pixels[static_cast<size_t>(y) * frame.width], frame.GetRow(y), frame.width);
+    }
+    frame.content_top = 0;
+    frame.content_bottom = frame.height;
+}
+
+void AudioVisualizer::DrawWaveformVis(cairo_t* cr, const wxRect& rect, const wxColour& color)
+{
+    if (current_wave_data.size() < 2) return;
 
     double x_step = (double)rect.width / (current_wave_data.size() - 1);
     double center_y = rect.y + rect.height / 2.0;
     double amplitude_scale = rect.height / 4.0 * amplification;
 
-    bool first_point = true;
-    for (size_t i = 0; i < current_wave_data.size(); i++) {
-        double x = rect.x + i * x_step;
-        double y = center_y + current_wave_data[i] * amplitude_scale;
-
-        if (first_point) {
-            path.MoveToPoint(x, y);
-            first_point = false;
-        } else {
-            path.AddLineToPoint(x, y);
-        }
+    cairo_move_to(cr, rect.x, center_y + current_wave_data[0] * amplitude_scale);
+    for (size_t i = 1; i < current_wave_data.size(); i++) {
+        cairo_line_to(cr, rect.x + i * x_step, center_y + current_wave_data[i] * amplitude_scale);
     }
 
-    gc->StrokePath(path);
+    SetSourceColor(cr, color, color.Alpha());
+    cairo_set_line_width(cr, 2.0);
+    cairo_stroke(cr);
 }
 
-void AudioVisualizer::DrawSpectrumVis(wxGraphicsContext* gc, const wxRect& rect, const wxColour& color)
+void AudioVisualizer::DrawSpectrumVis(cairo_t* cr, const wxRect& rect, const wxColour& color)
 {
     if (smoothed_data.empty()) return;
 
@@ -672,17 +1531,18 @@ void AudioVisualizer::DrawSpectrumVis(wxGraphicsContext* gc, const wxRect& rect,
         // Color gradient based on frequency
         double freq_ratio = (double)i / smoothed_data.size();
         wxColour bar_color(
-            (int)(color.Red() * (1.0 - freq_ratio) + 255 * freq_ratio),
-            (int)(color.Green() * (1.0 - freq_ratio * 0.5)),
-            (int)(color.Blue() * (1.0 + freq_ratio * 0.5))
+            (unsigned char)std::min(255.0, color.Red() * (1.0 - freq_ratio) + 255 * freq_ratio),
+            (unsigned char)std::min(255.0, color.Green() * (1.0 - freq_ratio * 0.5)),
+            (unsigned char)std::min(255.0, color.Blue() * (1.0 + freq_ratio * 0.5))
         );
 
-        gc->SetBrush(wxBrush(bar_color));
-        gc->DrawRectangle(x, y, bar_width - 1, height);
+        SetSourceColor(cr, bar_color, 255);
+        cairo_rectangle(cr, x, y, bar_width - 1, height);
+        cairo_fill(cr);
     }
 }
 
-void AudioVisualizer::DrawBarsVis(wxGraphicsContext* gc, const wxRect& rect, const wxColour& color)
+void AudioVisualizer::DrawBarsVis(cairo_t* cr, const wxRect& rect, const wxColour& color)
 {
     if (smoothed_data.empty()) return;
 
@@ -695,36 +1555,460 @@ void AudioVisualizer::DrawBarsVis(wxGraphicsContext* gc, const wxRect& rect, con
         double y = rect.y + rect.height - height;
 
         // Gradient fill
-        wxGraphicsBrush gradient = gc->CreateLinearGradientBrush(
-            x, y + height, x, y,
-            wxColour(color.Red(), color.Green(), color.Blue(), 100),
-            color
-        );
-
-        gc->SetBrush(gradient);
-        gc->DrawRectangle(x, y, bar_width, height);
+        cairo_pattern_t* gradient = cairo_pattern_create_linear(x, y + height, x, y);
+        cairo_pattern_add_color_stop_rgba(gradient, 0.0, color.Red() / 255.0, color.Green() / 255.0,
+                                          color.Blue() / 255.0, 100 / 255.0);
+        cairo_pattern_add_color_stop_rgba(gradient, 1.0, color.Red() / 255.0, color.Green() / 255.0,
+                                          color.Blue() / 255.0, color.Alpha() / 255.0);
+
+        cairo_set_source(cr, gradient);
+        cairo_rectangle(cr, x, y, bar_width, height);
+        cairo_fill(cr);
+        cairo_pattern_destroy(gradient);
     }
 }
 
-void AudioVisualizer::DrawCircleVis(wxGraphicsContext* gc, const wxRect& rect, const wxColour& color)
+void AudioVisualizer::DrawCircleVis(cairo_t* cr, const wxRect& rect, const wxColour& color)
 {
     if (smoothed_data.empty()) return;
 
     double center_x = rect.x + rect.width / 2.0;
     double center_y = rect.y + rect.height / 2.0;
-    double max_radius = std::min(rect.width, rect.height) / 3.0;
+    double max_radius = std::min(rect.width, rect.height) / 3.0 * (1.0 + 0.25 * beat_pulse);
+
+    // One stroke for all the dots
+    for (size_t i = 0; i < smoothed_data.size(); i++) {
+        double angle = 2 * M_PI * i / smoothed_data.size() + phase_offset;
+        double radius = max_radius + smoothed_data[i] * max_radius * amplification * sensitivity;
+
+        cairo_new_sub_path(cr);
+        cairo_arc(cr, center_x + radius * cos(angle), center_y + radius * sin(angle), 2.0, 0.0, 2 * M_PI);
+    }
+
+    SetSourceColor(cr, color, color.Alpha());
+    cairo_set_line_width(cr, 1.0);
+    cairo_stroke(cr);
+}
+
+void AudioVisualizer::DrawOscilloscopeVis(cairo_t* cr, const wxRect& rect, const wxColour& color)
+{
+    // Align the trace on a rising edge so periodic signals stand still
+    size_t trigger = FindTrigger(pcm_snapshot.data(), SCOPE_SEARCH);
+    DrawPcmEnvelope(cr, rect, color, pcm_snapshot.data() + trigger, SCOPE_WINDOW);
+
+    // Centre line
+    double center_y = rect.y + rect.height / 2.0;
+    cairo_move_to(cr, rect.x, center_y);
+    cairo_line_to(cr, rect.x + rect.width, center_y);
+    SetSourceColor(cr, color, 60);
+    cairo_set_line_width(cr, 1.0);
+    cairo_stroke(cr);
+}
+
+void AudioVisualizer::DrawPcmEnvelope(cairo_t* cr, const wxRect& rect, const wxColour& color,
+                                      const float* samples, size_t count)
+{
+    if (rect.width <= 1 || count == 0) return;
+
+    size_t columns = DecimateMinMax(samples, count, static_cast<size_t>(rect.width));
+    double x_step = (double)rect.width / columns;
+    double center_y = rect.y + rect.height / 2.0;
+    double scale = rect.height / 2.0 * 0.9;
+
+    // Upper edge left to right, lower edge back: one closed path per frame
+    cairo_move_to(cr, rect.x, center_y - column_max[0] * scale);
+    for (size_t i = 1; i < columns; i++) {
+        cairo_line_to(cr, rect.x + i * x_step, center_y - column_max[i] * scale);
+    }
+    for (size_t i = columns; i-- > 0;) {
+        cairo_line_to(cr, rect.x + i * x_step, center_y - column_min[i] * scale);
+    }
+    cairo_close_path(cr);
+
+    SetSourceColor(cr, color, 90);
+    cairo_fill_preserve(cr);
+    SetSourceColor(cr, color, color.Alpha());
+    cairo_set_line_width(cr, 1.5);
+    cairo_stroke(cr);
+}
+#endif // WANJPLAYER_HAVE_CAIRO
+
+void AudioVisualizer::DrawSpectrogramVis(VisualizationFrame& frame)
+{
+    const int width = frame.width;
+    const int height = frame.height;
+    if (width <= 1 || height <= 1) {
+        ClearFrame(frame);
+        return;
+    }
+
+    EnsureSpectrogramSize(width, height, has_pcm ? pcm_sample_rate : 0);
+    AdvanceSpectrogram();
+
+    // History never gets redrawn: each row of the ring is copied out in two
+    // pieces, oldest columns (from the write position on) first, then the
+    // wrapped part, packed as opaque pixels on the way
+    const int older = width - spectrogram_column;
+    const unsigned char* src = spectrogram_image.GetData();
+
+    for (int y = 0; y < height; y++, src += static_cast<size_t>(width) * 3) {
+        uint32_t* dest = frame.GetRow(y);
+        const unsigned char* rgb = src + static_cast<size_t>(spectrogram_column) * 3;
+        for (int x = 0; x < older; x++, rgb += 3) {
+            dest[x] = PackPixel(rgb[0], rgb[1], rgb[2], 255);
+        }
+        rgb = src;
+        for (int x = older; x < width; x++, rgb += 3) {
+            dest[x] = PackPixel(rgb[0], rgb[1], rgb[2], 255);
+        }
+    }
+    frame.content_top = 0;
+    frame.content_bottom = height;
+}
+
+void AudioVisualizer::EnsureSpectrogramSize(int width, int height, int sample_rate)
+{
+    bool resized = !spectrogram_image.IsOk() ||
+                   spectrogram_image.GetWidth() != width ||
+                   spectrogram_image.GetHeight() != height;
+
+    if (resized) {
+        if (spectrogram_image.IsOk()) {
+            // Unroll the ring oldest-first and stretch it to the new size so
+            // history survives a resize
+            int old_width = spectrogram_image.GetWidth();
+            int older = old_width - spectrogram_column;
+            wxImage unrolled(old_width, spectrogram_image.GetHeight(), false);
+            unrolled.Paste(spectrogram_image.GetSubImage(wxRect(spectrogram_column, 0, older, spectrogram_image.GetHeight())), 0, 0);
+            if (spectrogram_column > 0) {
+                unrolled.Paste(spectrogram_image.GetSubImage(wxRect(0, 0, spectrogram_column, spectrogram_image.GetHeight())), older, 0);
+            }
+            spectrogram_image = unrolled.Scale(width, height);
+        } else {
+            spectrogram_image.Create(width, height, true);
+            unsigned char* data = spectrogram_image.GetData();
+            for (int i = 0; i < width * height; i++) {
+                data[i * 3] = colormap[0][0];
+                data[i * 3 + 1] = colormap[0][1];
+                data[i * 3 + 2] = colormap[0][2];
+            }
+        }
+        spectrogram_column = 0;
+    }
+
+    if (!resized && sample_rate == spectrogram_rate) {
+        return;
+    }
+    spectrogram_rate = sample_rate;
+
+    // Rows top to bottom map onto bin ranges: log-spaced from 30 Hz to
+    // Nyquist for real PCM, linear over the bars for the synthetic fallback
+    row_bin_begin.resize(height);
+    row_bin_end.resize(height);
+    const int bins = static_cast<int>(spectrum_analyzer->GetBinCount());
+    for (int row = 0; row < height; row++) {
+        double lo = (double)(height - 1 - row) / height;
+        double hi = (double)(height - row) / height;
+        int begin;
+        int end;
+        if (sample_rate > 0) {
+            double bin_hz = (double)sample_rate / spectrum_analyzer->GetSize();
+            double nyquist = sample_rate / 2.0;
+            begin = static_cast<int>(30.0 * std::pow(nyquist / 30.0, lo) / bin_hz);
+            end = static_cast<int>(std::ceil(30.0 * std::pow(nyquist / 30.0, hi) / bin_hz));
+            end = std::min(end, bins);
+        } else {
+            begin = static_cast<int>(lo * bar_count);
+            end = static_cast<int>(std::ceil(hi * bar_count));
+        }
+        row_bin_begin[row] = begin;
+        row_bin_end[row] = std::max(begin + 1, end);
+    }
+}
 
-    gc->SetPen(wxPen(color, 1));
+void AudioVisualizer::AdvanceSpectrogram()
+{
+    if (!has_pcm) {
+        // Synthetic fallback: one column per paint from the smoothed bars
+        size_t count = std::min(smoothed_data.size(), spectrum_magnitudes.size());
+        std::copy(smoothed_data.begin(), smoothed_data.begin() + count, spectrum_magnitudes.begin());
+        WriteSpectrogramColumn();
+        return;
+    }
+
+    // Columns sit on a fixed hop grid so scrolling speed follows playback,
+    // not the paint rate; seeks restart the grid
+    const long long hop = static_cast<long long>(SPECTROGRAM_HOP);
+    const long long first_window = static_cast<long long>(PCM_SNAPSHOT_FRAMES - SPECTROGRAM_FFT);
+    long long target = pcm_end_frame - pcm_end_frame % hop;
+    if (spectrogram_frame < 0 || target < spectrogram_frame) {
+        spectrogram_frame = target - hop;
+    }
+    long long columns = (target - spectrogram_frame) / hop;
+    columns = std::min<long long>(columns, spectrogram_image.GetWidth());
+
+    for (long long i = columns - 1; i >= 0; i--) {
+        // Windows older than the snapshot reuse its first window
+        long long end = target - i * hop;
+        long long offset = std::max(0LL, first_window - (pcm_end_frame - end));
+        spectrum_analyzer->Compute(pcm_snapshot.data() + offset, spectrum_magnitudes.data());
+        WriteSpectrogramColumn();
+    }
+    spectrogram_frame = target;
+}
+
+void AudioVisualizer::WriteSpectrogramColumn()
+{
+    const int height = spectrogram_image.GetHeight();
+    const int width = spectrogram_image.GetWidth();
+    unsigned char* data = spectrogram_image.GetData() + spectrogram_column * 3;
+    const bool synthetic = spectrogram_rate == 0;
+
+    for (int row = 0; row < height; row++) {
+        float level = 0.0f;
+        for (int bin = row_bin_begin[row]; bin < row_bin_end[row]; bin++) {
+            level = std::max(level, spectrum_magnitudes[bin]);
+        }
+
+        // 90 dB of range below full scale; the synthetic bars are already 0..1
+        int index;
+        if (synthetic) {
+            index = static_cast<int>(std::min(1.0f, level) * 255.0f);
+        } else {
+            double db = 20.0 * std::log10(level + 1e-9);
+            index = static_cast<int>((db + 90.0) / 90.0 * 255.0);
+        }
+        index = std::max(0, std::min(255, index));
+
+        const unsigned char* rgb = colormap[index];
+        data[0] = rgb[0];
+        data[1] = rgb[1];
+        data[2] = rgb[2];
+        data += width * 3;
+    }
+
+    spectrogram_column = (spectrogram_column + 1) % width;
+}
+
+void AudioVisualizer::DrawRasterized(VisualizationFrame& frame, const wxColour& color)
+{
+    wxRect local(0, 0, frame.width, frame.height);
+    if (local.width <= 0 || local.height <= 0) {
+        ClearFrame(frame);
+        return;
+    }
+
+    if (raster.GetWidth() != local.width || raster.GetHeight() != local.height) {
+        raster.Resize(local.width, local.height);
+    }
+    raster.Clear();
+
+    switch (vis_type) {
+        case VisualizationType::WAVEFORM:
+            if (has_pcm) {
+                RasterizePcmEnvelope(local, color, pcm_snapshot.data(), pcm_snapshot.size());
+            } else {
+                RasterizeWaveform(local, color);
+            }
+            break;
+        case VisualizationType::OSCILLOSCOPE:
+            if (has_pcm) {
+                RasterizeOscilloscope(local, color);
+            } else {
+                RasterizeWaveform(local, color);
+            }
+            break;
+        case VisualizationType::SPECTRUM:
+            RasterizeBars(local, color, false);
+            break;
+        case VisualizationType::BARS:
+            RasterizeBars(local, color, true);
+            break;
+        case VisualizationType::CIRCLE:
+            RasterizeCircle(local, color);
+            break;
+        default:
+            RasterizeWaveform(local, color);
+            break;
+    }
+
+    CopyRaster(frame);
+}
+
+void AudioVisualizer::RasterizeBars(const wxRect& rect, const wxColour& color, bool gradient)
+{
+    if (smoothed_data.empty()) return;
+
+    const size_t count = smoothed_data.size();
+    const double spacing = (double)rect.width / count;
+    const double scale = rect.height * amplification * sensitivity;
+    raster_bars.resize(count);
+
+    if (gradient && bar_gradient_color != color) {
+        // Bottom to top: translucent accent to solid accent
+        bar_gradient_color = color;
+        utils::RasterSurface::BuildGradient(bar_gradient, 256,
+            utils::RasterSurface::MakeColor(color.Red(), color.Green(), color.Blue(), 100),
+            utils::RasterSurface::MakeColor(color.Red(), color.Green(), color.Blue(), 255));
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        utils::RasterSurface::Bar& bar = raster_bars[i];
+        bar.top = rect.height - smoothed_data[i] * scale;
+        if (gradient) {
+            bar.left = i * spacing + spacing * 0.1;
+            bar.right = bar.left + spacing * 0.8;
+            bar.color = 0;
+        } else {
+            // Same frequency tint as DrawSpectrumVis
+            double freq_ratio = (double)i / count;
+            bar.left = i * spacing;
+            bar.right = bar.left + spacing - 1;
+            bar.color = utils::RasterSurface::MakeColor(
+                (uint8_t)std::min(255.0, color.Red() * (1.0 - freq_ratio) + 255 * freq_ratio),
+                (uint8_t)std::min(255.0, color.Green() * (1.0 - freq_ratio * 0.5)),
+                (uint8_t)std::min(255.0, color.Blue() * (1.0 + freq_ratio * 0.5)));
+        }
+    }
+
+    raster.FillBars(raster_bars.data(), count, rect.height, gradient ? bar_gradient : nullptr, 256);
+}
+
+void AudioVisualizer::RasterizeWaveform(const wxRect& rect, const wxColour& color)
+{
+    if (current_wave_data.size() < 2) return;
+
+    const uint32_t pixel = utils::RasterSurface::MakeColor(color.Red(), color.Green(), color.Blue(), color.Alpha());
+    double x_step = (double)rect.width / (current_wave_data.size() - 1);
+    double center_y = rect.height / 2.0;
+    double amplitude_scale = rect.height / 4.0 * amplification;
+
+    for (size_t i = 1; i < current_wave_data.size(); i++) {
+        raster.DrawLine((i - 1) * x_step, center_y + current_wave_data[i - 1] * amplitude_scale,
+                        i * x_step, center_y + current_wave_data[i] * amplitude_scale, 2.0, pixel);
+    }
+}
+
+void AudioVisualizer::RasterizeCircle(const wxRect& rect, const wxColour& color)
+{
+    if (smoothed_data.empty()) return;
+
+    const uint32_t pixel = utils::RasterSurface::MakeColor(color.Red(), color.Green(), color.Blue(), color.Alpha());
+    double center_x = rect.width / 2.0;
+    double center_y = rect.height / 2.0;
+    double max_radius = std::min(rect.width, rect.height) / 3.0 * (1.0 + 0.25 * beat_pulse);
 
     for (size_t i = 0; i < smoothed_data.size(); i++) {
         double angle = 2 * M_PI * i / smoothed_data.size() + phase_offset;
         double radius = max_radius + smoothed_data[i] * max_radius * amplification * sensitivity;
+        raster.FillCircle(center_x + radius * cos(angle), center_y + radius * sin(angle), 2.0, pixel);
+    }
+}
+
+void AudioVisualizer::RasterizeOscilloscope(const wxRect& rect, const wxColour& color)
+{
+    // Same trigger and centre line as DrawOscilloscopeVis
+    size_t trigger = FindTrigger(pcm_snapshot.data(), SCOPE_SEARCH);
+    RasterizePcmEnvelope(rect, color, pcm_snapshot.data() + trigger, SCOPE_WINDOW);
+    raster.FillRect(0, rect.height / 2.0 - 0.5, rect.width, 1.0,
+                    utils::RasterSurface::MakeColor(color.Red(), color.Green(), color.Blue(), 60));
+}
+
+void AudioVisualizer::RasterizePcmEnvelope(const wxRect& rect, const wxColour& color, const float* samples, size_t count)
+{
+    if (rect.width <= 1 || count == 0) return;
+
+    size_t columns = DecimateMinMax(samples, count, static_cast<size_t>(rect.width));
+    double x_step = (double)rect.width / columns;
+    double center_y = rect.height / 2.0;
+    double scale = rect.height / 2.0 * 0.9;
+    const uint32_t fill = utils::RasterSurface::MakeColor(color.Red(), color.Green(), color.Blue(), 90);
+    const uint32_t edge = utils::RasterSurface::MakeColor(color.Red(), color.Green(), color.Blue(), color.Alpha());
+
+    // The band between the edges one column at a time, then both edges
+    for (size_t i = 0; i < columns; i++) {
+        double top = center_y - column_max[i] * scale;
+        double bottom = center_y - column_min[i] * scale;
+        raster.FillRect(i * x_step, top, x_step, std::max(bottom - top, 1.0), fill);
+    }
+    for (size_t i = 1; i < columns; i++) {
+        double x0 = (i - 1) * x_step;
+        double x1 = i * x_step;
+        raster.DrawLine(x0, center_y - column_max[i - 1] * scale, x1, center_y - column_max[i] * scale, 1.5, edge);
+        raster.DrawLine(x0, center_y - column_min[i - 1] * scale, x1, center_y - column_min[i] * scale, 1.5, edge);
+    }
+}
 
-        double x = center_x + radius * cos(angle);
-        double y = center_y + radius * sin(angle);
+void AudioVisualizer::CopyRaster(VisualizationFrame& frame) const
+{
+    const int width = raster.GetWidth();
+    const int top = raster.GetDirtyTop();
+    const int bottom = raster.GetDirtyBottom();
+
+    // Only rows drawn on now are converted; rows drawn on when this frame
+    // was last used, and not now, go back to transparent
+    ClearRows(frame, frame.content_top, std::min(frame.content_bottom, top));
+    ClearRows(frame, std::max(frame.content_top, bottom), frame.content_bottom);
+    for (int y = top; y < bottom; y++) {
+        ConvertRow<0, 8, 16>(raster.GetRow(y), frame.GetRow(y), width);
+    }
+    frame.content_top = top;
+    frame.content_bottom = bottom;
+}
 
-        gc->DrawEllipse(x - 2, y - 2, 4, 4);
+void AudioVisualizer::ClearFrame(VisualizationFrame& frame)
+{
+    ClearRows(frame, frame.content_top, frame.content_bottom);
+    frame.content_top = frame.height;
+    frame.content_bottom = 0;
+}
+
+size_t AudioVisualizer::FindTrigger(const float* samples, size_t search) const
+{
+    // Hysteresis relative to the local peak rejects noise around zero
+    float peak = 0.0f;
+    for (size_t i = 0; i < search + SCOPE_WINDOW; i++) {
+        peak = std::max(peak, std::abs(samples[i]));
+    }
+    const float hysteresis = peak * 0.1f;
+
+    // Latest qualifying rising zero crossing keeps the trace closest to "now"
+    size_t trigger = search;
+    bool armed = false;
+    for (size_t i = 1; i <= search; i++) {
+        if (samples[i] < -hysteresis) {
+            armed = true;
+        } else if (armed && samples[i - 1] < 0.0f && samples[i] >= 0.0f) {
+            trigger = i;
+            armed = false;
+        }
+    }
+    return trigger;
+}
+
+size_t AudioVisualizer::DecimateMinMax(const float* samples, size_t count, size_t columns)
+{
+    columns = std::max<size_t>(2, columns);
+
+    // Grow-only so steady-state frames never allocate
+    if (column_min.size() < columns) {
+        column_min.resize(columns);
+        column_max.resize(columns);
+    }
+
+    for (size_t c = 0; c < columns; c++) {
+        size_t begin = c * count / columns;
+        size_t end = std::max(begin + 1, (c + 1) * count / columns);
+        float lo = samples[begin];
+        float hi = samples[begin];
+        for (size_t i = begin + 1; i < end; i++) {
+            lo = std::min(lo, samples[i]);
+            hi = std::max(hi, samples[i]);
+        }
+        column_min[c] = std::max(-1.0f, lo);
+        column_max[c] = std::min(1.0f, hi);
     }
+    return columns;
 }
 
 void AudioVisualizer::SmoothData()
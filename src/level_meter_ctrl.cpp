@@ -0,0 +1,136 @@
+#include "level_meter_ctrl.hpp"
+#include <wx/dcbuffer.h>
+#include <algorithm>
+#include <memory>
+
+namespace gui {
+
+namespace {
+
+// Colour zones, lower bound in dBFS
+struct MeterZone {
+    float from_db;
+    unsigned char red;
+    unsigned char green;
+    unsigned char blue;
+};
+
+const MeterZone ZONES[] = {
+    { -LevelMeterCtrl::RANGE_DB, 46, 204, 64 },
+    { -18.0f, 255, 200, 0 },
+    { -6.0f, 255, 65, 54 },
+};
+
+const int CLIP_SIZE = 4;
+
+double MeterPosition(float db)
+{
+    return std::max(0.0, std::min(1.0, (db + LevelMeterCtrl::RANGE_DB) / static_cast<double>(LevelMeterCtrl::RANGE_DB)));
+}
+
+// Fills [from, to) of the meter's length, 0 = silence end
+void FillSpan(wxGraphicsContext* gc, const wxRect& rect, bool vertical, double from, double to)
+{
+    if (to <= from) return;
+    if (vertical) {
+        gc->DrawRectangle(rect.x, rect.y + rect.height * (1.0 - to), rect.width, rect.height * (to - from));
+    } else {
+        gc->DrawRectangle(rect.x + rect.width * from, rect.y, rect.width * (to - from), rect.height);
+    }
+}
+
+}
+
+LevelMeterCtrl::LevelMeterCtrl(wxWindow* parent, wxWindowID id, const wxSize& size)
+    : wxWindow(parent, id, wxDefaultPosition, size, wxBORDER_NONE)
+{
+    SetBackgroundStyle(wxBG_STYLE_PAINT);
+    SetMinSize(size);
+    Bind(wxEVT_PAINT, &LevelMeterCtrl::OnPaint, this);
+}
+
+void LevelMeterCtrl::SetLevels(const utils::LevelMeter& meter)
+{
+    levels = meter;
+    Refresh(false);
+}
+
+void LevelMeterCtrl::OnPaint(wxPaintEvent& event)
+{
+    wxAutoBufferedPaintDC dc(this);
+    dc.SetBackground(wxBrush(GetParent()->GetBackgroundColour()));
+    dc.Clear();
+
+    std::unique_ptr<wxGraphicsContext> gc(wxGraphicsContext::Create(dc));
+    if (gc) {
+        DrawMeters(gc.get(), GetClientRect(), levels, false);
+    }
+}
+
+void LevelMeterCtrl::DrawMeters(wxGraphicsContext* gc, const wxRect& rect, const utils::LevelMeter& meter, bool vertical)
+{
+    // One pixel gap between the channels
+    wxRect first = rect;
+    wxRect second = rect;
+    if (vertical) {
+        first.width = (rect.width - 1) / 2;
+        second.x = first.x + first.width + 1;
+        second.width = rect.width - first.width - 1;
+    } else {
+        first.height = (rect.height - 1) / 2;
+        second.y = first.y + first.height + 1;
+        second.height = rect.height - first.height - 1;
+    }
+
+    gc->SetPen(*wxTRANSPARENT_PEN);
+    DrawChannel(gc, first, meter, 0, vertical);
+    DrawChannel(gc, second, meter, 1, vertical);
+}
+
+void LevelMeterCtrl::DrawChannel(wxGraphicsContext* gc, const wxRect& rect, const utils::LevelMeter& meter, int channel, bool vertical)
+{
+    if (rect.width <= 0 || rect.height <= 0) return;
+
+    // The far end is the clip indicator
+    wxRect track = rect;
+    wxRect clip = rect;
+    if (vertical) {
+        track.y += CLIP_SIZE + 1;
+        track.height -= CLIP_SIZE + 1;
+        clip.height = CLIP_SIZE;
+    } else {
+        track.width -= CLIP_SIZE + 1;
+        clip.x = track.x + track.width + 1;
+        clip.width = CLIP_SIZE;
+    }
+
+    gc->SetBrush(wxBrush(wxColour(0, 0, 0, 120)));
+    gc->DrawRectangle(track.x, track.y, track.width, track.height);
+
+    // Peak as a dim bar, RMS solid over it, both split into the colour zones
+    const double peak = MeterPosition(meter.GetPeakDb(channel));
+    const double rms = MeterPosition(meter.GetRmsDb(channel));
+    const size_t zone_count = sizeof(ZONES) / sizeof(ZONES[0]);
+    for (size_t z = 0; z < zone_count; z++) {
+        double from = MeterPosition(ZONES[z].from_db);
+        double to = z + 1 < zone_count ? MeterPosition(ZONES[z + 1].from_db) : 1.0;
+
+        gc->SetBrush(wxBrush(wxColour(ZONES[z].red, ZONES[z].green, ZONES[z].blue, 90)));
+        FillSpan(gc, track, vertical, std::max(from, rms), std::min(to, peak));
+        gc->SetBrush(wxBrush(wxColour(ZONES[z].red, ZONES[z].green, ZONES[z].blue)));
+        FillSpan(gc, track, vertical, from, std::min(to, rms));
+    }
+
+    // Peak-hold marker
+    double hold = MeterPosition(meter.GetHoldDb(channel));
+    if (hold > 0.0) {
+        gc->SetBrush(wxBrush(wxColour(255, 255, 255, 220)));
+        double span = 2.0 / std::max(1, vertical ? track.height : track.width);
+        FillSpan(gc, track, vertical, std::max(0.0, hold - span), hold);
+    }
+
+    gc->SetBrush(wxBrush(meter.IsClipped(channel) ? wxColour(255, 40, 40) : wxColour(60, 0, 0, 160)));
+    gc->DrawRectangle(clip.x, clip.y, clip.width, clip.height);
+}
+
+}
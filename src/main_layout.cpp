@@ -18,6 +18,7 @@ MainLayout::MainLayout(wxFrame* parent)
     , playlist_pane(nullptr)
     , video_canvas_pane(nullptr)
     , toggle_playlist_btn(nullptr)
+    , playlist_search(nullptr)
     , playlist(nullptr)
     , media_controls(nullptr)
     , status_bar(nullptr)
@@ -26,6 +27,7 @@ MainLayout::MainLayout(wxFrame* parent)
     , playlist_visible(true)
     , minimum_pane_size(MINIMUM_PANE_SIZE)
     , sash_gravity(DEFAULT_SASH_GRAVITY)
+    , fuzzy_search(false)
 {
     InitializeTheme();
     LoadLayoutSettings();
@@ -143,9 +145,11 @@ void MainLayout::CreatePlaylistPane()
     
     // Create the playlist component
     playlist = new gui::player::Playlist(playlist_pane, wxID_ANY);
+    playlist->SetFuzzySearch(fuzzy_search);
     
     // Create toggle button
     CreateToggleButton();
+    CreateSearchBox();
     
     // Setup the sizer for playlist pane
     SetupPlaylistSizer();
@@ -166,6 +170,19 @@ void MainLayout::CreateToggleButton()
     }
 }
 
+void MainLayout::CreateSearchBox()
+{
+    playlist_search = new wxSearchCtrl(playlist_pane, wxID_ANY, wxEmptyString,
+                                       wxDefaultPosition, wxDefaultSize, wxTE_PROCESS_ENTER);
+    playlist_search->SetDescriptiveText("Search playlist");
+    playlist_search->ShowCancelButton(true);
+    
+    wxMenu* search_menu = new wxMenu();
+    search_menu->AppendCheckItem(ID_FUZZY_SEARCH, "Tolerate Typos");
+    search_menu->Check(ID_FUZZY_SEARCH, fuzzy_search);
+    playlist_search->SetMenu(search_menu);
+}
+
 void MainLayout::SetupPlaylistSizer()
 {
     wxBoxSizer* playlist_sizer = new wxBoxSizer(wxVERTICAL);
@@ -174,6 +191,10 @@ void MainLayout::SetupPlaylistSizer()
         playlist_sizer->Add(toggle_playlist_btn, 0, wxEXPAND | wxALL, PANEL_BORDER);
     }
     
+    if (playlist_search) {
+        playlist_sizer->Add(playlist_search, 0, wxEXPAND | wxALL, PANEL_BORDER);
+    }
+    
     if (playlist) {
         playlist_sizer->Add(playlist, 1, wxEXPAND | wxALL, PANEL_BORDER);
     }
@@ -313,6 +334,14 @@ void MainLayout::SetupEventBindings()
         toggle_playlist_btn->Bind(wxEVT_BUTTON, &MainLayout::OnTogglePlaylist, this);
     }
     
+    // Search as you type; Enter steps through the matches
+    if (playlist_search) {
+        playlist_search->Bind(wxEVT_TEXT, &MainLayout::OnPlaylistSearch, this);
+        playlist_search->Bind(wxEVT_TEXT_ENTER, &MainLayout::OnPlaylistSearchNext, this);
+        playlist_search->Bind(wxEVT_SEARCHCTRL_SEARCH_BTN, &MainLayout::OnPlaylistSearchNext, this);
+        playlist_search->Bind(wxEVT_MENU, &MainLayout::OnToggleFuzzySearch, this, ID_FUZZY_SEARCH);
+    }
+    
     // Bind splitter events
     if (main_splitter) {
         parent_frame->Bind(wxEVT_SPLITTER_SASH_POS_CHANGED, 
@@ -345,6 +374,16 @@ void MainLayout::ConnectComponents()
     if (media_controls && status_bar) {
         media_controls->SetStatusBar(status_bar);
     }
+
+    // The audio canvas drives the control-bar level meter
+    if (media_controls && player_ui_control && media_controls->GetLevelMeter()) {
+        player_ui_control->GetAudioCanvas()->SetLevelMeterCtrl(media_controls->GetLevelMeter());
+    }
+
+    // A-B loops are enforced in the canvas's PCM engine
+    if (media_controls && player_ui_control) {
+        media_controls->SetAudioCanvas(player_ui_control->GetAudioCanvas());
+    }
     
     utils::LogUtils::LogInfo("Components connected successfully");
 }
@@ -458,6 +497,40 @@ void MainLayout::OnPlaylistPaneSize(wxSizeEvent& event)
     event.Skip();
 }
 
+void MainLayout::OnPlaylistSearch(wxCommandEvent& event)
+{
+    if (playlist) {
+        playlist->SearchItems(event.GetString());
+        
+        if (status_bar && !event.GetString().IsEmpty()) {
+            size_t matches = playlist->GetMatchCount();
+            status_bar->set_system_message(matches == 1 ? wxString("1 match")
+                                                        : wxString::Format("%zu matches", matches));
+        }
+    }
+    event.Skip();
+}
+
+void MainLayout::OnPlaylistSearchNext(wxCommandEvent& event)
+{
+    if (playlist) {
+        playlist->SelectNextMatch();
+    }
+}
+
+void MainLayout::OnToggleFuzzySearch(wxCommandEvent& event)
+{
+    fuzzy_search = event.IsChecked();
+    if (playlist) {
+        playlist->SetFuzzySearch(fuzzy_search);
+        
+        // Rerun the current query under the new mode
+        if (playlist_search && !playlist_search->GetValue().IsEmpty()) {
+            playlist->SearchItems(playlist_search->GetValue());
+        }
+    }
+}
+
 void MainLayout::AnimatePlaylistToggle(bool show)
 {
     // Simple animation implementation
@@ -485,6 +558,10 @@ void MainLayout::SetupAccessibility()
         toggle_playlist_btn->SetToolTip("Toggle playlist visibility");
     }
     
+    if (playlist_search) {
+        playlist_search->SetToolTip("Search by title, artist, album or file name - Enter for the next match");
+    }
+    
     if (playlist) {
         playlist->SetToolTip("Media playlist - Double-click to play, Delete to remove");
     }
@@ -509,6 +586,7 @@ void MainLayout::SaveLayoutSettings()
     config.Write("Layout/PlaylistWidth", default_playlist_width);
     config.Write("Layout/PlaylistVisible", playlist_visible);
     config.Write("Layout/MinimumPaneSize", minimum_pane_size);
+    config.Write("Playlist/FuzzySearch", fuzzy_search);
     
     utils::LogUtils::LogDebug("Layout settings saved");
 }
@@ -520,6 +598,7 @@ void MainLayout::LoadLayoutSettings()
     config.Read("Layout/PlaylistWidth", &default_playlist_width, DEFAULT_PLAYLIST_WIDTH);
     config.Read("Layout/PlaylistVisible", &playlist_visible, true);
     config.Read("Layout/MinimumPaneSize", &minimum_pane_size, MINIMUM_PANE_SIZE);
+    config.Read("Playlist/FuzzySearch", &fuzzy_search, false);
     
     utils::LogUtils::LogDebug("Layout settings loaded");
 }
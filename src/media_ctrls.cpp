@@ -5,6 +5,23 @@
 #include "statusbar.hpp"
 #include "wanjplayer.hpp"
 #include "utils.hpp"
+#include "time_stretch.hpp"
+#include "level_meter_ctrl.hpp"
+#include "region_marker_ctrl.hpp"
+#include "canvas.hpp"
+#include <wx/config.h>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+const double PLAYBACK_RATES[] = { 0.5, 0.75, 1.0, 1.25, 1.5, 2.0, 2.5, 3.0 };
+const int DEFAULT_RATE_INDEX = 2;
+
+// Resume points are only kept for long files, and not for the very start
+// or end where starting over is what the listener wants anyway
+const wxFileOffset RESUME_MIN_LENGTH_MS = 5 * 60 * 1000;
+const wxFileOffset RESUME_MARGIN_MS = 30 * 1000;
+} // namespace
 
 gui::player::MediaControls::MediaControls(wxPanel* panel,
                                           wxMediaCtrl* media_ctrl)
@@ -14,7 +31,17 @@ gui::player::MediaControls::MediaControls(wxPanel* panel,
   , status_bar(nullptr)
   , media_duration(0)
   , media_position(0)
+  , choice_playback_rate(nullptr)
+  , level_meter(nullptr)
+  , playback_rate(1.0)
   , update_timer(nullptr)
+  , end_timer(nullptr)
+  , track_end(-1)
+  , resume_identity(0)
+  , loop_start(-1)
+  , loop_end(-1)
+  , audio_canvas(nullptr)
+  , loop_markers(nullptr)
 {
   if (!_pmedia_ctrl) {
     return;
@@ -28,10 +55,29 @@ gui::player::MediaControls::MediaControls(wxPanel* panel,
   btn_pause = new wxButton(this, wxID_ANY, "Pause");
   btn_prev = new wxButton(this, wxID_ANY, "Previous");
   btn_next = new wxButton(this, wxID_ANY, "Next");
+  btn_loop_start = new wxButton(this, wxID_ANY, "A", wxDefaultPosition, wxDefaultSize, wxBU_EXACTFIT);
+  btn_loop_end = new wxButton(this, wxID_ANY, "B", wxDefaultPosition, wxDefaultSize, wxBU_EXACTFIT);
+  btn_loop_clear = new wxButton(this, wxID_ANY, "A-B Off", wxDefaultPosition, wxDefaultSize, wxBU_EXACTFIT);
+  btn_loop_start->SetToolTip("Set the loop start to the current position");
+  btn_loop_end->SetToolTip("Set the loop end to the current position and start looping");
 
   // Create sliders
   slider_volume = new wxSlider(this, wxID_ANY, 35, 0, 100);
   slider_playback_position = new wxSlider(this, wxID_ANY, 0, 0, 100000);
+  loop_markers = new gui::RegionMarkerCtrl(this);
+
+  // Create playback speed selector
+  wxArrayString rate_labels;
+  for (double rate : PLAYBACK_RATES) {
+    rate_labels.Add(wxString::Format("%gx", rate));
+  }
+  choice_playback_rate = new wxChoice(this, wxID_ANY, wxDefaultPosition, wxDefaultSize, rate_labels);
+  choice_playback_rate->SetSelection(DEFAULT_RATE_INDEX);
+
+  // Optional level meter; fed by the audio canvas
+  if (wxConfigBase::Get()->Read("/General/ControlBarLevelMeters", false)) {
+    level_meter = new gui::LevelMeterCtrl(this);
+  }
 
   // Create time display labels
   label_current_time = new wxStaticText(this, wxID_ANY, "00:00", wxDefaultPosition, wxSize(50, -1));
@@ -43,6 +89,7 @@ gui::player::MediaControls::MediaControls(wxPanel* panel,
   if (!update_timer) {
     return;
   }
+  end_timer = new wxTimer(this);
 
   // Create layout
   wxBoxSizer* main_sizer = new wxBoxSizer(wxVERTICAL);
@@ -50,7 +97,10 @@ gui::player::MediaControls::MediaControls(wxPanel* panel,
   // First row: playback position and time
   wxBoxSizer* position_sizer = new wxBoxSizer(wxHORIZONTAL);
   position_sizer->Add(label_current_time, 0, wxALL | wxCENTER, 2);
-  position_sizer->Add(slider_playback_position, 1, wxALL | wxEXPAND, 2);
+  wxBoxSizer* slider_sizer = new wxBoxSizer(wxVERTICAL);
+  slider_sizer->Add(slider_playback_position, 0, wxEXPAND);
+  slider_sizer->Add(loop_markers, 0, wxEXPAND);
+  position_sizer->Add(slider_sizer, 1, wxALL | wxEXPAND, 2);
   position_sizer->Add(label_separator, 0, wxALL | wxCENTER, 2);
   position_sizer->Add(label_total_time, 0, wxALL | wxCENTER, 2);
   
@@ -64,6 +114,17 @@ gui::player::MediaControls::MediaControls(wxPanel* panel,
   controls_sizer->AddSpacer(20);
   controls_sizer->Add(new wxStaticText(this, wxID_ANY, "Volume:"), 0, wxALL | wxCENTER, 2);
   controls_sizer->Add(slider_volume, 0, wxALL | wxCENTER, 2);
+  controls_sizer->AddSpacer(20);
+  controls_sizer->Add(new wxStaticText(this, wxID_ANY, "Speed:"), 0, wxALL | wxCENTER, 2);
+  controls_sizer->Add(choice_playback_rate, 0, wxALL | wxCENTER, 2);
+  controls_sizer->AddSpacer(20);
+  controls_sizer->Add(btn_loop_start, 0, wxALL | wxCENTER, 2);
+  controls_sizer->Add(btn_loop_end, 0, wxALL | wxCENTER, 2);
+  controls_sizer->Add(btn_loop_clear, 0, wxALL | wxCENTER, 2);
+  if (level_meter) {
+    controls_sizer->AddSpacer(20);
+    controls_sizer->Add(level_meter, 0, wxALL | wxCENTER, 2);
+  }
 
   main_sizer->Add(position_sizer, 0, wxALL | wxEXPAND, 2);
   main_sizer->Add(controls_sizer, 0, wxALL | wxEXPAND, 2);
@@ -78,13 +139,18 @@ gui::player::MediaControls::MediaControls(wxPanel* panel,
   Bind(wxEVT_BUTTON, &MediaControls::OnPause, this, btn_pause->GetId());
   Bind(wxEVT_BUTTON, &MediaControls::OnNext, this, btn_next->GetId());
   Bind(wxEVT_BUTTON, &MediaControls::OnPrevious, this, btn_prev->GetId());
+  Bind(wxEVT_BUTTON, &MediaControls::OnLoopStart, this, btn_loop_start->GetId());
+  Bind(wxEVT_BUTTON, &MediaControls::OnLoopEnd, this, btn_loop_end->GetId());
+  Bind(wxEVT_BUTTON, &MediaControls::OnLoopClear, this, btn_loop_clear->GetId());
   
   // Bind slider events
   Bind(wxEVT_SLIDER, &MediaControls::OnVolumeChange, this, slider_volume->GetId());
   Bind(wxEVT_SLIDER, &MediaControls::OnPositionSliderChange, this, slider_playback_position->GetId());
+  Bind(wxEVT_CHOICE, &MediaControls::OnPlaybackRateChange, this, choice_playback_rate->GetId());
   
   // Bind timer event
   Bind(wxEVT_TIMER, &MediaControls::OnUpdateTimer, this, update_timer->GetId());
+  Bind(wxEVT_TIMER, &MediaControls::OnEndTimer, this, end_timer->GetId());
 
   // Bind hover events
   Bind(wxEVT_ENTER_WINDOW,
@@ -109,6 +175,11 @@ gui::player::MediaControls::~MediaControls()
     delete update_timer;
     update_timer = nullptr;
   }
+  if (end_timer) {
+    end_timer->Stop();
+    delete end_timer;
+    end_timer = nullptr;
+  }
 }
 
 void
@@ -123,15 +194,217 @@ gui::player::MediaControls::SetStatusBar(gui::StatusBar* sb)
   status_bar = sb;
 }
 
+void
+gui::player::MediaControls::SetPlaybackRate(double rate)
+{
+  playback_rate = std::max(utils::TimeStretcher::MIN_RATE, std::min(utils::TimeStretcher::MAX_RATE, rate));
+
+  // Keep the selector in sync with the closest preset
+  int best = DEFAULT_RATE_INDEX;
+  for (int i = 0; i < static_cast<int>(WXSIZEOF(PLAYBACK_RATES)); i++) {
+    if (std::abs(PLAYBACK_RATES[i] - playback_rate) < std::abs(PLAYBACK_RATES[best] - playback_rate)) {
+      best = i;
+    }
+  }
+  if (choice_playback_rate && choice_playback_rate->GetSelection() != best) {
+    choice_playback_rate->SetSelection(best);
+  }
+
+  ApplyPlaybackRate();
+}
+
+void
+gui::player::MediaControls::SetTrackEnd(wxFileOffset end_ms)
+{
+  track_end = end_ms;
+  if (end_timer) {
+    end_timer->Stop();
+  }
+}
+
+void
+gui::player::MediaControls::SetResumeFile(const wxString& path, uint64_t identity)
+{
+  resume_path = path;
+  resume_identity = identity;
+}
+
+void
+gui::player::MediaControls::RecordResumePosition()
+{
+  // The playlist moves on before the new media loads; never file its
+  // position under the previous track
+  if (resume_identity == 0 || !_pmedia_ctrl || !playlist || playlist->GetCurrentItem() != resume_path) {
+    return;
+  }
+  wxMediaState state = _pmedia_ctrl->GetState();
+  if (state != wxMEDIASTATE_PLAYING && state != wxMEDIASTATE_PAUSED) {
+    return;
+  }
+
+  wxFileOffset end = track_end > 0 ? track_end : media_duration;
+  if (end < RESUME_MIN_LENGTH_MS) {
+    return;
+  }
+  wxFileOffset position = _pmedia_ctrl->Tell();
+  if (position < RESUME_MARGIN_MS || position > end - RESUME_MARGIN_MS) {
+    utils::ResumeStore::Get().Forget(resume_identity);
+  } else {
+    utils::ResumeStore::Get().Record(resume_identity, position);
+  }
+}
+
+void
+gui::player::MediaControls::SetAudioCanvas(gui::PlayerCanvas* canvas)
+{
+  audio_canvas = canvas;
+}
+
+void
+gui::player::MediaControls::SetLoopStart(wxFileOffset start_ms)
+{
+  loop_start = std::max<wxFileOffset>(0, start_ms);
+  if (loop_end >= 0 && loop_end - loop_start < utils::AudioEngine::MIN_LOOP_MS) {
+    loop_end = -1;
+  }
+  ApplyLoop();
+}
+
+bool
+gui::player::MediaControls::SetLoopEnd(wxFileOffset end_ms)
+{
+  if (loop_start < 0 || end_ms - loop_start < utils::AudioEngine::MIN_LOOP_MS) {
+    return false;
+  }
+  loop_end = end_ms;
+  ApplyLoop();
+  return true;
+}
+
+void
+gui::player::MediaControls::ClearLoop()
+{
+  if (loop_start < 0 && loop_end < 0) {
+    return;
+  }
+  loop_start = -1;
+  loop_end = -1;
+  ApplyLoop();
+}
+
+void
+gui::player::MediaControls::ApplyLoop()
+{
+  if (loop_markers) {
+    loop_markers->SetRegion(loop_start, loop_end);
+  }
+  if (audio_canvas) {
+    audio_canvas->SetLoopRegion(loop_end >= 0 ? loop_start : 0, loop_end);
+  }
+  if (status_bar && loop_end >= 0) {
+    status_bar->set_system_message("Looping " + utils::TimeFormatter::FormatTimeRange(loop_start, loop_end));
+  }
+
+  // Setting B behind the playhead jumps back right away
+  if (end_timer) {
+    end_timer->Stop();
+  }
+  CheckTrackEnd();
+}
+
+void
+gui::player::MediaControls::OnLoopStart(wxCommandEvent& event)
+{
+  if (_pmedia_ctrl && media_duration > 0) {
+    SetLoopStart(_pmedia_ctrl->Tell());
+  }
+}
+
+void
+gui::player::MediaControls::OnLoopEnd(wxCommandEvent& event)
+{
+  if (_pmedia_ctrl && media_duration > 0 && !SetLoopEnd(_pmedia_ctrl->Tell()) && status_bar) {
+    status_bar->set_system_message("Set the loop start (A) before the end (B)");
+  }
+}
+
+void
+gui::player::MediaControls::OnLoopClear(wxCommandEvent& event)
+{
+  ClearLoop();
+}
+
+void
+gui::player::MediaControls::CheckTrackEnd()
+{
+  // An A-B loop takes over from the trimmed end
+  wxFileOffset end = loop_end >= 0 ? loop_end : track_end;
+  if (end < 0 || !_pmedia_ctrl || _pmedia_ctrl->GetState() != wxMEDIASTATE_PLAYING) {
+    return;
+  }
+
+  wxFileOffset remaining = end - _pmedia_ctrl->Tell();
+  if (remaining <= 0) {
+    if (loop_end >= 0) {
+      _pmedia_ctrl->Seek(loop_start);
+      // Timed from the region itself: Tell() can still report the old
+      // position until the seek lands, and a short loop would otherwise
+      // wait for the next position update
+      if (end_timer) {
+        end_timer->StartOnce(std::max(1, static_cast<int>((loop_end - loop_start) / playback_rate)));
+      }
+      return;
+    }
+    track_end = -1;
+    if (playlist && playlist->HasNext()) {
+      playlist->PlayNextItem();
+    } else {
+      _pmedia_ctrl->Stop();
+    }
+    return;
+  }
+
+  // Close to the end, arm the one-shot so the cut lands on time instead of
+  // on the next position update
+  if (remaining < 1500 && end_timer && !end_timer->IsRunning()) {
+    end_timer->StartOnce(std::max(1, static_cast<int>(remaining / playback_rate)));
+  }
+}
+
+void
+gui::player::MediaControls::OnEndTimer(wxTimerEvent& event)
+{
+  CheckTrackEnd();
+}
+
+void
+gui::player::MediaControls::ApplyPlaybackRate()
+{
+  // Changing the rate on the running pipeline keeps the current position and
+  // buffered media; nothing is reloaded. A stopped control has no pipeline
+  // to apply it to, so the rate is re-applied when playback starts.
+  if (_pmedia_ctrl && _pmedia_ctrl->GetState() != wxMEDIASTATE_STOPPED) {
+    if (!_pmedia_ctrl->SetPlaybackRate(playback_rate)) {
+      utils::LogUtils::LogWarning(wxString::Format("Backend rejected playback rate %.2fx", playback_rate));
+    }
+  }
+}
+
 void
 gui::player::MediaControls::UpdateDuration()
 {
   if (_pmedia_ctrl) {
     media_duration = _pmedia_ctrl->Length();
+    loop_markers->SetDuration(media_duration);
     if (media_duration > 0) {
       slider_playback_position->SetMax(static_cast<int>(media_duration / 100));
       UpdateTimeDisplay();
     }
+
+    // New media starts at the backend's default rate
+    if (playback_rate != 1.0) {
+      ApplyPlaybackRate();
+    }
   }
 }
 
@@ -164,6 +437,9 @@ gui::player::MediaControls::OnPlay(wxCommandEvent& event)
 {
   if (_pmedia_ctrl) {
     _pmedia_ctrl->Play();
+    if (playback_rate != 1.0) {
+      ApplyPlaybackRate();
+    }
   }
 }
 
@@ -217,6 +493,9 @@ gui::player::MediaControls::OnPositionSliderChange(wxCommandEvent& event)
   if (_pmedia_ctrl && media_duration > 0) {
     int slider_value = slider_playback_position->GetValue();
     wxFileOffset new_position = static_cast<wxFileOffset>(slider_value) * 100;
+    if (loop_end >= 0 && (new_position < loop_start || new_position >= loop_end)) {
+      ClearLoop();
+    }
     
     // Seek immediately when slider changes
     if (_pmedia_ctrl->Seek(new_position)) {
@@ -226,6 +505,15 @@ gui::player::MediaControls::OnPositionSliderChange(wxCommandEvent& event)
   }
 }
 
+void
+gui::player::MediaControls::OnPlaybackRateChange(wxCommandEvent& event)
+{
+  int selection = choice_playback_rate->GetSelection();
+  if (selection != wxNOT_FOUND && selection < static_cast<int>(WXSIZEOF(PLAYBACK_RATES))) {
+    SetPlaybackRate(PLAYBACK_RATES[selection]);
+  }
+}
+
 void
 gui::player::MediaControls::OnPositionSliderSeek(wxMouseEvent& event)
 {
@@ -243,10 +531,13 @@ gui::player::MediaControls::OnUpdateTimer(wxTimerEvent& event)
     if (current_duration != media_duration && current_duration > 0) {
       media_duration = current_duration;
       slider_playback_position->SetMax(static_cast<int>(media_duration / 100));
+      loop_markers->SetDuration(media_duration);
     }
     
     // Update position slider and time display
     UpdatePositionSlider();
+    RecordResumePosition();
+    CheckTrackEnd();
     
     // Update status bar duration counter every second
     if (status_bar && _pmedia_ctrl && media_duration > 0) {
@@ -7,6 +7,7 @@
 #include "canvas.hpp"
 #include "utils.hpp"
 #include "player_ui_control.hpp"
+#include <wx/config.h>
 
 namespace {
 bool IsAudioFile(const wxString& path) {
@@ -136,8 +137,10 @@ PlayerFrame::OnMediaLoaded(wxMediaEvent& event)
     wxFileOffset length = media_ctrl->Length();
     wxLogMessage("Media duration: %lld ms", length);
     
-    // Update media controls with new duration
+    // Update media controls with new duration; loops belong to the
+    // previous track
     if (player_ctrls) {
+      player_ctrls->ClearLoop();
       player_ctrls->UpdateDuration();
     }
     
@@ -153,21 +156,90 @@ PlayerFrame::OnMediaLoaded(wxMediaEvent& event)
     // Check if this is a video file
     wxString current_file = playlist->GetCurrentItem();
 
+    // Jump to the saved position before the first frame is shown
+    bool resumed = ApplyResumePosition(current_file);
+
     if (utils::FileUtils::IsVideoFile(current_file)) {
       wxLogMessage("Video file detected: %s", current_file);
+      if (player_ctrls) {
+        player_ctrls->SetTrackEnd(-1);
+      }
       if (player_ui_control) {
+        player_ui_control->GetAudioCanvas()->SetDisplayMode(gui::PlayerCanvas::DisplayMode::VIDEO);
         player_ui_control->ShowVideoCanvas();
       }
     } else {
       wxLogMessage("Audio-only media detected");
+      // Skip leading silence before the canvas syncs to the clock
+      ApplySilenceTrim(current_file, !resumed);
       if (player_ui_control) {
         player_ui_control->ShowAudioCanvas();
+        player_ui_control->GetAudioCanvas()->StartAudioVisualization(current_file);
       }
     }
   }
   event.Skip();
 }
 
+bool
+PlayerFrame::ApplyResumePosition(const wxString& path)
+{
+  bool enabled = wxConfigBase::Get()->Read("/General/ResumePlayback", true);
+  uint64_t identity = enabled ? utils::ResumeStore::FileIdentity(std::string(path.utf8_str())) : 0;
+  if (player_ctrls) {
+    player_ctrls->SetResumeFile(path, identity);
+  }
+  if (!enabled) {
+    return false;
+  }
+
+  // Only worthwhile positions are ever recorded, see MediaControls
+  wxMediaCtrl* media_ctrl = player_ui_control->GetMediaCtrl();
+  long long position_ms;
+  if (!media_ctrl || !utils::ResumeStore::Get().Lookup(identity, position_ms) || position_ms >= media_ctrl->Length()) {
+    return false;
+  }
+  media_ctrl->Seek(position_ms);
+  if (status_bar) {
+    status_bar->set_system_message("Resumed at " + utils::TimeFormatter::FormatTime(position_ms));
+  }
+  wxLogMessage("Resuming at %lld ms", position_ms);
+  return true;
+}
+
+void
+PlayerFrame::ApplySilenceTrim(const wxString& path, bool seek_start)
+{
+  if (player_ctrls) {
+    player_ctrls->SetTrackEnd(-1);
+  }
+  if (!wxConfigBase::Get()->Read("/General/TrimSilence", true)) {
+    return;
+  }
+
+  // Unknown files are analysed in the background and trimmed from their
+  // next play on
+  utils::TrimCache& cache = utils::TrimCache::Get();
+  utils::TrimPoints trim;
+  if (cache.Lookup(std::string(path.utf8_str()), trim)) {
+    wxMediaCtrl* media_ctrl = player_ui_control->GetMediaCtrl();
+    if (seek_start && media_ctrl && trim.start_ms > 0 && media_ctrl->Tell() < trim.start_ms) {
+      media_ctrl->Seek(trim.start_ms);
+    }
+    if (player_ctrls) {
+      player_ctrls->SetTrackEnd(trim.end_ms);
+    }
+  } else if (analysis_pool) {
+    cache.Queue(std::string(path.utf8_str()), *analysis_pool);
+  }
+
+  // Have the next track's trim ready before it loads
+  wxString next = playlist ? playlist->GetNextItem() : wxString();
+  if (analysis_pool && !next.IsEmpty() && utils::FileUtils::IsAudioFile(next)) {
+    cache.Queue(std::string(next.utf8_str()), *analysis_pool);
+  }
+}
+
 void
 PlayerFrame::OnMediaStop(wxMediaEvent& event)
 {
@@ -180,6 +252,7 @@ PlayerFrame::OnMediaStop(wxMediaEvent& event)
   }
   
   if (player_ui_control) {
+      player_ui_control->GetAudioCanvas()->SetDisplayMode(gui::PlayerCanvas::DisplayMode::IDLE);
       player_ui_control->ShowAudioCanvas();
   }
   
@@ -209,6 +282,7 @@ PlayerFrame::OnMediaFinished(wxMediaEvent& event)
       status_bar->update_playback_info("Stopped");
     }
     if (player_ui_control) {
+      player_ui_control->GetAudioCanvas()->SetDisplayMode(gui::PlayerCanvas::DisplayMode::IDLE);
       player_ui_control->ShowAudioCanvas();
     }
   }
@@ -247,6 +321,13 @@ PlayerFrame::OnMediaPlay(wxMediaEvent& event)
               player_ui_control->ShowVideoCanvas();
             } else {
               player_ui_control->ShowAudioCanvas();
+              // Restart after a stop; a load already started it
+              gui::PlayerCanvas* canvas = player_ui_control->GetAudioCanvas();
+              if (canvas->GetDisplayMode() != gui::PlayerCanvas::DisplayMode::AUDIO_VIS) {
+                canvas->StartAudioVisualization(current_file);
+              } else {
+                canvas->InvalidateFrame();
+              }
             }
           }
         }
@@ -267,10 +348,10 @@ PlayerFrame::OnMediaPause(wxMediaEvent& event)
     status_bar->set_system_message("Paused");
   }
   
-  // Pause audio visualization
-  // if (player_canvas && player_canvas->GetDisplayMode() == gui::PlayerCanvas::DisplayMode::AUDIO_VIS) {
-  //   player_canvas->PauseAudioVisualization();
-  // }
+  // Paint the paused position once; the canvas stops its frame clock
+  if (player_ui_control) {
+    player_ui_control->GetAudioCanvas()->InvalidateFrame();
+  }
   
   event.Skip();
 }
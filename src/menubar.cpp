@@ -9,12 +9,25 @@ gui::Menubar::create_menubar()
   wxMenu* menu_file = new wxMenu;
   menu_file->Append(ID_OPENFILE, "&Open File\tCtrl-O");
   menu_file->Append(ID_OPEN_FILES, "&OpenFiles\tCtrl-Shift-O");
+  menu_file->Append(ID_WATCH_FOLDER, "&Watch Folder...");
   menu_file->AppendSeparator();
   menu_file->Append(wxID_EXIT);
 
   wxMenu* menu_view = new wxMenu;
   menu_view->Append(ID_TOGGLE_PLAYLIST, "&Toggle Playlist\tF9");
 
+  wxMenu* menu_visualization = new wxMenu;
+  menu_visualization->AppendRadioItem(ID_VIS_WAVEFORM, "&Waveform");
+  menu_visualization->AppendRadioItem(ID_VIS_SPECTRUM, "&Spectrum");
+  menu_visualization->AppendRadioItem(ID_VIS_OSCILLOSCOPE, "&Oscilloscope");
+  menu_visualization->AppendRadioItem(ID_VIS_BARS, "&Bars");
+  menu_visualization->AppendRadioItem(ID_VIS_CIRCLE, "&Circle");
+  menu_visualization->AppendRadioItem(ID_VIS_SPECTROGRAM, "S&pectrogram");
+  menu_view->AppendSubMenu(menu_visualization, "&Visualization");
+
+  wxMenu* menu_tools = new wxMenu;
+  menu_tools->Append(ID_ANALYZE_TEMPO, "Analyze &Tempo of Playlist");
+
   wxMenu* menu_help = new wxMenu;
   menu_help->Append(ID_PREFS, "&Preferences");
   menu_help->Append(wxID_ABOUT);
@@ -23,6 +36,7 @@ gui::Menubar::create_menubar()
   wxMenuBar* menuBar = new wxMenuBar;
   menuBar->Append(menu_file, "&File");
   menuBar->Append(menu_view, "&View");
+  menuBar->Append(menu_tools, "&Tools");
   menuBar->Append(menu_help, "&Help");
 
   _parent->SetMenuBar(menuBar);
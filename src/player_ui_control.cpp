@@ -9,6 +9,7 @@ PlayerUIControl::PlayerUIControl(wxWindow* parent, wxWindowID id)
 
     media_ctrl = new wxMediaCtrl(book, wxID_ANY);
     audio_canvas = new PlayerCanvas(book, wxID_ANY);
+    audio_canvas->SetMediaCtrl(media_ctrl);
 
     book->AddPage(media_ctrl, "Video");
     book->AddPage(audio_canvas, "Audio");
@@ -1,22 +1,162 @@
 #include "playlist.hpp"
 #include "utils.hpp"
+#include <wx/dir.h>
 #include <wx/filename.h>
 #include <wx/textfile.h>
 #include <wx/xml/xml.h>
 #include <wx/menu.h>
 #include <wx/msgdlg.h>
+#include <wx/progdlg.h>
 #include <algorithm>
+#include <atomic>
 #include <fstream>
+#include <future>
 #include <set>
+#include <thread>
 
 namespace gui::player {
 
+namespace {
+
+// An item's metadata as a smart playlist library row
+utils::TrackTable::Row MakeLibraryRow(const PlaylistItem& item)
+{
+    using utils::TrackTable;
+    TrackTable::Row row;
+    row.text[TrackTable::TITLE] = std::string(item.title.Lower().utf8_str());
+    row.text[TrackTable::ARTIST] = std::string(item.artist.Lower().utf8_str());
+    row.text[TrackTable::ALBUM] = std::string(item.album.Lower().utf8_str());
+    row.text[TrackTable::GENRE] = std::string(item.genre.Lower().utf8_str());
+    row.text[TrackTable::PATH] = std::string(item.filepath.Lower().utf8_str());
+    row.numbers[TrackTable::DURATION - TrackTable::TEXT_FIELDS] = item.duration.GetSeconds().GetValue();
+    row.numbers[TrackTable::PLAY_COUNT - TrackTable::TEXT_FIELDS] = item.play_count;
+    row.numbers[TrackTable::TRACK - TrackTable::TEXT_FIELDS] = item.track_number;
+    row.numbers[TrackTable::DISC - TrackTable::TEXT_FIELDS] = item.disc_number;
+    row.numbers[TrackTable::FILE_SIZE - TrackTable::TEXT_FIELDS] = static_cast<int64_t>(item.file_size.GetValue());
+    row.numbers[TrackTable::DATE_ADDED - TrackTable::TEXT_FIELDS] = item.date_added.IsValid() ? item.date_added.GetTicks() : 0;
+    return row;
+}
+
+// An item's metadata as a library store track
+utils::LibraryStore::Track MakeStoreTrack(const PlaylistItem& item)
+{
+    using utils::LibraryStore;
+    LibraryStore::Track track;
+    track.text[LibraryStore::PATH] = std::string(item.filepath.utf8_str());
+    track.text[LibraryStore::TITLE] = std::string(item.title.utf8_str());
+    track.text[LibraryStore::ARTIST] = std::string(item.artist.utf8_str());
+    track.text[LibraryStore::ALBUM] = std::string(item.album.utf8_str());
+    track.text[LibraryStore::GENRE] = std::string(item.genre.utf8_str());
+    track.numbers[LibraryStore::DURATION] = item.duration.GetSeconds().GetValue();
+    track.numbers[LibraryStore::TRACK] = item.track_number;
+    track.numbers[LibraryStore::DISC] = item.disc_number;
+    track.numbers[LibraryStore::FILE_SIZE] = static_cast<int64_t>(item.file_size.GetValue());
+    wxDateTime modified = wxFileName(item.filepath).GetModificationTime();
+    track.numbers[LibraryStore::MODIFIED] = modified.IsValid() ? modified.GetTicks() : 0;
+    track.numbers[LibraryStore::DATE_ADDED] = item.date_added.IsValid() ? item.date_added.GetTicks() : 0;
+    track.numbers[LibraryStore::PLAY_COUNT] = item.play_count;
+    return track;
+}
+
+// A stored track as a smart playlist library row, straight from the
+// mapped columns; the table folds ASCII case itself
+utils::TrackTable::Row MakeLibraryRow(const utils::LibraryStore& store, uint32_t id)
+{
+    using utils::LibraryStore;
+    using utils::TrackTable;
+    TrackTable::Row row;
+    row.text[TrackTable::TITLE] = std::string(store.GetText(id, LibraryStore::TITLE));
+    row.text[TrackTable::ARTIST] = std::string(store.GetText(id, LibraryStore::ARTIST));
+    row.text[TrackTable::ALBUM] = std::string(store.GetText(id, LibraryStore::ALBUM));
+    row.text[TrackTable::GENRE] = std::string(store.GetText(id, LibraryStore::GENRE));
+    row.text[TrackTable::PATH] = std::string(store.GetText(id, LibraryStore::PATH));
+    row.numbers[TrackTable::DURATION - TrackTable::TEXT_FIELDS] = store.GetNumber(id, LibraryStore::DURATION);
+    row.numbers[TrackTable::PLAY_COUNT - TrackTable::TEXT_FIELDS] = store.GetNumber(id, LibraryStore::PLAY_COUNT);
+    row.numbers[TrackTable::TRACK - TrackTable::TEXT_FIELDS] = store.GetNumber(id, LibraryStore::TRACK);
+    row.numbers[TrackTable::DISC - TrackTable::TEXT_FIELDS] = store.GetNumber(id, LibraryStore::DISC);
+    row.numbers[TrackTable::FILE_SIZE - TrackTable::TEXT_FIELDS] = store.GetNumber(id, LibraryStore::FILE_SIZE);
+    row.numbers[TrackTable::DATE_ADDED - TrackTable::TEXT_FIELDS] = store.GetNumber(id, LibraryStore::DATE_ADDED);
+    return row;
+}
+
+PlaylistItem MakePlaylistItem(const utils::LibraryStore& store, uint32_t id)
+{
+    using utils::LibraryStore;
+    auto text = [&](LibraryStore::TextField field) {
+        std::string_view value = store.GetText(id, field);
+        return wxString::FromUTF8(value.data(), value.size());
+    };
+    PlaylistItem item(text(LibraryStore::PATH));
+    item.title = text(LibraryStore::TITLE);
+    item.artist = text(LibraryStore::ARTIST);
+    item.album = text(LibraryStore::ALBUM);
+    item.genre = text(LibraryStore::GENRE);
+    item.duration = wxTimeSpan::Seconds(store.GetNumber(id, LibraryStore::DURATION));
+    item.track_number = static_cast<unsigned int>(store.GetNumber(id, LibraryStore::TRACK));
+    item.disc_number = static_cast<unsigned int>(store.GetNumber(id, LibraryStore::DISC));
+    item.file_size = static_cast<wxULongLong_t>(store.GetNumber(id, LibraryStore::FILE_SIZE));
+    if (int64_t added = store.GetNumber(id, LibraryStore::DATE_ADDED); added > 0) {
+        item.date_added = wxDateTime(static_cast<time_t>(added));
+    }
+    item.play_count = static_cast<unsigned int>(store.GetNumber(id, LibraryStore::PLAY_COUNT));
+    item.is_video = utils::FileUtils::IsVideoFile(item.filepath);
+    return item;
+}
+
+// Tag text is meant to be UTF-8, but some taggers wrote Latin-1 into it
+wxString FromTag(std::string_view text)
+{
+    wxString value = wxString::FromUTF8(text.data(), text.size());
+    if (value.IsEmpty() && !text.empty()) {
+        value = wxString(text.data(), wxConvISO8859_1, text.size());
+    }
+    return value;
+}
+
+// Drops the entries of a per-item column whose removed flag is set, keeping
+// the order of the rest; missing flags count as unset
+template <typename T>
+void Compact(std::vector<T>& column, const std::vector<bool>& removed)
+{
+    size_t kept = 0;
+    for (size_t i = 0; i < column.size(); ++i) {
+        if (i >= removed.size() || !removed[i]) {
+            if (kept != i) {
+                column[kept] = std::move(column[i]);
+            }
+            kept++;
+        }
+    }
+    column.erase(column.begin() + kept, column.end());
+}
+
+// Reorders a per-item column so that position i holds the item from order[i]
+template <typename T>
+void Permute(std::vector<T>& column, const std::vector<uint32_t>& order)
+{
+    std::vector<T> sorted;
+    sorted.reserve(order.size());
+    for (uint32_t index : order) {
+        sorted.push_back(std::move(column[index]));
+    }
+    column = std::move(sorted);
+}
+
+}
+
 // Playlist implementation
 Playlist::Playlist(wxWindow* parent, wxWindowID id)
     : wxListBox(parent, id, wxDefaultPosition, wxDefaultSize, 0, nullptr, wxLB_SINGLE)
+    , name_ranks_valid(false)
+    , artist_names(new utils::SortDictionary())
+    , album_names(new utils::SortDictionary())
     , current_index(0)
     , media_ctrl_ref(nullptr)
     , queue_manager(new utils::QueueManager())
+    , search_index(new utils::SearchIndex())
+    , item_positions_valid(false)
+    , search_cursor(0)
+    , fuzzy_search(false)
     , auto_play_next(true)
     , crossfade_enabled(false)
     , crossfade_duration_ms(DEFAULT_CROSSFADE_DURATION)
@@ -34,6 +174,9 @@ Playlist::~Playlist()
 {
     ClearPlayQueue();
     delete queue_manager;
+    delete search_index;
+    delete artist_names;
+    delete album_names;
     utils::LogUtils::LogInfo("Playlist destroyed");
 }
 
@@ -53,11 +196,7 @@ void Playlist::AddItem(const wxString& path)
     auto start_time = utils::PerformanceUtils::StartTimer();
     
     wxFileName file_name(path);
-    play_queue.push_back(path);
-    date_added.push_back(wxDateTime::Now());
-    is_video_file.push_back(utils::FileUtils::IsVideoFile(path));
-    item_durations.push_back(wxTimeSpan(0)); // Will be updated when played
-    
+    AppendQueueItem(path);
     Append(file_name.GetFullName());
     
     // If this is the first item, set it as current
@@ -81,14 +220,35 @@ void Playlist::AddMultipleItems(const wxArrayString& paths)
 {
     auto start_time = utils::PerformanceUtils::StartTimer();
     
+    // The list and the shuffle order are updated once for the whole batch
+    size_t first_added = play_queue.size();
+    wxArrayString labels;
     for (const auto& path : paths) {
+        if (play_queue.size() >= MAX_QUEUE_SIZE) {
+            utils::LogUtils::LogWarning("Maximum queue size reached");
+            break;
+        }
         if (IsValidMediaFile(path)) {
-            AddItem(path);
+            AppendQueueItem(path);
+            labels.Add(wxFileName(path).GetFullName());
         }
     }
+    if (labels.IsEmpty()) {
+        return;
+    }
+    
+    Append(labels);
+    if (first_added == 0) {
+        current_index = 0;
+        HighlightCurrentTrack();
+    }
+    if (queue_manager && queue_manager->IsShuffleEnabled()) {
+        queue_manager->GenerateShuffleOrder(play_queue.size());
+    }
     
     auto duration = utils::PerformanceUtils::EndTimer(start_time);
     utils::LogUtils::LogPerformance("AddMultipleItems", duration);
+    utils::LogUtils::LogInfo(wxString::Format("Added %zu items to playlist", labels.GetCount()));
 }
 
 void Playlist::RemoveItem(size_t index)
@@ -98,34 +258,30 @@ void Playlist::RemoveItem(size_t index)
     }
     
     wxString removed_item = play_queue[index];
+    std::vector<bool> removed(play_queue.size(), false);
+    removed[index] = true;
+    CompactItems(removed);
     
-    // Remove from all vectors
-    play_queue.erase(play_queue.begin() + index);
-    date_added.erase(date_added.begin() + index);
-    is_video_file.erase(is_video_file.begin() + index);
-    if (index < item_durations.size()) {
-        item_durations.erase(item_durations.begin() + index);
-    }
-    
-    // Remove from UI
-    Delete(index);
-    
-    // Adjust current index if necessary
-    if (current_index >= index && current_index > 0) {
-        current_index--;
+    utils::LogUtils::LogInfo("Removed item from playlist: " + removed_item);
+}
+
+size_t Playlist::RemoveItems(const std::vector<bool>& removed)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < removed.size() && i < play_queue.size(); ++i) {
+        count += removed[i];
     }
-    if (current_index >= play_queue.size() && !play_queue.empty()) {
-        current_index = play_queue.size() - 1;
+    if (count == 0) {
+        return 0;
     }
     
-    HighlightCurrentTrack();
-    
-    // Update queue manager
-    if (queue_manager && queue_manager->IsShuffleEnabled()) {
-        queue_manager->GenerateShuffleOrder(play_queue.size());
-    }
+    auto start_time = utils::PerformanceUtils::StartTimer();
+    CompactItems(removed);
+    auto duration = utils::PerformanceUtils::EndTimer(start_time);
     
-    utils::LogUtils::LogInfo("Removed item from playlist: " + removed_item);
+    utils::LogUtils::LogPerformance("RemoveItems", duration);
+    utils::LogUtils::LogInfo(wxString::Format("Removed %zu items from playlist", count));
+    return count;
 }
 
 void Playlist::RemoveCurrentItem()
@@ -141,6 +297,21 @@ void Playlist::ClearPlayQueue()
     date_added.clear();
     is_video_file.clear();
     item_durations.clear();
+    item_ids.clear();
+    name_keys.clear();
+    name_ranks.clear();
+    name_ranks_valid = false;
+    item_artists.clear();
+    item_albums.clear();
+    item_discs.clear();
+    item_tracks.clear();
+    artist_names->Clear();
+    album_names->Clear();
+    sort_changed.clear();
+    search_index->Clear();
+    search_matches.clear();
+    search_cursor = 0;
+    InvalidateItemPositions();
     Clear();
     current_index = 0;
     
@@ -161,12 +332,24 @@ void Playlist::MoveItem(size_t from, size_t to)
     wxString item = play_queue[from];
     wxDateTime added = date_added[from];
     bool is_video = is_video_file[from];
+    uint32_t id = item_ids[from];
+    std::string name_key = std::move(name_keys[from]);
+    uint32_t artist = item_artists[from];
+    uint32_t album = item_albums[from];
+    uint16_t disc = item_discs[from];
+    uint16_t track = item_tracks[from];
     wxTimeSpan duration = (from < item_durations.size()) ? item_durations[from] : wxTimeSpan(0);
     
     // Remove from old position
     play_queue.erase(play_queue.begin() + from);
     date_added.erase(date_added.begin() + from);
     is_video_file.erase(is_video_file.begin() + from);
+    item_ids.erase(item_ids.begin() + from);
+    name_keys.erase(name_keys.begin() + from);
+    item_artists.erase(item_artists.begin() + from);
+    item_albums.erase(item_albums.begin() + from);
+    item_discs.erase(item_discs.begin() + from);
+    item_tracks.erase(item_tracks.begin() + from);
     if (from < item_durations.size()) {
         item_durations.erase(item_durations.begin() + from);
     }
@@ -175,6 +358,18 @@ void Playlist::MoveItem(size_t from, size_t to)
     play_queue.insert(play_queue.begin() + to, item);
     date_added.insert(date_added.begin() + to, added);
     is_video_file.insert(is_video_file.begin() + to, is_video);
+    item_ids.insert(item_ids.begin() + to, id);
+    name_keys.insert(name_keys.begin() + to, std::move(name_key));
+    item_artists.insert(item_artists.begin() + to, artist);
+    item_albums.insert(item_albums.begin() + to, album);
+    item_discs.insert(item_discs.begin() + to, disc);
+    item_tracks.insert(item_tracks.begin() + to, track);
+    name_ranks_valid = false;
+    
+    // A hand-placed item is out of sort order on purpose
+    sort_keys.clear();
+    sort_changed.clear();
+    InvalidateItemPositions();
     if (to < item_durations.size()) {
         item_durations.insert(item_durations.begin() + to, duration);
     }
@@ -212,6 +407,14 @@ wxString Playlist::GetCurrentItem() const
     return GetItem(current_index);
 }
 
+wxString Playlist::GetNextItem() const
+{
+    if (!HasNext()) {
+        return wxEmptyString;
+    }
+    return GetItem(GetNextPlaybackIndex());
+}
+
 unsigned int Playlist::GetCount() const
 {
     return static_cast<unsigned int>(play_queue.size());
@@ -409,22 +612,15 @@ void Playlist::FilterByMediaType(bool video_only, bool audio_only)
         return; // No filtering if both or neither are selected
     }
     
-    std::vector<size_t> indices_to_remove;
+    std::vector<bool> to_remove(play_queue.size(), false);
     
     for (size_t i = 0; i < play_queue.size(); ++i) {
         bool is_video = (i < is_video_file.size()) ? is_video_file[i] : utils::FileUtils::IsVideoFile(play_queue[i]);
-        
-        if ((video_only && !is_video) || (audio_only && is_video)) {
-            indices_to_remove.push_back(i);
-        }
-    }
-    
-    // Remove items in reverse order to maintain indices
-    for (auto it = indices_to_remove.rbegin(); it != indices_to_remove.rend(); ++it) {
-        RemoveItem(*it);
+        to_remove[i] = (video_only && !is_video) || (audio_only && is_video);
     }
     
-    utils::LogUtils::LogInfo(wxString::Format("Filtered playlist: removed %zu items", indices_to_remove.size()));
+    size_t removed = RemoveItems(to_remove);
+    utils::LogUtils::LogInfo(wxString::Format("Filtered playlist: removed %zu items", removed));
 }
 
 // Playlist management
@@ -473,83 +669,146 @@ void Playlist::ExportPlaylist(const wxString& filepath, const wxString& format)
 // Search and sorting
 void Playlist::SearchItems(const wxString& query)
 {
-    wxString lower_query = query.Lower();
+    search_matches.clear();
+    search_cursor = 0;
+    if (query.IsEmpty()) {
+        return;
+    }
     
-    for (size_t i = 0; i < GetCount(); ++i) {
-        wxString item_name = utils::FileUtils::GetFileName(GetItem(i)).Lower();
+    // Matches only move the selection, so typing never rebuilds the list
+    auto start_time = utils::PerformanceUtils::StartTimer();
+    std::string folded(query.Lower().utf8_str());
+    if (fuzzy_search) {
+        search_index->SearchFuzzy(folded, search_matches);
+    } else {
+        search_index->Search(folded, search_matches);
+    }
+    auto duration = utils::PerformanceUtils::EndTimer(start_time);
+    utils::LogUtils::LogPerformance("SearchItems", duration);
+    
+    SelectNextMatch();
+}
+
+bool Playlist::SelectNextMatch()
+{
+    // Items removed since the search no longer have a position
+    for (size_t tried = 0; tried < search_matches.size(); ++tried) {
+        uint32_t id = search_matches[search_cursor];
+        search_cursor = (search_cursor + 1) % search_matches.size();
         
-        if (item_name.Contains(lower_query)) {
-            SetSelection(i);
-            break;
+        size_t position = GetItemPosition(id);
+        if (position < play_queue.size()) {
+            SetSelection(static_cast<int>(position));
+            EnsureVisible(static_cast<int>(position));
+            return true;
         }
     }
+    return false;
+}
+
+size_t Playlist::GetMatchCount() const
+{
+    return search_matches.size();
+}
+
+void Playlist::SetFuzzySearch(bool enabled)
+{
+    fuzzy_search = enabled;
 }
 
 void Playlist::SortByName(bool ascending)
 {
-    std::vector<std::pair<wxString, size_t>> items_with_index;
-    
-    for (size_t i = 0; i < play_queue.size(); ++i) {
-        wxString name = utils::FileUtils::GetFileName(play_queue[i]);
-        items_with_index.emplace_back(name, i);
-    }
-    
-    std::sort(items_with_index.begin(), items_with_index.end(),
-        [ascending](const auto& a, const auto& b) {
-            return ascending ? a.first < b.first : a.first > b.first;
-        });
-    
-    // Reorder based on sorted indices
-    std::vector<wxString> new_queue;
-    std::vector<wxDateTime> new_dates;
-    std::vector<bool> new_video_flags;
-    std::vector<wxTimeSpan> new_durations;
-    
-    for (const auto& item : items_with_index) {
-        size_t orig_index = item.second;
-        new_queue.push_back(play_queue[orig_index]);
-        new_dates.push_back(date_added[orig_index]);
-        new_video_flags.push_back(is_video_file[orig_index]);
-        if (orig_index < item_durations.size()) {
-            new_durations.push_back(item_durations[orig_index]);
-        }
-    }
-    
-    play_queue = std::move(new_queue);
-    date_added = std::move(new_dates);
-    is_video_file = std::move(new_video_flags);
-    item_durations = std::move(new_durations);
-    
-    // Refresh UI
-    Clear();
-    for (const auto& path : play_queue) {
-        Append(utils::FileUtils::GetFileName(path));
-    }
-    
-    utils::LogUtils::LogInfo("Playlist sorted by name");
+    SortBy({ { SortField::NAME, ascending } });
 }
 
 void Playlist::SortByDuration(bool ascending)
 {
-    // Implementation would require duration metadata
-    utils::LogUtils::LogInfo("Sort by duration not yet implemented");
+    SortBy({ { SortField::DURATION, ascending } });
 }
 
 void Playlist::SortByDateAdded(bool ascending)
 {
-    std::vector<std::pair<wxDateTime, size_t>> items_with_index;
+    SortBy({ { SortField::DATE_ADDED, ascending } });
+}
+
+void Playlist::SortBy(const std::vector<SortKey>& keys)
+{
+    if (keys.empty() || play_queue.empty()) {
+        return;
+    }
+    
+    auto start_time = utils::PerformanceUtils::StartTimer();
     
-    for (size_t i = 0; i < play_queue.size() && i < date_added.size(); ++i) {
-        items_with_index.emplace_back(date_added[i], i);
+    // Every column as unsigned integers in its own order; signed values
+    // have their sign bit flipped
+    const size_t count = play_queue.size();
+    std::vector<utils::MultiKeySort::Key> columns(keys.size());
+    for (size_t k = 0; k < keys.size(); ++k) {
+        std::vector<uint64_t>& values = columns[k].values;
+        columns[k].ascending = keys[k].ascending;
+        values.resize(count);
+        
+        switch (keys[k].field) {
+        case SortField::NAME: {
+            const std::vector<uint32_t>& ranks = GetNameRanks();
+            std::copy(ranks.begin(), ranks.end(), values.begin());
+            break;
+        }
+        case SortField::ARTIST:
+        case SortField::ALBUM: {
+            bool artist = keys[k].field == SortField::ARTIST;
+            const std::vector<uint32_t>& ranks = (artist ? artist_names : album_names)->GetRanks();
+            const std::vector<uint32_t>& ids = artist ? item_artists : item_albums;
+            for (size_t i = 0; i < count; ++i) {
+                values[i] = ranks[ids[i]];
+            }
+            break;
+        }
+        case SortField::DISC:
+            std::copy(item_discs.begin(), item_discs.end(), values.begin());
+            break;
+        case SortField::TRACK:
+            std::copy(item_tracks.begin(), item_tracks.end(), values.begin());
+            break;
+        case SortField::DATE_ADDED:
+            for (size_t i = 0; i < count; ++i) {
+                values[i] = static_cast<uint64_t>(date_added[i].GetValue().GetValue()) ^ (1ULL << 63);
+            }
+            break;
+        case SortField::DURATION:
+            for (size_t i = 0; i < count && i < item_durations.size(); ++i) {
+                values[i] = static_cast<uint64_t>(item_durations[i].GetValue().GetValue()) ^ (1ULL << 63);
+            }
+            break;
+        }
     }
     
-    std::sort(items_with_index.begin(), items_with_index.end(),
-        [ascending](const auto& a, const auto& b) {
-            return ascending ? a.first < b.first : a.first > b.first;
-        });
+    // The items are already in this order unless they changed since, so a
+    // few edits only need those items placed again
+    std::vector<uint32_t> order(count);
+    for (size_t i = 0; i < count; ++i) {
+        order[i] = static_cast<uint32_t>(i);
+    }
+    bool incremental = keys == sort_keys && sort_changed.size() <= count / 8;
+    if (incremental) {
+        utils::MultiKeySort::Resort(columns, sort_changed, order);
+    } else {
+        utils::MultiKeySort::Sort(columns, order);
+    }
+    sort_keys = keys;
+    sort_changed.clear();
     
-    // Similar reordering logic as SortByName
-    utils::LogUtils::LogInfo("Playlist sorted by date added");
+    bool moved = false;
+    for (size_t i = 0; i < count && !moved; ++i) {
+        moved = order[i] != i;
+    }
+    if (moved) {
+        ReorderItems(order);
+    }
+    
+    auto duration = utils::PerformanceUtils::EndTimer(start_time);
+    utils::LogUtils::LogPerformance(incremental ? "SortBy (incremental)" : "SortBy", duration);
+    utils::LogUtils::LogInfo(wxString::Format("Playlist sorted by %zu key(s)", keys.size()));
 }
 
 // Statistics
@@ -654,25 +913,28 @@ void Playlist::UpdateItemInfo(size_t index)
     
     // Cache file information for performance
     CacheItemInfo(index, play_queue[index]);
+    
+    // The loaded file's length, for sorting and the total duration
+    if (media_ctrl_ref && index == current_index && index < item_durations.size()) {
+        wxFileOffset length = media_ctrl_ref->Length();
+        if (length > 0 && item_durations[index].GetMilliseconds().GetValue() != length) {
+            item_durations[index] = wxTimeSpan::Milliseconds(length);
+            MarkSortChanged(index);
+        }
+    }
 }
 
 void Playlist::ValidateQueue()
 {
-    std::vector<size_t> invalid_indices;
+    std::vector<bool> invalid(play_queue.size(), false);
     
     for (size_t i = 0; i < play_queue.size(); ++i) {
-        if (!utils::FileUtils::FileExists(play_queue[i])) {
-            invalid_indices.push_back(i);
-        }
-    }
-    
-    // Remove invalid files
-    for (auto it = invalid_indices.rbegin(); it != invalid_indices.rend(); ++it) {
-        RemoveItem(*it);
+        invalid[i] = !utils::FileUtils::FileExists(play_queue[i]);
     }
     
-    if (!invalid_indices.empty()) {
-        utils::LogUtils::LogInfo(wxString::Format("Removed %zu invalid files from playlist", invalid_indices.size()));
+    size_t removed = RemoveItems(invalid);
+    if (removed > 0) {
+        utils::LogUtils::LogInfo(wxString::Format("Removed %zu invalid files from playlist", removed));
     }
 }
 
@@ -752,6 +1014,407 @@ void Playlist::CacheItemInfo(size_t index, const wxString& path)
     // Cache file size and other metadata as needed
 }
 
+bool Playlist::AppendQueueItem(const wxString& path)
+{
+    if (play_queue.size() >= MAX_QUEUE_SIZE) {
+        return false;
+    }
+    
+    wxFileName file_name(path);
+    play_queue.push_back(path);
+    date_added.push_back(wxDateTime::Now());
+    is_video_file.push_back(utils::FileUtils::IsVideoFile(path));
+    item_durations.push_back(wxTimeSpan(0)); // Will be updated when played
+    item_ids.push_back(AddToIndex(path, file_name.GetName(), wxEmptyString, wxEmptyString));
+    name_keys.push_back(utils::NaturalSort::MakeKey(file_name.GetFullName().Lower().utf8_str().data()));
+    name_ranks_valid = false;
+    item_artists.push_back(0);
+    item_albums.push_back(0);
+    item_discs.push_back(0);
+    item_tracks.push_back(0);
+    MarkSortChanged(play_queue.size() - 1);
+    InvalidateItemPositions();
+    return true;
+}
+
+void Playlist::IndexItem(size_t index, const wxString& title, const wxString& artist, const wxString& album)
+{
+    if (index >= play_queue.size()) {
+        return;
+    }
+    
+    wxString indexed_title = title.IsEmpty() ? wxFileName(play_queue[index]).GetName() : title;
+    search_index->Remove(item_ids[index]);
+    item_ids[index] = AddToIndex(play_queue[index], indexed_title, artist, album);
+    InvalidateItemPositions();
+}
+
+uint32_t Playlist::AddToIndex(const wxString& path, const wxString& title,
+                              const wxString& artist, const wxString& album)
+{
+    // The index folds ASCII only; wx lowercases the rest
+    utils::SearchIndex::Fields fields;
+    fields[utils::SearchIndex::TITLE] = std::string(title.Lower().utf8_str());
+    fields[utils::SearchIndex::ARTIST] = std::string(artist.Lower().utf8_str());
+    fields[utils::SearchIndex::ALBUM] = std::string(album.Lower().utf8_str());
+    fields[utils::SearchIndex::FILENAME] = std::string(utils::FileUtils::GetFileName(path).Lower().utf8_str());
+    return search_index->Add(fields);
+}
+
+size_t Playlist::GetItemPosition(uint32_t id)
+{
+    if (!item_positions_valid) {
+        uint32_t max_id = 0;
+        for (uint32_t item_id : item_ids) {
+            max_id = std::max(max_id, item_id);
+        }
+        item_positions.assign(item_ids.empty() ? 0 : max_id + 1, play_queue.size());
+        for (size_t i = 0; i < item_ids.size(); ++i) {
+            item_positions[item_ids[i]] = i;
+        }
+        item_positions_valid = true;
+    }
+    
+    return id < item_positions.size() ? item_positions[id] : play_queue.size();
+}
+
+void Playlist::InvalidateItemPositions()
+{
+    item_positions_valid = false;
+}
+
+void Playlist::SetItemTags(size_t index, const wxString& artist, const wxString& album,
+                           unsigned int disc, unsigned int track, const wxTimeSpan& duration)
+{
+    if (index >= play_queue.size()) {
+        return;
+    }
+    
+    item_artists[index] = artist_names->Add(artist.Lower().utf8_str().data());
+    item_albums[index] = album_names->Add(album.Lower().utf8_str().data());
+    item_discs[index] = static_cast<uint16_t>(std::min(disc, 0xFFFFu));
+    item_tracks[index] = static_cast<uint16_t>(std::min(track, 0xFFFFu));
+    if (duration.GetValue() != 0 && index < item_durations.size()) {
+        item_durations[index] = duration;
+    }
+    MarkSortChanged(index);
+}
+
+void Playlist::ReorderItems(const std::vector<uint32_t>& order)
+{
+    wxArrayString labels = GetStrings();
+    wxArrayString new_labels;
+    new_labels.reserve(order.size());
+    for (uint32_t index : order) {
+        new_labels.push_back(labels[index]);
+    }
+    
+    item_durations.resize(play_queue.size());
+    Permute(play_queue, order);
+    Permute(date_added, order);
+    Permute(is_video_file, order);
+    Permute(item_durations, order);
+    Permute(item_ids, order);
+    Permute(name_keys, order);
+    if (name_ranks_valid) {
+        Permute(name_ranks, order);
+    }
+    Permute(item_artists, order);
+    Permute(item_albums, order);
+    Permute(item_discs, order);
+    Permute(item_tracks, order);
+    InvalidateItemPositions();
+    
+    // The current track follows its item
+    auto current = std::find(order.begin(), order.end(), static_cast<uint32_t>(current_index));
+    if (current != order.end()) {
+        current_index = static_cast<size_t>(current - order.begin());
+    }
+    
+    // The list labels move with their items rather than being rebuilt
+    // from the paths
+    Set(new_labels);
+    HighlightCurrentTrack();
+}
+
+void Playlist::CompactItems(const std::vector<bool>& removed_flags)
+{
+    const size_t count = play_queue.size();
+    std::vector<bool> removed = removed_flags;
+    removed.resize(count, false);
+    
+    // Each item's index once the removed ones are gone
+    std::vector<uint32_t> new_index(count);
+    uint32_t next = 0;
+    for (size_t i = 0; i < count; ++i) {
+        new_index[i] = next;
+        if (removed[i]) {
+            search_index->Remove(item_ids[i]);
+        } else {
+            next++;
+        }
+    }
+    
+    item_durations.resize(count);
+    Compact(play_queue, removed);
+    Compact(date_added, removed);
+    Compact(is_video_file, removed);
+    Compact(item_durations, removed);
+    Compact(item_ids, removed);
+    Compact(name_keys, removed);
+    if (name_ranks_valid) {
+        Compact(name_ranks, removed);
+    }
+    Compact(item_artists, removed);
+    Compact(item_albums, removed);
+    Compact(item_discs, removed);
+    Compact(item_tracks, removed);
+    InvalidateItemPositions();
+    
+    // The rest stay in sort order; edited items move with their index
+    size_t kept_changed = 0;
+    for (uint32_t changed : sort_changed) {
+        if (changed < count && !removed[changed]) {
+            sort_changed[kept_changed++] = new_index[changed];
+        }
+    }
+    sort_changed.resize(kept_changed);
+    
+    // A removed current item hands over to the next one left
+    if (current_index < count) {
+        current_index = new_index[current_index];
+    }
+    if (current_index >= play_queue.size()) {
+        current_index = play_queue.empty() ? 0 : play_queue.size() - 1;
+    }
+    
+    if (queue_manager && queue_manager->IsShuffleEnabled()) {
+        queue_manager->RemoveFromShuffleOrder(removed);
+    }
+    
+    // A few rows are deleted in place; more and the list is refilled once
+    if (count - next <= MAX_LIST_DELETES) {
+        for (size_t i = count; i-- > 0;) {
+            if (removed[i]) {
+                Delete(i);
+            }
+        }
+    } else {
+        wxArrayString labels = GetStrings();
+        wxArrayString kept_labels;
+        kept_labels.reserve(next);
+        for (size_t i = 0; i < count; ++i) {
+            if (!removed[i]) {
+                kept_labels.push_back(labels[i]);
+            }
+        }
+        Set(kept_labels);
+    }
+    HighlightCurrentTrack();
+}
+
+void Playlist::RenameItem(size_t index, const wxString& path)
+{
+    if (index >= play_queue.size()) {
+        return;
+    }
+    
+    wxFileName old_name(play_queue[index]);
+    wxFileName new_name(path);
+    play_queue[index] = path;
+    is_video_file[index] = utils::FileUtils::IsVideoFile(path);
+    name_keys[index] = utils::NaturalSort::MakeKey(new_name.GetFullName().Lower().utf8_str().data());
+    name_ranks_valid = false;
+    MarkSortChanged(index);
+    
+    // Tags stay as indexed; an untagged item's title was its file name
+    utils::SearchIndex::Fields fields;
+    if (search_index->GetFields(item_ids[index], fields)) {
+        std::string& title = fields[utils::SearchIndex::TITLE];
+        if (title == std::string(old_name.GetName().Lower().utf8_str())) {
+            title = std::string(new_name.GetName().Lower().utf8_str());
+        } else if (title == std::string(old_name.GetFullName().Lower().utf8_str())) {
+            title = std::string(new_name.GetFullName().Lower().utf8_str());
+        }
+        fields[utils::SearchIndex::FILENAME] = std::string(utils::FileUtils::GetFileName(path).Lower().utf8_str());
+        search_index->Remove(item_ids[index]);
+        item_ids[index] = search_index->Add(fields);
+        InvalidateItemPositions();
+    }
+    
+    SetString(index, new_name.GetFullName());
+}
+
+void Playlist::RefreshItem(size_t index)
+{
+    if (index >= play_queue.size()) {
+        return;
+    }
+    
+    // The new contents may play for a different length
+    item_durations.resize(play_queue.size());
+    item_durations[index] = wxTimeSpan(0);
+    CacheItemInfo(index, play_queue[index]);
+    MarkSortChanged(index);
+}
+
+void Playlist::ApplyLibraryChanges(const std::vector<utils::LibraryChange>& changes)
+{
+    using utils::LibraryChange;
+    auto start_time = utils::PerformanceUtils::StartTimer();
+    
+    std::unordered_map<std::string, size_t> items;      // path -> index
+    items.reserve(play_queue.size());
+    for (size_t i = 0; i < play_queue.size(); ++i) {
+        items.emplace(std::string(play_queue[i].utf8_str()), i);
+    }
+    
+    std::vector<bool> removed(play_queue.size(), false);
+    wxArrayString added;
+    std::set<std::string> added_paths;
+    size_t renamed = 0;
+    size_t refreshed = 0;
+    
+    auto items_under = [&items](const std::string& folder) {
+        std::string prefix = folder + '/';
+        std::vector<std::string> paths;
+        for (const auto& item : items) {
+            if (item.first.compare(0, prefix.size(), prefix) == 0) {
+                paths.push_back(item.first);
+            }
+        }
+        return paths;
+    };
+    auto remove_path = [&](const std::string& path) {
+        auto it = items.find(path);
+        if (it != items.end()) {
+            removed[it->second] = true;
+            items.erase(it);
+        }
+    };
+    auto add_path = [&](const std::string& path) {
+        auto it = items.find(path);
+        if (it != items.end()) {
+            RefreshItem(it->second);
+            refreshed++;
+            return;
+        }
+        wxString file = wxString::FromUTF8(path);
+        if (IsValidMediaFile(file) && added_paths.insert(path).second) {
+            added.Add(file);
+        }
+    };
+    auto rename_path = [&](const std::string& from, const std::string& to) {
+        auto it = items.find(from);
+        if (it == items.end()) {
+            add_path(to);
+            return;
+        }
+        size_t index = it->second;
+        items.erase(it);
+        remove_path(to);        // moved over another item's file
+        
+        wxString file = wxString::FromUTF8(to);
+        if (!utils::FileUtils::IsMediaFile(file)) {
+            removed[index] = true;
+            return;
+        }
+        RenameItem(index, file);
+        items[to] = index;
+        renamed++;
+    };
+    
+    for (const LibraryChange& change : changes) {
+        switch (change.kind) {
+        case LibraryChange::ADDED:
+            add_path(change.path);
+            break;
+        case LibraryChange::MODIFIED: {
+            auto it = items.find(change.path);
+            if (it != items.end()) {
+                RefreshItem(it->second);
+                refreshed++;
+            }
+            break;
+        }
+        case LibraryChange::REMOVED:
+            if (change.directory) {
+                for (const std::string& path : items_under(change.path)) {
+                    remove_path(path);
+                }
+            } else {
+                remove_path(change.path);
+            }
+            break;
+        case LibraryChange::MOVED:
+            if (change.directory) {
+                for (const std::string& path : items_under(change.old_path)) {
+                    rename_path(path, change.path + path.substr(change.old_path.size()));
+                }
+            } else {
+                rename_path(change.old_path, change.path);
+            }
+            // Cached analysis is of the contents, which did not change
+            utils::BpmCache::Get().Rename(change.old_path, change.path, change.directory);
+            utils::TrimCache::Get().Rename(change.old_path, change.path, change.directory);
+            utils::DuplicateFinder::Get().Rename(change.old_path, change.path, change.directory);
+            utils::ArtCache::Get().Rename(change.old_path, change.path, change.directory);
+            break;
+        case LibraryChange::RESCAN: {
+            for (const std::string& path : items_under(change.path)) {
+                if (!utils::FileUtils::FileExists(wxString::FromUTF8(path))) {
+                    remove_path(path);
+                }
+            }
+            wxArrayString files;
+            wxDir::GetAllFiles(wxString::FromUTF8(change.path), &files);
+            for (const auto& file : files) {
+                std::string path(file.utf8_str());
+                if (items.find(path) == items.end()) {
+                    add_path(path);
+                }
+            }
+            break;
+        }
+        }
+    }
+    
+    size_t removed_count = RemoveItems(removed);
+    AddMultipleItems(added);
+    
+    auto duration = utils::PerformanceUtils::EndTimer(start_time);
+    utils::LogUtils::LogPerformance("ApplyLibraryChanges", duration);
+    utils::LogUtils::LogInfo(wxString::Format("Library changes: %zu added, %zu removed, %zu renamed, %zu updated",
+                                              added.GetCount(), removed_count, renamed, refreshed));
+}
+
+void Playlist::MarkSortChanged(size_t index)
+{
+    if (!sort_keys.empty()) {
+        sort_changed.push_back(static_cast<uint32_t>(index));
+    }
+}
+
+const std::vector<uint32_t>& Playlist::GetNameRanks()
+{
+    if (!name_ranks_valid) {
+        std::vector<uint32_t> order;
+        utils::NaturalSort::Sort(name_keys, order);
+        
+        // Equal names share a rank
+        name_ranks.resize(name_keys.size());
+        uint32_t rank = 0;
+        for (size_t i = 0; i < order.size(); ++i) {
+            if (i > 0 && name_keys[order[i]] != name_keys[order[i - 1]]) {
+                rank++;
+            }
+            name_ranks[order[i]] = rank;
+        }
+        name_ranks_valid = true;
+    }
+    return name_ranks;
+}
+
 // PlaylistFileHandler implementation
 bool PlaylistFileHandler::CanHandle(const wxString& filepath)
 {
@@ -900,7 +1563,19 @@ bool PlaylistFileHandler::SaveXSPF(const wxString& filepath, const wxArrayString
 // EnhancedPlaylist implementation
 EnhancedPlaylist::EnhancedPlaylist(wxWindow* parent, wxWindowID id)
     : Playlist(parent, id)
+    , library(new utils::TrackTable())
+    , smart_playlist(nullptr)
+    , loading_smart_playlist(false)
+    , smart_playlist_stale(false)
+    , tag_reader(new utils::TagReader())
+{
+}
+
+EnhancedPlaylist::~EnhancedPlaylist()
 {
+    delete tag_reader;
+    delete smart_playlist;
+    delete library;
 }
 
 void EnhancedPlaylist::SetItemMetadata(size_t index, const PlaylistItem& metadata)
@@ -909,6 +1584,19 @@ void EnhancedPlaylist::SetItemMetadata(size_t index, const PlaylistItem& metadat
         item_metadata.resize(index + 1);
     }
     item_metadata[index] = metadata;
+    IndexItem(index, metadata.title, metadata.artist, metadata.album);
+    SetItemTags(index, metadata.artist, metadata.album, metadata.disc_number,
+                metadata.track_number, metadata.duration);
+    
+    if (!loading_smart_playlist) {
+        PlaylistItem item = metadata;
+        if (item.filepath.IsEmpty()) {
+            item.filepath = GetItem(index);
+        }
+        if (AddToLibrary(item)) {
+            UpdateSmartPlaylist();
+        }
+    }
 }
 
 PlaylistItem EnhancedPlaylist::GetItemMetadata(size_t index) const
@@ -919,22 +1607,171 @@ PlaylistItem EnhancedPlaylist::GetItemMetadata(size_t index) const
     return PlaylistItem();
 }
 
+void EnhancedPlaylist::ReorderItems(const std::vector<uint32_t>& order)
+{
+    item_metadata.resize(order.size());
+    Permute(item_metadata, order);
+    Playlist::ReorderItems(order);
+}
+
+void EnhancedPlaylist::CompactItems(const std::vector<bool>& removed)
+{
+    item_metadata.resize(GetCount());
+    Compact(item_metadata, removed);
+    Playlist::CompactItems(removed);
+}
+
+void EnhancedPlaylist::RenameItem(size_t index, const wxString& path)
+{
+    wxString old_path = GetItem(index);
+    Playlist::RenameItem(index, path);
+    
+    if (index < item_metadata.size() && !item_metadata[index].filepath.IsEmpty()) {
+        PlaylistItem& item = item_metadata[index];
+        if (item.title == utils::FileUtils::GetFileName(old_path)) {
+            item.title = utils::FileUtils::GetFileName(path);
+        }
+        item.filepath = path;
+    }
+}
+
+void EnhancedPlaylist::RefreshItem(size_t index)
+{
+    Playlist::RefreshItem(index);
+    if (index >= item_metadata.size() || item_metadata[index].filepath.IsEmpty()) {
+        return;
+    }
+    
+    // Tags may have been edited; play count and date added are kept
+    PlaylistItem& item = item_metadata[index];
+    ExtractMetadataFromFile(item.filepath, item);
+    IndexItem(index, item.title, item.artist, item.album);
+    SetItemTags(index, item.artist, item.album, item.disc_number, item.track_number, item.duration);
+    smart_playlist_stale |= AddToLibrary(item);
+}
+
+void EnhancedPlaylist::ApplyLibraryChanges(const std::vector<utils::LibraryChange>& changes)
+{
+    using utils::LibraryChange;
+    utils::LibraryStore& store = utils::LibraryStore::Get();
+    
+    // Library tracks follow their files whether they are queued or not; the
+    // store is committed with the next sync
+    for (const LibraryChange& change : changes) {
+        if (change.kind != LibraryChange::MOVED && change.kind != LibraryChange::REMOVED) {
+            continue;
+        }
+        const std::string& from = change.kind == LibraryChange::MOVED ? change.old_path : change.path;
+        std::vector<std::string> paths;
+        if (!change.directory) {
+            if (library_rows.count(from)) {
+                paths.push_back(from);
+            }
+        } else {
+            std::string prefix = from + '/';
+            for (const auto& entry : library_rows) {
+                if (entry.first.compare(0, prefix.size(), prefix) == 0) {
+                    paths.push_back(entry.first);
+                }
+            }
+        }
+        
+        for (const std::string& path : paths) {
+            auto node = library_rows.extract(path);
+            uint32_t row = node.mapped();
+            if (change.kind == LibraryChange::REMOVED) {
+                // The playlist drops the queued item itself
+                library->Remove(row);
+                library_items.erase(row);
+                smart_items.erase(row);
+                if (store.IsOpen()) {
+                    store.Remove(path);
+                }
+            } else {
+                node.key() = change.path + path.substr(from.size());
+                auto replaced = library_rows.find(node.key());
+                if (replaced != library_rows.end()) {
+                    library->Remove(replaced->second);
+                    library_items.erase(replaced->second);
+                    smart_items.erase(replaced->second);
+                    smart_playlist_stale |= smart_playlist && smart_playlist->Update(replaced->second);
+                    library_rows.erase(replaced);
+                }
+                PlaylistItem item = GetLibraryItem(row);
+                item.filepath = wxString::FromUTF8(node.key());
+                auto shown = smart_items.find(row);
+                if (shown != smart_items.end()) {
+                    shown->second = item.filepath;
+                }
+                library->Update(row, MakeLibraryRow(item));
+                if (store.IsOpen()) {
+                    store.Remove(path);
+                    store.Put(MakeStoreTrack(item));
+                }
+                library_items[row] = std::move(item);
+                library_rows.insert(std::move(node));
+            }
+            smart_playlist_stale |= smart_playlist && smart_playlist->Update(row);
+        }
+    }
+    
+    Playlist::ApplyLibraryChanges(changes);
+    
+    if (smart_playlist_stale) {
+        smart_playlist_stale = false;
+        UpdateSmartPlaylist();
+    }
+}
+
 void EnhancedPlaylist::RefreshAllMetadata()
 {
     item_metadata.clear();
     item_metadata.resize(GetCount());
     
+    bool smart_playlist_changed = false;
     for (size_t i = 0; i < GetCount(); ++i) {
         PlaylistItem item(GetItem(i));
         ExtractMetadataFromFile(GetItem(i), item);
         item_metadata[i] = item;
+        smart_playlist_changed |= AddToLibrary(item);
+    }
+    
+    if (smart_playlist_changed) {
+        UpdateSmartPlaylist();
     }
 }
 
-void EnhancedPlaylist::CreateSmartPlaylist(const wxString& criteria)
+bool EnhancedPlaylist::CreateSmartPlaylist(const wxString& criteria)
 {
-    // Smart playlist creation based on criteria
-    utils::LogUtils::LogInfo("Smart playlist creation not yet implemented");
+    utils::SmartQuery query;
+    std::string error;
+    if (!query.Parse(std::string(criteria.utf8_str()), error)) {
+        utils::LogUtils::LogWarning("Invalid smart playlist query: " + wxString::FromUTF8(error));
+        return false;
+    }
+    
+    auto start_time = utils::PerformanceUtils::StartTimer();
+    
+    // What is queued now is part of the library too
+    for (size_t i = 0; i < GetCount(); ++i) {
+        if (i < item_metadata.size() && !item_metadata[i].filepath.IsEmpty()) {
+            AddToLibrary(item_metadata[i]);
+        } else {
+            PlaylistItem item(GetItem(i));
+            ExtractMetadataFromFile(GetItem(i), item);
+            AddToLibrary(item);
+        }
+    }
+    
+    delete smart_playlist;
+    smart_playlist = new utils::SmartPlaylist(*library, query);
+    smart_playlist->Refresh(wxDateTime::Now().GetTicks());
+    LoadSmartPlaylist();
+    
+    auto duration = utils::PerformanceUtils::EndTimer(start_time);
+    utils::LogUtils::LogPerformance("CreateSmartPlaylist", duration);
+    utils::LogUtils::LogInfo(wxString::Format("Smart playlist matches %zu tracks", smart_playlist->GetMatchCount()));
+    return true;
 }
 
 void EnhancedPlaylist::AddFromDirectory(const wxString& directory, bool recursive)
@@ -948,33 +1785,122 @@ void EnhancedPlaylist::AddFromDirectory(const wxString& directory, bool recursiv
 void EnhancedPlaylist::RemoveDuplicates()
 {
     std::set<wxString> seen_files;
-    std::vector<size_t> duplicates;
-    
+    std::vector<std::string> paths;
     for (size_t i = 0; i < GetCount(); ++i) {
         wxString normalized_path = utils::FileUtils::NormalizePath(GetItem(i));
-        if (seen_files.count(normalized_path)) {
-            duplicates.push_back(i);
-        } else {
-            seen_files.insert(normalized_path);
+        if (seen_files.insert(normalized_path).second) {
+            paths.push_back(std::string(normalized_path.utf8_str()));
+        }
+    }
+    
+    // Copies of the same file under other names; the first copy stays.
+    // Hashing runs on a pool that leaves a core for playback, driven from a
+    // task the GUI waits on behind a progress dialog that can cancel it.
+    // Declared before the pool so queued jobs never outlive what they use.
+    std::atomic<bool> cancel(false);
+    unsigned cores = std::thread::hardware_concurrency();
+    utils::ThreadPool pool(cores > 1 ? cores - 1 : 1);
+    auto search = std::async(std::launch::async, [&paths, &pool, &cancel] {
+        return utils::DuplicateFinder::Get().FindDuplicates(paths, pool, cancel);
+    });
+    
+    // A scan answered from the hash cache finishes before a dialog is worth showing
+    if (search.wait_for(std::chrono::milliseconds(250)) != std::future_status::ready) {
+        wxProgressDialog progress("Remove Duplicates", "Comparing files...", 100, wxGetTopLevelParent(this),
+                                  wxPD_APP_MODAL | wxPD_CAN_ABORT | wxPD_AUTO_HIDE | wxPD_ELAPSED_TIME);
+        while (search.wait_for(std::chrono::milliseconds(100)) != std::future_status::ready) {
+            if (!cancel && !progress.Pulse()) {
+                cancel = true;
+            }
         }
     }
+    auto groups = search.get();
+    utils::DuplicateFinder::Get().Save();
     
-    // Remove duplicates in reverse order
-    for (auto it = duplicates.rbegin(); it != duplicates.rend(); ++it) {
-        RemoveItem(*it);
+    // The dialog lets library changes through, so the queue is matched
+    // again by path rather than by the indices it had before
+    std::set<wxString> copies;
+    for (const auto& group : groups) {
+        for (size_t j = 1; j < group.size(); ++j) {
+            copies.insert(wxString::FromUTF8(paths[group[j]]));
+        }
+    }
+    seen_files.clear();
+    std::vector<bool> duplicates(GetCount(), false);
+    for (size_t i = 0; i < GetCount(); ++i) {
+        wxString normalized_path = utils::FileUtils::NormalizePath(GetItem(i));
+        duplicates[i] = !seen_files.insert(normalized_path).second || copies.count(normalized_path) > 0;
     }
     
-    utils::LogUtils::LogInfo(wxString::Format("Removed %zu duplicate items", duplicates.size()));
+    size_t removed = RemoveItems(duplicates);
+    utils::LogUtils::LogInfo(wxString::Format(cancel ? "Duplicate search cancelled; removed %zu duplicate items"
+                                                     : "Removed %zu duplicate items", removed));
 }
 
 void EnhancedPlaylist::RemoveMissingFiles()
 {
-    // ValidateQueue(); // This already handles missing files - make it public or add friend access
+    std::vector<bool> missing(GetCount(), false);
+    for (size_t i = 0; i < GetCount(); ++i) {
+        missing[i] = !utils::FileUtils::FileExists(GetItem(i));
+    }
+    RemoveItems(missing);
 }
 
 void EnhancedPlaylist::SyncWithMusicLibrary()
 {
-    utils::LogUtils::LogInfo("Music library sync not yet implemented");
+    utils::LibraryStore& store = utils::LibraryStore::Get();
+    if (!store.IsOpen()) {
+        utils::LogUtils::LogWarning("The music library is not available");
+        return;
+    }
+    
+    auto start_time = utils::PerformanceUtils::StartTimer();
+    
+    // What is queued goes into the library; unchanged tracks cost nothing
+    for (size_t i = 0; i < GetCount(); ++i) {
+        PlaylistItem item(GetItem(i));
+        if (i < item_metadata.size() && !item_metadata[i].filepath.IsEmpty()) {
+            item = item_metadata[i];
+        } else {
+            ExtractMetadataFromFile(GetItem(i), item);
+        }
+        store.Put(MakeStoreTrack(item));
+    }
+    if (!store.Commit()) {
+        utils::LogUtils::LogWarning("Could not save the music library");
+    }
+    
+    // The rest of the library becomes smart playlist material without a
+    // PlaylistItem each; store ids are current until the next commit
+    std::vector<uint32_t> tracks;
+    store.GetTracks(tracks);
+    size_t new_rows = 0;
+    for (uint32_t track : tracks) {
+        std::string path(store.GetText(track, utils::LibraryStore::PATH));
+        auto it = library_rows.find(path);
+        uint32_t row;
+        if (it != library_rows.end()) {
+            row = it->second;
+        } else {
+            row = library->Add(MakeLibraryRow(store, track));
+            library_rows.emplace(std::move(path), row);
+            new_rows++;
+        }
+        if (row >= library_tracks.size()) {
+            library_tracks.resize(row + 1, utils::LibraryStore::NO_TRACK);
+        }
+        library_tracks[row] = track;
+    }
+    
+    if (smart_playlist && new_rows > 0) {
+        smart_playlist->Refresh(wxDateTime::Now().GetTicks());
+        UpdateSmartPlaylist();
+    }
+    
+    auto duration = utils::PerformanceUtils::EndTimer(start_time);
+    utils::LogUtils::LogPerformance("SyncWithMusicLibrary", duration);
+    utils::LogUtils::LogInfo(wxString::Format("Music library holds %zu tracks, %zu new to this session",
+                                              store.GetTrackCount(), new_rows));
 }
 
 void EnhancedPlaylist::UpdateFromLastFM()
@@ -984,20 +1910,147 @@ void EnhancedPlaylist::UpdateFromLastFM()
 
 void EnhancedPlaylist::ExtractMetadataFromFile(const wxString& filepath, PlaylistItem& item)
 {
-    // Metadata extraction would require media libraries like TagLib
+    using utils::TagReader;
     item.filepath = filepath;
-    item.title = utils::FileUtils::GetFileName(filepath);
     item.is_video = utils::FileUtils::IsVideoFile(filepath);
     item.file_size = utils::FileUtils::GetFileSize(filepath);
+    
+    // Tags removed since the last read are cleared; an untitled track is
+    // known by its file name
+    TagReader::Tags tags;
+    tag_reader->Read(std::string(filepath.utf8_str()), tags);
+    item.title = FromTag(tags.text[TagReader::TITLE]);
+    if (item.title.IsEmpty()) {
+        item.title = utils::FileUtils::GetFileName(filepath);
+    }
+    item.artist = FromTag(tags.text[TagReader::ARTIST]);
+    if (item.artist.IsEmpty()) {
+        item.artist = FromTag(tags.text[TagReader::ALBUM_ARTIST]);
+    }
+    item.album = FromTag(tags.text[TagReader::ALBUM]);
+    item.genre = FromTag(tags.text[TagReader::GENRE]);
+    item.track_number = tags.track;
+    item.disc_number = tags.disc;
+    item.duration = wxTimeSpan::Milliseconds(static_cast<wxLongLong_t>(tags.duration * 1000.0 + 0.5));
 }
 
 bool EnhancedPlaylist::MatchesCriteria(const PlaylistItem& item, const wxString& criteria) const
 {
-    // Simple criteria matching - could be enhanced
-    wxString lower_criteria = criteria.Lower();
-    return item.title.Lower().Contains(lower_criteria) ||
-           item.artist.Lower().Contains(lower_criteria) ||
-           item.album.Lower().Contains(lower_criteria);
+    utils::SmartQuery query;
+    std::string error;
+    if (!query.Parse(std::string(criteria.utf8_str()), error)) {
+        return false;
+    }
+    
+    utils::TrackTable table;
+    uint32_t row = table.Add(MakeLibraryRow(item));
+    return query.Matches(table, row, wxDateTime::Now().GetTicks());
 }
 
-}
\ No newline at end of file
+bool EnhancedPlaylist::AddToLibrary(const PlaylistItem& item)
+{
+    std::string path(item.filepath.utf8_str());
+    auto it = library_rows.find(path);
+    uint32_t row;
+    if (it != library_rows.end()) {
+        row = it->second;
+        library->Update(row, MakeLibraryRow(item));
+    } else {
+        row = library->Add(MakeLibraryRow(item));
+        library_rows.emplace(std::move(path), row);
+    }
+    library_items[row] = item;
+    
+    return smart_playlist && smart_playlist->Update(row);
+}
+
+PlaylistItem EnhancedPlaylist::GetLibraryItem(uint32_t row) const
+{
+    auto it = library_items.find(row);
+    if (it != library_items.end()) {
+        return it->second;
+    }
+    if (row < library_tracks.size() && library_tracks[row] != utils::LibraryStore::NO_TRACK) {
+        return MakePlaylistItem(utils::LibraryStore::Get(), library_tracks[row]);
+    }
+    return PlaylistItem();
+}
+
+void EnhancedPlaylist::LoadSmartPlaylist()
+{
+    if (!smart_playlist) {
+        return;
+    }
+    
+    // Everything shown from here on counts as applied
+    std::vector<uint32_t> rows;
+    std::vector<uint32_t> removed;
+    smart_playlist->TakeChanges(rows, removed);
+    smart_playlist->GetRows(rows);
+    
+    ClearPlayQueue();
+    item_metadata.clear();
+    smart_items.clear();
+    AppendSmartRows(rows);
+}
+
+void EnhancedPlaylist::UpdateSmartPlaylist()
+{
+    if (!smart_playlist) {
+        return;
+    }
+    
+    std::vector<uint32_t> added;
+    std::vector<uint32_t> removed;
+    smart_playlist->TakeChanges(added, removed);
+    
+    // Tracks that stopped matching go wherever they are in the queue; the
+    // other items, and the one playing, keep their places
+    std::set<wxString> leaving;
+    for (uint32_t row : removed) {
+        auto it = smart_items.find(row);
+        if (it != smart_items.end()) {
+            leaving.insert(it->second);
+            smart_items.erase(it);
+        }
+    }
+    if (!leaving.empty()) {
+        std::vector<bool> flags(GetCount(), false);
+        for (size_t i = 0; i < GetCount() && !leaving.empty(); ++i) {
+            flags[i] = leaving.erase(GetItem(i)) > 0;
+        }
+        RemoveItems(flags);
+    }
+    
+    AppendSmartRows(added);
+}
+
+void EnhancedPlaylist::AppendSmartRows(const std::vector<uint32_t>& rows)
+{
+    if (rows.empty()) {
+        return;
+    }
+    
+    std::vector<PlaylistItem> items;
+    wxArrayString paths;
+    items.reserve(rows.size());
+    for (uint32_t row : rows) {
+        items.push_back(GetLibraryItem(row));
+        paths.Add(items.back().filepath);
+    }
+    
+    // One append for the batch; items it skipped (invalid files, a full
+    // queue) are passed over when matching the rest back to their rows
+    size_t index = GetCount();
+    AddMultipleItems(paths);
+    loading_smart_playlist = true;
+    for (size_t i = 0; i < items.size() && index < GetCount(); ++i) {
+        if (GetItem(index) == items[i].filepath) {
+            SetItemMetadata(index++, items[i]);
+            smart_items[rows[i]] = items[i].filepath;
+        }
+    }
+    loading_smart_playlist = false;
+}
+
+}
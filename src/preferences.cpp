@@ -76,6 +76,22 @@ void PreferencesDialog::CreateGeneralPage(wxNotebook* parent_notebook) {
     appearance_sizer->Add(transparency_slider, 0, wxEXPAND | wxALL, 5);
     top_sizer->Add(appearance_sizer, 0, wxEXPAND | wxALL, 5);
 
+    // Level Meters
+    wxStaticBoxSizer* meters_sizer = new wxStaticBoxSizer(wxVERTICAL, page, "Level Meters");
+    canvas_meters_checkbox = new wxCheckBox(meters_sizer->GetStaticBox(), wxID_ANY, "Show level meters on the audio visualization");
+    meters_sizer->Add(canvas_meters_checkbox, 0, wxALL, 5);
+    control_bar_meters_checkbox = new wxCheckBox(meters_sizer->GetStaticBox(), wxID_ANY, "Show level meters in the control bar (requires restart)");
+    meters_sizer->Add(control_bar_meters_checkbox, 0, wxALL, 5);
+    top_sizer->Add(meters_sizer, 0, wxEXPAND | wxALL, 5);
+
+    // Playback
+    wxStaticBoxSizer* playback_sizer = new wxStaticBoxSizer(wxVERTICAL, page, "Playback");
+    trim_silence_checkbox = new wxCheckBox(playback_sizer->GetStaticBox(), wxID_ANY, "Skip silence at the start and end of audio tracks");
+    playback_sizer->Add(trim_silence_checkbox, 0, wxALL, 5);
+    resume_playback_checkbox = new wxCheckBox(playback_sizer->GetStaticBox(), wxID_ANY, "Resume long files where playback left off");
+    playback_sizer->Add(resume_playback_checkbox, 0, wxALL, 5);
+    top_sizer->Add(playback_sizer, 0, wxEXPAND | wxALL, 5);
+
     page->SetSizer(top_sizer);
 }
 
@@ -138,6 +154,12 @@ void PreferencesDialog::CreatePerformancePage(wxNotebook* parent_notebook) {
     profiling_sizer->Add(performance_profiling_checkbox, 0, wxALL, 5);
     top_sizer->Add(profiling_sizer, 0, wxEXPAND | wxALL, 5);
 
+    // Rendering
+    wxStaticBoxSizer* rendering_sizer = new wxStaticBoxSizer(wxVERTICAL, page, "Rendering");
+    software_visualizer_checkbox = new wxCheckBox(rendering_sizer->GetStaticBox(), wxID_ANY, "Software-rasterize bar, line and dot visualizations");
+    rendering_sizer->Add(software_visualizer_checkbox, 0, wxALL, 5);
+    top_sizer->Add(rendering_sizer, 0, wxEXPAND | wxALL, 5);
+
     // Caching
     wxStaticBoxSizer* cache_sizer = new wxStaticBoxSizer(wxVERTICAL, page, "Caching");
     cache_sizer->Add(new wxStaticText(cache_sizer->GetStaticBox(), wxID_ANY, "Max cache size (MB):"), 0, wxALL, 5);
@@ -166,6 +188,10 @@ void PreferencesDialog::LoadSettings()
     remember_geometry_checkbox->SetValue(config->Read("RememberGeometry", true));
     theme_choice->SetSelection(config->Read("Theme", 0L)); // 0=System
     transparency_slider->SetValue(config->Read("Transparency", 255L));
+    canvas_meters_checkbox->SetValue(config->Read("CanvasLevelMeters", true));
+    control_bar_meters_checkbox->SetValue(config->Read("ControlBarLevelMeters", false));
+    trim_silence_checkbox->SetValue(config->Read("TrimSilence", true));
+    resume_playback_checkbox->SetValue(config->Read("ResumePlayback", true));
 
     config->SetPath("/Logging");
     log_level_choice->SetSelection(config->Read("LogLevel", (long)utils::LogUtils::LogLevel::INFO));
@@ -176,6 +202,7 @@ void PreferencesDialog::LoadSettings()
 
     config->SetPath("/Performance");
     performance_profiling_checkbox->SetValue(config->Read("ProfilingEnabled", true));
+    software_visualizer_checkbox->SetValue(config->Read("SoftwareVisualizer", true));
     cache_size_spin->SetValue(config->Read("MaxCacheSizeMB", 100L));
 }
 
@@ -206,6 +233,10 @@ void PreferencesDialog::SaveSettings()
     config->Write("RememberGeometry", remember_geometry_checkbox->GetValue());
     config->Write("Theme", (long)theme_choice->GetSelection());
     config->Write("Transparency", (long)transparency_slider->GetValue());
+    config->Write("CanvasLevelMeters", canvas_meters_checkbox->GetValue());
+    config->Write("ControlBarLevelMeters", control_bar_meters_checkbox->GetValue());
+    config->Write("TrimSilence", trim_silence_checkbox->GetValue());
+    config->Write("ResumePlayback", resume_playback_checkbox->GetValue());
 
     config->SetPath("/Logging");
     config->Write("LogLevel", (long)log_level_choice->GetSelection());
@@ -216,6 +247,7 @@ void PreferencesDialog::SaveSettings()
 
     config->SetPath("/Performance");
     config->Write("ProfilingEnabled", performance_profiling_checkbox->GetValue());
+    config->Write("SoftwareVisualizer", software_visualizer_checkbox->GetValue());
     config->Write("MaxCacheSizeMB", (long)cache_size_spin->GetValue());
 
     config->Flush();
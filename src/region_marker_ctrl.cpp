@@ -0,0 +1,79 @@
+#include "region_marker_ctrl.hpp"
+#include <wx/dcbuffer.h>
+#include <wx/graphics.h>
+#include <algorithm>
+#include <memory>
+
+namespace gui {
+
+namespace {
+
+const int STRIP_HEIGHT = 6;
+const wxColour MARKER_COLOUR(255, 200, 0);
+const wxColour REGION_COLOUR(255, 200, 0, 90);
+
+}
+
+RegionMarkerCtrl::RegionMarkerCtrl(wxWindow* parent, wxWindowID id)
+    : wxWindow(parent, id, wxDefaultPosition, wxSize(-1, STRIP_HEIGHT), wxBORDER_NONE)
+    , duration(0)
+    , region_start(-1)
+    , region_end(-1)
+{
+    SetBackgroundStyle(wxBG_STYLE_PAINT);
+    SetMinSize(wxSize(-1, STRIP_HEIGHT));
+    Bind(wxEVT_PAINT, &RegionMarkerCtrl::OnPaint, this);
+}
+
+void RegionMarkerCtrl::SetDuration(wxFileOffset duration_ms)
+{
+    if (duration_ms != duration) {
+        duration = duration_ms;
+        Refresh(false);
+    }
+}
+
+void RegionMarkerCtrl::SetRegion(wxFileOffset start_ms, wxFileOffset end_ms)
+{
+    region_start = start_ms;
+    region_end = end_ms;
+    Refresh(false);
+}
+
+double RegionMarkerCtrl::PositionToX(wxFileOffset position_ms, const wxRect& track) const
+{
+    double fraction = std::max(0.0, std::min(1.0, static_cast<double>(position_ms) / duration));
+    return track.x + fraction * track.width;
+}
+
+void RegionMarkerCtrl::OnPaint(wxPaintEvent& event)
+{
+    wxAutoBufferedPaintDC dc(this);
+    dc.SetBackground(wxBrush(GetParent()->GetBackgroundColour()));
+    dc.Clear();
+
+    if (duration <= 0 || region_start < 0) {
+        return;
+    }
+    std::unique_ptr<wxGraphicsContext> gc(wxGraphicsContext::Create(dc));
+    if (!gc) {
+        return;
+    }
+
+    wxRect track = GetClientRect();
+    track.Deflate(TRACK_INSET, 0);
+    gc->SetPen(*wxTRANSPARENT_PEN);
+
+    double start_x = PositionToX(region_start, track);
+    if (region_end >= 0) {
+        double end_x = PositionToX(region_end, track);
+        gc->SetBrush(wxBrush(REGION_COLOUR));
+        gc->DrawRectangle(start_x, track.y, end_x - start_x, track.height);
+        gc->SetBrush(wxBrush(MARKER_COLOUR));
+        gc->DrawRectangle(end_x - 1, track.y, 2, track.height);
+    }
+    gc->SetBrush(wxBrush(MARKER_COLOUR));
+    gc->DrawRectangle(start_x - 1, track.y, 2, track.height);
+}
+
+}
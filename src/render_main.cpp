@@ -0,0 +1,108 @@
+// Headless renderer: decodes a file through the AudioEngine into a null or
+// WAV sink as fast as possible and reports throughput and analysis results.
+// Needs no display or audio device, so it runs on CI and benchmark boxes.
+
+#include "audio_engine.hpp"
+#include "audio_sink.hpp"
+#include "time_stretch.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+
+namespace {
+
+void PrintUsage(const char* program)
+{
+  std::fprintf(stderr,
+               "Usage: %s [--frames N] [--rate R] INPUT [OUTPUT.wav]\n"
+               "Decodes INPUT through the playback engine. Without OUTPUT the\n"
+               "samples go to a null sink; with it they are written as 32-bit\n"
+               "float WAV, bit-exact with the decoded stream. --rate R (%.1f to\n"
+               "%.1f) time-stretches the output to R times the speed at the\n"
+               "same pitch.\n",
+               program, utils::TimeStretcher::MIN_RATE, utils::TimeStretcher::MAX_RATE);
+}
+
+} // namespace
+
+int
+main(int argc, char** argv)
+{
+  long long max_frames = -1;
+  double rate = 1.0;
+  std::string input;
+  std::string output;
+
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+      max_frames = std::atoll(argv[++i]);
+    } else if (std::strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+      rate = std::atof(argv[++i]);
+      if (rate < utils::TimeStretcher::MIN_RATE || rate > utils::TimeStretcher::MAX_RATE) {
+        PrintUsage(argv[0]);
+        return 2;
+      }
+    } else if (std::strcmp(argv[i], "--help") == 0) {
+      PrintUsage(argv[0]);
+      return 0;
+    } else if (argv[i][0] == '-') {
+      PrintUsage(argv[0]);
+      return 2;
+    } else if (input.empty()) {
+      input = argv[i];
+    } else if (output.empty()) {
+      output = argv[i];
+    } else {
+      PrintUsage(argv[0]);
+      return 2;
+    }
+  }
+  if (input.empty()) {
+    PrintUsage(argv[0]);
+    return 2;
+  }
+
+  utils::NullSink null_sink;
+  std::unique_ptr<utils::WavSink> wav_sink;
+  if (!output.empty()) {
+    wav_sink = std::make_unique<utils::WavSink>(output);
+  }
+  utils::AudioSink& sink = wav_sink ? static_cast<utils::AudioSink&>(*wav_sink) : null_sink;
+
+  utils::AudioEngine engine;
+  auto start = std::chrono::steady_clock::now();
+  long long frames = engine.Render(input, sink, max_frames, rate);
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  if (frames < 0) {
+    std::fprintf(stderr, "Could not render %s%s%s\n", input.c_str(),
+                 output.empty() ? "" : " to ", output.c_str());
+    return 1;
+  }
+
+  double seconds = static_cast<double>(frames) / engine.GetSampleRate();
+  std::printf("frames\t%lld\n", frames);
+  std::printf("sample_rate\t%d\n", engine.GetSampleRate());
+  std::printf("channels\t%d\n", engine.GetChannels());
+  std::printf("audio_seconds\t%.3f\n", seconds);
+  std::printf("wall_seconds\t%.3f\n", elapsed);
+  std::printf("realtime_factor\t%.1f\n", elapsed > 0.0 ? seconds / elapsed : 0.0);
+  if (rate != 1.0) {
+    // Stretched length against the decoded one, ~1 / rate when it works
+    long long written = wav_sink ? wav_sink->GetFramesWritten() : null_sink.GetFramesWritten();
+    std::printf("rate\t%.2f\n", rate);
+    std::printf("output_frames\t%lld\n", written);
+    std::printf("output_ratio\t%.4f\n", frames > 0 ? static_cast<double>(written) / frames : 0.0);
+  }
+
+  double bpm;
+  float confidence;
+  if (engine.GetBeats().GetTrackBpm(bpm, confidence)) {
+    std::printf("bpm\t%.2f\n", bpm);
+    std::printf("bpm_confidence\t%.2f\n", confidence);
+  }
+  return 0;
+}
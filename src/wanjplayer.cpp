@@ -6,10 +6,18 @@
 #include "main_layout.hpp"
 #include "utils.hpp"
 #include <algorithm>
+#include <atomic>
 #include <memory>
+#include <string>
+#include <thread>
+#include <vector>
 #include <wx/dir.h>
+#include <wx/dirdlg.h>
 #include <wx/iconbndl.h>
 #include <wx/config.h>
+#include <wx/filename.h>
+#include <wx/stdpaths.h>
+#include <wx/progdlg.h>
 
 wxIMPLEMENT_APP(WanjPlayer);
 
@@ -35,6 +43,16 @@ WanjPlayer::OnInit()
   utils::PerformanceUtils::EnableProfiling(config->Read("ProfilingEnabled", true));
   utils::PerformanceUtils::SetMaxCacheSize(config->Read("MaxCacheSizeMB", 100L) * 1024 * 1024);
 
+  // Tempo estimates, silence trims, content hashes, resume points, the
+  // music library and scaled album art persist next to the log
+  wxString data_dir = wxStandardPaths::Get().GetUserDataDir();
+  utils::BpmCache::Get().Load(std::string(wxFileName(data_dir, "tempo.tsv").GetFullPath().utf8_str()));
+  utils::TrimCache::Get().Load(std::string(wxFileName(data_dir, "trim.tsv").GetFullPath().utf8_str()));
+  utils::DuplicateFinder::Get().Load(std::string(wxFileName(data_dir, "hashes.tsv").GetFullPath().utf8_str()));
+  utils::ResumeStore::Get().Open(std::string(wxFileName(data_dir, "resume.log").GetFullPath().utf8_str()));
+  utils::LibraryStore::Get().Open(std::string(wxFileName(data_dir, "library").GetFullPath().utf8_str()));
+  utils::ArtCache::Get().Open(std::string(wxFileName(data_dir, "art").GetFullPath().utf8_str()));
+
   // Set essential environment variables for video compatibility
   wxSetEnv("GDK_BACKEND", "x11");
   wxSetEnv("GST_GL_DISABLED", "1");
@@ -51,6 +69,19 @@ WanjPlayer::OnInit()
   return true;
 }
 
+int
+WanjPlayer::OnExit()
+{
+  // Frames are gone by now, so their last live estimates are in
+  utils::BpmCache::Get().Save();
+  utils::TrimCache::Get().Save();
+  utils::DuplicateFinder::Get().Save();
+  utils::ResumeStore::Get().Close();
+  utils::LibraryStore::Get().Close();
+  utils::ArtCache::Get().Close();
+  return wxApp::OnExit();
+}
+
 PlayerFrame::PlayerFrame()
   : wxFrame(nullptr,
             wxID_ANY,
@@ -142,6 +173,9 @@ PlayerFrame::PlayerFrame()
    */
   BindMenuEvents();
   BindMediaEvents();
+
+  analysis_pool = std::make_unique<utils::ThreadPool>(1);
+  StartLibraryWatcher();
   
   // Setup accessibility
   main_layout->SetupAccessibility();
@@ -162,12 +196,15 @@ void PlayerFrame::BindMenuEvents()
   Bind(wxEVT_MENU, &PlayerFrame::OnExit, this, wxID_EXIT);
   Bind(wxEVT_MENU, &PlayerFrame::OnFileOpen, this, ID_OPENFILE);
   Bind(wxEVT_MENU, &PlayerFrame::OnFilesOpen, this, ID_OPEN_FILES);
+  Bind(wxEVT_MENU, &PlayerFrame::OnWatchFolder, this, ID_WATCH_FOLDER);
   Bind(wxEVT_MENU, &PlayerFrame::OnPreferences, this, ID_PREFS);
   Bind(wxEVT_MENU, &PlayerFrame::OnLicense, this, ID_LICENSE);
   Bind(wxEVT_MENU, &PlayerFrame::OnAbout, this, wxID_ABOUT);
   
   // Playlist toggle is now handled by main_layout
   Bind(wxEVT_MENU, &PlayerFrame::OnTogglePlaylist, this, ID_TOGGLE_PLAYLIST);
+  Bind(wxEVT_MENU, &PlayerFrame::OnVisualizationStyle, this, ID_VIS_WAVEFORM, ID_VIS_SPECTROGRAM);
+  Bind(wxEVT_MENU, &PlayerFrame::OnAnalyzeTempo, this, ID_ANALYZE_TEMPO);
 }
 
 void PlayerFrame::BindMediaEvents()
@@ -179,6 +216,69 @@ void PlayerFrame::BindMediaEvents()
   Bind(wxEVT_MEDIA_FINISHED, &PlayerFrame::OnMediaFinished, this);
 }
 
+void PlayerFrame::StartLibraryWatcher()
+{
+  library_watcher = std::make_unique<utils::LibraryWatcher>();
+
+  wxConfigBase* config = wxConfig::Get();
+  config->SetPath("/Library");
+  wxArrayString folders = wxSplit(config->Read("WatchedFolders", wxEmptyString), '\n', '\0');
+  for (const wxString& folder : folders) {
+    if (!folder.IsEmpty() && !library_watcher->AddRoot(std::string(folder.utf8_str()))) {
+      utils::LogUtils::LogWarning("Could not watch every folder under " + folder);
+    }
+  }
+
+  // Batches arrive on the watcher thread; the playlist is only touched here
+  library_watcher->Start([this](std::vector<utils::LibraryChange>&& changes) {
+    CallAfter([this, changes = std::move(changes)] {
+      if (playlist) {
+        playlist->ApplyLibraryChanges(changes);
+      }
+    });
+  });
+}
+
+void PlayerFrame::SaveWatchedFolders()
+{
+  wxArrayString folders;
+  for (const std::string& root : library_watcher->GetRoots()) {
+    folders.Add(wxString::FromUTF8(root));
+  }
+
+  wxConfigBase* config = wxConfig::Get();
+  config->SetPath("/Library");
+  config->Write("WatchedFolders", wxJoin(folders, '\n', '\0'));
+  config->Flush();
+}
+
+void PlayerFrame::OnWatchFolder(wxCommandEvent& event)
+{
+  wxDirDialog dialog(this, "Choose a folder to keep in the playlist", wxEmptyString,
+                     wxDD_DEFAULT_STYLE | wxDD_DIR_MUST_EXIST);
+  if (dialog.ShowModal() != wxID_OK || !playlist || !library_watcher) {
+    return;
+  }
+
+  wxString folder = dialog.GetPath();
+  if (!library_watcher->AddRoot(std::string(folder.utf8_str()))) {
+    wxMessageBox("Some folders under " + folder + " cannot be watched; changes to them will be missed.\n"
+                 "Raising fs.inotify.max_user_watches may help.",
+                 "Watch Folder", wxOK | wxICON_WARNING, this);
+  }
+  SaveWatchedFolders();
+
+  // What is there already is queued now; later changes arrive as batches
+  wxArrayString files;
+  wxDir::GetAllFiles(folder, &files);
+  files.Sort();
+  playlist->AddMultipleItems(files);
+
+  if (status_bar) {
+    status_bar->set_system_message("Watching " + folder);
+  }
+}
+
 void PlayerFrame::OnTogglePlaylist(wxCommandEvent& event)
 {
   if (main_layout) {
@@ -187,8 +287,59 @@ void PlayerFrame::OnTogglePlaylist(wxCommandEvent& event)
   event.Skip();
 }
 
+void PlayerFrame::OnVisualizationStyle(wxCommandEvent& event)
+{
+  if (player_ui_control) {
+    player_ui_control->GetAudioCanvas()->SetVisualizationStyle(event.GetId() - ID_VIS_WAVEFORM);
+  }
+}
+
+void PlayerFrame::OnAnalyzeTempo(wxCommandEvent& event)
+{
+  std::vector<std::string> paths;
+  for (size_t i = 0; playlist && i < playlist->GetCount(); i++) {
+    wxString item = playlist->GetItem(i);
+    if (utils::FileUtils::IsAudioFile(item)) {
+      paths.push_back(std::string(item.utf8_str()));
+    }
+  }
+  if (paths.empty()) {
+    wxMessageBox("The playlist has no audio files to analyze.", "Analyze Tempo", wxOK | wxICON_INFORMATION, this);
+    return;
+  }
+
+  // Leave a core for playback; declared before the pool so queued jobs
+  // never outlive what they point at
+  std::atomic<bool> cancel(false);
+  std::atomic<size_t> completed(0);
+  unsigned cores = std::thread::hardware_concurrency();
+  utils::ThreadPool pool(cores > 1 ? cores - 1 : 1);
+
+  size_t queued = utils::BpmCache::Get().AnalyzeFiles(paths, pool, cancel, completed);
+  if (queued > 0) {
+    wxProgressDialog progress("Analyze Tempo", "Analyzing playlist...", static_cast<int>(queued), this,
+                              wxPD_APP_MODAL | wxPD_CAN_ABORT | wxPD_AUTO_HIDE | wxPD_ELAPSED_TIME | wxPD_REMAINING_TIME);
+    while (!pool.WaitIdle(std::chrono::milliseconds(100))) {
+      size_t done = completed.load();
+      if (!cancel && !progress.Update(static_cast<int>(done), wxString::Format("Analyzed %zu of %zu files", done, queued))) {
+        cancel = true;
+      }
+    }
+  }
+  utils::BpmCache::Get().Save();
+
+  if (status_bar) {
+    status_bar->set_system_message(cancel ? wxString("Tempo analysis cancelled")
+                                          : wxString::Format("Tempo analyzed for %zu files", queued));
+  }
+  utils::LogUtils::LogInfo(wxString::Format("Tempo analysis: %zu of %zu playlist files needed analysis", queued, paths.size()));
+}
+
 PlayerFrame::~PlayerFrame()
 {
+  // No more batches may be queued for a playlist on its way out
+  library_watcher.reset();
+
   // Save window geometry
   wxConfigBase* config = wxConfig::Get();
   config->SetPath("/General");
@@ -0,0 +1,323 @@
+#include "art_cache.hpp"
+#include "content_hash.hpp"
+#include "performance_utils.hpp"
+#include "tag_reader.hpp"
+#include "thread_pool.hpp"
+#include <wx/image.h>
+#include <wx/log.h>
+#include <wx/mstream.h>
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <thread>
+
+namespace utils {
+
+namespace {
+
+// Folder images by preference, matched without case against the stem
+const char* const FOLDER_ART_NAMES[] = { "cover", "folder", "front", "albumart", "album" };
+const size_t MAX_FOLDER_ART_BYTES = 16 * 1024 * 1024;
+
+std::shared_ptr<ArtCache::Image> MakeImage(const wxImage& image)
+{
+    auto result = std::make_shared<ArtCache::Image>();
+    result->width = image.GetWidth();
+    result->height = image.GetHeight();
+    size_t pixels = static_cast<size_t>(result->width) * result->height;
+    result->rgb.assign(image.GetData(), image.GetData() + pixels * 3);
+    if (image.HasAlpha()) {
+        result->alpha.assign(image.GetAlpha(), image.GetAlpha() + pixels);
+    }
+    return result;
+}
+
+size_t GetImageBytes(const ArtCache::Image& image)
+{
+    return sizeof(image) + image.rgb.size() + image.alpha.size();
+}
+
+// Scaled down to fit a square of the given side; never scaled up
+wxImage FitImage(const wxImage& image, int pixels)
+{
+    int width = image.GetWidth();
+    int height = image.GetHeight();
+    if (width <= pixels && height <= pixels) {
+        return image;
+    }
+    double scale = static_cast<double>(pixels) / std::max(width, height);
+    return image.Scale(std::max(1, static_cast<int>(width * scale + 0.5)),
+                       std::max(1, static_cast<int>(height * scale + 0.5)), wxIMAGE_QUALITY_HIGH);
+}
+
+}
+
+ArtCache& ArtCache::Get()
+{
+    static ArtCache instance;
+    return instance;
+}
+
+ArtCache::ArtCache()
+    : memory_usage(0)
+{
+}
+
+bool ArtCache::Open(const std::string& path)
+{
+    Close();
+
+    std::error_code error;
+    std::filesystem::create_directories(path, error);
+    std::lock_guard<std::mutex> lock(mutex);
+    folder = path;
+    pool = std::make_unique<ThreadPool>(THREADS);
+
+    // A missing index only means no art is known yet
+    index.Load(folder + "/index.tsv");
+    return !error;
+}
+
+void ArtCache::Close()
+{
+    // Running jobs finish outside the lock, which they take themselves
+    std::unique_ptr<ThreadPool> stopping;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = std::move(pool);
+    }
+    stopping.reset();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    queued.clear();
+    index.Save();
+}
+
+void ArtCache::SetCallback(Callback function)
+{
+    std::lock_guard<std::mutex> lock(callback_mutex);
+    callback = std::move(function);
+}
+
+std::shared_ptr<const ArtCache::Image> ArtCache::Find(const std::string& path, Size size)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!pool) {
+        return nullptr;
+    }
+
+    // Entries loaded from the index are used at once and checked against
+    // the file in the background
+    auto entry = index.Find(path);
+    if (entry) {
+        const Indexed& known = entry->value;
+        auto image = known.art != 0 ? images.find(Key{ known.art, size }) : images.end();
+        if (image != images.end()) {
+            recent.splice(recent.begin(), recent, image->second);
+            if (!known.checked && queued.insert(path).second) {
+                pool->Submit([this, path] { Extract(path); });
+            }
+            return image->second->image;
+        }
+        if (known.art == 0 && known.checked) {
+            return nullptr;
+        }
+    }
+
+    if (queued.insert(path).second) {
+        pool->Submit([this, path] { Extract(path); });
+    }
+    return nullptr;
+}
+
+void ArtCache::Rename(const std::string& from, const std::string& to, bool folder)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    index.Rename(from, to, folder);
+}
+
+void ArtCache::Clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    recent.clear();
+    images.clear();
+    memory_usage = 0;
+}
+
+size_t ArtCache::GetMemoryUsage() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return memory_usage;
+}
+
+void ArtCache::Extract(const std::string& path)
+{
+    long long size = 0;
+    long long modified = 0;
+    bool exists = FileCacheBase::Stat(path, size, modified);
+
+    uint64_t art = 0;
+    bool known = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Indexed* indexed = index.Lookup(path, size, modified);
+        if (indexed) {
+            indexed->checked = true;
+            art = indexed->art;
+            known = true;
+        }
+    }
+
+    // Unknown or changed files are read again; art whose scaled images
+    // went missing from disk is decoded again
+    if (known && art != 0) {
+        known = LoadImages(art);
+    }
+    if (exists && !known) {
+        thread_local TagReader reader;
+        thread_local std::vector<unsigned char> data;
+        if (!reader.ReadPicture(path, data)) {
+            FindFolderArt(path, data);
+        }
+        art = data.empty() ? 0 : std::max<uint64_t>(ContentHash::Hash(data.data(), data.size()), 1);
+        if (art != 0 && !LoadImages(art) && !CreateImages(art, data)) {
+            art = 0;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!known) {
+            index.Store(path, size, modified, Indexed{ art, true });
+        }
+        queued.erase(path);
+    }
+
+    std::lock_guard<std::mutex> lock(callback_mutex);
+    if (callback) {
+        callback(path);
+    }
+}
+
+bool ArtCache::LoadImages(uint64_t art)
+{
+    wxLogNull quiet;
+    for (int size = 0; size < SIZES; size++) {
+        Key key{ art, static_cast<Size>(size) };
+        if (IsCached(key)) {
+            continue;
+        }
+        wxImage image;
+        std::string file = GetImagePath(key);
+        if (!std::filesystem::exists(file) || !image.LoadFile(wxString::FromUTF8(file.c_str()), wxBITMAP_TYPE_PNG)) {
+            return false;
+        }
+        Insert(key, MakeImage(image));
+    }
+    return true;
+}
+
+bool ArtCache::CreateImages(uint64_t art, const std::vector<unsigned char>& data)
+{
+    // Decoded once; each smaller size is scaled from the next larger
+    wxLogNull quiet;
+    wxMemoryInputStream stream(data.data(), data.size());
+    wxImage image;
+    if (!image.LoadFile(stream, wxBITMAP_TYPE_ANY) || !image.IsOk()) {
+        return false;
+    }
+
+    for (int size = SIZES - 1; size >= 0; size--) {
+        Key key{ art, static_cast<Size>(size) };
+        image = FitImage(image, GetPixels(key.size));
+
+        // Written beside and renamed into place: another thread may be
+        // storing the same art for another track of the album
+        std::string file = GetImagePath(key);
+        std::string temporary = file + ".tmp" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+        if (image.SaveFile(wxString::FromUTF8(temporary.c_str()), wxBITMAP_TYPE_PNG)) {
+            std::error_code error;
+            std::filesystem::rename(temporary, file, error);
+            if (error) {
+                std::remove(temporary.c_str());
+            }
+        }
+        Insert(key, MakeImage(image));
+    }
+    return true;
+}
+
+void ArtCache::Insert(const Key& key, std::shared_ptr<const Image> image)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto existing = images.find(key);
+    if (existing != images.end()) {
+        memory_usage -= GetImageBytes(*existing->second->image);
+        recent.erase(existing->second);
+        images.erase(existing);
+    }
+    memory_usage += GetImageBytes(*image);
+    recent.push_front(Cached{ key, std::move(image) });
+    images[key] = recent.begin();
+
+    // The newest image stays even if it alone is over the limit
+    size_t limit = PerformanceUtils::GetMaxCacheSize();
+    while (memory_usage > limit && recent.size() > 1) {
+        memory_usage -= GetImageBytes(*recent.back().image);
+        images.erase(recent.back().key);
+        recent.pop_back();
+    }
+}
+
+bool ArtCache::IsCached(const Key& key) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return images.count(key) != 0;
+}
+
+std::string ArtCache::GetImagePath(const Key& key) const
+{
+    char name[48];
+    std::snprintf(name, sizeof(name), "%016llx-%d.png", static_cast<unsigned long long>(key.art),
+                  GetPixels(key.size));
+    std::lock_guard<std::mutex> lock(mutex);
+    return folder + '/' + name;
+}
+
+bool ArtCache::FindFolderArt(const std::string& path, std::vector<unsigned char>& data)
+{
+    data.clear();
+    std::error_code error;
+    std::filesystem::path best;
+    size_t best_rank = std::size(FOLDER_ART_NAMES);
+    for (const auto& item : std::filesystem::directory_iterator(std::filesystem::path(path).parent_path(), error)) {
+        std::string stem = item.path().stem().string();
+        std::string extension = item.path().extension().string();
+        std::transform(stem.begin(), stem.end(), stem.begin(), [](unsigned char c) { return std::tolower(c); });
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return std::tolower(c); });
+        if (extension != ".jpg" && extension != ".jpeg" && extension != ".png") {
+            continue;
+        }
+        // "albumart" also covers Windows Media Player's AlbumArt_{...}_Large
+        for (size_t rank = 0; rank < best_rank; rank++) {
+            std::string_view name(FOLDER_ART_NAMES[rank]);
+            if (stem == name || (name == "albumart" && stem.compare(0, name.size(), name) == 0)) {
+                best = item.path();
+                best_rank = rank;
+                break;
+            }
+        }
+    }
+    if (best.empty() || std::filesystem::file_size(best, error) > MAX_FOLDER_ART_BYTES || error) {
+        return false;
+    }
+
+    std::ifstream in(best, std::ios::binary);
+    data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    return !data.empty();
+}
+
+}
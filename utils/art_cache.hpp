@@ -0,0 +1,128 @@
+#ifndef __ART_CACHE_HPP
+#define __ART_CACHE_HPP
+
+#include "file_cache.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace utils {
+
+class ThreadPool;
+
+// Album art for tracks, decoded and downscaled once and kept ready to draw.
+//
+// A track's art is its embedded front cover (see TagReader::ReadPicture)
+// or else an image such as cover.jpg or folder.jpg in its folder. Finding,
+// decoding and scaling it to every Size happen on a small pool of
+// background threads. Find() only looks in memory and queues whatever is
+// missing, so the GUI thread may ask for art on every paint.
+//
+// Images are addressed by a hash of the encoded art, so the tracks of an
+// album share one copy in memory and one PNG per size on disk. Memory is
+// bounded by PerformanceUtils::GetMaxCacheSize(), dropping the least
+// recently used first. The art each file has is remembered in an index
+// (a FileCache, checked against size and modification time), so a later
+// session goes straight to the scaled PNGs. All methods are thread-safe.
+class ArtCache {
+public:
+    enum Size { THUMBNAIL, COVER, SIZES };
+
+    // 8-bit RGB rows, and alpha when the art has it
+    struct Image {
+        int width;
+        int height;
+        std::vector<unsigned char> rgb;
+        std::vector<unsigned char> alpha;
+    };
+
+    // Runs on a worker thread once a path's art is in memory or known to
+    // be missing
+    using Callback = std::function<void(const std::string& path)>;
+
+    static ArtCache& Get();
+
+    // folder holds the index and the images, and is created if missing
+    bool Open(const std::string& folder);
+    void Close();               // drops queued work and saves the index
+
+    // No call of the previous callback is running once this returns
+    void SetCallback(Callback callback);
+
+    // The art if it is in memory; otherwise nullptr, and it is fetched in
+    // the background unless the file is known to have none
+    std::shared_ptr<const Image> Find(const std::string& path, Size size);
+
+    void Rename(const std::string& from, const std::string& to, bool folder);   // see FileCache
+
+    void Clear();               // drops the images in memory
+    size_t GetMemoryUsage() const;
+
+    // Longest side of each size, in pixels
+    static int GetPixels(Size size) { return size == THUMBNAIL ? 64 : 512; }
+
+    static constexpr size_t THREADS = 2;
+
+private:
+    struct Indexed {
+        uint64_t art;           // 0: none
+        bool checked;           // against the file this session
+
+        bool Read(std::istream& fields)
+        {
+            checked = false;
+            return static_cast<bool>(fields >> art);
+        }
+        void Write(std::ostream& out) const { out << '\t' << art; }
+    };
+
+    struct Key {
+        uint64_t art;
+        Size size;
+        bool operator==(const Key& other) const { return art == other.art && size == other.size; }
+    };
+    struct KeyHash {
+        size_t operator()(const Key& key) const { return key.art ^ (uint64_t(key.size) * 0x9E3779B97F4A7C15ull); }
+    };
+    struct Cached {
+        Key key;
+        std::shared_ptr<const Image> image;
+    };
+
+    ArtCache();
+
+    mutable std::mutex mutex;
+    std::string folder;
+    std::unique_ptr<ThreadPool> pool;
+    FileCache<Indexed> index;
+    std::unordered_set<std::string> queued;
+
+    std::list<Cached> recent;                   // most recently used first
+    std::unordered_map<Key, std::list<Cached>::iterator, KeyHash> images;
+    size_t memory_usage;
+
+    std::mutex callback_mutex;
+    Callback callback;
+
+    void Extract(const std::string& path);
+    bool LoadImages(uint64_t art);              // scaled PNGs from disk
+    bool CreateImages(uint64_t art, const std::vector<unsigned char>& data);
+    void Insert(const Key& key, std::shared_ptr<const Image> image);
+    bool IsCached(const Key& key) const;
+    std::string GetImagePath(const Key& key) const;
+
+    static bool FindFolderArt(const std::string& path, std::vector<unsigned char>& data);
+};
+
+}
+
+#endif // __ART_CACHE_HPP
@@ -0,0 +1,340 @@
+#include "audio_decoder.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+#ifdef WANJPLAYER_HAVE_GSTREAMER
+#include <gst/gst.h>
+#include <gst/app/gstappsink.h>
+#endif
+
+namespace utils {
+
+namespace {
+
+uint16_t ReadLE16(const uint8_t* p)
+{
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+uint32_t ReadLE32(const uint8_t* p)
+{
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+bool HasWavExtension(const std::string& path)
+{
+    if (path.size() < 4) {
+        return false;
+    }
+    std::string ext = path.substr(path.size() - 4);
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return std::tolower(c); });
+    return ext == ".wav";
+}
+
+#ifdef WANJPLAYER_HAVE_GSTREAMER
+
+// Decodes anything GStreamer can play through an appsink, as fast as possible
+class GstDecoder : public AudioDecoder {
+public:
+    GstDecoder()
+        : pipeline(nullptr)
+        , sink(nullptr)
+        , sample_rate(0)
+        , channels(0)
+        , total_frames(-1)
+        , pending_pos(0)
+        , eos(false)
+    {
+    }
+
+    ~GstDecoder() override
+    {
+        if (pipeline) {
+            gst_element_set_state(pipeline, GST_STATE_NULL);
+            gst_object_unref(sink);
+            gst_object_unref(pipeline);
+        }
+    }
+
+    bool Open(const std::string& path)
+    {
+        if (!gst_init_check(nullptr, nullptr, nullptr)) {
+            return false;
+        }
+
+        gchar* uri = gst_filename_to_uri(path.c_str(), nullptr);
+        if (!uri) {
+            return false;
+        }
+
+        pipeline = gst_parse_launch(
+            "uridecodebin name=src ! audioconvert ! audioresample ! "
+            "appsink name=sink sync=false max-buffers=8 "
+            "caps=audio/x-raw,format=F32LE,layout=interleaved",
+            nullptr);
+        if (!pipeline) {
+            g_free(uri);
+            return false;
+        }
+
+        GstElement* src = gst_bin_get_by_name(GST_BIN(pipeline), "src");
+        g_object_set(src, "uri", uri, nullptr);
+        gst_object_unref(src);
+        g_free(uri);
+
+        sink = gst_bin_get_by_name(GST_BIN(pipeline), "sink");
+        gst_element_set_state(pipeline, GST_STATE_PAUSED);
+        if (gst_element_get_state(pipeline, nullptr, nullptr, 5 * GST_SECOND) == GST_STATE_CHANGE_FAILURE) {
+            return false;
+        }
+
+        // The preroll sample carries the negotiated format
+        GstSample* preroll = gst_app_sink_pull_preroll(GST_APP_SINK(sink));
+        if (!preroll) {
+            return false;
+        }
+        GstStructure* caps = gst_caps_get_structure(gst_sample_get_caps(preroll), 0);
+        gst_structure_get_int(caps, "rate", &sample_rate);
+        gst_structure_get_int(caps, "channels", &channels);
+        gst_sample_unref(preroll);
+        if (sample_rate <= 0 || channels <= 0) {
+            return false;
+        }
+
+        gint64 duration = 0;
+        if (gst_element_query_duration(pipeline, GST_FORMAT_TIME, &duration) && duration > 0) {
+            total_frames = gst_util_uint64_scale(duration, sample_rate, GST_SECOND);
+        }
+
+        gst_element_set_state(pipeline, GST_STATE_PLAYING);
+        return true;
+    }
+
+    int GetSampleRate() const override { return sample_rate; }
+    int GetChannels() const override { return channels; }
+    long long GetTotalFrames() const override { return total_frames; }
+
+    size_t Read(float* interleaved, size_t frames) override
+    {
+        size_t wanted = frames * channels;
+        size_t copied = 0;
+
+        while (copied < wanted) {
+            if (pending_pos >= pending.size()) {
+                if (eos || !PullSample()) {
+                    break;
+                }
+            }
+            size_t count = std::min(wanted - copied, pending.size() - pending_pos);
+            std::memcpy(interleaved + copied, &pending[pending_pos], count * sizeof(float));
+            pending_pos += count;
+            copied += count;
+        }
+
+        return copied / channels;
+    }
+
+    bool Seek(long long frame) override
+    {
+        pending.clear();
+        pending_pos = 0;
+        eos = false;
+        gint64 position = gst_util_uint64_scale(std::max(0LL, frame), GST_SECOND, sample_rate);
+        return gst_element_seek_simple(pipeline, GST_FORMAT_TIME,
+                                       static_cast<GstSeekFlags>(GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_ACCURATE),
+                                       position);
+    }
+
+private:
+    GstElement* pipeline;
+    GstElement* sink;
+    int sample_rate;
+    int channels;
+    long long total_frames;
+    std::vector<float> pending;
+    size_t pending_pos;
+    bool eos;
+
+    bool PullSample()
+    {
+        GstSample* sample = gst_app_sink_pull_sample(GST_APP_SINK(sink));
+        if (!sample) {
+            eos = true;
+            return false;
+        }
+
+        GstBuffer* buffer = gst_sample_get_buffer(sample);
+        GstMapInfo map;
+        if (buffer && gst_buffer_map(buffer, &map, GST_MAP_READ)) {
+            const float* data = reinterpret_cast<const float*>(map.data);
+            pending.assign(data, data + map.size / sizeof(float));
+            gst_buffer_unmap(buffer, &map);
+        } else {
+            pending.clear();
+        }
+        pending_pos = 0;
+        gst_sample_unref(sample);
+        return true;
+    }
+};
+
+#endif // WANJPLAYER_HAVE_GSTREAMER
+
+} // namespace
+
+std::unique_ptr<AudioDecoder> AudioDecoder::Open(const std::string& path)
+{
+    if (HasWavExtension(path)) {
+        auto wav = std::make_unique<WavDecoder>();
+        if (wav->Open(path)) {
+            return wav;
+        }
+    }
+
+#ifdef WANJPLAYER_HAVE_GSTREAMER
+    auto gst = std::make_unique<GstDecoder>();
+    if (gst->Open(path)) {
+        return gst;
+    }
+#endif
+
+    return nullptr;
+}
+
+// WavDecoder implementation
+
+WavDecoder::WavDecoder()
+    : file(nullptr)
+    , sample_rate(0)
+    , channels(0)
+    , bits_per_sample(0)
+    , is_float(false)
+    , data_offset(0)
+    , total_frames(0)
+    , position(0)
+{
+}
+
+WavDecoder::~WavDecoder()
+{
+    if (file) {
+        fclose(file);
+    }
+}
+
+bool WavDecoder::Open(const std::string& path)
+{
+    file = fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+
+    uint8_t header[12];
+    if (fread(header, 1, sizeof(header), file) != sizeof(header) ||
+        std::memcmp(header, "RIFF", 4) != 0 || std::memcmp(header + 8, "WAVE", 4) != 0) {
+        return false;
+    }
+
+    bool have_format = false;
+    uint8_t chunk[8];
+    while (fread(chunk, 1, sizeof(chunk), file) == sizeof(chunk)) {
+        uint32_t chunk_size = ReadLE32(chunk + 4);
+        long chunk_start = ftell(file);
+
+        if (std::memcmp(chunk, "fmt ", 4) == 0 && chunk_size >= 16) {
+            uint8_t fmt[40] = {};
+            size_t fmt_size = std::min<size_t>(chunk_size, sizeof(fmt));
+            if (fread(fmt, 1, fmt_size, file) != fmt_size) {
+                return false;
+            }
+            uint16_t format_tag = ReadLE16(fmt);
+            channels = ReadLE16(fmt + 2);
+            sample_rate = static_cast<int>(ReadLE32(fmt + 4));
+            bits_per_sample = ReadLE16(fmt + 14);
+
+            // WAVE_FORMAT_EXTENSIBLE stores the real tag in the sub-format GUID
+            if (format_tag == 0xFFFE && fmt_size >= 26) {
+                format_tag = ReadLE16(fmt + 24);
+            }
+            is_float = (format_tag == 3);
+            have_format = (format_tag == 1 || format_tag == 3);
+        } else if (std::memcmp(chunk, "data", 4) == 0) {
+            if (!have_format || channels <= 0 || bits_per_sample % 8 != 0 || bits_per_sample == 0) {
+                return false;
+            }
+            data_offset = chunk_start;
+            total_frames = chunk_size / BytesPerFrame();
+            position = 0;
+            return sample_rate > 0;
+        }
+
+        // Chunks are word-aligned
+        if (fseek(file, chunk_start + chunk_size + (chunk_size & 1), SEEK_SET) != 0) {
+            return false;
+        }
+    }
+
+    return false;
+}
+
+size_t WavDecoder::Read(float* interleaved, size_t frames)
+{
+    if (!file || position >= total_frames) {
+        return 0;
+    }
+
+    frames = static_cast<size_t>(std::min<long long>(frames, total_frames - position));
+    const size_t bytes_per_sample = bits_per_sample / 8;
+    raw.resize(frames * BytesPerFrame());
+    size_t frames_read = fread(raw.data(), BytesPerFrame(), frames, file);
+    size_t samples = frames_read * channels;
+    const uint8_t* p = raw.data();
+
+    for (size_t i = 0; i < samples; i++, p += bytes_per_sample) {
+        float value = 0.0f;
+        if (is_float) {
+            if (bits_per_sample == 32) {
+                std::memcpy(&value, p, sizeof(float));
+            } else if (bits_per_sample == 64) {
+                double d;
+                std::memcpy(&d, p, sizeof(double));
+                value = static_cast<float>(d);
+            }
+        } else {
+            switch (bits_per_sample) {
+                case 8:
+                    value = (static_cast<int>(p[0]) - 128) / 128.0f;
+                    break;
+                case 16:
+                    value = static_cast<int16_t>(ReadLE16(p)) / 32768.0f;
+                    break;
+                case 24:
+                    value = (static_cast<int32_t>((static_cast<uint32_t>(p[0]) << 8) |
+                                                  (static_cast<uint32_t>(p[1]) << 16) |
+                                                  (static_cast<uint32_t>(p[2]) << 24)) >> 8) / 8388608.0f;
+                    break;
+                case 32:
+                    value = static_cast<int32_t>(ReadLE32(p)) / 2147483648.0f;
+                    break;
+            }
+        }
+        interleaved[i] = value;
+    }
+
+    position += frames_read;
+    return frames_read;
+}
+
+bool WavDecoder::Seek(long long frame)
+{
+    if (!file) {
+        return false;
+    }
+
+    position = std::max(0LL, std::min(frame, total_frames));
+    return fseek(file, static_cast<long>(data_offset + position * static_cast<long long>(BytesPerFrame())), SEEK_SET) == 0;
+}
+
+}
@@ -0,0 +1,64 @@
+#ifndef __AUDIO_DECODER_HPP
+#define __AUDIO_DECODER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace utils {
+
+// Decodes a media file to interleaved 32-bit float PCM.
+//
+// WAV is decoded natively. Other formats go through GStreamer when the build
+// found it (WANJPLAYER_HAVE_GSTREAMER); otherwise Open() returns nullptr for
+// them and callers fall back to their non-PCM behaviour.
+class AudioDecoder {
+public:
+    virtual ~AudioDecoder() = default;
+
+    static std::unique_ptr<AudioDecoder> Open(const std::string& path);
+
+    virtual int GetSampleRate() const = 0;
+    virtual int GetChannels() const = 0;
+    virtual long long GetTotalFrames() const = 0;  // -1 when unknown
+
+    // Returns frames decoded; 0 means end of stream
+    virtual size_t Read(float* interleaved, size_t frames) = 0;
+    virtual bool Seek(long long frame) = 0;
+};
+
+// Native RIFF/WAVE reader (PCM 8/16/24/32-bit, IEEE float 32/64-bit)
+class WavDecoder : public AudioDecoder {
+public:
+    WavDecoder();
+    ~WavDecoder() override;
+
+    bool Open(const std::string& path);
+
+    int GetSampleRate() const override { return sample_rate; }
+    int GetChannels() const override { return channels; }
+    long long GetTotalFrames() const override { return total_frames; }
+
+    size_t Read(float* interleaved, size_t frames) override;
+    bool Seek(long long frame) override;
+
+private:
+    FILE* file;
+    int sample_rate;
+    int channels;
+    int bits_per_sample;
+    bool is_float;
+    long long data_offset;
+    long long total_frames;
+    long long position;
+    std::vector<uint8_t> raw;
+
+    size_t BytesPerFrame() const { return static_cast<size_t>(channels) * (bits_per_sample / 8); }
+};
+
+}
+
+#endif // __AUDIO_DECODER_HPP
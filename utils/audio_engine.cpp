@@ -0,0 +1,364 @@
+#include "audio_engine.hpp"
+#include <algorithm>
+
+namespace utils {
+
+AudioEngine::AudioEngine()
+    : sink(nullptr)
+    , stretching(false)
+    , stretched_frames(0)
+    , sample_rate(0)
+    , channels(0)
+    , running(false)
+    , end_of_stream(false)
+    , clock_frame(0)
+    , clock_playing(false)
+    , clock_rate(1.0)
+    , loop_start(0)
+    , loop_end(-1)
+    , loop_generation(0)
+    , active_loop_start(0)
+    , active_loop_end(-1)
+    , active_loop_generation(0)
+    , preroll_start(0)
+{
+}
+
+AudioEngine::~AudioEngine()
+{
+    Close();
+}
+
+bool AudioEngine::Open(const std::string& path)
+{
+    if (!Prepare(path)) {
+        return false;
+    }
+
+    running.store(true, std::memory_order_release);
+    worker = std::thread(&AudioEngine::Run, this);
+    return true;
+}
+
+long long AudioEngine::Render(const std::string& path, AudioSink& output, long long max_frames, double rate)
+{
+    if (!Prepare(path)) {
+        return -1;
+    }
+    if (!output.Open(sample_rate, channels)) {
+        decoder.reset();
+        return -1;
+    }
+
+    stretching = rate != 1.0;
+    if (stretching) {
+        stretcher.Configure(sample_rate, channels, BLOCK_FRAMES);
+        stretcher.SetRate(rate);
+        stretched.assign(BLOCK_FRAMES * channels, 0.0f);
+        stretched_frames = 0;
+    }
+
+    sink = &output;
+    long long rendered = 0;
+    while (max_frames < 0 || rendered < max_frames) {
+        size_t frames = BLOCK_FRAMES;
+        if (max_frames >= 0) {
+            frames = static_cast<size_t>(std::min<long long>(frames, max_frames - rendered));
+        }
+        if (!DecodeBlock(frames)) {
+            break;
+        }
+        rendered = tap.GetWriteFrame();
+    }
+
+    // Silence pushes the last of the audio through the stretcher's window,
+    // up to the stretched length of what was decoded
+    if (stretching) {
+        const long long length = static_cast<long long>(rendered / stretcher.GetRate());
+        std::fill(block.begin(), block.end(), 0.0f);
+        while (stretched_frames < length && WriteSink(block.data(), BLOCK_FRAMES, length)) {
+        }
+    }
+    stretching = false;
+    sink = nullptr;
+    output.Close();
+    return rendered;
+}
+
+bool AudioEngine::Prepare(const std::string& path)
+{
+    Close();
+
+    decoder = AudioDecoder::Open(path);
+    if (!decoder) {
+        return false;
+    }
+
+    this->path = path;
+    sample_rate = decoder->GetSampleRate();
+    channels = decoder->GetChannels();
+    block.assign(BLOCK_FRAMES * channels, 0.0f);
+    block_mono.assign(BLOCK_FRAMES, 0.0f);
+    end_of_stream = false;
+    tap.Reset(0, sample_rate);
+    levels.Reset();
+    beats.Reset(sample_rate, 0);
+
+    {
+        std::lock_guard<std::mutex> lock(clock_mutex);
+        clock_frame = 0;
+        clock_time = std::chrono::steady_clock::now();
+        clock_playing = false;
+        clock_rate = 1.0;
+        loop_end = -1;
+        active_loop_generation = loop_generation;
+    }
+    active_loop_end = -1;
+    loop_preroll.clear();
+    return true;
+}
+
+void AudioEngine::Close()
+{
+    if (worker.joinable()) {
+        running.store(false, std::memory_order_release);
+        wake.notify_all();
+        worker.join();
+    }
+    running.store(false, std::memory_order_release);
+    decoder.reset();
+}
+
+void AudioEngine::SetClock(long long position_ms, bool playing, double rate)
+{
+    {
+        std::lock_guard<std::mutex> lock(clock_mutex);
+        clock_frame = position_ms * sample_rate / 1000;
+        clock_time = std::chrono::steady_clock::now();
+        clock_playing = playing;
+        clock_rate = rate;
+    }
+    wake.notify_one();
+}
+
+long long AudioEngine::GetPlaybackFrame() const
+{
+    std::lock_guard<std::mutex> lock(clock_mutex);
+    long long frame = clock_frame;
+    if (clock_playing) {
+        // Extrapolate between clock updates
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - clock_time).count();
+        frame += static_cast<long long>(elapsed * clock_rate * sample_rate);
+    }
+
+    // Past the loop end, the backend is about to seek back to the start
+    if (loop_end >= 0 && frame >= loop_end) {
+        frame = loop_start + (frame - loop_end) % (loop_end - loop_start);
+    }
+    return frame;
+}
+
+bool AudioEngine::SetLoop(long long start_frame, long long end_frame)
+{
+    if (start_frame < 0 || end_frame - start_frame < static_cast<long long>(MIN_LOOP_MS) * sample_rate / 1000) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(clock_mutex);
+        loop_start = start_frame;
+        loop_end = end_frame;
+        loop_generation++;
+    }
+    wake.notify_one();
+    return true;
+}
+
+void AudioEngine::ClearLoop()
+{
+    {
+        std::lock_guard<std::mutex> lock(clock_mutex);
+        if (loop_end < 0) {
+            return;
+        }
+        loop_end = -1;
+        loop_generation++;
+    }
+    wake.notify_one();
+}
+
+void AudioEngine::Run()
+{
+    const long long lookahead = sample_rate / 4;
+    const long long capacity = static_cast<long long>(tap.GetCapacity());
+
+    while (running.load(std::memory_order_acquire)) {
+        SyncLoop();
+
+        long long playback = GetPlaybackFrame();
+        long long written = tap.GetWriteFrame();
+        long long needed_from = std::max(0LL, playback - static_cast<long long>(HISTORY_FRAMES));
+
+        // Decoding stopped on the loop end and the clock has folded back
+        // into the region
+        bool at_loop_end = active_loop_end >= 0 && written >= active_loop_end;
+        if (at_loop_end && playback >= active_loop_start &&
+            playback < written - lookahead - static_cast<long long>(BLOCK_FRAMES)) {
+            WrapLoop();
+            continue;
+        }
+
+        // Resynchronise after seeks: history fell out of the tap, or the
+        // backend jumped too far ahead to catch up by decoding
+        if (needed_from < tap.GetStartFrame() ||
+            needed_from < written - capacity ||
+            (!end_of_stream && playback > written + sample_rate)) {
+            SeekTo(needed_from);
+            continue;
+        }
+
+        if (!end_of_stream && !at_loop_end && written < playback + lookahead) {
+            size_t frames = BLOCK_FRAMES;
+            if (active_loop_end >= 0 && active_loop_end - written < static_cast<long long>(BLOCK_FRAMES)) {
+                frames = static_cast<size_t>(active_loop_end - written);
+            }
+            if (!DecodeBlock(frames)) {
+                end_of_stream = true;
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(wake_mutex);
+        wake.wait_for(lock, std::chrono::milliseconds(10));
+    }
+}
+
+void AudioEngine::SeekTo(long long frame)
+{
+    decoder->Seek(frame);
+    tap.Reset(frame, sample_rate);
+    levels.Reset();
+    beats.Restart(frame);
+    end_of_stream = false;
+}
+
+void AudioEngine::SyncLoop()
+{
+    long long start;
+    long long end;
+    {
+        std::lock_guard<std::mutex> lock(clock_mutex);
+        if (loop_generation == active_loop_generation) {
+            return;
+        }
+        active_loop_generation = loop_generation;
+        start = loop_start;
+        end = loop_end;
+    }
+
+    active_loop_start = start;
+    active_loop_end = end;
+    loop_preroll.clear();
+    if (end < 0) {
+        return;
+    }
+
+    // A second decoder leaves the playback decoder where it is; without
+    // one the wrap falls back to seeking
+    preroll_start = std::max(0LL, start - static_cast<long long>(HISTORY_FRAMES));
+    std::unique_ptr<AudioDecoder> reader = AudioDecoder::Open(path);
+    if (!reader || !reader->Seek(preroll_start)) {
+        return;
+    }
+
+    const long long preroll_end = std::min(end, start + sample_rate / 4 + static_cast<long long>(BLOCK_FRAMES));
+    const size_t total = static_cast<size_t>(preroll_end - preroll_start);
+    loop_preroll.resize(total * channels);
+    size_t frames = 0;
+    while (frames < total) {
+        size_t read = reader->Read(loop_preroll.data() + frames * channels, total - frames);
+        if (read == 0) break;
+        frames += read;
+    }
+    loop_preroll.resize(frames * channels);
+}
+
+void AudioEngine::WrapLoop()
+{
+    tap.Reset(preroll_start, sample_rate);
+    levels.Reset();
+    beats.Restart(preroll_start);
+
+    const size_t frames = loop_preroll.size() / channels;
+    for (size_t done = 0; done < frames; done += BLOCK_FRAMES) {
+        size_t count = std::min(frames - done, static_cast<size_t>(BLOCK_FRAMES));
+        Publish(loop_preroll.data() + done * channels, count);
+    }
+    decoder->Seek(preroll_start + static_cast<long long>(frames));
+    end_of_stream = false;
+}
+
+bool AudioEngine::DecodeBlock(size_t max_frames)
+{
+    size_t frames = decoder->Read(block.data(), max_frames < BLOCK_FRAMES ? max_frames : BLOCK_FRAMES);
+    if (frames == 0) {
+        return false;
+    }
+    if (sink && !WriteSink(block.data(), frames)) {
+        return false;
+    }
+    Publish(block.data(), frames);
+    return true;
+}
+
+bool AudioEngine::WriteSink(const float* interleaved, size_t frames, long long limit)
+{
+    if (!stretching) {
+        return sink->Write(interleaved, frames);
+    }
+
+    // Drained after every write, the stretcher always has room for a block
+    size_t accepted = 0;
+    while (accepted < frames) {
+        size_t count = stretcher.Write(interleaved + accepted * channels, frames - accepted);
+        if (count == 0) {
+            return false;
+        }
+        accepted += count;
+
+        while (limit < 0 || stretched_frames < limit) {
+            size_t wanted = BLOCK_FRAMES;
+            if (limit >= 0) {
+                wanted = static_cast<size_t>(std::min<long long>(wanted, limit - stretched_frames));
+            }
+            size_t produced = stretcher.Read(stretched.data(), wanted);
+            if (produced == 0) {
+                break;
+            }
+            if (!sink->Write(stretched.data(), produced)) {
+                return false;
+            }
+            stretched_frames += static_cast<long long>(produced);
+        }
+    }
+    return true;
+}
+
+void AudioEngine::Publish(const float* interleaved, size_t frames)
+{
+    // Meter levels come from the interleaved block, before the mixdown
+    levels.Measure(interleaved, frames, channels, tap.GetWriteFrame() + static_cast<long long>(frames));
+
+    const float scale = 1.0f / channels;
+    for (size_t i = 0; i < frames; i++) {
+        float sum = 0.0f;
+        for (int c = 0; c < channels; c++) {
+            sum += interleaved[i * channels + c];
+        }
+        block_mono[i] = sum * scale;
+    }
+
+    tap.Write(block_mono.data(), frames);
+    beats.Process(block_mono.data(), frames);
+}
+
+}
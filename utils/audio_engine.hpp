@@ -0,0 +1,132 @@
+#ifndef __AUDIO_ENGINE_HPP
+#define __AUDIO_ENGINE_HPP
+
+#include "audio_decoder.hpp"
+#include "audio_sink.hpp"
+#include "beat_tracker.hpp"
+#include "level_meter.hpp"
+#include "pcm_tap.hpp"
+#include "time_stretch.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace utils {
+
+// Decoded-PCM path that runs alongside the media backend.
+//
+// wxMediaCtrl renders audio itself and does not expose samples, so the engine
+// decodes the same file on a worker thread, a little ahead of the backend's
+// playback clock, and publishes the result through a PcmTap. The GUI feeds the
+// clock with SetClock() and reads windows ending at GetPlaybackFrame().
+//
+// A loop region only shapes the PCM decoded here for the visualizers:
+// decoding stops on the region's end frame and continues from audio
+// pre-decoded at its start, and the clock folds positions past the end back
+// into the region until the backend's own seek lands. What is heard loops
+// when MediaControls seeks the backend.
+//
+// Render() runs the same decode and analysis path without a backend or a
+// clock, as fast as the sink accepts frames, for benchmarks and headless
+// checks. At a rate other than 1.0 the sink gets the audio time-stretched
+// by a TimeStretcher, at the same pitch.
+class AudioEngine {
+public:
+    AudioEngine();
+    ~AudioEngine();
+
+    bool Open(const std::string& path);
+    void Close();
+    bool IsOpen() const { return running.load(std::memory_order_acquire); }
+
+    // Decodes path into sink on the calling thread, stopping after
+    // max_frames when that is not negative. Returns the frames decoded, or
+    // -1 if the file or the sink could not be opened; at another rate the
+    // sink gets about frames / rate. The analysis taps see the decoded
+    // stream and keep their final state until the next Open() or Render().
+    long long Render(const std::string& path, AudioSink& sink, long long max_frames = -1, double rate = 1.0);
+
+    // Playback clock (GUI thread)
+    void SetClock(long long position_ms, bool playing, double rate = 1.0);
+    long long GetPlaybackFrame() const;
+
+    // Loop region in frames (GUI thread). Returns false, leaving any
+    // previous region in place, when it is shorter than MIN_LOOP_MS.
+    bool SetLoop(long long start_frame, long long end_frame);
+    void ClearLoop();
+
+    const PcmTap& GetTap() const { return tap; }
+    const LevelTap& GetLevels() const { return levels; }
+    const BeatTracker& GetBeats() const { return beats; }
+    int GetSampleRate() const { return sample_rate; }
+    int GetChannels() const { return channels; }
+
+    // History kept behind the playback position for analysis windows
+    static const size_t HISTORY_FRAMES = 16384;
+
+    static const int MIN_LOOP_MS = 500;
+
+private:
+    std::unique_ptr<AudioDecoder> decoder;
+    std::string path;
+    AudioSink* sink;            // only while rendering
+    TimeStretcher stretcher;    // between the decoder and sink, when stretching
+    bool stretching;
+    std::vector<float> stretched;
+    long long stretched_frames;
+    PcmTap tap;
+    LevelTap levels;
+    BeatTracker beats;
+    int sample_rate;
+    int channels;
+
+    // Worker
+    std::thread worker;
+    std::atomic<bool> running;
+    std::mutex wake_mutex;
+    std::condition_variable wake;
+    std::vector<float> block;
+    std::vector<float> block_mono;
+    bool end_of_stream;
+
+    // Clock anchor: frame position at a steady_clock instant
+    mutable std::mutex clock_mutex;
+    long long clock_frame;
+    std::chrono::steady_clock::time_point clock_time;
+    bool clock_playing;
+    double clock_rate;
+
+    // Loop region as set by the GUI (clock_mutex); end -1 when off
+    long long loop_start;
+    long long loop_end;
+    unsigned loop_generation;
+
+    // Worker's copy of the region and the audio it wraps to: interleaved
+    // frames from preroll_start, covering the analysis history before the
+    // loop start and the lookahead after it
+    long long active_loop_start;
+    long long active_loop_end;
+    unsigned active_loop_generation;
+    long long preroll_start;
+    std::vector<float> loop_preroll;
+
+    bool Prepare(const std::string& path);
+    void Run();
+    void SeekTo(long long frame);
+    void SyncLoop();
+    void WrapLoop();
+    bool DecodeBlock(size_t max_frames = BLOCK_FRAMES);
+    bool WriteSink(const float* interleaved, size_t frames, long long limit = -1);
+    void Publish(const float* interleaved, size_t frames);
+
+    static const size_t BLOCK_FRAMES = 1024;
+};
+
+}
+
+#endif // __AUDIO_ENGINE_HPP
@@ -0,0 +1,147 @@
+#include "audio_sink.hpp"
+#include <algorithm>
+#include <cstdint>
+
+namespace utils {
+
+namespace {
+
+void PutLE16(uint8_t* p, uint16_t value)
+{
+    p[0] = static_cast<uint8_t>(value);
+    p[1] = static_cast<uint8_t>(value >> 8);
+}
+
+void PutLE32(uint8_t* p, uint32_t value)
+{
+    p[0] = static_cast<uint8_t>(value);
+    p[1] = static_cast<uint8_t>(value >> 8);
+    p[2] = static_cast<uint8_t>(value >> 16);
+    p[3] = static_cast<uint8_t>(value >> 24);
+}
+
+const uint16_t WAVE_FORMAT_IEEE_FLOAT = 3;
+const size_t WAV_HEADER_SIZE = 58;  // RIFF + fmt (18) + fact + data headers
+
+}
+
+NullSink::NullSink()
+    : frames_written(0)
+{
+}
+
+bool NullSink::Open(int sample_rate, int channels)
+{
+    frames_written = 0;
+    return sample_rate > 0 && channels > 0;
+}
+
+bool NullSink::Write(const float* /*interleaved*/, size_t frames)
+{
+    frames_written += static_cast<long long>(frames);
+    return true;
+}
+
+WavSink::WavSink(const std::string& path)
+    : path(path)
+    , file(nullptr)
+    , sample_rate(0)
+    , channels(0)
+    , frames_written(0)
+{
+}
+
+WavSink::~WavSink()
+{
+    Close();
+}
+
+bool WavSink::Open(int rate, int channel_count)
+{
+    Close();
+    if (rate <= 0 || channel_count <= 0) {
+        return false;
+    }
+
+    file = fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+
+    sample_rate = rate;
+    channels = channel_count;
+    frames_written = 0;
+
+    // Placeholder sizes until Close()
+    if (!WriteHeader(0)) {
+        fclose(file);
+        file = nullptr;
+        return false;
+    }
+    return true;
+}
+
+bool WavSink::Write(const float* interleaved, size_t frames)
+{
+    if (!file) {
+        return false;
+    }
+
+    // Samples are stored as the host's floats, which WAV defines as
+    // little-endian like every platform the decoder supports
+    size_t samples = frames * channels;
+    if (fwrite(interleaved, sizeof(float), samples, file) != samples) {
+        return false;
+    }
+    frames_written += static_cast<long long>(frames);
+    return true;
+}
+
+void WavSink::Close()
+{
+    if (!file) {
+        return;
+    }
+
+    // Rewrite the header now that the length is known
+    if (fseek(file, 0, SEEK_SET) == 0) {
+        WriteHeader(static_cast<unsigned long long>(frames_written) * channels * sizeof(float));
+    }
+
+    fclose(file);
+    file = nullptr;
+}
+
+bool WavSink::WriteHeader(unsigned long long data_bytes)
+{
+    // Sizes saturate past 4 GiB, as most writers do
+    const uint32_t data_size = static_cast<uint32_t>(std::min<unsigned long long>(data_bytes, 0xFFFFFFFFull - WAV_HEADER_SIZE));
+    const uint32_t block_align = static_cast<uint32_t>(channels * sizeof(float));
+
+    uint8_t header[WAV_HEADER_SIZE] = {};
+    std::copy_n("RIFF", 4, header);
+    PutLE32(header + 4, static_cast<uint32_t>(WAV_HEADER_SIZE - 8 + data_size));
+    std::copy_n("WAVE", 4, header + 8);
+
+    std::copy_n("fmt ", 4, header + 12);
+    PutLE32(header + 16, 18);
+    PutLE16(header + 20, WAVE_FORMAT_IEEE_FLOAT);
+    PutLE16(header + 22, static_cast<uint16_t>(channels));
+    PutLE32(header + 24, static_cast<uint32_t>(sample_rate));
+    PutLE32(header + 28, static_cast<uint32_t>(sample_rate) * block_align);
+    PutLE16(header + 32, static_cast<uint16_t>(block_align));
+    PutLE16(header + 34, 32);
+    PutLE16(header + 36, 0);
+
+    // Non-PCM formats carry the frame count in a fact chunk
+    std::copy_n("fact", 4, header + 38);
+    PutLE32(header + 42, 4);
+    PutLE32(header + 46, data_size / block_align);
+
+    std::copy_n("data", 4, header + 50);
+    PutLE32(header + 54, data_size);
+
+    return fwrite(header, 1, sizeof(header), file) == sizeof(header);
+}
+
+}
@@ -0,0 +1,63 @@
+#ifndef __AUDIO_SINK_HPP
+#define __AUDIO_SINK_HPP
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+
+namespace utils {
+
+// Destination for decoded PCM when the engine renders without a device.
+//
+// Sinks take interleaved 32-bit float frames at whatever pace the engine
+// produces them, so headless renders run as fast as decoding allows.
+class AudioSink {
+public:
+    virtual ~AudioSink() = default;
+
+    virtual bool Open(int sample_rate, int channels) = 0;
+    virtual bool Write(const float* interleaved, size_t frames) = 0;
+    virtual void Close() = 0;
+};
+
+// Discards everything; for timing the decode and analysis path
+class NullSink : public AudioSink {
+public:
+    NullSink();
+
+    bool Open(int sample_rate, int channels) override;
+    bool Write(const float* interleaved, size_t frames) override;
+    void Close() override {}
+
+    long long GetFramesWritten() const { return frames_written; }
+
+private:
+    long long frames_written;
+};
+
+// Writes a 32-bit IEEE float WAV, bit-exact with what the engine decoded.
+// The header sizes are patched in Close().
+class WavSink : public AudioSink {
+public:
+    explicit WavSink(const std::string& path);
+    ~WavSink() override;
+
+    bool Open(int sample_rate, int channels) override;
+    bool Write(const float* interleaved, size_t frames) override;
+    void Close() override;
+
+    long long GetFramesWritten() const { return frames_written; }
+
+private:
+    std::string path;
+    FILE* file;
+    int sample_rate;
+    int channels;
+    long long frames_written;
+
+    bool WriteHeader(unsigned long long data_bytes);
+};
+
+}
+
+#endif // __AUDIO_SINK_HPP
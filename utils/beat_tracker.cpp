@@ -0,0 +1,339 @@
+#include "beat_tracker.hpp"
+#include "audio_decoder.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace utils {
+
+BeatTracker::BeatTracker()
+    : sample_rate(0)
+    , fft_size(0)
+    , hop(0)
+    , window_fill(0)
+    , frame_position(0)
+    , have_previous(false)
+    , envelope_count(0)
+    , envelope_origin(0)
+    , next_estimate(0)
+    , tracked_lag(0.0)
+    , sequence(0)
+    , beat_period(0.0)
+    , beat_anchor(0)
+    , beat_confidence(0.0f)
+    , histogram_estimates(0)
+{
+    Reset(44100);
+}
+
+void BeatTracker::Reset(int rate, long long start_frame)
+{
+    sample_rate = rate > 0 ? rate : 44100;
+
+    // ~46 ms windows, the power of two nearest to it, hopped by a quarter
+    const double target = sample_rate * 0.046;
+    size_t size = 64;
+    while (size * 2 <= target) {
+        size *= 2;
+    }
+    if (target - size > size * 2 - target) {
+        size *= 2;
+    }
+    fft_size = size;
+    hop = size / 4;
+
+    analyzer.Configure(fft_size);
+    magnitudes.assign(analyzer.GetBinCount(), 0.0f);
+    previous_log.assign(analyzer.GetBinCount(), 0.0f);
+    window.assign(fft_size, 0.0f);
+    envelope.assign(static_cast<size_t>(std::ceil(ENVELOPE_SECONDS * EnvelopeRate())), 0.0f);
+    tracked_lag = 0.0;
+
+    {
+        std::lock_guard<std::mutex> lock(histogram_mutex);
+        histogram.assign(static_cast<size_t>(MAX_BPM - MIN_BPM) + 1, 0.0);
+        histogram_estimates = 0;
+    }
+
+    Publish(0.0, 0, 0.0f);
+    Restart(start_frame);
+}
+
+void BeatTracker::Restart(long long frame)
+{
+    window_fill = 0;
+    frame_position = frame;
+    have_previous = false;
+    envelope_count = 0;
+    envelope_origin = frame + static_cast<long long>(fft_size / 2);
+    next_estimate = static_cast<long long>(MIN_ESTIMATE_SECONDS * EnvelopeRate());
+
+    // The grid no longer lines up with the audio; keep the period so the
+    // next estimate can still be blended with it
+    Publish(beat_period.load(std::memory_order_relaxed), beat_anchor.load(std::memory_order_relaxed), 0.0f);
+}
+
+void BeatTracker::Process(const float* mono, size_t frames)
+{
+    while (frames > 0) {
+        size_t count = std::min(frames, fft_size - window_fill);
+        std::memcpy(window.data() + window_fill, mono, count * sizeof(float));
+        window_fill += count;
+        mono += count;
+        frames -= count;
+
+        if (window_fill == fft_size) {
+            AnalyzeWindow();
+            std::memmove(window.data(), window.data() + hop, (fft_size - hop) * sizeof(float));
+            window_fill -= hop;
+            frame_position += static_cast<long long>(hop);
+        }
+    }
+}
+
+void BeatTracker::AnalyzeWindow()
+{
+    analyzer.Compute(window.data(), magnitudes.data());
+
+    // Half-wave rectified rise in log magnitude, summed over the spectrum
+    float flux = 0.0f;
+    for (size_t bin = 0; bin < magnitudes.size(); bin++) {
+        float level = std::log1p(1000.0f * magnitudes[bin]);
+        flux += std::max(0.0f, level - previous_log[bin]);
+        previous_log[bin] = level;
+    }
+    if (!have_previous) {
+        flux = 0.0f;
+        have_previous = true;
+    }
+
+    envelope[static_cast<size_t>(envelope_count % static_cast<long long>(envelope.size()))] = flux;
+    envelope_count++;
+
+    if (envelope_count >= next_estimate) {
+        Estimate();
+        next_estimate = envelope_count + static_cast<long long>(ESTIMATE_INTERVAL_SECONDS * EnvelopeRate());
+    }
+}
+
+void BeatTracker::Estimate()
+{
+    const double rate = EnvelopeRate();
+    const size_t capacity = envelope.size();
+    const size_t n = static_cast<size_t>(std::min<long long>(envelope_count, static_cast<long long>(capacity)));
+    const size_t lag_min = static_cast<size_t>(std::floor(60.0 * rate / MAX_BPM));
+    const size_t lag_max = static_cast<size_t>(std::ceil(60.0 * rate / MIN_BPM));
+    if (lag_min < 2 || n <= 2 * lag_max + 1) {
+        return;
+    }
+
+    // Oldest first, minus a ~0.25 s local mean so only peaks remain
+    odf.resize(n);
+    prefix.resize(n + 1);
+    prefix[0] = 0.0;
+    const size_t first = static_cast<size_t>((envelope_count - static_cast<long long>(n)) % static_cast<long long>(capacity));
+    for (size_t i = 0; i < n; i++) {
+        odf[i] = envelope[(first + i) % capacity];
+        prefix[i + 1] = prefix[i] + odf[i];
+    }
+    const size_t half_width = std::max<size_t>(1, static_cast<size_t>(rate * 0.125));
+    for (size_t i = 0; i < n; i++) {
+        size_t from = i > half_width ? i - half_width : 0;
+        size_t to = std::min(n, i + half_width + 1);
+        double mean = (prefix[to] - prefix[from]) / (to - from);
+        odf[i] = std::max(0.0f, static_cast<float>(odf[i] - mean));
+    }
+
+    correlation.assign(2 * lag_max + 2, 0.0);
+    for (size_t lag = 0; lag < correlation.size(); lag++) {
+        double sum = 0.0;
+        for (size_t i = lag; i < n; i++) {
+            sum += static_cast<double>(odf[i]) * odf[i - lag];
+        }
+        correlation[lag] = sum / (n - lag);
+    }
+    if (correlation[0] <= 0.0) {
+        return;     // silence
+    }
+
+    // Score each period by itself plus its double (half-tempo support),
+    // under a log-normal prior one octave wide around 120 BPM
+    auto score = [&](size_t lag) {
+        double bpm = 60.0 * rate / lag;
+        double octaves = std::log2(bpm / 120.0);
+        return (correlation[lag] + 0.5 * correlation[2 * lag]) * std::exp(-0.5 * octaves * octaves);
+    };
+
+    size_t best = lag_min;
+    double best_score = score(lag_min);
+    double mean = 0.0;
+    for (size_t lag = lag_min; lag <= lag_max; lag++) {
+        double s = score(lag);
+        if (s > best_score) {
+            best_score = s;
+            best = lag;
+        }
+        mean += correlation[lag];
+    }
+    mean /= (lag_max - lag_min + 1);
+
+    double lag = static_cast<double>(best);
+    if (best > lag_min && best < lag_max) {
+        double a = score(best - 1);
+        double c = score(best + 1);
+        double denominator = a - 2.0 * best_score + c;
+        if (denominator < 0.0) {
+            lag += 0.5 * (a - c) / denominator;
+        }
+    }
+
+    float confidence = 0.0f;
+    if (correlation[0] > mean) {
+        confidence = static_cast<float>((correlation[best] - mean) / (correlation[0] - mean));
+        confidence = std::max(0.0f, std::min(1.0f, confidence));
+    }
+
+    // Follow small drifts smoothly, jump on anything else
+    if (tracked_lag > 0.0 && std::abs(lag - tracked_lag) < 0.04 * tracked_lag) {
+        tracked_lag += (lag - tracked_lag) * 0.25;
+    } else {
+        tracked_lag = lag;
+    }
+
+    // Beat placement: the offset back from the newest value whose comb over
+    // the last eight periods collects the most onset energy
+    const size_t offsets = static_cast<size_t>(std::lround(tracked_lag));
+    size_t best_offset = 0;
+    double best_sum = -1.0;
+    for (size_t offset = 0; offset < offsets; offset++) {
+        double sum = 0.0;
+        for (int k = 0; k < 8; k++) {
+            double position = static_cast<double>(n - 1 - offset) - k * tracked_lag;
+            if (position < 0.0) break;
+            sum += odf[static_cast<size_t>(std::lround(position))];
+        }
+        if (sum > best_sum) {
+            best_sum = sum;
+            best_offset = offset;
+        }
+    }
+
+    long long anchor = envelope_origin + (envelope_count - 1 - static_cast<long long>(best_offset)) * static_cast<long long>(hop);
+    Publish(tracked_lag * hop, anchor, confidence);
+
+    // Split the vote between the two nearest bins so the centroid in
+    // GetTrackBpm() resolves fractions of a BPM
+    double position = std::max(0.0, std::min(MAX_BPM - MIN_BPM, 60.0 * rate / tracked_lag - MIN_BPM));
+    size_t bin = static_cast<size_t>(position);
+    double fraction = position - bin;
+    std::lock_guard<std::mutex> lock(histogram_mutex);
+    histogram[bin] += confidence * (1.0 - fraction);
+    if (bin + 1 < histogram.size()) {
+        histogram[bin + 1] += confidence * fraction;
+    }
+    histogram_estimates++;
+}
+
+void BeatTracker::Publish(double period, long long anchor, float confidence)
+{
+    unsigned seq = sequence.load(std::memory_order_relaxed);
+    sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    beat_period.store(period, std::memory_order_relaxed);
+    beat_anchor.store(anchor, std::memory_order_relaxed);
+    beat_confidence.store(confidence, std::memory_order_relaxed);
+    sequence.store(seq + 2, std::memory_order_release);
+}
+
+bool BeatTracker::GetBeat(long long frame, double& phase, float& confidence) const
+{
+    double period;
+    long long anchor;
+    float trust;
+    while (true) {
+        unsigned before = sequence.load(std::memory_order_acquire);
+        if (before & 1) continue;
+        period = beat_period.load(std::memory_order_relaxed);
+        anchor = beat_anchor.load(std::memory_order_relaxed);
+        trust = beat_confidence.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence.load(std::memory_order_relaxed) == before) break;
+    }
+
+    if (period <= 0.0) {
+        return false;
+    }
+
+    double beats = (frame - anchor) / period;
+    phase = beats - std::floor(beats);
+    confidence = trust;
+    return true;
+}
+
+bool BeatTracker::GetTrackBpm(double& bpm, float& confidence) const
+{
+    std::lock_guard<std::mutex> lock(histogram_mutex);
+    if (histogram_estimates == 0) {
+        return false;
+    }
+
+    size_t best = 0;
+    for (size_t bin = 1; bin < histogram.size(); bin++) {
+        if (histogram[bin] > histogram[best]) {
+            best = bin;
+        }
+    }
+    if (histogram[best] <= 0.0) {
+        return false;
+    }
+
+    // Centre of mass of the peak and its neighbours
+    double weight = 0.0;
+    double moment = 0.0;
+    for (size_t bin = best > 0 ? best - 1 : 0; bin <= best + 1 && bin < histogram.size(); bin++) {
+        weight += histogram[bin];
+        moment += histogram[bin] * bin;
+    }
+
+    bpm = MIN_BPM + moment / weight;
+    confidence = static_cast<float>(std::min(1.0, weight / histogram_estimates));
+    return true;
+}
+
+bool BeatTracker::AnalyzeFile(const std::string& path, double& bpm, float& confidence)
+{
+    std::unique_ptr<AudioDecoder> decoder = AudioDecoder::Open(path);
+    if (!decoder) {
+        return false;
+    }
+
+    const int channels = decoder->GetChannels();
+    const size_t block_frames = 4096;
+    const long long limit = static_cast<long long>(MAX_ANALYSIS_SECONDS * decoder->GetSampleRate());
+    std::vector<float> block(block_frames * channels);
+    std::vector<float> mono(block_frames);
+
+    BeatTracker tracker;
+    tracker.Reset(decoder->GetSampleRate());
+
+    long long decoded = 0;
+    while (decoded < limit) {
+        size_t frames = decoder->Read(block.data(), block_frames);
+        if (frames == 0) break;
+
+        const float scale = 1.0f / channels;
+        for (size_t i = 0; i < frames; i++) {
+            float sum = 0.0f;
+            for (int c = 0; c < channels; c++) {
+                sum += block[i * channels + c];
+            }
+            mono[i] = sum * scale;
+        }
+        tracker.Process(mono.data(), frames);
+        decoded += static_cast<long long>(frames);
+    }
+
+    return tracker.GetTrackBpm(bpm, confidence);
+}
+
+}
@@ -0,0 +1,100 @@
+#ifndef __BEAT_TRACKER_HPP
+#define __BEAT_TRACKER_HPP
+
+#include "spectrum_analyzer.hpp"
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace utils {
+
+// Streaming onset detector and tempo tracker over mono PCM.
+//
+// Onsets are the spectral flux of a log-magnitude STFT. About once a second
+// the last few seconds of that envelope are autocorrelated to pick a beat
+// period (60-200 BPM, weighted towards 120) and a comb over the envelope
+// places the beat grid. The grid is published lock-free as an anchor frame
+// plus a period, so readers can ask for the phase at any frame. Estimates
+// also accumulate into a per-track tempo histogram.
+//
+// Process() and Restart() belong to one producer thread; GetBeat() and
+// GetTrackBpm() may be called from any thread.
+class BeatTracker {
+public:
+    BeatTracker();
+
+    // New track: clears everything, including the tempo histogram
+    void Reset(int sample_rate, long long start_frame = 0);
+    // Discontinuity within the same track (seek): keeps the histogram
+    void Restart(long long frame);
+
+    void Process(const float* mono, size_t frames);
+
+    // Phase in [0, 1) since the last beat at the given frame, and how much
+    // to trust it (0..1). False until a tempo has been found.
+    bool GetBeat(long long frame, double& phase, float& confidence) const;
+
+    // Dominant tempo seen so far in this track
+    bool GetTrackBpm(double& bpm, float& confidence) const;
+
+    // Decodes up to MAX_ANALYSIS_SECONDS of a file and returns its tempo
+    static bool AnalyzeFile(const std::string& path, double& bpm, float& confidence);
+
+    static constexpr double MIN_BPM = 60.0;
+    static constexpr double MAX_BPM = 200.0;
+    static constexpr double MAX_ANALYSIS_SECONDS = 240.0;
+
+private:
+    int sample_rate;
+    size_t fft_size;
+    size_t hop;
+
+    // STFT input; frame_position is the absolute frame of window[0]
+    SpectrumAnalyzer analyzer;
+    std::vector<float> window;
+    size_t window_fill;
+    long long frame_position;
+    std::vector<float> magnitudes;
+    std::vector<float> previous_log;
+    bool have_previous;
+
+    // Onset envelope, one value per hop; envelope_count is the total written
+    // since the last restart and envelope_origin the frame of value 0
+    std::vector<float> envelope;
+    long long envelope_count;
+    long long envelope_origin;
+    long long next_estimate;
+
+    // Estimation scratch
+    std::vector<float> odf;
+    std::vector<double> prefix;
+    std::vector<double> correlation;
+    double tracked_lag;
+
+    // Published beat grid (seqlock)
+    std::atomic<unsigned> sequence;
+    std::atomic<double> beat_period;     // frames, 0 when unknown
+    std::atomic<long long> beat_anchor;  // frame of a beat
+    std::atomic<float> beat_confidence;
+
+    // Tempo histogram, 1 BPM bins from MIN_BPM
+    mutable std::mutex histogram_mutex;
+    std::vector<double> histogram;
+    int histogram_estimates;
+
+    void AnalyzeWindow();
+    void Estimate();
+    void Publish(double period, long long anchor, float confidence);
+
+    double EnvelopeRate() const { return static_cast<double>(sample_rate) / hop; }
+
+    static constexpr double ENVELOPE_SECONDS = 8.0;
+    static constexpr double MIN_ESTIMATE_SECONDS = 4.0;
+    static constexpr double ESTIMATE_INTERVAL_SECONDS = 1.0;
+};
+
+}
+
+#endif // __BEAT_TRACKER_HPP
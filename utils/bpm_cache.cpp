@@ -0,0 +1,89 @@
+#include "bpm_cache.hpp"
+#include "beat_tracker.hpp"
+#include "thread_pool.hpp"
+
+namespace utils {
+
+BpmCache& BpmCache::Get()
+{
+    static BpmCache instance;
+    return instance;
+}
+
+bool BpmCache::Load(const std::string& path)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return cache.Load(path);
+}
+
+bool BpmCache::Save()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return cache.Save();
+}
+
+bool BpmCache::Lookup(const std::string& path, double& bpm, float& confidence) const
+{
+    long long size;
+    long long modified;
+    if (!FileCacheBase::Stat(path, size, modified)) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    const Tempo* tempo = cache.Lookup(path, size, modified);
+    if (!tempo) {
+        return false;
+    }
+    bpm = tempo->bpm;
+    confidence = tempo->confidence;
+    return true;
+}
+
+void BpmCache::Store(const std::string& path, double bpm, float confidence)
+{
+    long long size;
+    long long modified;
+    if (!FileCacheBase::Stat(path, size, modified)) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    const Tempo* known = cache.Lookup(path, size, modified);
+    if (known && known->confidence > confidence) {
+        return;
+    }
+    cache.Store(path, size, modified, Tempo{ bpm, confidence });
+}
+
+void BpmCache::Rename(const std::string& from, const std::string& to, bool folder)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    cache.Rename(from, to, folder);
+}
+
+size_t BpmCache::AnalyzeFiles(const std::vector<std::string>& paths, ThreadPool& pool,
+                              const std::atomic<bool>& cancel, std::atomic<size_t>& completed)
+{
+    size_t queued = 0;
+    for (const std::string& path : paths) {
+        double bpm;
+        float confidence;
+        if (Lookup(path, bpm, confidence)) {
+            continue;
+        }
+
+        pool.Submit([this, path, &cancel, &completed] {
+            double bpm;
+            float confidence;
+            if (!cancel.load(std::memory_order_relaxed) && BeatTracker::AnalyzeFile(path, bpm, confidence)) {
+                Store(path, bpm, confidence);
+            }
+            completed.fetch_add(1, std::memory_order_relaxed);
+        });
+        queued++;
+    }
+    return queued;
+}
+
+}
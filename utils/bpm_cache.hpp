@@ -0,0 +1,62 @@
+#ifndef __BPM_CACHE_HPP
+#define __BPM_CACHE_HPP
+
+#include "file_cache.hpp"
+#include <atomic>
+#include <cstddef>
+#include <istream>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace utils {
+
+class ThreadPool;
+
+// Per-file tempo estimates, persisted as a tab-separated file.
+//
+// Entries are keyed by path and remember the file's size and modification
+// time (see FileCache), so an edited file is treated as unknown again.
+// Live estimates from playback and offline batch results share the cache;
+// a lower-confidence estimate never replaces a better one for the same
+// file. All methods are thread-safe.
+class BpmCache {
+public:
+    static BpmCache& Get();
+
+    // Replaces the contents with the file's; remembers it for Save()
+    bool Load(const std::string& file);
+    bool Save();
+
+    bool Lookup(const std::string& path, double& bpm, float& confidence) const;
+    void Store(const std::string& path, double bpm, float confidence);
+
+    // A file (or every file under a folder) was renamed; size and
+    // modification time survive a rename, so its entries stay valid
+    void Rename(const std::string& from, const std::string& to, bool folder);
+
+    // Queues tempo analysis of every path without a current entry; completed
+    // is bumped as each queued job finishes. Jobs still queued see cancel and
+    // return without decoding. Returns the number of jobs queued.
+    size_t AnalyzeFiles(const std::vector<std::string>& paths, ThreadPool& pool,
+                        const std::atomic<bool>& cancel, std::atomic<size_t>& completed);
+
+private:
+    struct Tempo {
+        double bpm;
+        float confidence;
+
+        bool Read(std::istream& fields) { return static_cast<bool>(fields >> bpm >> confidence); }
+        void Write(std::ostream& out) const { out << '\t' << bpm << '\t' << confidence; }
+    };
+
+    BpmCache() = default;
+
+    mutable std::mutex mutex;
+    FileCache<Tempo> cache;
+};
+
+}
+
+#endif // __BPM_CACHE_HPP
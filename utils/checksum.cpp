@@ -0,0 +1,437 @@
+#include "checksum.hpp"
+#include "mapped_file.hpp"
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#define HARDWARE_CRC_TARGET __attribute__((target("sse4.2")))
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define HARDWARE_CRC_TARGET
+#endif
+
+namespace utils {
+
+namespace {
+
+const uint32_t CRC32_POLYNOMIAL = 0xEDB88320;     // reflected
+const uint32_t CRC32C_POLYNOMIAL = 0x82F63B78;
+
+// Bytes per stream in the three-stream hardware loop: long runs for
+// throughput, short ones for the remainder
+const size_t LONG_STREAM = 8192;
+const size_t SHORT_STREAM = 256;
+
+inline uint64_t Load64(const unsigned char* p)
+{
+    uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline uint32_t Rotate(uint32_t value, int bits)
+{
+    return (value << bits) | (value >> (32 - bits));
+}
+
+// Slicing-by-8: table k gives a byte's contribution k bytes further on,
+// so eight bytes take eight independent lookups
+struct CrcTables {
+    uint32_t slices[8][256];
+
+    explicit CrcTables(uint32_t polynomial)
+    {
+        for (uint32_t n = 0; n < 256; n++) {
+            uint32_t crc = n;
+            for (int bit = 0; bit < 8; bit++) {
+                crc = (crc & 1) ? (crc >> 1) ^ polynomial : crc >> 1;
+            }
+            slices[0][n] = crc;
+        }
+        for (uint32_t n = 0; n < 256; n++) {
+            uint32_t crc = slices[0][n];
+            for (int k = 1; k < 8; k++) {
+                crc = slices[0][crc & 0xFF] ^ (crc >> 8);
+                slices[k][n] = crc;
+            }
+        }
+    }
+
+    // On the inverted register
+    uint32_t Update(const unsigned char* p, size_t size, uint32_t crc) const
+    {
+        for (; size >= 8; p += 8, size -= 8) {
+            uint64_t word = Load64(p) ^ crc;
+            crc = slices[7][word & 0xFF] ^ slices[6][(word >> 8) & 0xFF] ^
+                  slices[5][(word >> 16) & 0xFF] ^ slices[4][(word >> 24) & 0xFF] ^
+                  slices[3][(word >> 32) & 0xFF] ^ slices[2][(word >> 40) & 0xFF] ^
+                  slices[1][(word >> 48) & 0xFF] ^ slices[0][word >> 56];
+        }
+        for (; size > 0; p++, size--) {
+            crc = slices[0][(crc ^ *p) & 0xFF] ^ (crc >> 8);
+        }
+        return crc;
+    }
+};
+
+const CrcTables& Crc32Tables()
+{
+    static const CrcTables tables(CRC32_POLYNOMIAL);
+    return tables;
+}
+
+const CrcTables& Crc32cTables()
+{
+    static const CrcTables tables(CRC32C_POLYNOMIAL);
+    return tables;
+}
+
+#ifdef HARDWARE_CRC_TARGET
+
+// Multiplication of a CRC-32C register by x^(8 * length) modulo the
+// polynomial, i.e. the effect of length zero bytes, a byte at a time
+struct ShiftTable {
+    uint32_t bytes[4][256];
+
+    explicit ShiftTable(size_t length)
+    {
+        // Operators on the register as 32 columns over GF(2), squared up
+        // from one zero bit to length zero bytes (a power of two)
+        uint32_t odd[32];
+        uint32_t even[32];
+        odd[0] = CRC32C_POLYNOMIAL;
+        for (int n = 1; n < 32; n++) {
+            odd[n] = 1u << (n - 1);
+        }
+        Square(even, odd);      // two zero bits
+        Square(odd, even);      // four
+        const uint32_t* result;
+        for (;;) {
+            Square(even, odd);  // a byte on the first pass
+            length >>= 1;
+            if (length == 0) {
+                result = even;
+                break;
+            }
+            Square(odd, even);
+            length >>= 1;
+            if (length == 0) {
+                result = odd;
+                break;
+            }
+        }
+
+        for (uint32_t n = 0; n < 256; n++) {
+            for (int k = 0; k < 4; k++) {
+                bytes[k][n] = Times(result, n << (8 * k));
+            }
+        }
+    }
+
+    uint32_t Apply(uint32_t crc) const
+    {
+        return bytes[0][crc & 0xFF] ^ bytes[1][(crc >> 8) & 0xFF] ^
+               bytes[2][(crc >> 16) & 0xFF] ^ bytes[3][crc >> 24];
+    }
+
+    static uint32_t Times(const uint32_t* matrix, uint32_t vector)
+    {
+        uint32_t sum = 0;
+        for (; vector; vector >>= 1, matrix++) {
+            if (vector & 1) {
+                sum ^= *matrix;
+            }
+        }
+        return sum;
+    }
+
+    static void Square(uint32_t* square, const uint32_t* matrix)
+    {
+        for (int n = 0; n < 32; n++) {
+            square[n] = Times(matrix, matrix[n]);
+        }
+    }
+};
+
+const ShiftTable& LongShift()
+{
+    static const ShiftTable table(LONG_STREAM);
+    return table;
+}
+
+const ShiftTable& ShortShift()
+{
+    static const ShiftTable table(SHORT_STREAM);
+    return table;
+}
+
+#if defined(__x86_64__)
+HARDWARE_CRC_TARGET inline uint32_t Crc32cWord(uint32_t crc, uint64_t word)
+{
+    return static_cast<uint32_t>(_mm_crc32_u64(crc, word));
+}
+
+HARDWARE_CRC_TARGET inline uint32_t Crc32cByte(uint32_t crc, unsigned char byte)
+{
+    return _mm_crc32_u8(crc, byte);
+}
+#else
+inline uint32_t Crc32cWord(uint32_t crc, uint64_t word)
+{
+    return __crc32cd(crc, word);
+}
+
+inline uint32_t Crc32cByte(uint32_t crc, unsigned char byte)
+{
+    return __crc32cb(crc, byte);
+}
+#endif
+
+// The CRC instruction takes three cycles but can start every cycle, so
+// three interleaved streams run it at full rate; each later stream's CRC is
+// then folded in after shifting the running one over its length.
+// On the inverted register.
+HARDWARE_CRC_TARGET uint32_t Crc32cHardware(const unsigned char* p, size_t size, uint32_t crc)
+{
+    for (; size > 0 && (reinterpret_cast<uintptr_t>(p) & 7) != 0; p++, size--) {
+        crc = Crc32cByte(crc, *p);
+    }
+
+    const size_t streams[] = { LONG_STREAM, SHORT_STREAM };
+    for (size_t stream : streams) {
+        const ShiftTable& shift = stream == LONG_STREAM ? LongShift() : ShortShift();
+        while (size >= 3 * stream) {
+            uint32_t crc1 = 0;
+            uint32_t crc2 = 0;
+            const unsigned char* end = p + stream;
+            for (; p < end; p += 8) {
+                crc = Crc32cWord(crc, Load64(p));
+                crc1 = Crc32cWord(crc1, Load64(p + stream));
+                crc2 = Crc32cWord(crc2, Load64(p + 2 * stream));
+            }
+            crc = shift.Apply(crc) ^ crc1;
+            crc = shift.Apply(crc) ^ crc2;
+            p += 2 * stream;
+            size -= 3 * stream;
+        }
+    }
+
+    for (; size >= 8; p += 8, size -= 8) {
+        crc = Crc32cWord(crc, Load64(p));
+    }
+    for (; size > 0; p++, size--) {
+        crc = Crc32cByte(crc, *p);
+    }
+    return crc;
+}
+
+#endif
+
+bool DetectHardwareCrc32c()
+{
+#if defined(__x86_64__)
+    return __builtin_cpu_supports("sse4.2");
+#elif defined(HARDWARE_CRC_TARGET)
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Feeds block the input 64 bytes at a time, then the Merkle-Damgard
+// padding shared by MD5 and SHA-1: 0x80, zeros and the length in bits
+template <typename Block>
+void Pad(const unsigned char* data, size_t size, bool big_endian, Block block)
+{
+    size_t whole = size & ~size_t(63);
+    for (size_t i = 0; i < whole; i += 64) {
+        block(data + i);
+    }
+
+    unsigned char tail[128] = {};
+    size_t rest = size - whole;
+    if (rest > 0) {
+        std::memcpy(tail, data + whole, rest);
+    }
+    tail[rest] = 0x80;
+    size_t tail_size = rest < 56 ? 64 : 128;
+    uint64_t bits = static_cast<uint64_t>(size) * 8;
+    for (int i = 0; i < 8; i++) {
+        tail[tail_size - 8 + i] = static_cast<unsigned char>(big_endian ? bits >> (56 - 8 * i) : bits >> (8 * i));
+    }
+    block(tail);
+    if (tail_size == 128) {
+        block(tail + 64);
+    }
+}
+
+std::string ToHex(const unsigned char* bytes, size_t size)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string hex(size * 2, '0');
+    for (size_t i = 0; i < size; i++) {
+        hex[2 * i] = digits[bytes[i] >> 4];
+        hex[2 * i + 1] = digits[bytes[i] & 0xF];
+    }
+    return hex;
+}
+
+}
+
+uint32_t Checksum::Crc32(const void* data, size_t size, uint32_t crc)
+{
+    return ~Crc32Tables().Update(static_cast<const unsigned char*>(data), size, ~crc);
+}
+
+uint32_t Checksum::Crc32c(const void* data, size_t size, uint32_t crc)
+{
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+#ifdef HARDWARE_CRC_TARGET
+    if (HasHardwareCrc32c()) {
+        return ~Crc32cHardware(p, size, ~crc);
+    }
+#endif
+    return ~Crc32cTables().Update(p, size, ~crc);
+}
+
+bool Checksum::HasHardwareCrc32c()
+{
+    static const bool available = DetectHardwareCrc32c();
+    return available;
+}
+
+std::string Checksum::Md5(const void* data, size_t size)
+{
+    static const uint32_t constants[64] = {
+        0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+        0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+        0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+        0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+        0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+        0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+        0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+        0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391,
+    };
+    static const int shifts[4][4] = { { 7, 12, 17, 22 }, { 5, 9, 14, 20 }, { 4, 11, 16, 23 }, { 6, 10, 15, 21 } };
+
+    uint32_t state[4] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476 };
+    Pad(static_cast<const unsigned char*>(data), size, false, [&](const unsigned char* block) {
+        uint32_t words[16];
+        for (int i = 0; i < 16; i++) {
+            words[i] = block[4 * i] | (block[4 * i + 1] << 8) | (block[4 * i + 2] << 16) |
+                       (static_cast<uint32_t>(block[4 * i + 3]) << 24);
+        }
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        for (int i = 0; i < 64; i++) {
+            uint32_t f;
+            int g;
+            switch (i / 16) {
+            case 0: f = (b & c) | (~b & d); g = i; break;
+            case 1: f = (d & b) | (~d & c); g = (5 * i + 1) % 16; break;
+            case 2: f = b ^ c ^ d; g = (3 * i + 5) % 16; break;
+            default: f = c ^ (b | ~d); g = (7 * i) % 16; break;
+            }
+            f += a + constants[i] + words[g];
+            a = d;
+            d = c;
+            c = b;
+            b += Rotate(f, shifts[i / 16][i % 4]);
+        }
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+    });
+
+    unsigned char digest[16];
+    for (int i = 0; i < 16; i++) {
+        digest[i] = static_cast<unsigned char>(state[i / 4] >> (8 * (i % 4)));
+    }
+    return ToHex(digest, sizeof(digest));
+}
+
+std::string Checksum::Sha1(const void* data, size_t size)
+{
+    uint32_t state[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+    Pad(static_cast<const unsigned char*>(data), size, true, [&](const unsigned char* block) {
+        uint32_t words[80];
+        for (int i = 0; i < 16; i++) {
+            words[i] = (static_cast<uint32_t>(block[4 * i]) << 24) | (block[4 * i + 1] << 16) |
+                       (block[4 * i + 2] << 8) | block[4 * i + 3];
+        }
+        for (int i = 16; i < 80; i++) {
+            words[i] = Rotate(words[i - 3] ^ words[i - 8] ^ words[i - 14] ^ words[i - 16], 1);
+        }
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+        for (int i = 0; i < 80; i++) {
+            uint32_t f;
+            uint32_t k;
+            if (i < 20) {
+                f = (b & c) | (~b & d);
+                k = 0x5A827999;
+            } else if (i < 40) {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1;
+            } else if (i < 60) {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDC;
+            } else {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6;
+            }
+            uint32_t next = Rotate(a, 5) + f + e + k + words[i];
+            e = d;
+            d = c;
+            c = Rotate(b, 30);
+            b = a;
+            a = next;
+        }
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d; state[4] += e;
+    });
+
+    unsigned char digest[20];
+    for (int i = 0; i < 20; i++) {
+        digest[i] = static_cast<unsigned char>(state[i / 4] >> (24 - 8 * (i % 4)));
+    }
+    return ToHex(digest, sizeof(digest));
+}
+
+bool Checksum::Crc32cFile(const std::string& path, uint32_t& crc)
+{
+    MappedFile file(path);
+    if (!file.IsOk()) {
+        return false;
+    }
+
+    uint32_t result = 0;
+    const unsigned char* data;
+    size_t length;
+    while (file.Next(data, length)) {
+        result = Crc32c(data, length, result);
+    }
+    if (file.HasFailed()) {
+        return false;
+    }
+    crc = result;
+    return true;
+}
+
+bool Checksum::FilesEqual(const std::string& path1, const std::string& path2)
+{
+    MappedFile file1(path1);
+    MappedFile file2(path2);
+    if (!file1.IsOk() || !file2.IsOk() || file1.GetSize() != file2.GetSize()) {
+        return false;
+    }
+
+    // Both hand out full blocks until the end, so the blocks line up
+    const unsigned char* data1;
+    const unsigned char* data2;
+    size_t length1;
+    size_t length2;
+    while (file1.Next(data1, length1)) {
+        if (!file2.Next(data2, length2) || length1 != length2 || std::memcmp(data1, data2, length1) != 0) {
+            return false;
+        }
+    }
+    return !file1.HasFailed() && !file2.Next(data2, length2) && !file2.HasFailed();
+}
+
+}
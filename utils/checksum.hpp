@@ -0,0 +1,39 @@
+#ifndef __CHECKSUM_HPP
+#define __CHECKSUM_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace utils {
+
+// Checksums, digests and byte comparison of buffers and files.
+//
+// Crc32c() uses the SSE4.2 (x86) or ARMv8 CRC instructions when the CPU
+// has them, running three independent streams to hide the instruction's
+// latency and folding them together with precomputed shift tables; it
+// falls back to slicing-by-8 tables. Crc32() is the zlib/PNG polynomial,
+// always by table. Both continue from a previous result, zlib style:
+// Crc32c(b, n, Crc32c(a, m)) is the checksum of a followed by b.
+//
+// Md5() and Sha1() return lowercase hex digests, for interoperating with
+// other tools; neither is fit for security use.
+//
+// File functions go through MappedFile; FilesEqual() stops at the first
+// block that differs.
+class Checksum {
+public:
+    static uint32_t Crc32(const void* data, size_t size, uint32_t crc = 0);
+    static uint32_t Crc32c(const void* data, size_t size, uint32_t crc = 0);
+    static bool HasHardwareCrc32c();
+
+    static std::string Md5(const void* data, size_t size);
+    static std::string Sha1(const void* data, size_t size);
+
+    static bool Crc32cFile(const std::string& path, uint32_t& crc);
+    static bool FilesEqual(const std::string& path1, const std::string& path2);
+};
+
+}
+
+#endif // __CHECKSUM_HPP
@@ -0,0 +1,214 @@
+#include "content_hash.hpp"
+#include "mapped_file.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <vector>
+
+namespace utils {
+
+namespace {
+
+const uint64_t PRIME1 = 0x9E3779B185EBCA87ull;
+const uint64_t PRIME2 = 0xC2B2AE3D27D4EB4Full;
+const uint64_t PRIME3 = 0x165667B19E3779F9ull;
+const uint64_t PRIME4 = 0x85EBCA77C2B2AE63ull;
+const uint64_t PRIME5 = 0x27D4EB2F165667C5ull;
+
+inline uint64_t Rotate(uint64_t value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+// Little-endian loads; memcpy keeps them legal on unaligned input
+inline uint64_t Load64(const unsigned char* p)
+{
+    uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline uint32_t Load32(const unsigned char* p)
+{
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline uint64_t Round(uint64_t lane, uint64_t input)
+{
+    lane += input * PRIME2;
+    return Rotate(lane, 31) * PRIME1;
+}
+
+inline uint64_t MergeRound(uint64_t hash, uint64_t lane)
+{
+    hash ^= Round(0, lane);
+    return hash * PRIME1 + PRIME4;
+}
+
+// Whole 32-byte stripes from p; returns the bytes consumed
+size_t Consume(uint64_t* lanes, const unsigned char* p, size_t size)
+{
+    uint64_t v1 = lanes[0], v2 = lanes[1], v3 = lanes[2], v4 = lanes[3];
+    const unsigned char* end = p + (size & ~size_t(31));
+    const unsigned char* start = p;
+    while (p < end) {
+        v1 = Round(v1, Load64(p));
+        v2 = Round(v2, Load64(p + 8));
+        v3 = Round(v3, Load64(p + 16));
+        v4 = Round(v4, Load64(p + 24));
+        p += 32;
+    }
+    lanes[0] = v1; lanes[1] = v2; lanes[2] = v3; lanes[3] = v4;
+    return static_cast<size_t>(p - start);
+}
+
+bool ReadFully(int fd, unsigned char* data, size_t size, off_t offset)
+{
+    while (size > 0) {
+        ssize_t got = pread(fd, data, size, offset);
+        if (got <= 0) {
+            return false;
+        }
+        data += got;
+        size -= static_cast<size_t>(got);
+        offset += got;
+    }
+    return true;
+}
+
+}
+
+ContentHash::ContentHash(uint64_t seed)
+    : buffered(0)
+    , total(0)
+    , seed(seed)
+{
+    lanes[0] = seed + PRIME1 + PRIME2;
+    lanes[1] = seed + PRIME2;
+    lanes[2] = seed;
+    lanes[3] = seed - PRIME1;
+}
+
+void ContentHash::Update(const void* data, size_t size)
+{
+    if (size == 0) {
+        return;
+    }
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    total += size;
+
+    if (buffered > 0) {
+        size_t take = std::min(size, sizeof(buffer) - buffered);
+        std::memcpy(buffer + buffered, p, take);
+        buffered += take;
+        p += take;
+        size -= take;
+        if (buffered < sizeof(buffer)) {
+            return;
+        }
+        Consume(lanes, buffer, sizeof(buffer));
+        buffered = 0;
+    }
+
+    size_t used = Consume(lanes, p, size);
+    buffered = size - used;
+    std::memcpy(buffer, p + used, buffered);
+}
+
+uint64_t ContentHash::Digest() const
+{
+    uint64_t hash;
+    if (total >= 32) {
+        hash = Rotate(lanes[0], 1) + Rotate(lanes[1], 7) + Rotate(lanes[2], 12) + Rotate(lanes[3], 18);
+        for (uint64_t lane : lanes) {
+            hash = MergeRound(hash, lane);
+        }
+    } else {
+        hash = seed + PRIME5;
+    }
+    hash += total;
+
+    const unsigned char* p = buffer;
+    size_t left = buffered;
+    for (; left >= 8; p += 8, left -= 8) {
+        hash ^= Round(0, Load64(p));
+        hash = Rotate(hash, 27) * PRIME1 + PRIME4;
+    }
+    if (left >= 4) {
+        hash ^= static_cast<uint64_t>(Load32(p)) * PRIME1;
+        hash = Rotate(hash, 23) * PRIME2 + PRIME3;
+        p += 4;
+        left -= 4;
+    }
+    for (; left > 0; p++, left--) {
+        hash ^= *p * PRIME5;
+        hash = Rotate(hash, 11) * PRIME1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= PRIME2;
+    hash ^= hash >> 29;
+    hash *= PRIME3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+uint64_t ContentHash::Hash(const void* data, size_t size, uint64_t seed)
+{
+    ContentHash hasher(seed);
+    hasher.Update(data, size);
+    return hasher.Digest();
+}
+
+bool ContentHash::HashFile(const std::string& path, uint64_t& hash)
+{
+    MappedFile file(path);
+    if (!file.IsOk()) {
+        return false;
+    }
+
+    ContentHash hasher;
+    const unsigned char* data;
+    size_t length;
+    while (file.Next(data, length)) {
+        hasher.Update(data, length);
+    }
+    if (file.HasFailed()) {
+        return false;
+    }
+    hash = hasher.Digest();
+    return true;
+}
+
+bool ContentHash::HashSamples(const std::string& path, uint64_t size, size_t sample, uint64_t& hash)
+{
+    if (size <= 2 * static_cast<uint64_t>(sample)) {
+        return HashFile(path, hash);
+    }
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    std::vector<unsigned char> block(sample);
+    ContentHash hasher;
+    bool ok = ReadFully(fd, block.data(), sample, 0);
+    if (ok) {
+        hasher.Update(block.data(), sample);
+        ok = ReadFully(fd, block.data(), sample, static_cast<off_t>(size - sample));
+    }
+    if (ok) {
+        hasher.Update(block.data(), sample);
+    }
+    close(fd);
+
+    if (ok) {
+        hash = hasher.Digest();
+    }
+    return ok;
+}
+
+}
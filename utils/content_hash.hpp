@@ -0,0 +1,43 @@
+#ifndef __CONTENT_HASH_HPP
+#define __CONTENT_HASH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace utils {
+
+// 64-bit non-cryptographic hash of file contents (the XXH64 algorithm).
+//
+// Input is consumed 32 bytes at a time in four independent multiply-rotate
+// lanes, so it runs at several bytes per cycle without SIMD. Update() may
+// be fed in pieces of any size; the digest only depends on the bytes.
+// Good for telling files apart, not for resisting anyone crafting
+// collisions.
+class ContentHash {
+public:
+    explicit ContentHash(uint64_t seed = 0);
+
+    void Update(const void* data, size_t size);
+    uint64_t Digest() const;
+
+    static uint64_t Hash(const void* data, size_t size, uint64_t seed = 0);
+
+    // The whole file, through MappedFile; false if it cannot be read
+    static bool HashFile(const std::string& path, uint64_t& hash);
+
+    // The first and last sample bytes of a file of the given size, or all
+    // of it when it is no longer than both; equal to HashFile() then
+    static bool HashSamples(const std::string& path, uint64_t size, size_t sample, uint64_t& hash);
+
+private:
+    uint64_t lanes[4];
+    unsigned char buffer[32];
+    size_t buffered;
+    uint64_t total;
+    uint64_t seed;
+};
+
+}
+
+#endif // __CONTENT_HASH_HPP
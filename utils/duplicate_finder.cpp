@@ -0,0 +1,172 @@
+#include "duplicate_finder.hpp"
+#include "content_hash.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <tuple>
+
+namespace utils {
+
+namespace {
+
+struct Candidate {
+    size_t index;
+    long long size;
+    long long modified;
+    uint64_t sample;
+    uint64_t full;
+    bool has_sample;
+    bool has_full;
+    bool hashed;            // something new to cache
+};
+
+// The candidates that share their key with at least one other, grouped
+// by key, in input order within a group
+template <typename KeyOf>
+std::vector<Candidate*> KeepCollisions(std::vector<Candidate*> list, KeyOf key_of)
+{
+    std::stable_sort(list.begin(), list.end(), [&](const Candidate* a, const Candidate* b) {
+        return key_of(*a) < key_of(*b);
+    });
+
+    std::vector<Candidate*> kept;
+    for (size_t start = 0; start < list.size();) {
+        size_t end = start + 1;
+        while (end < list.size() && key_of(*list[end]) == key_of(*list[start])) {
+            end++;
+        }
+        if (end - start > 1) {
+            kept.insert(kept.end(), list.begin() + start, list.begin() + end);
+        }
+        start = end;
+    }
+    return kept;
+}
+
+}
+
+DuplicateFinder& DuplicateFinder::Get()
+{
+    static DuplicateFinder instance;
+    return instance;
+}
+
+bool DuplicateFinder::Load(const std::string& path)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return cache.Load(path);
+}
+
+bool DuplicateFinder::Save()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return cache.Save();
+}
+
+std::vector<std::vector<size_t>> DuplicateFinder::FindDuplicates(const std::vector<std::string>& paths,
+                                                                 ThreadPool& pool, const std::atomic<bool>& cancel)
+{
+    std::vector<Candidate> candidates;
+    candidates.reserve(paths.size());
+    for (size_t i = 0; i < paths.size(); i++) {
+        Candidate candidate{ i, 0, 0, 0, 0, false, false, false };
+        if (FileCacheBase::Stat(paths[i], candidate.size, candidate.modified) && candidate.size > 0) {
+            candidates.push_back(candidate);
+        }
+    }
+    std::vector<Candidate*> all;
+    for (Candidate& candidate : candidates) {
+        all.push_back(&candidate);
+    }
+
+    // A file with a size of its own has no duplicate and is never opened
+    std::vector<Candidate*> same_size = KeepCollisions(all, [](const Candidate& c) { return c.size; });
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (Candidate* candidate : same_size) {
+            const Hashes* known = cache.Lookup(paths[candidate->index], candidate->size, candidate->modified);
+            if (known) {
+                candidate->sample = known->sample;
+                candidate->has_sample = true;
+                candidate->full = known->full;
+                candidate->has_full = known->has_full;
+            }
+        }
+    }
+
+    for (Candidate* candidate : same_size) {
+        if (candidate->has_sample) {
+            continue;
+        }
+        pool.Submit([candidate, &paths, &cancel] {
+            if (cancel.load(std::memory_order_relaxed)) {
+                return;
+            }
+            const std::string& path = paths[candidate->index];
+            uint64_t size = static_cast<uint64_t>(candidate->size);
+            if (ContentHash::HashSamples(path, size, SAMPLE_BYTES, candidate->sample)) {
+                candidate->has_sample = true;
+                candidate->hashed = true;
+                // The samples covered the whole file
+                if (size <= 2 * SAMPLE_BYTES) {
+                    candidate->full = candidate->sample;
+                    candidate->has_full = true;
+                }
+            }
+        });
+    }
+    pool.WaitIdle();
+
+    // Only files whose samples collide are read in full
+    std::erase_if(same_size, [](const Candidate* c) { return !c->has_sample; });
+    std::vector<Candidate*> same_sample = KeepCollisions(same_size, [](const Candidate& c) {
+        return std::make_tuple(c.size, c.sample);
+    });
+    for (Candidate* candidate : same_sample) {
+        if (candidate->has_full) {
+            continue;
+        }
+        pool.Submit([candidate, &paths, &cancel] {
+            if (!cancel.load(std::memory_order_relaxed) &&
+                ContentHash::HashFile(paths[candidate->index], candidate->full)) {
+                candidate->has_full = true;
+                candidate->hashed = true;
+            }
+        });
+    }
+    pool.WaitIdle();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (Candidate* candidate : same_size) {
+            if (candidate->hashed) {
+                cache.Store(paths[candidate->index], candidate->size, candidate->modified,
+                            Hashes{ candidate->sample, candidate->has_full ? candidate->full : 0, candidate->has_full });
+            }
+        }
+    }
+
+    std::erase_if(same_sample, [](const Candidate* c) { return !c->has_full; });
+    std::vector<Candidate*> same_content = KeepCollisions(same_sample, [](const Candidate& c) {
+        return std::make_tuple(c.size, c.full);
+    });
+
+    std::vector<std::vector<size_t>> groups;
+    for (size_t i = 0; i < same_content.size(); i++) {
+        if (i == 0 || same_content[i]->size != same_content[i - 1]->size ||
+            same_content[i]->full != same_content[i - 1]->full) {
+            groups.emplace_back();
+        }
+        groups.back().push_back(same_content[i]->index);
+    }
+    std::sort(groups.begin(), groups.end());
+    return groups;
+}
+
+void DuplicateFinder::Rename(const std::string& from, const std::string& to, bool folder)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    cache.Rename(from, to, folder);
+}
+
+}
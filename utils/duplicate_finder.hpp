@@ -0,0 +1,84 @@
+#ifndef __DUPLICATE_FINDER_HPP
+#define __DUPLICATE_FINDER_HPP
+
+#include "file_cache.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace utils {
+
+class ThreadPool;
+
+// Finds files with identical contents, wherever they live.
+//
+// Work is spent only where it can still tell files apart: files are first
+// grouped by size, files sharing a size are hashed on their first and last
+// SAMPLE_BYTES, and only files whose samples also match are hashed in full.
+// Hashes are cached per file in a FileCache, keyed by path and checked
+// against size and modification time, so a repeat
+// scan of an unchanged library reads nothing but directory entries. All
+// methods are thread-safe.
+class DuplicateFinder {
+public:
+    static DuplicateFinder& Get();
+
+    // Replaces the contents with the file's; remembers it for Save()
+    bool Load(const std::string& file);
+    bool Save();
+
+    // Groups of two or more indices into paths whose files have the same
+    // contents; each group ascending, groups by their first index. Hashing
+    // runs on pool, and the call returns once pool is idle, so it should
+    // have no other work queued. Files that cannot be read, empty files and
+    // any left unhashed after cancel is raised are in no group.
+    std::vector<std::vector<size_t>> FindDuplicates(const std::vector<std::string>& paths, ThreadPool& pool,
+                                                    const std::atomic<bool>& cancel);
+
+    // Moves the hashes of a renamed file, or of everything under a
+    // renamed folder, to the new paths
+    void Rename(const std::string& from, const std::string& to, bool folder);
+
+    static constexpr size_t SAMPLE_BYTES = 64 * 1024;
+
+private:
+    // sample hash [\t full hash]
+    struct Hashes {
+        uint64_t sample;
+        uint64_t full;
+        bool has_full;
+
+        bool Read(std::istream& fields)
+        {
+            if (!(fields >> sample)) {
+                return false;
+            }
+            has_full = static_cast<bool>(fields >> full);
+            if (!has_full) {
+                full = 0;
+            }
+            return true;
+        }
+        void Write(std::ostream& out) const
+        {
+            out << '\t' << sample;
+            if (has_full) {
+                out << '\t' << full;
+            }
+        }
+    };
+
+    DuplicateFinder() = default;
+
+    mutable std::mutex mutex;
+    FileCache<Hashes> cache;
+};
+
+}
+
+#endif // __DUPLICATE_FINDER_HPP
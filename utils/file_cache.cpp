@@ -0,0 +1,89 @@
+#include "file_cache.hpp"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+namespace utils {
+
+FileCacheBase::FileCacheBase()
+    : dirty(false)
+{
+}
+
+bool FileCacheBase::Stat(const std::string& path, long long& size, long long& modified)
+{
+    std::error_code error;
+    std::filesystem::path file_path(path);
+    auto file_size = std::filesystem::file_size(file_path, error);
+    if (error) {
+        return false;
+    }
+    auto write_time = std::filesystem::last_write_time(file_path, error);
+    if (error) {
+        return false;
+    }
+    size = static_cast<long long>(file_size);
+    modified = static_cast<long long>(write_time.time_since_epoch().count());
+    return true;
+}
+
+bool FileCacheBase::IsStorable(const std::string& path)
+{
+    // Tabs and line breaks would corrupt the file format
+    return !path.empty() && path.find_first_of("\t\r\n") == std::string::npos;
+}
+
+bool FileCacheBase::ReadLines(const std::string& path,
+                              const std::function<void(std::string path, std::istream& fields)>& read)
+{
+    std::ifstream in(path);
+    if (!in) {
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t tab = line.find('\t');
+        if (tab == std::string::npos || tab == 0) continue;
+
+        std::istringstream fields(line.substr(tab + 1));
+        read(line.substr(0, tab), fields);
+    }
+    return true;
+}
+
+bool FileCacheBase::WriteLines(const std::function<void(std::ostream& out)>& write)
+{
+    // Write beside the real file and swap it in, so a crash mid-write
+    // leaves the previous cache intact
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(file).parent_path(), error);
+    std::string temporary = file + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::trunc);
+        if (!out) {
+            return false;
+        }
+        write(out);
+        if (!out) {
+            return false;
+        }
+    }
+
+    std::filesystem::rename(temporary, file, error);
+    if (error) {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    dirty = false;
+    return true;
+}
+
+bool FileCacheBase::IsUnder(const std::string& path, const std::string& folder)
+{
+    return path.size() > folder.size() && path[folder.size()] == '/' &&
+           path.compare(0, folder.size(), folder) == 0;
+}
+
+}
@@ -0,0 +1,157 @@
+#ifndef __FILE_CACHE_HPP
+#define __FILE_CACHE_HPP
+
+#include <functional>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace utils {
+
+// The parts of FileCache that do not depend on the value type
+class FileCacheBase {
+public:
+    // Size and modification time, which together tell whether a file
+    // changed since it was cached
+    static bool Stat(const std::string& path, long long& size, long long& modified);
+
+    // False for paths the file format cannot hold
+    static bool IsStorable(const std::string& path);
+
+protected:
+    FileCacheBase();
+
+    std::string file;
+    bool dirty;
+
+    // Calls read with each line's path and the fields after it
+    bool ReadLines(const std::string& path, const std::function<void(std::string path, std::istream& fields)>& read);
+    bool WriteLines(const std::function<void(std::ostream& out)>& write);
+
+    // True for paths inside folder, at any depth
+    static bool IsUnder(const std::string& path, const std::string& folder);
+};
+
+// Per-file records, keyed by path and persisted as a tab-separated file:
+//
+//     path \t size \t mtime \t value fields...
+//
+// Each record remembers the file's size and modification time, so once a
+// file is edited its record no longer applies. Value supplies the fields
+// after mtime:
+//
+//     bool Read(std::istream& fields);        false skips the line
+//     void Write(std::ostream& out) const;    each field after a '\t'
+//
+// Not thread-safe; the cache that owns one locks around every call.
+template <typename Value>
+class FileCache : public FileCacheBase {
+public:
+    struct Entry {
+        long long size;
+        long long modified;
+        Value value;
+    };
+
+    // Replaces the contents with the file's; remembers it for Save()
+    bool Load(const std::string& path)
+    {
+        file = path;
+        entries.clear();
+        dirty = false;
+        return ReadLines(path, [this](std::string path, std::istream& fields) {
+            Entry entry;
+            if (fields >> entry.size >> entry.modified && entry.value.Read(fields)) {
+                entries[std::move(path)] = std::move(entry);
+            }
+        });
+    }
+
+    // Writes the file if anything changed since Load() or the last Save()
+    bool Save()
+    {
+        if (!dirty || file.empty()) {
+            return true;
+        }
+        return WriteLines([this](std::ostream& out) {
+            for (const auto& item : entries) {
+                out << item.first << '\t' << item.second.size << '\t' << item.second.modified;
+                item.second.value.Write(out);
+                out << '\n';
+            }
+        });
+    }
+
+    // The record for path whether or not it is current, or nullptr
+    Entry* Find(const std::string& path)
+    {
+        auto it = entries.find(path);
+        return it != entries.end() ? &it->second : nullptr;
+    }
+
+    // The value if path has a record for this size and modification time
+    const Value* Lookup(const std::string& path, long long size, long long modified) const
+    {
+        auto it = entries.find(path);
+        if (it == entries.end() || it->second.size != size || it->second.modified != modified) {
+            return nullptr;
+        }
+        return &it->second.value;
+    }
+    Value* Lookup(const std::string& path, long long size, long long modified)
+    {
+        Entry* entry = Find(path);
+        return entry && entry->size == size && entry->modified == modified ? &entry->value : nullptr;
+    }
+
+    // False if the path cannot be stored
+    bool Store(const std::string& path, long long size, long long modified, Value value)
+    {
+        if (!IsStorable(path)) {
+            return false;
+        }
+        entries[path] = Entry{ size, modified, std::move(value) };
+        dirty = true;
+        return true;
+    }
+
+    // A file (or every file under a folder) was renamed; size and
+    // modification time survive a rename, so its records stay valid
+    void Rename(const std::string& from, const std::string& to, bool folder)
+    {
+        if (!IsStorable(to)) {
+            return;
+        }
+
+        std::vector<std::string> moved;
+        if (!folder) {
+            if (entries.count(from)) {
+                moved.push_back(from);
+            }
+        } else {
+            for (const auto& item : entries) {
+                if (IsUnder(item.first, from)) {
+                    moved.push_back(item.first);
+                }
+            }
+        }
+
+        for (const std::string& path : moved) {
+            auto node = entries.extract(path);
+            node.key() = to + path.substr(from.size());
+            entries.erase(node.key());
+            entries.insert(std::move(node));
+            dirty = true;
+        }
+    }
+
+private:
+    std::unordered_map<std::string, Entry> entries;
+};
+
+}
+
+#endif // __FILE_CACHE_HPP
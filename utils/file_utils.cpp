@@ -1,4 +1,5 @@
 #include "file_utils.hpp"
+#include "checksum.hpp"
 #include <wx/filename.h>
 #include <wx/dir.h>
 #include <wx/textfile.h>
@@ -381,66 +382,17 @@ bool FileUtils::CleanupTempFiles()
 // File comparison
 bool FileUtils::AreFilesEqual(const wxString& file1, const wxString& file2)
 {
-    if (!FileExists(file1) || !FileExists(file2)) {
-        return false;
-    }
-    
-    if (GetFileSize(file1) != GetFileSize(file2)) {
-        return false;
-    }
-    
-    wxFileInputStream stream1(file1);
-    wxFileInputStream stream2(file2);
-    
-    if (!stream1.IsOk() || !stream2.IsOk()) {
-        return false;
-    }
-    
-    const size_t buffer_size = 4096;
-    char buffer1[buffer_size];
-    char buffer2[buffer_size];
-    
-    while (!stream1.Eof() && !stream2.Eof()) {
-        stream1.Read(buffer1, buffer_size);
-        stream2.Read(buffer2, buffer_size);
-        
-        if (stream1.LastRead() != stream2.LastRead()) {
-            return false;
-        }
-        
-        if (memcmp(buffer1, buffer2, stream1.LastRead()) != 0) {
-            return false;
-        }
-    }
-    
-    return stream1.Eof() && stream2.Eof();
+    // Sizes are compared first, then contents block by block until one differs
+    return Checksum::FilesEqual(std::string(file1.utf8_str()), std::string(file2.utf8_str()));
 }
 
 wxString FileUtils::GetFileChecksum(const wxString& filepath)
 {
-    if (!FileExists(filepath)) {
-        return wxEmptyString;
-    }
-    
-    wxFileInputStream stream(filepath);
-    if (!stream.IsOk()) {
+    // CRC-32C, hardware-accelerated where the CPU supports it
+    uint32_t checksum;
+    if (!Checksum::Crc32cFile(std::string(filepath.utf8_str()), checksum)) {
         return wxEmptyString;
     }
-    
-    // Simple checksum calculation (not cryptographically secure)
-    wxUint32 checksum = 0;
-    const size_t buffer_size = 4096;
-    char buffer[buffer_size];
-    
-    while (!stream.Eof()) {
-        stream.Read(buffer, buffer_size);
-        size_t bytes_read = stream.LastRead();
-        
-        for (size_t i = 0; i < bytes_read; i++) {
-            checksum = ((checksum << 1) | (checksum >> 31)) ^ static_cast<wxUint32>(buffer[i]);
-        }
-    }
-    
     return wxString::Format("%08X", checksum);
 }
 
@@ -0,0 +1,293 @@
+#include "fuzzy_matcher.hpp"
+#include <algorithm>
+
+namespace utils {
+
+namespace {
+
+const size_t ASCII_CHARS = 128;
+const uint64_t HIGH_BIT = 1ULL << 63;
+
+// Next code point; a malformed byte decodes on its own to U+DC80..U+DCFF so
+// it cannot collide with a real character
+char32_t Decode(const unsigned char*& p, const unsigned char* end)
+{
+    char32_t lead = *p++;
+    if (lead < 0x80) {
+        return lead;
+    }
+
+    int extra = lead >= 0xF8 ? 0 : lead >= 0xF0 ? 3 : lead >= 0xE0 ? 2 : lead >= 0xC0 ? 1 : 0;
+    if (extra == 0 || end - p < extra) {
+        return 0xDC00 + lead;
+    }
+    char32_t c = lead & (0x3F >> extra);
+    for (int i = 0; i < extra; i++) {
+        if ((p[i] & 0xC0) != 0x80) {
+            return 0xDC00 + lead;
+        }
+        c = (c << 6) | (p[i] & 0x3F);
+    }
+    p += extra;
+    return c;
+}
+
+// One column step of a block of up to 64 query rows. h_in is the horizontal
+// delta entering the block's top row and tr the rows ending a transposition;
+// returns the delta leaving the row at out_bit. d0 receives the rows whose
+// diagonal step was free, for the next column's transpositions.
+inline int AdvanceBlock(uint64_t& pv, uint64_t& mv, uint64_t& d0, uint64_t eq, uint64_t tr,
+                        int h_in, uint64_t out_bit)
+{
+    uint64_t xv = eq | mv | tr;
+    if (h_in < 0) {
+        eq |= 1;
+    }
+    uint64_t xh = (((eq & pv) + pv) ^ pv) | eq | tr;
+    uint64_t ph = mv | ~(xh | pv);
+    uint64_t mh = pv & xh;
+    d0 = xh | xv;
+
+    int h_out = (ph & out_bit) ? 1 : (mh & out_bit) ? -1 : 0;
+
+    ph <<= 1;
+    mh <<= 1;
+    if (h_in < 0) {
+        mh |= 1;
+    } else if (h_in > 0) {
+        ph |= 1;
+    }
+    pv = mh | ~(xv | ph);
+    mv = ph & xv;
+    return h_out;
+}
+
+}
+
+FuzzyMatcher::FuzzyMatcher(std::string_view query, bool transpositions)
+    : length(0)
+    , blocks(1)
+    , transpositions(transpositions)
+    , last_bit(1)
+{
+    std::vector<char32_t> chars;
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(query.data());
+    const unsigned char* end = p + query.size();
+    while (p < end) {
+        chars.push_back(Decode(p, end));
+    }
+
+    length = chars.size();
+    blocks = std::max<size_t>(1, (length + 63) / 64);
+    if (length > 0) {
+        last_bit = 1ULL << ((length - 1) % 64);
+    }
+
+    ascii_masks.assign((ASCII_CHARS + 1) * blocks, 0);
+    std::vector<std::pair<char32_t, size_t>> wide;
+    for (size_t i = 0; i < length; i++) {
+        if (chars[i] < ASCII_CHARS) {
+            ascii_masks[chars[i] * blocks + i / 64] |= 1ULL << (i % 64);
+        } else {
+            wide.emplace_back(chars[i], i);
+        }
+    }
+
+    std::sort(wide.begin(), wide.end());
+    for (const auto& [c, i] : wide) {
+        if (wide_chars.empty() || wide_chars.back().first != c) {
+            wide_chars.emplace_back(c, wide_masks.size());
+            wide_masks.resize(wide_masks.size() + blocks, 0);
+        }
+        wide_masks[wide_chars.back().second + i / 64] |= 1ULL << (i % 64);
+    }
+}
+
+int FuzzyMatcher::Distance(std::string_view text, int max_distance) const
+{
+    return Run(text, false, max_distance, nullptr);
+}
+
+int FuzzyMatcher::SubstringDistance(std::string_view text, size_t* end) const
+{
+    return Run(text, true, -1, end);
+}
+
+void FuzzyMatcher::Distances(const std::vector<std::string>& candidates, std::vector<int>& distances,
+                             int max_distance) const
+{
+    distances.resize(candidates.size());
+    for (size_t i = 0; i < candidates.size(); i++) {
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(candidates[i].data());
+        const unsigned char* stop = p + candidates[i].size();
+        if (blocks != 1 || length == 0) {
+            distances[i] = Run(candidates[i], false, max_distance, nullptr);
+        } else if (transpositions) {
+            distances[i] = RunBlock<false, true>(p, stop, max_distance, nullptr);
+        } else {
+            distances[i] = RunBlock<false, false>(p, stop, max_distance, nullptr);
+        }
+    }
+}
+
+int FuzzyMatcher::Distance(std::string_view a, std::string_view b)
+{
+    // The shorter side as the query needs the fewest blocks
+    if (a.size() > b.size()) {
+        std::swap(a, b);
+    }
+    return FuzzyMatcher(a).Distance(b);
+}
+
+const uint64_t* FuzzyMatcher::GetMasks(char32_t c) const
+{
+    if (c < ASCII_CHARS) {
+        return &ascii_masks[c * blocks];
+    }
+    auto it = std::lower_bound(wide_chars.begin(), wide_chars.end(), std::make_pair(c, size_t(0)));
+    if (it != wide_chars.end() && it->first == c) {
+        return &wide_masks[it->second];
+    }
+    return &ascii_masks[ASCII_CHARS * blocks];
+}
+
+template <bool SUBSTRING, bool TRANSPOSE>
+int FuzzyMatcher::RunBlock(const unsigned char* p, const unsigned char* stop, int max_distance, size_t* end) const
+{
+    const unsigned char* begin = p;
+    uint64_t pv = ~0ULL;
+    uint64_t mv = 0;
+    uint64_t d0 = 0;
+    uint64_t eq_prev = 0;
+    int score = static_cast<int>(length);
+    int best = score;
+    size_t best_end = 0;
+    const long long limit = max_distance >= 0 ? max_distance : static_cast<long long>(stop - p) + score;
+    if (!SUBSTRING && score - (stop - p) > limit) {
+        return max_distance + 1;
+    }
+
+    while (p < stop) {
+        uint64_t eq = *p < ASCII_CHARS ? ascii_masks[*p++] : *GetMasks(Decode(p, stop));
+
+        // AdvanceBlock() with the top row's delta fixed
+        uint64_t tr = 0;
+        if constexpr (TRANSPOSE) {
+            tr = ((~d0 & eq) << 1) & eq_prev;
+            eq_prev = eq;
+        }
+        uint64_t xv = eq | mv | tr;
+        uint64_t xh = (((eq & pv) + pv) ^ pv) | eq | tr;
+        uint64_t ph = mv | ~(xh | pv);
+        uint64_t mh = pv & xh;
+        if constexpr (TRANSPOSE) {
+            d0 = xh | xv;
+        }
+        score += static_cast<int>((ph & last_bit) != 0) - static_cast<int>((mh & last_bit) != 0);
+        ph = (ph << 1) | (SUBSTRING ? 0 : 1);
+        mh <<= 1;
+        pv = mh | ~(xv | ph);
+        mv = ph & xv;
+
+        if constexpr (SUBSTRING) {
+            if (score < best) {
+                best = score;
+                best_end = static_cast<size_t>(p - begin);
+                if (best == 0) break;
+            }
+        } else if (score - (stop - p) > limit) {
+            // Each remaining character lowers the distance by at most one
+            return max_distance + 1;
+        }
+    }
+
+    if constexpr (SUBSTRING) {
+        if (end) {
+            *end = best_end;
+        }
+        return best;
+    }
+    return max_distance >= 0 ? std::min(score, max_distance + 1) : score;
+}
+
+int FuzzyMatcher::Run(std::string_view text, bool substring, int max_distance, size_t* end) const
+{
+    const unsigned char* begin = reinterpret_cast<const unsigned char*>(text.data());
+    const unsigned char* stop = begin + text.size();
+    const unsigned char* p = begin;
+
+    if (length == 0) {
+        int score = 0;
+        if (!substring) {
+            while (p < stop) {
+                Decode(p, stop);
+                score++;
+            }
+        }
+        if (end) {
+            *end = 0;
+        }
+        return max_distance >= 0 ? std::min(score, max_distance + 1) : score;
+    }
+
+    // The common case, a query of up to 64 characters, in straight-line code
+    if (blocks == 1) {
+        if (substring) {
+            return transpositions ? RunBlock<true, true>(p, stop, max_distance, end)
+                                  : RunBlock<true, false>(p, stop, max_distance, end);
+        }
+        return transpositions ? RunBlock<false, true>(p, stop, max_distance, end)
+                              : RunBlock<false, false>(p, stop, max_distance, end);
+    }
+
+    // Row 0 of the table is 0 everywhere for a substring match and counts
+    // up by one per text character for a whole-string match
+    const int h_top = substring ? 0 : 1;
+    std::vector<uint64_t> pv(blocks, ~0ULL);
+    std::vector<uint64_t> mv(blocks, 0);
+    std::vector<uint64_t> d0(blocks, 0);
+    std::vector<uint64_t> eq_prev(blocks, 0);
+    int score = static_cast<int>(length);
+    int best = score;
+    size_t best_end = 0;
+
+    while (p < stop) {
+        const uint64_t* eq = *p < ASCII_CHARS ? &ascii_masks[*p++ * blocks] : GetMasks(Decode(p, stop));
+
+        int h = h_top;
+        uint64_t carry = 0;
+        for (size_t b = 0; b < blocks; b++) {
+            // A transposition ending on a block's first row starts in the
+            // block above
+            uint64_t tr = 0;
+            if (transpositions) {
+                uint64_t swapped = ~d0[b] & eq[b];
+                tr = ((swapped << 1) | carry) & eq_prev[b];
+                carry = swapped >> 63;
+                eq_prev[b] = eq[b];
+            }
+            h = AdvanceBlock(pv[b], mv[b], d0[b], eq[b], tr, h, b + 1 < blocks ? HIGH_BIT : last_bit);
+        }
+        score += h;
+
+        if (substring) {
+            if (score < best) {
+                best = score;
+                best_end = static_cast<size_t>(p - begin);
+                if (best == 0) break;
+            }
+        } else if (max_distance >= 0 && score - (stop - p) > max_distance) {
+            return max_distance + 1;
+        }
+    }
+
+    if (!substring) {
+        return max_distance >= 0 ? std::min(score, max_distance + 1) : score;
+    }
+    if (end) {
+        *end = best_end;
+    }
+    return best;
+}
+
+}
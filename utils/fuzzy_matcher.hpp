@@ -0,0 +1,69 @@
+#ifndef __FUZZY_MATCHER_HPP
+#define __FUZZY_MATCHER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace utils {
+
+// Levenshtein distance between one query and many texts.
+//
+// Uses Myers' bit-parallel algorithm: each column of the edit-distance
+// table is held as vertical deltas in 64-bit words, so one text character
+// costs a handful of word operations per 64 query characters rather than a
+// row of cells. The query's character masks are built once in the
+// constructor, which is what makes scoring a batch cheap. Queries longer
+// than 64 characters use a block per 64 characters, carrying the
+// horizontal delta from block to block.
+//
+// With transpositions, swapping two adjacent characters is one edit rather
+// than two (optimal string alignment, Hyyro's extension), which is what
+// typo tolerance wants.
+//
+// Strings are UTF-8 and compared by code point; invalid bytes count as
+// single characters. Case is significant; fold both sides beforehand.
+class FuzzyMatcher {
+public:
+    explicit FuzzyMatcher(std::string_view query, bool transpositions = false);
+
+    size_t GetLength() const { return length; }     // in code points
+
+    // Edits turning the query into text. With max_distance >= 0, gives up
+    // as soon as the result must exceed it and returns max_distance + 1.
+    int Distance(std::string_view text, int max_distance = -1) const;
+
+    // Fewest edits turning the query into any substring of text; end, if
+    // given, receives the byte offset just past the best match
+    int SubstringDistance(std::string_view text, size_t* end = nullptr) const;
+
+    // Distance() against every candidate
+    void Distances(const std::vector<std::string>& candidates, std::vector<int>& distances,
+                   int max_distance = -1) const;
+
+    static int Distance(std::string_view a, std::string_view b);
+
+private:
+    size_t length;
+    size_t blocks;
+    bool transpositions;
+    uint64_t last_bit;                          // the last query row in the last block
+
+    // Match masks, blocks words per character. ASCII is looked up directly;
+    // the row after it is all zeros, for characters not in the query.
+    std::vector<uint64_t> ascii_masks;
+    std::vector<std::pair<char32_t, size_t>> wide_chars;    // sorted, offset into wide_masks
+    std::vector<uint64_t> wide_masks;
+
+    const uint64_t* GetMasks(char32_t c) const;
+    int Run(std::string_view text, bool substring, int max_distance, size_t* end) const;
+    template <bool SUBSTRING, bool TRANSPOSE>
+    int RunBlock(const unsigned char* p, const unsigned char* stop, int max_distance, size_t* end) const;
+};
+
+}
+
+#endif // __FUZZY_MATCHER_HPP
@@ -0,0 +1,242 @@
+#include "level_meter.hpp"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace utils {
+
+LevelTap::LevelTap()
+    : next_slot(0)
+{
+    Reset();
+}
+
+void LevelTap::Reset()
+{
+    for (Slot& slot : slots) {
+        slot.end_frame.store(-1, std::memory_order_relaxed);
+    }
+    next_slot = 0;
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+void LevelTap::Measure(const float* interleaved, size_t frames, int channels, long long end_frame)
+{
+    if (frames == 0) {
+        return;
+    }
+
+    float peak[2];
+    float mean_square[2];
+    Reduce(interleaved, frames, channels, peak, mean_square);
+
+    // Invalidate, fill, then publish: a reader that sees the same end frame
+    // before and after copying the fields got a consistent slot
+    Slot& slot = slots[next_slot];
+    slot.end_frame.store(-1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.frames.store(static_cast<unsigned>(frames), std::memory_order_relaxed);
+    for (int side = 0; side < 2; side++) {
+        slot.peak[side].store(peak[side], std::memory_order_relaxed);
+        slot.mean_square[side].store(mean_square[side], std::memory_order_relaxed);
+    }
+    slot.end_frame.store(end_frame, std::memory_order_release);
+
+    next_slot = (next_slot + 1) % SLOTS;
+}
+
+bool LevelTap::Read(long long from_frame, long long to_frame, LevelReading& reading) const
+{
+    float peak[2] = {0.0f, 0.0f};
+    double energy[2] = {0.0, 0.0};
+    double frames = 0.0;
+
+    long long newest_end = -1;
+    LevelReading newest = {};
+
+    for (const Slot& slot : slots) {
+        long long end = slot.end_frame.load(std::memory_order_acquire);
+        if (end < 0 || end > to_frame) {
+            continue;
+        }
+
+        unsigned count = slot.frames.load(std::memory_order_relaxed);
+        LevelReading block;
+        for (int side = 0; side < 2; side++) {
+            block.peak[side] = slot.peak[side].load(std::memory_order_relaxed);
+            block.mean_square[side] = slot.mean_square[side].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.end_frame.load(std::memory_order_relaxed) != end) {
+            continue;   // overwritten while copying
+        }
+
+        if (end > from_frame) {
+            for (int side = 0; side < 2; side++) {
+                peak[side] = std::max(peak[side], block.peak[side]);
+                energy[side] += static_cast<double>(block.mean_square[side]) * count;
+            }
+            frames += count;
+        }
+        if (end > newest_end) {
+            newest_end = end;
+            newest = block;
+        }
+    }
+
+    if (frames > 0.0) {
+        for (int side = 0; side < 2; side++) {
+            reading.peak[side] = peak[side];
+            reading.mean_square[side] = static_cast<float>(energy[side] / frames);
+        }
+        return true;
+    }
+    if (newest_end >= 0) {
+        reading = newest;
+        return true;
+    }
+    return false;
+}
+
+void LevelTap::Reduce(const float* samples, size_t frames, int channels, float* peak, float* mean_square)
+{
+    peak[0] = peak[1] = 0.0f;
+    mean_square[0] = mean_square[1] = 0.0f;
+    if (frames == 0 || channels <= 0) {
+        return;
+    }
+
+    if (channels > 2) {
+        float sum[2] = {0.0f, 0.0f};
+        for (size_t i = 0; i < frames; i++) {
+            const float* frame = samples + i * channels;
+            for (int c = 0; c < channels; c++) {
+                float s = frame[c];
+                peak[c & 1] = std::max(peak[c & 1], std::abs(s));
+                sum[c & 1] += s * s;
+            }
+        }
+        mean_square[0] = sum[0] / (frames * ((channels + 1) / 2));
+        mean_square[1] = sum[1] / (frames * (channels / 2));
+        return;
+    }
+
+    // Four lanes; with stereo, lanes 0 and 2 carry the left channel and 1
+    // and 3 the right, since each vector starts on an even sample
+    const size_t count = frames * channels;
+    float lane_peak[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    float lane_sum[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    size_t i = 0;
+
+#if defined(__SSE2__) || defined(_M_X64)
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    __m128 peak_a = _mm_setzero_ps();
+    __m128 peak_b = _mm_setzero_ps();
+    __m128 sum_a = _mm_setzero_ps();
+    __m128 sum_b = _mm_setzero_ps();
+    for (; i + 8 <= count; i += 8) {
+        __m128 a = _mm_loadu_ps(samples + i);
+        __m128 b = _mm_loadu_ps(samples + i + 4);
+        peak_a = _mm_max_ps(peak_a, _mm_andnot_ps(sign, a));
+        peak_b = _mm_max_ps(peak_b, _mm_andnot_ps(sign, b));
+        sum_a = _mm_add_ps(sum_a, _mm_mul_ps(a, a));
+        sum_b = _mm_add_ps(sum_b, _mm_mul_ps(b, b));
+    }
+    _mm_storeu_ps(lane_peak, _mm_max_ps(peak_a, peak_b));
+    _mm_storeu_ps(lane_sum, _mm_add_ps(sum_a, sum_b));
+#elif defined(__ARM_NEON)
+    float32x4_t peak_a = vdupq_n_f32(0.0f);
+    float32x4_t peak_b = vdupq_n_f32(0.0f);
+    float32x4_t sum_a = vdupq_n_f32(0.0f);
+    float32x4_t sum_b = vdupq_n_f32(0.0f);
+    for (; i + 8 <= count; i += 8) {
+        float32x4_t a = vld1q_f32(samples + i);
+        float32x4_t b = vld1q_f32(samples + i + 4);
+        peak_a = vmaxq_f32(peak_a, vabsq_f32(a));
+        peak_b = vmaxq_f32(peak_b, vabsq_f32(b));
+        sum_a = vmlaq_f32(sum_a, a, a);
+        sum_b = vmlaq_f32(sum_b, b, b);
+    }
+    vst1q_f32(lane_peak, vmaxq_f32(peak_a, peak_b));
+    vst1q_f32(lane_sum, vaddq_f32(sum_a, sum_b));
+#endif
+
+    for (; i < count; i++) {
+        float s = samples[i];
+        lane_peak[i & 3] = std::max(lane_peak[i & 3], std::abs(s));
+        lane_sum[i & 3] += s * s;
+    }
+
+    if (channels == 2) {
+        peak[0] = std::max(lane_peak[0], lane_peak[2]);
+        peak[1] = std::max(lane_peak[1], lane_peak[3]);
+        mean_square[0] = (lane_sum[0] + lane_sum[2]) / frames;
+        mean_square[1] = (lane_sum[1] + lane_sum[3]) / frames;
+    } else {
+        peak[0] = peak[1] = std::max(std::max(lane_peak[0], lane_peak[1]), std::max(lane_peak[2], lane_peak[3]));
+        mean_square[0] = mean_square[1] = (lane_sum[0] + lane_sum[1] + lane_sum[2] + lane_sum[3]) / frames;
+    }
+}
+
+LevelMeter::LevelMeter()
+{
+    Reset();
+}
+
+void LevelMeter::Reset()
+{
+    for (int c = 0; c < 2; c++) {
+        peak_db[c] = FLOOR_DB;
+        hold_db[c] = FLOOR_DB;
+        hold_age[c] = 0.0;
+        rms_square[c] = 0.0f;
+        clipped[c] = false;
+    }
+}
+
+void LevelMeter::Update(const LevelReading& reading, double seconds)
+{
+    const float fall = static_cast<float>(PEAK_FALL_DB_PER_SECOND * seconds);
+    const float blend = static_cast<float>(1.0 - std::exp(-seconds / RMS_TIME_CONSTANT));
+
+    for (int c = 0; c < 2; c++) {
+        float measured = ToDb(reading.peak[c]);
+        peak_db[c] = std::max(measured, std::max(FLOOR_DB, peak_db[c] - fall));
+
+        hold_age[c] += seconds;
+        if (peak_db[c] >= hold_db[c]) {
+            hold_db[c] = peak_db[c];
+            hold_age[c] = 0.0;
+        } else if (hold_age[c] > PEAK_HOLD_SECONDS) {
+            hold_db[c] = std::max(peak_db[c], hold_db[c] - fall);
+        }
+
+        rms_square[c] += (reading.mean_square[c] - rms_square[c]) * blend;
+
+        if (reading.peak[c] >= 1.0f) {
+            clipped[c] = true;
+        }
+    }
+}
+
+void LevelMeter::Decay(double seconds)
+{
+    LevelReading silence = {};
+    Update(silence, seconds);
+}
+
+float LevelMeter::ToDb(float level, bool squared)
+{
+    if (level <= 0.0f) {
+        return FLOOR_DB;
+    }
+    float db = (squared ? 10.0f : 20.0f) * std::log10(level);
+    return std::max(FLOOR_DB, db);
+}
+
+}
@@ -0,0 +1,90 @@
+#ifndef __LEVEL_METER_HPP
+#define __LEVEL_METER_HPP
+
+#include <atomic>
+#include <cstddef>
+
+namespace utils {
+
+// Stereo levels over a stretch of audio, linear full scale = 1.0
+struct LevelReading {
+    float peak[2];          // max |x|
+    float mean_square[2];   // average x^2
+};
+
+// Per-block levels published by the decoding thread.
+//
+// The producer reduces each decoded block to a peak and a mean square per
+// side and stores those few floats in a small ring, keyed by the block's end
+// frame. Readers combine the blocks that were played since their last look,
+// so meters follow the playback clock rather than the decoder, which runs
+// ahead of it. Neither side ever blocks.
+class LevelTap {
+public:
+    LevelTap();
+
+    // Producer side
+    void Reset();
+    void Measure(const float* interleaved, size_t frames, int channels, long long end_frame);
+
+    // Reader side: levels of the blocks ending in (from_frame, to_frame], or
+    // of the newest block ending at or before to_frame when none does (the
+    // reader polls faster than blocks complete). False when nothing is known.
+    bool Read(long long from_frame, long long to_frame, LevelReading& reading) const;
+
+    // Max-abs and mean square per side in one vectorized pass. Mono is
+    // reported on both sides; beyond two channels even channels fold into
+    // the left side and odd ones into the right.
+    static void Reduce(const float* interleaved, size_t frames, int channels, float* peak, float* mean_square);
+
+private:
+    struct Slot {
+        std::atomic<long long> end_frame;   // -1 while being written
+        std::atomic<unsigned> frames;
+        std::atomic<float> peak[2];
+        std::atomic<float> mean_square[2];
+    };
+
+    static const size_t SLOTS = 256;
+    Slot slots[SLOTS];
+    size_t next_slot;   // producer only
+};
+
+// Meter ballistics for display.
+//
+// Peaks attack instantly and fall back at 20 dB per 1.7 s, as on digital
+// peak programme meters; a hold marker stays at the highest recent peak for
+// two seconds. The RMS level integrates the mean square with a VU-like
+// 300 ms time constant. Anything reaching full scale latches the clip flag
+// until Reset().
+class LevelMeter {
+public:
+    LevelMeter();
+
+    void Reset();
+    void Update(const LevelReading& reading, double seconds);
+    void Decay(double seconds);     // time passed without audio
+
+    float GetPeakDb(int channel) const { return peak_db[channel]; }
+    float GetRmsDb(int channel) const { return ToDb(rms_square[channel], true); }
+    float GetHoldDb(int channel) const { return hold_db[channel]; }
+    bool IsClipped(int channel) const { return clipped[channel]; }
+
+    static float ToDb(float level, bool squared = false);
+
+    static constexpr float FLOOR_DB = -96.0f;
+    static constexpr float PEAK_FALL_DB_PER_SECOND = 20.0f / 1.7f;
+    static constexpr double PEAK_HOLD_SECONDS = 2.0;
+    static constexpr double RMS_TIME_CONSTANT = 0.3;
+
+private:
+    float peak_db[2];
+    float hold_db[2];
+    double hold_age[2];
+    float rms_square[2];
+    bool clipped[2];
+};
+
+}
+
+#endif // __LEVEL_METER_HPP
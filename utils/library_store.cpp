@@ -0,0 +1,927 @@
+#include "library_store.hpp"
+#include "checksum.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <numeric>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace utils {
+
+namespace {
+
+const char SNAPSHOT_MAGIC[8] = { 'W', 'J', 'L', 'I', 'B', 'D', 'B', '\0' };
+const char LOG_MAGIC[8] = { 'W', 'J', 'L', 'I', 'B', 'L', 'O', 'G' };
+const uint32_t VERSION = 1;
+
+enum Section {
+    VALUE_OFFSETS,                                          // one per text field
+    VALUE_BYTES = VALUE_OFFSETS + LibraryStore::TEXT_FIELDS,
+    CODES = VALUE_BYTES + LibraryStore::TEXT_FIELDS,
+    NUMBERS = CODES + LibraryStore::TEXT_FIELDS,             // one per number field
+    PATH_ROWS = NUMBERS + LibraryStore::NUMBER_FIELDS,
+    ARTIST_ALBUMS,
+    ALBUM_NAMES,
+    ALBUM_ROWS,
+    SECTION_COUNT
+};
+
+// Native byte order: the files never leave the machine
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t track_count;
+    uint64_t generation;
+    uint32_t album_count;
+    uint32_t value_counts[LibraryStore::TEXT_FIELDS];
+    uint64_t sections[SECTION_COUNT][2];                    // offset, size
+    uint32_t checksum;                                      // CRC-32C of the above
+};
+
+struct LogHeader {
+    char magic[8];
+    uint64_t generation;                                    // of the checkpoint it follows
+};
+
+// A log record is its payload's length and CRC-32C, then the payload: the
+// type, then the text fields as length and bytes, then the numbers
+enum RecordType : uint8_t { RECORD_PUT = 1, RECORD_REMOVE = 2 };
+const size_t RECORD_HEADER = 8;
+
+// Name order: ASCII case-folded first, so "abba" and "ABBA" sit together
+int CompareNames(std::string_view a, std::string_view b)
+{
+    // Bytes that match exactly match folded, and names share long prefixes
+    size_t length = std::min(a.size(), b.size());
+    size_t i = std::mismatch(a.begin(), a.begin() + length, b.begin()).first - a.begin();
+    for (; i < length; i++) {
+        unsigned char x = static_cast<unsigned char>(a[i]);
+        unsigned char y = static_cast<unsigned char>(b[i]);
+        if (x >= 'A' && x <= 'Z') x += 'a' - 'A';
+        if (y >= 'A' && y <= 'Z') y += 'a' - 'A';
+        if (x != y) {
+            return x < y ? -1 : 1;
+        }
+    }
+    if (a.size() != b.size()) {
+        return a.size() < b.size() ? -1 : 1;
+    }
+    return a.compare(b);
+}
+
+bool NameLess(std::string_view a, std::string_view b)
+{
+    return CompareNames(a, b) < 0;
+}
+
+// names is in name order; adds the extra ones, keeping it so, once each
+void MergeNames(std::vector<std::string_view>& names, std::vector<std::string_view>& extra)
+{
+    if (extra.empty()) {
+        return;
+    }
+    std::sort(extra.begin(), extra.end(), NameLess);
+    size_t middle = names.size();
+    names.insert(names.end(), extra.begin(), extra.end());
+    std::inplace_merge(names.begin(), names.begin() + middle, names.end(), NameLess);
+    names.erase(std::unique(names.begin(), names.end()), names.end());
+}
+
+bool WriteAll(int fd, const void* data, size_t size)
+{
+    const char* bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t written = write(fd, bytes, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        bytes += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+void AppendValue(std::string& out, const void* data, size_t size)
+{
+    out.append(static_cast<const char*>(data), size);
+}
+
+void AppendText(std::string& out, std::string_view text)
+{
+    uint32_t length = static_cast<uint32_t>(text.size());
+    AppendValue(out, &length, sizeof(length));
+    out.append(text);
+}
+
+bool ReadText(const char*& data, const char* end, std::string& text)
+{
+    uint32_t length;
+    if (static_cast<size_t>(end - data) < sizeof(length)) {
+        return false;
+    }
+    std::memcpy(&length, data, sizeof(length));
+    data += sizeof(length);
+    if (static_cast<size_t>(end - data) < length) {
+        return false;
+    }
+    text.assign(data, length);
+    data += length;
+    return true;
+}
+
+// Sections go after the header, each 8-byte aligned, in the order written
+class SectionWriter {
+public:
+    explicit SectionWriter(int fd)
+        : fd(fd)
+        , offset(sizeof(FileHeader))
+        , ok(true)
+    {
+        static const char zeros[sizeof(FileHeader)] = {};
+        ok = WriteAll(fd, zeros, sizeof(zeros));
+        Pad();
+    }
+
+    template <typename T>
+    void Write(FileHeader& header, int section, const std::vector<T>& values)
+    {
+        Write(header, section, values.data(), values.size() * sizeof(T));
+    }
+
+    void Write(FileHeader& header, int section, const void* data, size_t size)
+    {
+        header.sections[section][0] = offset;
+        header.sections[section][1] = size;
+        ok = ok && WriteAll(fd, data, size);
+        offset += size;
+        Pad();
+    }
+
+    bool IsOk() const { return ok; }
+
+private:
+    int fd;
+    uint64_t offset;
+    bool ok;
+
+    void Pad()
+    {
+        static const char zeros[8] = {};
+        size_t padding = (8 - offset % 8) % 8;
+        ok = ok && WriteAll(fd, zeros, padding);
+        offset += padding;
+    }
+};
+
+void SyncFolder(const std::string& folder)
+{
+    int fd = open(folder.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+}
+
+LibraryStore& LibraryStore::Get()
+{
+    static LibraryStore instance;
+    return instance;
+}
+
+LibraryStore::LibraryStore()
+    : wal_fd(-1)
+    , log_size(0)
+    , log_records(0)
+    , live_count(0)
+{
+}
+
+LibraryStore::~LibraryStore()
+{
+    Close();
+}
+
+bool LibraryStore::Open(const std::string& path)
+{
+    Close();
+
+    std::error_code error;
+    std::filesystem::create_directories(path, error);
+    folder = path;
+    if (!MapSnapshot()) {
+        return false;
+    }
+
+    wal_fd = open((folder + "/library.wal").c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (wal_fd < 0 || !ReplayLog()) {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void LibraryStore::Close()
+{
+    if (wal_fd >= 0) {
+        WriteLog();
+        close(wal_fd);
+        wal_fd = -1;
+    }
+    UnmapSnapshot();
+    ClearChanges();
+    pending.clear();
+    log_size = 0;
+    log_records = 0;
+}
+
+bool LibraryStore::Put(const Track& track)
+{
+    const std::string& path = track.text[PATH];
+    if (!IsOpen() || path.empty()) {
+        return false;
+    }
+
+    uint32_t id = Find(path);
+    if (id != NO_TRACK) {
+        bool same = true;
+        for (int f = 0; f < TEXT_FIELDS && same; f++) {
+            same = GetText(id, static_cast<TextField>(f)) == track.text[f];
+        }
+        for (int f = 0; f < NUMBER_FIELDS && same; f++) {
+            same = GetNumber(id, static_cast<NumberField>(f)) == track.numbers[f];
+        }
+        if (same) {
+            return true;
+        }
+    }
+
+    std::string payload(1, static_cast<char>(RECORD_PUT));
+    for (const std::string& text : track.text) {
+        AppendText(payload, text);
+    }
+    AppendValue(payload, track.numbers.data(), sizeof(track.numbers));
+
+    AppendRecord(payload);
+    ApplyPut(track);
+    return true;
+}
+
+bool LibraryStore::Remove(std::string_view path)
+{
+    if (!IsOpen()) {
+        return false;
+    }
+    if (Find(path) == NO_TRACK) {
+        return true;
+    }
+
+    std::string payload(1, static_cast<char>(RECORD_REMOVE));
+    AppendText(payload, path);
+
+    AppendRecord(payload);
+    ApplyRemove(path);
+    return true;
+}
+
+bool LibraryStore::Commit()
+{
+    if (!WriteLog()) {
+        return false;
+    }
+    if (log_records >= CHECKPOINT_RECORDS) {
+        return Checkpoint();
+    }
+    return true;
+}
+
+bool LibraryStore::Checkpoint()
+{
+    // The log keeps the changes should the new checkpoint not make it
+    if (!WriteLog()) {
+        return false;
+    }
+
+    std::string file = folder + "/library.db";
+    std::string temporary = file + ".tmp";
+    uint64_t generation = snapshot.generation + 1;
+    if (!WriteSnapshot(temporary, generation) || std::rename(temporary.c_str(), file.c_str()) != 0) {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    SyncFolder(folder);
+
+    // From here the new file holds everything; the old log no longer
+    // matches its generation and is never replayed
+    UnmapSnapshot();
+    ClearChanges();
+    if (!MapSnapshot()) {
+        return false;
+    }
+    return ResetLog();
+}
+
+uint32_t LibraryStore::Find(std::string_view path) const
+{
+    auto it = added_paths.find(std::string(path));
+    if (it != added_paths.end()) {
+        return snapshot.track_count + it->second;
+    }
+
+    uint32_t code = FindValue(PATH, path);
+    if (code == NO_TRACK) {
+        return NO_TRACK;
+    }
+    uint32_t row = snapshot.path_rows[code];
+    if (row >= snapshot.track_count || shadowed[row]) {
+        return NO_TRACK;
+    }
+    return row;
+}
+
+std::string_view LibraryStore::GetText(uint32_t track, TextField field) const
+{
+    if (track < snapshot.track_count) {
+        return GetValue(field, snapshot.codes[field][track]);
+    }
+    track -= snapshot.track_count;
+    return track < added.size() ? std::string_view(added[track].text[field]) : std::string_view();
+}
+
+int64_t LibraryStore::GetNumber(uint32_t track, NumberField field) const
+{
+    if (track < snapshot.track_count) {
+        return snapshot.numbers[field][track];
+    }
+    track -= snapshot.track_count;
+    return track < added.size() ? added[track].numbers[field] : 0;
+}
+
+void LibraryStore::GetTracks(std::vector<uint32_t>& tracks) const
+{
+    tracks.clear();
+    tracks.reserve(live_count);
+    for (uint32_t row = 0; row < snapshot.track_count; row++) {
+        if (!shadowed[row]) {
+            tracks.push_back(row);
+        }
+    }
+    for (size_t i = 0; i < added.size(); i++) {
+        if (added_live[i]) {
+            tracks.push_back(snapshot.track_count + static_cast<uint32_t>(i));
+        }
+    }
+}
+
+void LibraryStore::GetArtists(std::vector<std::string_view>& artists) const
+{
+    artists.clear();
+    for (uint32_t code = 0; code < snapshot.value_counts[ARTIST]; code++) {
+        for (uint32_t album = snapshot.artist_albums[code]; album < snapshot.artist_albums[code + 1]; album++) {
+            if (IsAlbumLive(album)) {
+                artists.push_back(GetValue(ARTIST, code));
+                break;
+            }
+        }
+    }
+
+    std::vector<std::string_view> extra;
+    for (size_t i = 0; i < added.size(); i++) {
+        if (added_live[i]) {
+            extra.push_back(added[i].text[ARTIST]);
+        }
+    }
+    MergeNames(artists, extra);
+}
+
+void LibraryStore::GetAlbums(std::string_view artist, std::vector<std::string_view>& albums) const
+{
+    albums.clear();
+    uint32_t code = FindValue(ARTIST, artist);
+    if (code != NO_TRACK) {
+        for (uint32_t album = snapshot.artist_albums[code]; album < snapshot.artist_albums[code + 1]; album++) {
+            if (IsAlbumLive(album)) {
+                albums.push_back(GetValue(ALBUM, snapshot.album_names[album]));
+            }
+        }
+    }
+
+    std::vector<std::string_view> extra;
+    for (size_t i = 0; i < added.size(); i++) {
+        if (added_live[i] && added[i].text[ARTIST] == artist) {
+            extra.push_back(added[i].text[ALBUM]);
+        }
+    }
+    MergeNames(albums, extra);
+}
+
+void LibraryStore::GetAlbumTracks(std::string_view artist, std::string_view album, std::vector<uint32_t>& tracks) const
+{
+    tracks.clear();
+    uint32_t artist_code = FindValue(ARTIST, artist);
+    uint32_t album_code = FindValue(ALBUM, album);
+    if (artist_code != NO_TRACK && album_code != NO_TRACK) {
+        const uint32_t* first = snapshot.album_names + snapshot.artist_albums[artist_code];
+        const uint32_t* last = snapshot.album_names + snapshot.artist_albums[artist_code + 1];
+        const uint32_t* found = std::lower_bound(first, last, album_code);
+        if (found != last && *found == album_code) {
+            uint32_t index = static_cast<uint32_t>(found - snapshot.album_names);
+            for (uint32_t row = snapshot.album_rows[index]; row < snapshot.album_rows[index + 1]; row++) {
+                if (!shadowed[row]) {
+                    tracks.push_back(row);
+                }
+            }
+        }
+    }
+
+    size_t checkpointed = tracks.size();
+    for (size_t i = 0; i < added.size(); i++) {
+        if (added_live[i] && added[i].text[ARTIST] == artist && added[i].text[ALBUM] == album) {
+            tracks.push_back(snapshot.track_count + static_cast<uint32_t>(i));
+        }
+    }
+    auto less = [this](uint32_t a, uint32_t b) { return TrackLess(a, b); };
+    std::sort(tracks.begin() + checkpointed, tracks.end(), less);
+    std::inplace_merge(tracks.begin(), tracks.begin() + checkpointed, tracks.end(), less);
+}
+
+bool LibraryStore::MapSnapshot()
+{
+    snapshot = Snapshot();
+    int fd = open((folder + "/library.db").c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        // No checkpoint yet: an empty library
+        return errno == ENOENT;
+    }
+
+    struct stat info;
+    void* mapped = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) >= sizeof(FileHeader)) {
+        mapped = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        return false;
+    }
+    snapshot.data = static_cast<const unsigned char*>(mapped);
+    snapshot.size = static_cast<size_t>(info.st_size);
+    madvise(mapped, snapshot.size, MADV_RANDOM);
+
+    FileHeader header;
+    std::memcpy(&header, snapshot.data, sizeof(header));
+    if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 || header.version != VERSION ||
+        header.checksum != Checksum::Crc32c(&header, offsetof(FileHeader, checksum))) {
+        UnmapSnapshot();
+        return false;
+    }
+
+    // Every section must lie within the file, aligned, at its expected size
+    bool valid = true;
+    auto section = [&](int index, size_t element_size, uint64_t count) -> const void* {
+        uint64_t offset = header.sections[index][0];
+        uint64_t size = header.sections[index][1];
+        if (offset % 8 != 0 || offset > snapshot.size || size > snapshot.size - offset ||
+            (element_size > 0 && size != element_size * count)) {
+            valid = false;
+            return nullptr;
+        }
+        return snapshot.data + offset;
+    };
+
+    const uint32_t tracks = header.track_count;
+    snapshot.generation = header.generation;
+    snapshot.track_count = tracks;
+    snapshot.album_count = header.album_count;
+    for (int f = 0; f < TEXT_FIELDS; f++) {
+        snapshot.value_counts[f] = header.value_counts[f];
+        snapshot.value_offsets[f] = static_cast<const uint32_t*>(
+            section(VALUE_OFFSETS + f, sizeof(uint32_t), uint64_t(header.value_counts[f]) + 1));
+        snapshot.value_bytes[f] = static_cast<const char*>(section(VALUE_BYTES + f, 0, 0));
+        snapshot.value_bytes_size[f] = header.sections[VALUE_BYTES + f][1];
+        snapshot.codes[f] = static_cast<const uint32_t*>(section(CODES + f, sizeof(uint32_t), tracks));
+    }
+    for (int f = 0; f < NUMBER_FIELDS; f++) {
+        snapshot.numbers[f] = static_cast<const int64_t*>(section(NUMBERS + f, sizeof(int64_t), tracks));
+    }
+    snapshot.path_rows = static_cast<const uint32_t*>(section(PATH_ROWS, sizeof(uint32_t), header.value_counts[PATH]));
+    snapshot.artist_albums = static_cast<const uint32_t*>(
+        section(ARTIST_ALBUMS, sizeof(uint32_t), uint64_t(header.value_counts[ARTIST]) + 1));
+    snapshot.album_names = static_cast<const uint32_t*>(section(ALBUM_NAMES, sizeof(uint32_t), header.album_count));
+    snapshot.album_rows = static_cast<const uint32_t*>(
+        section(ALBUM_ROWS, sizeof(uint32_t), uint64_t(header.album_count) + 1));
+
+    // The album tables drive every range; the columns are checked as read
+    if (valid) {
+        const uint32_t* artist_albums = snapshot.artist_albums;
+        const uint32_t* album_rows = snapshot.album_rows;
+        valid = artist_albums[0] == 0 && artist_albums[header.value_counts[ARTIST]] == header.album_count &&
+                std::is_sorted(artist_albums, artist_albums + header.value_counts[ARTIST] + 1) &&
+                album_rows[0] == 0 && album_rows[header.album_count] == tracks &&
+                std::is_sorted(album_rows, album_rows + header.album_count + 1);
+    }
+    if (!valid) {
+        UnmapSnapshot();
+        return false;
+    }
+
+    shadowed.assign(tracks, false);
+    live_count = tracks;
+    return true;
+}
+
+void LibraryStore::UnmapSnapshot()
+{
+    if (snapshot.data) {
+        munmap(const_cast<unsigned char*>(snapshot.data), snapshot.size);
+    }
+    snapshot = Snapshot();
+}
+
+void LibraryStore::ClearChanges()
+{
+    added.clear();
+    added_live.clear();
+    added_paths.clear();
+    shadowed.assign(snapshot.track_count, false);
+    shadowed_per_album.clear();
+    live_count = snapshot.track_count;
+}
+
+bool LibraryStore::WriteSnapshot(const std::string& path, uint64_t generation) const
+{
+    // Checkpointed rows come first, still in row order, then the added ones
+    std::vector<uint32_t> tracks;
+    GetTracks(tracks);
+    const uint32_t count = static_cast<uint32_t>(tracks.size());
+    const uint32_t kept = static_cast<uint32_t>(
+        std::lower_bound(tracks.begin(), tracks.end(), snapshot.track_count) - tracks.begin());
+
+    FileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = VERSION;
+    header.track_count = count;
+    header.generation = generation;
+
+    // Each field's dictionary is the old one, less unused values, merged
+    // with the sorted new ones; only the changes are ever sorted. Codes are
+    // by position in tracks.
+    std::array<std::vector<uint32_t>, TEXT_FIELDS> codes;
+    std::array<std::vector<std::string_view>, TEXT_FIELDS> values;
+    for (int f = 0; f < TEXT_FIELDS; f++) {
+        TextField field = static_cast<TextField>(f);
+        const uint32_t old_count = snapshot.value_counts[f];
+        std::vector<uint32_t> old_codes(old_count, NO_TRACK);
+        for (uint32_t position = 0; position < kept; position++) {
+            uint32_t code = snapshot.codes[f][tracks[position]];
+            if (code >= old_count) {
+                return false;
+            }
+            old_codes[code] = 0;
+        }
+
+        std::vector<std::string_view> fresh;
+        for (uint32_t position = kept; position < count; position++) {
+            fresh.push_back(GetText(tracks[position], field));
+        }
+        std::sort(fresh.begin(), fresh.end(), NameLess);
+        fresh.erase(std::unique(fresh.begin(), fresh.end()), fresh.end());
+        std::vector<uint32_t> fresh_codes(fresh.size());
+
+        size_t i = 0;
+        size_t j = 0;
+        while (i < old_count || j < fresh.size()) {
+            if (i < old_count && old_codes[i] == NO_TRACK) {
+                i++;
+                continue;
+            }
+            uint32_t code = static_cast<uint32_t>(values[f].size());
+            int order = i == old_count ? 1 : j == fresh.size() ? -1 : CompareNames(GetValue(field, i), fresh[j]);
+            if (order <= 0) {
+                values[f].push_back(GetValue(field, i));
+                old_codes[i++] = code;
+            } else {
+                values[f].push_back(fresh[j]);
+            }
+            if (order >= 0) {
+                fresh_codes[j++] = code;
+            }
+        }
+        header.value_counts[f] = static_cast<uint32_t>(values[f].size());
+
+        codes[f].resize(count);
+        for (uint32_t position = 0; position < kept; position++) {
+            codes[f][position] = old_codes[snapshot.codes[f][tracks[position]]];
+        }
+        for (uint32_t position = kept; position < count; position++) {
+            auto found = std::lower_bound(fresh.begin(), fresh.end(), GetText(tracks[position], field), NameLess);
+            codes[f][position] = fresh_codes[found - fresh.begin()];
+        }
+    }
+
+    // Rows grouped by artist and album, each album in play order. Codes
+    // kept their order, so the checkpointed rows still are; the added
+    // ones are sorted and merged in.
+    auto row_less = [&](uint32_t a, uint32_t b) {
+        if (codes[ARTIST][a] != codes[ARTIST][b]) return codes[ARTIST][a] < codes[ARTIST][b];
+        if (codes[ALBUM][a] != codes[ALBUM][b]) return codes[ALBUM][a] < codes[ALBUM][b];
+        int64_t disc_a = GetNumber(tracks[a], DISC), disc_b = GetNumber(tracks[b], DISC);
+        if (disc_a != disc_b) return disc_a < disc_b;
+        int64_t track_a = GetNumber(tracks[a], TRACK), track_b = GetNumber(tracks[b], TRACK);
+        if (track_a != track_b) return track_a < track_b;
+        if (codes[TITLE][a] != codes[TITLE][b]) return codes[TITLE][a] < codes[TITLE][b];
+        return codes[PATH][a] < codes[PATH][b];
+    };
+    std::vector<uint32_t> rows(count);
+    std::iota(rows.begin(), rows.end(), 0);
+    std::sort(rows.begin() + kept, rows.end(), row_less);
+    std::inplace_merge(rows.begin(), rows.begin() + kept, rows.end(), row_less);
+
+    std::vector<uint32_t> artist_albums(header.value_counts[ARTIST] + 1, 0);
+    std::vector<uint32_t> album_names;
+    std::vector<uint32_t> album_rows;
+    std::vector<uint32_t> path_rows(header.value_counts[PATH], 0);
+    for (uint32_t row = 0; row < count; row++) {
+        uint32_t position = rows[row];
+        path_rows[codes[PATH][position]] = row;
+        if (row == 0 || codes[ARTIST][position] != codes[ARTIST][rows[row - 1]] ||
+            codes[ALBUM][position] != codes[ALBUM][rows[row - 1]]) {
+            artist_albums[codes[ARTIST][position] + 1]++;
+            album_names.push_back(codes[ALBUM][position]);
+            album_rows.push_back(row);
+        }
+    }
+    std::partial_sum(artist_albums.begin(), artist_albums.end(), artist_albums.begin());
+    header.album_count = static_cast<uint32_t>(album_names.size());
+    album_rows.push_back(count);
+
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    SectionWriter writer(fd);
+    for (int f = 0; f < TEXT_FIELDS; f++) {
+        std::vector<uint32_t> offsets;
+        offsets.reserve(values[f].size() + 1);
+        std::string bytes;
+        for (std::string_view value : values[f]) {
+            offsets.push_back(static_cast<uint32_t>(bytes.size()));
+            bytes += value;
+        }
+        offsets.push_back(static_cast<uint32_t>(bytes.size()));
+        writer.Write(header, VALUE_OFFSETS + f, offsets);
+        writer.Write(header, VALUE_BYTES + f, bytes.data(), bytes.size());
+
+        std::vector<uint32_t> column(count);
+        for (uint32_t row = 0; row < count; row++) {
+            column[row] = codes[f][rows[row]];
+        }
+        writer.Write(header, CODES + f, column);
+    }
+    for (int f = 0; f < NUMBER_FIELDS; f++) {
+        std::vector<int64_t> column(count);
+        for (uint32_t row = 0; row < count; row++) {
+            column[row] = GetNumber(tracks[rows[row]], static_cast<NumberField>(f));
+        }
+        writer.Write(header, NUMBERS + f, column);
+    }
+    writer.Write(header, PATH_ROWS, path_rows);
+    writer.Write(header, ARTIST_ALBUMS, artist_albums);
+    writer.Write(header, ALBUM_NAMES, album_names);
+    writer.Write(header, ALBUM_ROWS, album_rows);
+
+    // The header goes last, so a file cut short never checks out
+    header.checksum = Checksum::Crc32c(&header, offsetof(FileHeader, checksum));
+    bool ok = writer.IsOk() && pwrite(fd, &header, sizeof(header), 0) == static_cast<ssize_t>(sizeof(header)) &&
+              fsync(fd) == 0;
+    return close(fd) == 0 && ok;
+}
+
+bool LibraryStore::ReplayLog()
+{
+    std::string log;
+    char buffer[65536];
+    ssize_t got;
+    while ((got = pread(wal_fd, buffer, sizeof(buffer), static_cast<off_t>(log.size()))) != 0) {
+        if (got < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        log.append(buffer, static_cast<size_t>(got));
+    }
+
+    // A log written after another checkpoint is already in this one
+    LogHeader header;
+    if (log.size() < sizeof(header)) {
+        return ResetLog();
+    }
+    std::memcpy(&header, log.data(), sizeof(header));
+    if (std::memcmp(header.magic, LOG_MAGIC, sizeof(header.magic)) != 0 ||
+        header.generation != snapshot.generation) {
+        return ResetLog();
+    }
+
+    size_t offset = sizeof(header);
+    while (log.size() - offset >= RECORD_HEADER) {
+        uint32_t length;
+        uint32_t crc;
+        std::memcpy(&length, log.data() + offset, sizeof(length));
+        std::memcpy(&crc, log.data() + offset + sizeof(length), sizeof(crc));
+        if (length == 0 || length > log.size() - offset - RECORD_HEADER) {
+            break;
+        }
+        const char* data = log.data() + offset + RECORD_HEADER;
+        const char* end = data + length;
+        if (Checksum::Crc32c(data, length) != crc) {
+            break;
+        }
+
+        uint8_t type = static_cast<uint8_t>(*data++);
+        if (type == RECORD_PUT) {
+            Track track;
+            bool ok = true;
+            for (int f = 0; f < TEXT_FIELDS && ok; f++) {
+                ok = ReadText(data, end, track.text[f]);
+            }
+            if (!ok || static_cast<size_t>(end - data) != sizeof(track.numbers)) {
+                break;
+            }
+            std::memcpy(track.numbers.data(), data, sizeof(track.numbers));
+            ApplyPut(std::move(track));
+        } else if (type == RECORD_REMOVE) {
+            std::string path;
+            if (!ReadText(data, end, path)) {
+                break;
+            }
+            ApplyRemove(path);
+        } else {
+            break;
+        }
+        offset += RECORD_HEADER + length;
+        log_records++;
+    }
+
+    // Whatever follows the last whole record was torn by a crash
+    if (offset < log.size() && ftruncate(wal_fd, static_cast<off_t>(offset)) != 0) {
+        return false;
+    }
+    log_size = offset;
+    return true;
+}
+
+bool LibraryStore::ResetLog()
+{
+    LogHeader header;
+    std::memcpy(header.magic, LOG_MAGIC, sizeof(header.magic));
+    header.generation = snapshot.generation;
+    if (ftruncate(wal_fd, 0) != 0 || !WriteAll(wal_fd, &header, sizeof(header)) || fdatasync(wal_fd) != 0) {
+        return false;
+    }
+    log_size = sizeof(header);
+    log_records = 0;
+    pending.clear();
+    return true;
+}
+
+void LibraryStore::AppendRecord(const std::string& payload)
+{
+    uint32_t length = static_cast<uint32_t>(payload.size());
+    uint32_t crc = Checksum::Crc32c(payload.data(), payload.size());
+    AppendValue(pending, &length, sizeof(length));
+    AppendValue(pending, &crc, sizeof(crc));
+    pending += payload;
+    log_records++;
+}
+
+bool LibraryStore::WriteLog()
+{
+    if (wal_fd < 0) {
+        return false;
+    }
+    if (pending.empty()) {
+        return true;
+    }
+
+    // A failed append is cut off again, so later records are not stranded
+    // behind a torn one; failing that, the next Open() drops it
+    if (!WriteAll(wal_fd, pending.data(), pending.size()) || fdatasync(wal_fd) != 0) {
+        [[maybe_unused]] int result = ftruncate(wal_fd, static_cast<off_t>(log_size));
+        return false;
+    }
+    log_size += pending.size();
+    pending.clear();
+    return true;
+}
+
+void LibraryStore::ApplyPut(Track track)
+{
+    auto it = added_paths.find(track.text[PATH]);
+    if (it != added_paths.end()) {
+        added[it->second] = std::move(track);
+        return;
+    }
+
+    uint32_t code = FindValue(PATH, track.text[PATH]);
+    if (code != NO_TRACK) {
+        Shadow(snapshot.path_rows[code]);
+    }
+    added_paths.emplace(track.text[PATH], static_cast<uint32_t>(added.size()));
+    added.push_back(std::move(track));
+    added_live.push_back(true);
+    live_count++;
+}
+
+void LibraryStore::ApplyRemove(std::string_view path)
+{
+    auto it = added_paths.find(std::string(path));
+    if (it != added_paths.end()) {
+        added_live[it->second] = false;
+        added[it->second] = Track();
+        added_paths.erase(it);
+        live_count--;
+    }
+
+    uint32_t code = FindValue(PATH, path);
+    if (code != NO_TRACK) {
+        Shadow(snapshot.path_rows[code]);
+    }
+}
+
+void LibraryStore::Shadow(uint32_t row)
+{
+    if (row >= snapshot.track_count || shadowed[row]) {
+        return;
+    }
+    shadowed[row] = true;
+    live_count--;
+
+    const uint32_t* album_rows = snapshot.album_rows;
+    uint32_t album = static_cast<uint32_t>(
+        std::upper_bound(album_rows, album_rows + snapshot.album_count + 1, row) - album_rows - 1);
+    shadowed_per_album[album]++;
+}
+
+uint32_t LibraryStore::FindValue(TextField field, std::string_view value) const
+{
+    uint32_t low = 0;
+    uint32_t high = snapshot.value_counts[field];
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        if (NameLess(GetValue(field, middle), value)) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    if (low < snapshot.value_counts[field] && GetValue(field, low) == value) {
+        return low;
+    }
+    return NO_TRACK;
+}
+
+std::string_view LibraryStore::GetValue(TextField field, uint32_t code) const
+{
+    if (code >= snapshot.value_counts[field]) {
+        return std::string_view();
+    }
+    uint32_t begin = snapshot.value_offsets[field][code];
+    uint32_t end = snapshot.value_offsets[field][code + 1];
+    if (begin > end || end > snapshot.value_bytes_size[field]) {
+        return std::string_view();
+    }
+    return std::string_view(snapshot.value_bytes[field] + begin, end - begin);
+}
+
+bool LibraryStore::IsAlbumLive(uint32_t album) const
+{
+    uint32_t rows = snapshot.album_rows[album + 1] - snapshot.album_rows[album];
+    auto it = shadowed_per_album.find(album);
+    return it == shadowed_per_album.end() || it->second < rows;
+}
+
+bool LibraryStore::TrackLess(uint32_t a, uint32_t b) const
+{
+    for (TextField field : { ARTIST, ALBUM }) {
+        int order = CompareNames(GetText(a, field), GetText(b, field));
+        if (order != 0) return order < 0;
+    }
+    for (NumberField field : { DISC, TRACK }) {
+        int64_t x = GetNumber(a, field), y = GetNumber(b, field);
+        if (x != y) return x < y;
+    }
+    for (TextField field : { TITLE, PATH }) {
+        int order = CompareNames(GetText(a, field), GetText(b, field));
+        if (order != 0) return order < 0;
+    }
+    return false;
+}
+
+}
@@ -0,0 +1,137 @@
+#ifndef __LIBRARY_STORE_HPP
+#define __LIBRARY_STORE_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace utils {
+
+// The music library on disk: every known track's tags and file facts.
+//
+// A checkpoint is one file of columns. Each text field is dictionary-encoded
+// and its dictionary sorted by name (ASCII case-folded, then exact), so code
+// order is name order. Rows are stored grouped by artist, then album, disc
+// and track number, with the first album of each artist and the first row of
+// each album alongside, so listing an artist's albums or an album's tracks
+// is a binary search and a contiguous range at any library size. The file
+// is mapped, not read: Open() checks the header and album tables, and the
+// columns are paged in as they are used.
+//
+// Changes are appended to a write-ahead log as checksummed records and
+// kept in memory over the checkpoint; Commit() makes them durable. After
+// CHECKPOINT_RECORDS of them Commit() writes a new checkpoint beside the old
+// one, renames it into place and starts the log over. A crash leaves either
+// checkpoint with its own log, and a torn record at the end of the log is
+// dropped.
+//
+// Track ids hold until the next checkpoint, string_views until the next
+// write. Not thread-safe.
+class LibraryStore {
+public:
+    enum TextField { PATH, TITLE, ARTIST, ALBUM, GENRE, TEXT_FIELDS };
+    // Seconds, positions, bytes, Unix times and a count
+    enum NumberField { DURATION, TRACK, DISC, FILE_SIZE, MODIFIED, DATE_ADDED, PLAY_COUNT, NUMBER_FIELDS };
+
+    struct Track {
+        std::array<std::string, TEXT_FIELDS> text;
+        std::array<int64_t, NUMBER_FIELDS> numbers = {};
+    };
+
+    static LibraryStore& Get();
+    ~LibraryStore();
+
+    LibraryStore(const LibraryStore&) = delete;
+    LibraryStore& operator=(const LibraryStore&) = delete;
+
+    // folder holds library.db and library.wal, and is created if missing
+    bool Open(const std::string& folder);
+    void Close();               // commits first
+    bool IsOpen() const { return wal_fd >= 0; }
+
+    // Visible at once, durable after Commit(). Put() replaces the track
+    // with the same path, and logs nothing if it is unchanged.
+    bool Put(const Track& track);
+    bool Remove(std::string_view path);
+    bool Commit();
+    bool Checkpoint();
+
+    static constexpr uint32_t NO_TRACK = UINT32_MAX;
+
+    size_t GetTrackCount() const { return live_count; }
+    uint32_t Find(std::string_view path) const;
+    std::string_view GetText(uint32_t track, TextField field) const;
+    int64_t GetNumber(uint32_t track, NumberField field) const;
+    void GetTracks(std::vector<uint32_t>& tracks) const;
+
+    // In name order; an album's tracks by disc, track number and title
+    void GetArtists(std::vector<std::string_view>& artists) const;
+    void GetAlbums(std::string_view artist, std::vector<std::string_view>& albums) const;
+    void GetAlbumTracks(std::string_view artist, std::string_view album, std::vector<uint32_t>& tracks) const;
+
+    static constexpr size_t CHECKPOINT_RECORDS = 50000;
+
+private:
+    // The mapped checkpoint
+    struct Snapshot {
+        const unsigned char* data = nullptr;
+        size_t size = 0;
+        uint64_t generation = 0;
+        uint32_t track_count = 0;
+        uint32_t album_count = 0;
+        std::array<uint32_t, TEXT_FIELDS> value_counts = {};
+        std::array<const uint32_t*, TEXT_FIELDS> value_offsets = {};   // value_counts + 1 each
+        std::array<const char*, TEXT_FIELDS> value_bytes = {};
+        std::array<uint64_t, TEXT_FIELDS> value_bytes_size = {};
+        std::array<const uint32_t*, TEXT_FIELDS> codes = {};
+        std::array<const int64_t*, NUMBER_FIELDS> numbers = {};
+        const uint32_t* path_rows = nullptr;        // by path code
+        const uint32_t* artist_albums = nullptr;    // by artist code, + 1: first album
+        const uint32_t* album_names = nullptr;      // album codes
+        const uint32_t* album_rows = nullptr;       // album_count + 1: first row
+    };
+
+    LibraryStore();
+
+    std::string folder;
+    Snapshot snapshot;
+    int wal_fd;
+    uint64_t log_size;
+    size_t log_records;
+    std::string pending;                        // records not yet written
+
+    // Changes since the checkpoint; added tracks follow its rows in id
+    std::vector<Track> added;
+    std::vector<bool> added_live;
+    std::unordered_map<std::string, uint32_t> added_paths;
+    std::vector<bool> shadowed;                 // rows removed or replaced
+    std::unordered_map<uint32_t, uint32_t> shadowed_per_album;
+    size_t live_count;
+
+    bool MapSnapshot();
+    void UnmapSnapshot();
+    void ClearChanges();
+    bool WriteSnapshot(const std::string& path, uint64_t generation) const;
+
+    bool ReplayLog();
+    bool ResetLog();
+    void AppendRecord(const std::string& payload);
+    bool WriteLog();
+
+    void ApplyPut(Track track);
+    void ApplyRemove(std::string_view path);
+    void Shadow(uint32_t row);
+
+    uint32_t FindValue(TextField field, std::string_view value) const;
+    std::string_view GetValue(TextField field, uint32_t code) const;
+    bool IsAlbumLive(uint32_t album) const;
+    bool TrackLess(uint32_t a, uint32_t b) const;
+};
+
+}
+
+#endif // __LIBRARY_STORE_HPP
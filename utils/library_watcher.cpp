@@ -0,0 +1,422 @@
+#include "library_watcher.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <filesystem>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace utils {
+
+namespace {
+
+const uint32_t WATCH_MASK = IN_CREATE | IN_CLOSE_WRITE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                            IN_DELETE_SELF | IN_ONLYDIR | IN_EXCL_UNLINK;
+
+// Room for many events per read()
+const size_t EVENT_BUFFER = 64 * 1024;
+
+std::string Join(const std::string& folder, const char* name)
+{
+    std::string path = folder;
+    if (path.empty() || path.back() != '/') {
+        path += '/';
+    }
+    return path + name;
+}
+
+std::string TrimSlash(std::string path)
+{
+    while (path.size() > 1 && path.back() == '/') {
+        path.pop_back();
+    }
+    return path;
+}
+
+}
+
+void LibraryWatcher::Batch::Add(LibraryChange change)
+{
+    // A directory change covers paths the folding below knows nothing
+    // about, so nothing before it folds with anything after
+    if (change.directory || change.kind == LibraryChange::RESCAN) {
+        latest.clear();
+        changes.push_back(std::move(change));
+        dropped.push_back(false);
+        return;
+    }
+
+    const std::string& source = change.kind == LibraryChange::MOVED ? change.old_path : change.path;
+    auto it = latest.find(source);
+    if (it != latest.end()) {
+        size_t index = it->second;
+        LibraryChange& previous = changes[index];
+        switch (change.kind) {
+        case LibraryChange::ADDED:
+            if (previous.kind == LibraryChange::REMOVED) {
+                previous.kind = LibraryChange::MODIFIED;    // replaced
+                return;
+            }
+            if (previous.kind != LibraryChange::MOVED) {
+                return;
+            }
+            break;
+        case LibraryChange::MODIFIED:
+            if (previous.kind != LibraryChange::REMOVED) {
+                return;     // added or modified already says it
+            }
+            break;
+        case LibraryChange::REMOVED:
+            if (previous.kind == LibraryChange::ADDED) {
+                dropped[index] = true;                      // never there
+                latest.erase(it);
+                return;
+            }
+            if (previous.kind == LibraryChange::MOVED) {
+                previous.kind = LibraryChange::REMOVED;     // the original went
+                previous.path = previous.old_path;
+                previous.old_path.clear();
+                latest.erase(it);
+                return;
+            }
+            previous.kind = LibraryChange::REMOVED;
+            return;
+        case LibraryChange::MOVED:
+            if (previous.kind == LibraryChange::ADDED) {
+                dropped[index] = true;
+                change.kind = LibraryChange::ADDED;
+                change.old_path.clear();
+            } else if (previous.kind == LibraryChange::MOVED) {
+                dropped[index] = true;
+                change.old_path = previous.old_path;
+            }
+            latest.erase(it);
+            if (change.kind == LibraryChange::MOVED && change.old_path == change.path) {
+                return;     // renamed and back again
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    latest[change.path] = changes.size();
+    changes.push_back(std::move(change));
+    dropped.push_back(false);
+}
+
+std::vector<LibraryChange> LibraryWatcher::Batch::Take()
+{
+    std::vector<LibraryChange> result;
+    for (size_t i = 0; i < changes.size(); i++) {
+        if (!dropped[i]) {
+            result.push_back(std::move(changes[i]));
+        }
+    }
+    changes.clear();
+    dropped.clear();
+    latest.clear();
+    return result;
+}
+
+LibraryWatcher::LibraryWatcher()
+    : inotify_fd(inotify_init1(IN_NONBLOCK | IN_CLOEXEC))
+    , wake_fd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+    , running(false)
+{
+}
+
+LibraryWatcher::~LibraryWatcher()
+{
+    Stop();
+    if (inotify_fd >= 0) {
+        close(inotify_fd);
+    }
+    if (wake_fd >= 0) {
+        close(wake_fd);
+    }
+}
+
+bool LibraryWatcher::AddRoot(const std::string& root)
+{
+    if (inotify_fd < 0) {
+        return false;
+    }
+
+    std::string folder = TrimSlash(root);
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const std::string& existing : roots) {
+        if (IsUnder(folder, existing)) {
+            return true;
+        }
+    }
+    roots.push_back(folder);
+    return WatchTree(folder, nullptr);
+}
+
+void LibraryWatcher::RemoveRoot(const std::string& root)
+{
+    std::string folder = TrimSlash(root);
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = std::find(roots.begin(), roots.end(), folder);
+    if (it != roots.end()) {
+        roots.erase(it);
+        RemoveWatches(folder);
+    }
+}
+
+std::vector<std::string> LibraryWatcher::GetRoots() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return roots;
+}
+
+bool LibraryWatcher::Start(Callback on_changes)
+{
+    if (running || inotify_fd < 0 || wake_fd < 0) {
+        return false;
+    }
+    callback = std::move(on_changes);
+    running = true;
+    thread = std::thread(&LibraryWatcher::Run, this);
+    return true;
+}
+
+void LibraryWatcher::Stop()
+{
+    if (!running) {
+        return;
+    }
+    uint64_t one = 1;
+    ssize_t written = write(wake_fd, &one, sizeof(one));
+    (void)written;
+    thread.join();
+    running = false;
+}
+
+void LibraryWatcher::Run()
+{
+    std::vector<char> buffer(EVENT_BUFFER);
+
+    for (;;) {
+        int timeout = -1;
+        if (!batch.IsEmpty() || !pending_moves.empty()) {
+            auto now = Clock::now();
+            auto deadline = std::min(batch.last_event + std::chrono::milliseconds(QUIET_MS),
+                                     batch.first_event + std::chrono::milliseconds(MAX_DELAY_MS));
+            timeout = static_cast<int>(std::max<long long>(
+                0, std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count() + 1));
+        }
+
+        pollfd fds[2] = { { inotify_fd, POLLIN, 0 }, { wake_fd, POLLIN, 0 } };
+        if (poll(fds, 2, timeout) < 0 && errno != EINTR) {
+            break;
+        }
+        if (fds[1].revents & POLLIN) {
+            break;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            ssize_t got;
+            while ((got = read(inotify_fd, buffer.data(), buffer.size())) > 0) {
+                HandleEvents(buffer.data(), static_cast<size_t>(got));
+            }
+        }
+
+        if (!batch.IsEmpty() || !pending_moves.empty()) {
+            auto now = Clock::now();
+            if (now - batch.last_event >= std::chrono::milliseconds(QUIET_MS) ||
+                now - batch.first_event >= std::chrono::milliseconds(MAX_DELAY_MS)) {
+                Flush();
+            }
+        }
+    }
+
+    // Deliver what was collected, so nothing seen is lost on shutdown
+    Flush();
+}
+
+void LibraryWatcher::HandleEvents(const char* data, size_t size)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (batch.IsEmpty() && pending_moves.empty()) {
+        batch.first_event = Clock::now();
+    }
+    batch.last_event = Clock::now();
+
+    for (size_t offset = 0; offset < size;) {
+        const inotify_event* event = reinterpret_cast<const inotify_event*>(data + offset);
+        offset += sizeof(inotify_event) + event->len;
+
+        if (event->mask & IN_Q_OVERFLOW) {
+            // Events were dropped; the only way back is to look again
+            writing.clear();
+            for (const std::string& root : roots) {
+                batch.Add(LibraryChange{ LibraryChange::RESCAN, root, std::string(), true });
+            }
+            continue;
+        }
+
+        auto folder = directories.find(event->wd);
+        if (folder == directories.end()) {
+            continue;
+        }
+        if (event->mask & (IN_IGNORED | IN_DELETE_SELF)) {
+            if (event->mask & IN_IGNORED) {
+                directories.erase(folder);
+            }
+            continue;
+        }
+        if (event->len == 0) {
+            continue;
+        }
+
+        std::string path = Join(folder->second, event->name);
+        bool directory = (event->mask & IN_ISDIR) != 0;
+
+        if (event->mask & IN_CREATE) {
+            if (directory) {
+                // Files may land in it before its watch exists; the scan
+                // reports those
+                WatchTree(path, &batch);
+            } else {
+                writing.insert(path);
+            }
+        } else if (event->mask & IN_CLOSE_WRITE) {
+            bool created = writing.erase(path) > 0;
+            batch.Add(LibraryChange{ created ? LibraryChange::ADDED : LibraryChange::MODIFIED, path,
+                                     std::string(), false });
+        } else if (event->mask & IN_DELETE) {
+            writing.erase(path);
+            batch.Add(LibraryChange{ LibraryChange::REMOVED, path, std::string(), directory });
+        } else if (event->mask & IN_MOVED_FROM) {
+            if (!directory || early_moves.erase(path) == 0) {
+                pending_moves[event->cookie] = PendingMove{ path, directory };
+            }
+        } else if (event->mask & IN_MOVED_TO) {
+            auto move = pending_moves.find(event->cookie);
+            if (move != pending_moves.end()) {
+                if (writing.erase(move->second.path) > 0) {
+                    writing.insert(path);
+                }
+                if (directory) {
+                    MoveWatches(move->second.path, path);
+                }
+                batch.Add(LibraryChange{ LibraryChange::MOVED, path, move->second.path, directory });
+                pending_moves.erase(move);
+            } else if (directory) {
+                WatchTree(path, &batch);
+            } else {
+                batch.Add(LibraryChange{ LibraryChange::ADDED, path, std::string(), false });
+            }
+        }
+    }
+}
+
+void LibraryWatcher::Flush()
+{
+    std::vector<LibraryChange> changes;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        // A move whose other half never came left the watched folders
+        for (auto& [cookie, move] : pending_moves) {
+            writing.erase(move.path);
+            if (move.directory) {
+                RemoveWatches(move.path);
+            }
+            batch.Add(LibraryChange{ LibraryChange::REMOVED, move.path, std::string(), move.directory });
+        }
+        pending_moves.clear();
+        early_moves.clear();
+        changes = batch.Take();
+    }
+    if (!changes.empty() && callback) {
+        callback(std::move(changes));
+    }
+}
+
+bool LibraryWatcher::WatchTree(const std::string& folder, Batch* report)
+{
+    WatchResult result = WatchFolder(folder, report);
+    if (result != WATCH_ADDED) {
+        return result == WATCH_MOVED;
+    }
+
+    bool ok = true;
+    std::error_code error;
+    std::filesystem::recursive_directory_iterator it(
+        folder, std::filesystem::directory_options::skip_permission_denied, error);
+    for (; !error && it != std::filesystem::recursive_directory_iterator(); it.increment(error)) {
+        std::string path = it->path().string();
+        if (it->is_directory(error)) {
+            result = WatchFolder(path, report);
+            if (result != WATCH_ADDED) {
+                ok = ok && result == WATCH_MOVED;
+                it.disable_recursion_pending();
+            }
+        } else if (report && it->is_regular_file(error)) {
+            report->Add(LibraryChange{ LibraryChange::ADDED, path, std::string(), false });
+        }
+    }
+    return ok && !error;
+}
+
+LibraryWatcher::WatchResult LibraryWatcher::WatchFolder(const std::string& folder, Batch* report)
+{
+    int wd = inotify_add_watch(inotify_fd, folder.c_str(), WATCH_MASK);
+    if (wd < 0) {
+        return WATCH_FAILED;
+    }
+
+    // The kernel hands back the existing watch for a folder it already
+    // watches: one moved here before the watch on its new parent existed,
+    // so only its old parent saw the move
+    auto known = directories.find(wd);
+    if (known != directories.end() && known->second != folder) {
+        std::string from = known->second;
+        MoveWatches(from, folder);
+        if (report) {
+            for (auto move = pending_moves.begin(); move != pending_moves.end(); ++move) {
+                if (move->second.path == from) {
+                    pending_moves.erase(move);
+                    break;
+                }
+            }
+            report->Add(LibraryChange{ LibraryChange::MOVED, folder, from, true });
+            early_moves.insert(from);
+        }
+        return WATCH_MOVED;
+    }
+    directories[wd] = folder;
+    return WATCH_ADDED;
+}
+
+void LibraryWatcher::MoveWatches(const std::string& from, const std::string& to)
+{
+    for (auto& [wd, folder] : directories) {
+        if (IsUnder(folder, from)) {
+            folder = to + folder.substr(from.size());
+        }
+    }
+}
+
+void LibraryWatcher::RemoveWatches(const std::string& folder)
+{
+    for (auto it = directories.begin(); it != directories.end();) {
+        if (IsUnder(it->second, folder)) {
+            inotify_rm_watch(inotify_fd, it->first);
+            it = directories.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+bool LibraryWatcher::IsUnder(const std::string& path, const std::string& folder)
+{
+    return path.size() >= folder.size() && path.compare(0, folder.size(), folder) == 0 &&
+           (path.size() == folder.size() || path[folder.size()] == '/' || folder == "/");
+}
+
+}
@@ -0,0 +1,126 @@
+#ifndef __LIBRARY_WATCHER_HPP
+#define __LIBRARY_WATCHER_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace utils {
+
+// One change under a watched folder. Additions are always reported file by
+// file; a REMOVED or MOVED directory stands for everything below it.
+struct LibraryChange {
+    enum Kind {
+        ADDED,          // a file finished being written, or was moved in
+        MODIFIED,       // rewritten in place, or replaced by another file
+        REMOVED,        // deleted, or moved out of the watched folders
+        MOVED,          // renamed within the watched folders
+        RESCAN          // events were lost; path is a root to check again
+    };
+
+    Kind kind;
+    std::string path;
+    std::string old_path;   // MOVED only
+    bool directory;
+};
+
+// Watches library folders with inotify and reports what changed in batches.
+//
+// Every folder under a root gets a watch; folders created or moved in are
+// watched as they appear, and their files reported. A file counts as added
+// once it is closed after writing, not when it is created, so a copy in
+// progress is reported once, complete. The two halves of a rename are
+// paired by cookie into one MOVED, so a track keeps its data when it is
+// renamed or its folder is.
+//
+// Events collect into a batch until none have arrived for QUIET_MS, or for
+// at most MAX_DELAY_MS after the first; within a batch a path's changes
+// are folded together (created then deleted is nothing, deleted then
+// re-created is MODIFIED). Copying thousands of files therefore comes out
+// as a few batches rather than an update per file. Batches go to the
+// callback on the watcher thread, in event order. Nothing is ever
+// rescanned except a root after the kernel's event queue overflowed.
+class LibraryWatcher {
+public:
+    using Callback = std::function<void(std::vector<LibraryChange>&& changes)>;
+
+    LibraryWatcher();
+    ~LibraryWatcher();
+
+    LibraryWatcher(const LibraryWatcher&) = delete;
+    LibraryWatcher& operator=(const LibraryWatcher&) = delete;
+
+    // False if inotify is unavailable or some folder could not be watched
+    // (see /proc/sys/fs/inotify/max_user_watches); the rest are watched
+    bool AddRoot(const std::string& root);
+    void RemoveRoot(const std::string& root);
+    std::vector<std::string> GetRoots() const;
+
+    bool Start(Callback callback);
+    void Stop();
+
+    static constexpr int QUIET_MS = 300;
+    static constexpr int MAX_DELAY_MS = 2000;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // Changes of the batch being collected, folded per path
+    struct Batch {
+        std::vector<LibraryChange> changes;
+        std::vector<bool> dropped;
+        std::unordered_map<std::string, size_t> latest;     // path -> its last change
+        Clock::time_point first_event;
+        Clock::time_point last_event;
+
+        void Add(LibraryChange change);
+        bool IsEmpty() const { return changes.empty(); }
+        std::vector<LibraryChange> Take();
+    };
+
+    struct PendingMove {
+        std::string path;
+        bool directory;
+    };
+
+    int inotify_fd;
+    int wake_fd;
+    std::thread thread;
+    bool running;
+    Callback callback;
+
+    // Watch bookkeeping, shared with the thread
+    mutable std::mutex mutex;
+    std::vector<std::string> roots;
+    std::unordered_map<int, std::string> directories;   // watch descriptor -> folder
+
+    // Thread state
+    Batch batch;
+    std::unordered_map<uint32_t, PendingMove> pending_moves;   // by cookie
+    std::unordered_set<std::string> writing;                   // created, not yet closed
+    std::unordered_set<std::string> early_moves;               // reported before their IN_MOVED_FROM
+
+    void Run();
+    void HandleEvents(const char* data, size_t size);
+    void Flush();
+
+    enum WatchResult { WATCH_FAILED, WATCH_ADDED, WATCH_MOVED };
+
+    // With mutex held; files found are reported ADDED when batch is given
+    bool WatchTree(const std::string& folder, Batch* report);
+    WatchResult WatchFolder(const std::string& folder, Batch* report);
+    void MoveWatches(const std::string& from, const std::string& to);
+    void RemoveWatches(const std::string& folder);
+
+    static bool IsUnder(const std::string& path, const std::string& folder);
+};
+
+}
+
+#endif // __LIBRARY_WATCHER_HPP
@@ -0,0 +1,98 @@
+#include "mapped_file.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace utils {
+
+namespace {
+
+const size_t PAGE_ALIGNMENT = 4096;
+
+}
+
+MappedFile::MappedFile(const std::string& path)
+    : fd(open(path.c_str(), O_RDONLY))
+    , size(0)
+    , offset(0)
+    , mapping(nullptr)
+    , buffer(nullptr)
+    , failed(false)
+{
+    struct stat info;
+    if (fd < 0) {
+        return;
+    }
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        fd = -1;
+        return;
+    }
+    size = static_cast<uint64_t>(info.st_size);
+
+    if (size > 0 && size <= SIZE_MAX) {
+        void* mapped = mmap(nullptr, static_cast<size_t>(size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped != MAP_FAILED) {
+            madvise(mapped, static_cast<size_t>(size), MADV_SEQUENTIAL);
+            mapping = static_cast<unsigned char*>(mapped);
+            return;
+        }
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    buffer = static_cast<unsigned char*>(std::aligned_alloc(PAGE_ALIGNMENT, BLOCK_SIZE));
+    if (!buffer) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+MappedFile::~MappedFile()
+{
+    if (mapping) {
+        munmap(mapping, static_cast<size_t>(size));
+    }
+    std::free(buffer);
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+bool MappedFile::Next(const unsigned char*& data, size_t& length)
+{
+    if (fd < 0 || failed) {
+        return false;
+    }
+
+    if (mapping) {
+        if (offset >= size) {
+            return false;
+        }
+        data = mapping + offset;
+        length = static_cast<size_t>(std::min<uint64_t>(BLOCK_SIZE, size - offset));
+        offset += length;
+        return true;
+    }
+
+    // Fill the whole block unless the file ends, so block sizes do not
+    // depend on how the kernel splits reads
+    length = 0;
+    while (length < BLOCK_SIZE) {
+        ssize_t got = read(fd, buffer + length, BLOCK_SIZE - length);
+        if (got < 0) {
+            failed = true;
+            return false;
+        }
+        if (got == 0) {
+            break;
+        }
+        length += static_cast<size_t>(got);
+    }
+    data = buffer;
+    offset += length;
+    return length > 0;
+}
+
+}
@@ -0,0 +1,47 @@
+#ifndef __MAPPED_FILE_HPP
+#define __MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace utils {
+
+// One front-to-back pass over a file's contents at page cache speed.
+//
+// The file is mapped read-only and advised MADV_SEQUENTIAL, so the kernel
+// reads ahead and frees pages behind and no byte is copied. Next() hands
+// the mapping out BLOCK_SIZE bytes at a time, so a caller that stops early
+// never faults in the rest. Files that cannot be mapped are read with
+// BLOCK_SIZE reads into a page-aligned buffer instead; Next() returns
+// blocks of the same sizes either way.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool IsOk() const { return fd >= 0; }
+    uint64_t GetSize() const { return size; }
+
+    // The next block, valid until the following call; false at the end
+    // or on a read error
+    bool Next(const unsigned char*& data, size_t& length);
+    bool HasFailed() const { return failed; }
+
+    static constexpr size_t BLOCK_SIZE = 1 << 20;
+
+private:
+    int fd;
+    uint64_t size;
+    uint64_t offset;
+    unsigned char* mapping;
+    unsigned char* buffer;
+    bool failed;
+};
+
+}
+
+#endif // __MAPPED_FILE_HPP
@@ -0,0 +1,196 @@
+#include "multi_key_sort.hpp"
+#include "natural_sort.hpp"
+#include <algorithm>
+#include <bit>
+
+namespace utils {
+
+namespace {
+
+// Where one key lives in the packed words
+struct Field {
+    const MultiKeySort::Key* key;
+    uint64_t min;
+    uint64_t range;
+    size_t word;            // 0 is the least significant
+    int shift;
+};
+
+struct Entry {
+    uint64_t packed;
+    uint32_t row;
+};
+
+// Stable LSD radix sort of entries on packed, bits wide
+void RadixSort(std::vector<Entry>& entries, std::vector<Entry>& scratch, int bits)
+{
+    const size_t count = entries.size();
+    const size_t passes = (static_cast<size_t>(bits) + 7) / 8;
+    std::vector<size_t> counts(passes * 256, 0);
+    for (const Entry& entry : entries) {
+        for (size_t b = 0; b < passes; b++) {
+            counts[b * 256 + ((entry.packed >> (8 * b)) & 0xFF)]++;
+        }
+    }
+
+    for (size_t b = 0; b < passes; b++) {
+        size_t* pass_counts = &counts[b * 256];
+        // A byte that is the same in every entry needs no pass
+        if (pass_counts[(entries[0].packed >> (8 * b)) & 0xFF] == count) {
+            continue;
+        }
+        size_t total = 0;
+        for (size_t v = 0; v < 256; v++) {
+            size_t n = pass_counts[v];
+            pass_counts[v] = total;
+            total += n;
+        }
+        for (const Entry& entry : entries) {
+            scratch[pass_counts[(entry.packed >> (8 * b)) & 0xFF]++] = entry;
+        }
+        entries.swap(scratch);
+    }
+}
+
+}
+
+void MultiKeySort::Sort(const std::vector<Key>& keys, std::vector<uint32_t>& order)
+{
+    const size_t rows = keys.empty() ? order.size() : keys[0].values.size();
+    if (order.size() != rows) {
+        order.resize(rows);
+        for (size_t i = 0; i < rows; i++) {
+            order[i] = static_cast<uint32_t>(i);
+        }
+    }
+    if (rows < 2) {
+        return;
+    }
+
+    // Lay the keys out from the last (least significant) upwards; a key
+    // that no longer fits in the current word starts the next one.
+    // Constant keys cannot change the order and take no bits.
+    std::vector<Field> fields;
+    std::vector<int> word_bits(1, 0);
+    for (auto key = keys.rbegin(); key != keys.rend(); ++key) {
+        auto [low, high] = std::minmax_element(key->values.begin(), key->values.end());
+        uint64_t range = *high - *low;
+        if (range == 0) {
+            continue;
+        }
+        int bits = std::bit_width(range);
+        if (word_bits.back() + bits > 64) {
+            word_bits.push_back(0);
+        }
+        fields.push_back({ &*key, *low, range, word_bits.size() - 1, word_bits.back() });
+        word_bits.back() += bits;
+    }
+    if (fields.empty()) {
+        return;
+    }
+
+    // One word at a time, least significant first, each sort stable on
+    // the order the previous one left
+    std::vector<Entry> entries(rows);
+    std::vector<Entry> scratch(rows);
+    for (size_t word = 0; word < word_bits.size(); word++) {
+        for (size_t i = 0; i < rows; i++) {
+            entries[i] = { 0, order[i] };
+        }
+        for (const Field& field : fields) {
+            if (field.word != word) {
+                continue;
+            }
+            const uint64_t* values = field.key->values.data();
+            for (Entry& entry : entries) {
+                uint64_t value = values[entry.row] - field.min;
+                if (!field.key->ascending) {
+                    value = field.range - value;
+                }
+                entry.packed |= value << field.shift;
+            }
+        }
+
+        RadixSort(entries, scratch, word_bits[word]);
+        for (size_t i = 0; i < rows; i++) {
+            order[i] = entries[i].row;
+        }
+    }
+}
+
+void MultiKeySort::Resort(const std::vector<Key>& keys, const std::vector<uint32_t>& changed,
+                          std::vector<uint32_t>& order)
+{
+    const size_t rows = order.size();
+    std::vector<uint32_t> position(rows);
+    std::vector<bool> is_changed(rows, false);
+    for (size_t i = 0; i < rows; i++) {
+        position[order[i]] = static_cast<uint32_t>(i);
+    }
+
+    std::vector<uint32_t> moved;
+    for (uint32_t row : changed) {
+        if (row < rows && !is_changed[row]) {
+            is_changed[row] = true;
+            moved.push_back(row);
+        }
+    }
+
+    auto less = [&](uint32_t a, uint32_t b) {
+        for (const Key& key : keys) {
+            uint64_t value_a = key.values[a];
+            uint64_t value_b = key.values[b];
+            if (value_a != value_b) {
+                return key.ascending ? value_a < value_b : value_a > value_b;
+            }
+        }
+        return position[a] < position[b];
+    };
+    std::sort(moved.begin(), moved.end(), less);
+
+    std::vector<uint32_t> kept;
+    kept.reserve(rows - moved.size());
+    for (uint32_t row : order) {
+        if (!is_changed[row]) {
+            kept.push_back(row);
+        }
+    }
+    std::merge(kept.begin(), kept.end(), moved.begin(), moved.end(), order.begin(), less);
+}
+
+SortDictionary::SortDictionary()
+    : ranks_valid(false)
+{
+    Add("");
+}
+
+uint32_t SortDictionary::Add(std::string_view text)
+{
+    auto [it, added] = ids.try_emplace(NaturalSort::MakeKey(text), static_cast<uint32_t>(ids.size()));
+    if (added) {
+        ranks_valid = false;
+    }
+    return it->second;
+}
+
+const std::vector<uint32_t>& SortDictionary::GetRanks()
+{
+    if (!ranks_valid) {
+        ranks.resize(ids.size());
+        uint32_t rank = 0;
+        for (const auto& [key, id] : ids) {
+            ranks[id] = rank++;
+        }
+        ranks_valid = true;
+    }
+    return ranks;
+}
+
+void SortDictionary::Clear()
+{
+    ids.clear();
+    ranks_valid = false;
+    Add("");
+}
+
+}
@@ -0,0 +1,62 @@
+#ifndef __MULTI_KEY_SORT_HPP
+#define __MULTI_KEY_SORT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace utils {
+
+// Stable sort of table rows by several integer columns at once.
+//
+// Each column is shifted to start at zero, trimmed to the bits its range
+// needs and, when descending, complemented within them; the columns are
+// then packed side by side into 64-bit words, the first key in the most
+// significant bits. An LSD radix sort over those words orders by every key
+// in one go, skipping bytes that no row differs in. Text columns take part
+// as ranks, see SortDictionary.
+//
+// Resort() repairs an order after a few rows changed: only those rows are
+// sorted, by comparison, and merged back among the others.
+class MultiKeySort {
+public:
+    struct Key {
+        std::vector<uint64_t> values;       // one per row
+        bool ascending;
+    };
+
+    // order holds the rows in their current sequence (or is empty for
+    // 0..n-1) and receives them sorted; rows that tie keep that sequence
+    static void Sort(const std::vector<Key>& keys, std::vector<uint32_t>& order);
+
+    // order must already be sorted by keys apart from the rows in changed
+    static void Resort(const std::vector<Key>& keys, const std::vector<uint32_t>& changed,
+                       std::vector<uint32_t>& order);
+};
+
+// Distinct strings with stable ids and their rank in natural order.
+//
+// A row stores the id of its string, so a text column becomes a rank column
+// by one lookup per row. Adding a string only marks the ranks stale; they
+// are recounted, once per distinct string, when next asked for. Ids are
+// never reused until Clear(); the empty string is always id 0.
+class SortDictionary {
+public:
+    SortDictionary();
+
+    uint32_t Add(std::string_view text);        // id of text, added if new
+    const std::vector<uint32_t>& GetRanks();    // rank by id
+    void Clear();
+
+private:
+    std::map<std::string, uint32_t> ids;        // by natural sort key
+    std::vector<uint32_t> ranks;
+    bool ranks_valid;
+};
+
+}
+
+#endif // __MULTI_KEY_SORT_HPP
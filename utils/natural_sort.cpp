@@ -0,0 +1,235 @@
+#include "natural_sort.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <thread>
+
+namespace utils {
+
+namespace {
+
+// Below every text byte, so "track 2" sorts before "track 2b" and "track a"
+const char DIGIT_MARKER = '\x01';
+
+// U+00C0..U+00FF without accents; null keeps the character (the
+// multiplication and division signs)
+const char* const LATIN1_FOLDS[64] = {
+    "a", "a", "a", "a", "a", "a", "ae", "c", "e", "e", "e", "e", "i", "i", "i", "i",
+    "d", "n", "o", "o", "o", "o", "o", nullptr, "o", "u", "u", "u", "u", "y", "th", "ss",
+    "a", "a", "a", "a", "a", "a", "ae", "c", "e", "e", "e", "e", "i", "i", "i", "i",
+    "d", "n", "o", "o", "o", "o", "o", nullptr, "o", "u", "u", "u", "u", "y", "th", "y",
+};
+
+const size_t PREFIX_BYTES = 8;
+
+// Runs shorter than this sort by comparison instead of another radix level
+const size_t MIN_RADIX_RUN = 64;
+
+struct Entry {
+    uint64_t prefix;        // PREFIX_BYTES key bytes from the current depth
+    uint32_t index;
+};
+
+struct SortContext {
+    const std::vector<std::string>* keys;
+    bool ascending;
+};
+
+// Big-endian and zero-padded; keys never hold a zero byte, so a key that
+// is a prefix of another stays in front of it. Complemented when sorting
+// descending.
+uint64_t LoadPrefix(const std::string& key, size_t depth, bool ascending)
+{
+    uint64_t prefix = 0;
+    for (size_t i = depth; i < key.size() && i < depth + PREFIX_BYTES; i++) {
+        prefix |= static_cast<uint64_t>(static_cast<unsigned char>(key[i])) << (56 - 8 * (i - depth));
+    }
+    return ascending ? prefix : ~prefix;
+}
+
+// Key order from depth onwards, then input position
+struct EntryLess {
+    const SortContext* context;
+    size_t depth;
+
+    bool operator()(const Entry& a, const Entry& b) const
+    {
+        std::string_view key_a = (*context->keys)[a.index];
+        std::string_view key_b = (*context->keys)[b.index];
+        int order = key_a.substr(std::min(key_a.size(), depth)).compare(key_b.substr(std::min(key_b.size(), depth)));
+        if (order != 0) {
+            return context->ascending ? order < 0 : order > 0;
+        }
+        return a.index < b.index;
+    }
+};
+
+// MSD over eight-byte digits: an LSD radix sort on the entries' current
+// prefixes, then the same again one digit deeper within each run that
+// shares them. Entries arrive in input order, and every pass is stable.
+void SortRange(Entry* data, Entry* scratch, size_t count, size_t depth, const SortContext& context)
+{
+    if (count < MIN_RADIX_RUN) {
+        std::sort(data, data + count, EntryLess{ &context, depth });
+        return;
+    }
+
+    // A byte that is the same in every prefix needs no pass
+    size_t counts[PREFIX_BYTES][256] = {};
+    for (size_t i = 0; i < count; i++) {
+        for (size_t b = 0; b < PREFIX_BYTES; b++) {
+            counts[b][(data[i].prefix >> (8 * b)) & 0xFF]++;
+        }
+    }
+
+    Entry* from = data;
+    Entry* to = scratch;
+    for (size_t b = 0; b < PREFIX_BYTES; b++) {
+        if (counts[b][(from[0].prefix >> (8 * b)) & 0xFF] == count) {
+            continue;
+        }
+        size_t offsets[256];
+        size_t total = 0;
+        for (size_t v = 0; v < 256; v++) {
+            offsets[v] = total;
+            total += counts[b][v];
+        }
+        for (size_t i = 0; i < count; i++) {
+            to[offsets[(from[i].prefix >> (8 * b)) & 0xFF]++] = from[i];
+        }
+        std::swap(from, to);
+    }
+    if (from != data) {
+        std::copy(from, from + count, data);
+    }
+
+    const size_t next_depth = depth + PREFIX_BYTES;
+    for (size_t i = 0; i < count;) {
+        size_t j = i + 1;
+        while (j < count && data[j].prefix == data[i].prefix) {
+            j++;
+        }
+
+        // Keys that all end within this digit are equal and already in
+        // input order
+        bool longer = false;
+        for (size_t k = i; k < j && !longer; k++) {
+            longer = (*context.keys)[data[k].index].size() > next_depth;
+        }
+        if (j - i > 1 && longer) {
+            for (size_t k = i; k < j; k++) {
+                data[k].prefix = LoadPrefix((*context.keys)[data[k].index], next_depth, context.ascending);
+            }
+            SortRange(data + i, scratch + i, j - i, next_depth, context);
+        }
+        i = j;
+    }
+}
+
+}
+
+std::string NaturalSort::MakeKey(std::string_view text)
+{
+    std::string key;
+    key.reserve(text.size() + 8);
+    AppendKey(text, key);
+    return key;
+}
+
+void NaturalSort::AppendKey(std::string_view text, std::string& key)
+{
+    size_t i = 0;
+    while (i < text.size()) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+
+        if (c >= '0' && c <= '9') {
+            size_t start = i;
+            while (i < text.size() && text[i] >= '0' && text[i] <= '9') {
+                i++;
+            }
+            while (start + 1 < i && text[start] == '0') {
+                start++;
+            }
+            size_t digits = std::min<size_t>(i - start, 255);
+            key.push_back(DIGIT_MARKER);
+            key.push_back(static_cast<char>(digits));
+            key.append(text.substr(start, digits));
+            continue;
+        }
+
+        if (c == 0xC3 && i + 1 < text.size() && (static_cast<unsigned char>(text[i + 1]) & 0xC0) == 0x80) {
+            const char* fold = LATIN1_FOLDS[static_cast<unsigned char>(text[i + 1]) - 0x80];
+            if (fold) {
+                key.append(fold);
+                i += 2;
+                continue;
+            }
+        }
+
+        if (c >= 'A' && c <= 'Z') {
+            key.push_back(static_cast<char>(c - 'A' + 'a'));
+        } else if (c < 0x20) {
+            key.push_back(' ');
+        } else {
+            key.push_back(static_cast<char>(c));
+        }
+        i++;
+    }
+}
+
+int NaturalSort::Compare(std::string_view a, std::string_view b)
+{
+    return MakeKey(a).compare(MakeKey(b));
+}
+
+void NaturalSort::Sort(const std::vector<std::string>& keys, std::vector<uint32_t>& order, bool ascending)
+{
+    const size_t count = keys.size();
+    std::vector<Entry> entries(count);
+    std::vector<Entry> scratch(count);
+    for (size_t i = 0; i < count; i++) {
+        entries[i] = { LoadPrefix(keys[i], 0, ascending), static_cast<uint32_t>(i) };
+    }
+
+    const SortContext context = { &keys, ascending };
+    size_t parts = count >= PARALLEL_MIN_KEYS ? std::max(1u, std::thread::hardware_concurrency()) : 1;
+    if (parts == 1) {
+        SortRange(entries.data(), scratch.data(), count, 0, context);
+    } else {
+        std::vector<size_t> bounds(parts + 1);
+        for (size_t p = 0; p <= parts; p++) {
+            bounds[p] = count * p / parts;
+        }
+
+        ThreadPool pool(parts);
+        for (size_t p = 0; p < parts; p++) {
+            pool.Submit([&, p] {
+                SortRange(entries.data() + bounds[p], scratch.data() + bounds[p], bounds[p + 1] - bounds[p], 0, context);
+            });
+        }
+        pool.WaitIdle();
+
+        // Merge neighbouring parts pairwise, each level in parallel
+        const EntryLess less = { &context, 0 };
+        for (size_t width = 1; width < parts; width *= 2) {
+            for (size_t p = 0; p + width < parts; p += 2 * width) {
+                size_t begin = bounds[p];
+                size_t middle = bounds[p + width];
+                size_t end = bounds[std::min(p + 2 * width, parts)];
+                pool.Submit([&, begin, middle, end] {
+                    std::merge(entries.begin() + begin, entries.begin() + middle,
+                               entries.begin() + middle, entries.begin() + end,
+                               scratch.begin() + begin, less);
+                    std::copy(scratch.begin() + begin, scratch.begin() + end, entries.begin() + begin);
+                });
+            }
+            pool.WaitIdle();
+        }
+    }
+
+    order.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        order[i] = entries[i].index;
+    }
+}
+
+}
@@ -0,0 +1,43 @@
+#ifndef __NATURAL_SORT_HPP
+#define __NATURAL_SORT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace utils {
+
+// Natural ordering ("Track 2" before "Track 10") through binary sort keys.
+//
+// A key is built once per string, after which plain byte comparison of two
+// keys gives the natural order of the strings: ASCII and Latin-1 letters
+// are case- and accent-folded (so "Édith" files with "edith"), and a digit
+// run becomes a marker below any text, its length and its digits without
+// leading zeros, so longer numbers sort after shorter ones. Other text
+// compares by code point; callers lowercase it beforehand when it matters.
+//
+// Sort() orders a batch of keys mostly without comparing them: a radix sort
+// on eight key bytes at a time, going a digit deeper only within runs that
+// share the current one, and comparisons only for small runs.
+class NaturalSort {
+public:
+    static std::string MakeKey(std::string_view text);
+    static void AppendKey(std::string_view text, std::string& key);
+
+    // <0, 0 or >0 as a sorts before, with or after b
+    static int Compare(std::string_view a, std::string_view b);
+
+    // Indices of keys in sorted order; ties keep their input order.
+    // Batches of PARALLEL_MIN_KEYS or more are split across the hardware
+    // threads and merged.
+    static void Sort(const std::vector<std::string>& keys, std::vector<uint32_t>& order,
+                     bool ascending = true);
+
+    static const size_t PARALLEL_MIN_KEYS = 1 << 16;
+};
+
+}
+
+#endif // __NATURAL_SORT_HPP
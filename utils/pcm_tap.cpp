@@ -0,0 +1,88 @@
+#include "pcm_tap.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace utils {
+
+PcmTap::PcmTap(size_t capacity_frames)
+    : mask(0)
+    , generation(0)
+    , start_frame(0)
+    , write_frame(0)
+    , reserve_frame(0)
+    , sample_rate(0)
+{
+    // Round up to a power of two so positions wrap with a mask
+    size_t capacity = 1024;
+    while (capacity < capacity_frames) {
+        capacity *= 2;
+    }
+    ring.assign(capacity, 0.0f);
+    mask = capacity - 1;
+}
+
+void PcmTap::Reset(long long start, int rate)
+{
+    generation.fetch_add(1, std::memory_order_acq_rel);
+    start_frame.store(start, std::memory_order_relaxed);
+    write_frame.store(start, std::memory_order_relaxed);
+    reserve_frame.store(start, std::memory_order_relaxed);
+    sample_rate.store(rate, std::memory_order_relaxed);
+    generation.fetch_add(1, std::memory_order_release);
+}
+
+void PcmTap::Write(const float* mono, size_t frames)
+{
+    long long position = write_frame.load(std::memory_order_relaxed);
+    size_t offset = static_cast<size_t>(position) & mask;
+
+    // Announce the slots about to be overwritten before touching them
+    reserve_frame.store(position + static_cast<long long>(frames), std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    // At most two contiguous pieces
+    size_t first = std::min(frames, ring.size() - offset);
+    std::memcpy(&ring[offset], mono, first * sizeof(float));
+    if (first < frames) {
+        std::memcpy(ring.data(), mono + first, (frames - first) * sizeof(float));
+    }
+
+    write_frame.store(position + static_cast<long long>(frames), std::memory_order_release);
+}
+
+bool PcmTap::Snapshot(long long end_frame, float* dest, size_t frames) const
+{
+    if (frames == 0 || frames > ring.size()) {
+        return false;
+    }
+
+    unsigned gen = generation.load(std::memory_order_acquire);
+    if (gen & 1) {
+        return false;
+    }
+
+    long long written = write_frame.load(std::memory_order_acquire);
+    long long begin = end_frame - static_cast<long long>(frames);
+    long long oldest = std::max(start_frame.load(std::memory_order_acquire),
+                                written - static_cast<long long>(ring.size()));
+    if (begin < oldest || end_frame > written) {
+        return false;
+    }
+
+    size_t offset = static_cast<size_t>(begin) & mask;
+    size_t first = std::min(frames, ring.size() - offset);
+    std::memcpy(dest, &ring[offset], first * sizeof(float));
+    if (first < frames) {
+        std::memcpy(dest + first, ring.data(), (frames - first) * sizeof(float));
+    }
+
+    // Validate that the producer did not overwrite the range while copying
+    std::atomic_thread_fence(std::memory_order_acquire);
+    long long reserved = reserve_frame.load(std::memory_order_relaxed);
+    if (generation.load(std::memory_order_relaxed) != gen) {
+        return false;
+    }
+    return begin >= reserved - static_cast<long long>(ring.size());
+}
+
+}
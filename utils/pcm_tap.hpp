@@ -0,0 +1,43 @@
+#ifndef __PCM_TAP_HPP
+#define __PCM_TAP_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace utils {
+
+// Lock-free history of decoded audio (mono mixdown) indexed by absolute frame.
+//
+// One producer thread appends frames; any number of readers copy out a window
+// ending at a given frame. Readers never block the producer: a snapshot that
+// raced with an overwrite or a Reset() is detected and reported as failed.
+class PcmTap {
+public:
+    explicit PcmTap(size_t capacity_frames = 1 << 17);
+
+    // Producer side
+    void Reset(long long start_frame, int sample_rate);
+    void Write(const float* mono, size_t frames);
+
+    // Reader side
+    bool Snapshot(long long end_frame, float* dest, size_t frames) const;
+    long long GetWriteFrame() const { return write_frame.load(std::memory_order_acquire); }
+    long long GetStartFrame() const { return start_frame.load(std::memory_order_acquire); }
+    int GetSampleRate() const { return sample_rate.load(std::memory_order_relaxed); }
+    size_t GetCapacity() const { return ring.size(); }
+
+private:
+    std::vector<float> ring;
+    size_t mask;
+
+    std::atomic<unsigned> generation;   // odd while a Reset() is in progress
+    std::atomic<long long> start_frame;
+    std::atomic<long long> write_frame;
+    std::atomic<long long> reserve_frame;  // end of the write in progress
+    std::atomic<int> sample_rate;
+};
+
+}
+
+#endif // __PCM_TAP_HPP
@@ -1,5 +1,6 @@
 #include "performance_utils.hpp"
 #include "log_utils.hpp"
+#include "art_cache.hpp"
 #include <wx/utils.h>
 #include <wx/string.h>
 #include <wx/textfile.h>
@@ -317,14 +318,14 @@ wxString PerformanceUtils::GetSystemInfo()
 
 void PerformanceUtils::ClearAllCaches()
 {
-    // Clear various caches - this is application-specific
+    // Album art is the cache bounded by max_cache_size
+    ArtCache::Get().Clear();
     LogUtils::LogInfo("Caches cleared");
 }
 
 size_t PerformanceUtils::GetCacheMemoryUsage()
 {
-    // Return estimated cache memory usage
-    return 0; // Not implemented
+    return ArtCache::Get().GetMemoryUsage();
 }
 
 void PerformanceUtils::SetMaxCacheSize(size_t max_size_bytes)
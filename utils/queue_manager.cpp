@@ -29,6 +29,40 @@ void QueueManager::GenerateShuffleOrder(size_t queue_size) const
     current_shuffle_pos = 0;
 }
 
+void QueueManager::RemoveFromShuffleOrder(const std::vector<bool>& removed) const
+{
+    if (shuffle_indices.size() != removed.size()) {
+        // Stale anyway; the next step regenerates it
+        shuffle_indices.clear();
+        current_shuffle_pos = 0;
+        return;
+    }
+    
+    std::vector<size_t> new_index(removed.size());
+    size_t next = 0;
+    for (size_t i = 0; i < removed.size(); ++i) {
+        new_index[i] = next;
+        if (!removed[i]) {
+            next++;
+        }
+    }
+    
+    // A removed current item hands its place to the next survivor
+    size_t kept = 0;
+    size_t new_pos = 0;
+    for (size_t pos = 0; pos < shuffle_indices.size(); ++pos) {
+        if (pos == current_shuffle_pos) {
+            new_pos = kept;
+        }
+        size_t index = shuffle_indices[pos];
+        if (!removed[index]) {
+            shuffle_indices[kept++] = new_index[index];
+        }
+    }
+    shuffle_indices.resize(kept);
+    current_shuffle_pos = kept == 0 ? 0 : std::min(new_pos, kept - 1);
+}
+
 size_t QueueManager::GetNextIndex(size_t current_index, size_t queue_size) const
 {
     if (queue_size == 0) {
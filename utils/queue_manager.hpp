@@ -33,6 +33,9 @@ public:
     
     // Queue manipulation
     void GenerateShuffleOrder(size_t queue_size) const;
+    // Drops removed items from the shuffle order and renumbers the rest,
+    // keeping the order otherwise; removed holds one flag per queue index
+    void RemoveFromShuffleOrder(const std::vector<bool>& removed) const;
     size_t GetNextIndex(size_t current_index, size_t queue_size) const;
     size_t GetPreviousIndex(size_t current_index, size_t queue_size) const;
     
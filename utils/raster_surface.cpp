@@ -0,0 +1,351 @@
+#include "raster_surface.hpp"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace utils {
+
+namespace {
+
+// x * y / 255, rounded, for 8-bit x and y
+inline uint32_t MulDiv255(uint32_t x, uint32_t y)
+{
+    uint32_t t = x * y + 128;
+    return (t + (t >> 8)) >> 8;
+}
+
+// All four channels times scale / 256, two channels per multiply
+inline uint32_t ScaleChannels(uint32_t color, uint32_t scale)
+{
+    uint32_t rb = ((color & 0x00FF00FF) * scale >> 8) & 0x00FF00FF;
+    uint32_t ga = ((color >> 8) & 0x00FF00FF) * scale & 0xFF00FF00;
+    return rb | ga;
+}
+
+// Premultiplied "over"; channels cannot overflow since each is <= alpha
+inline uint32_t BlendOver(uint32_t dest, uint32_t color)
+{
+    return color + ScaleChannels(dest, 256 - (color >> 24));
+}
+
+}
+
+RasterSurface::RasterSurface()
+    : width(0)
+    , height(0)
+    , dirty_top(0)
+    , dirty_bottom(0)
+{
+}
+
+void RasterSurface::Resize(int w, int h)
+{
+    width = std::max(0, w);
+    height = std::max(0, h);
+    size_t needed = static_cast<size_t>(width) * height;
+    if (pixels.size() < needed) {
+        pixels.resize(needed);
+    }
+
+    // Contents are undefined after a resize
+    dirty_top = 0;
+    dirty_bottom = height;
+}
+
+uint32_t RasterSurface::MakeColor(uint8_t r, uint8_t g, uint8_t b, uint8_t a)
+{
+    return MulDiv255(r, a) | (MulDiv255(g, a) << 8) | (MulDiv255(b, a) << 16) | (static_cast<uint32_t>(a) << 24);
+}
+
+void RasterSurface::BuildGradient(uint32_t* gradient, size_t count, uint32_t from, uint32_t to)
+{
+    for (size_t i = 0; i < count; i++) {
+        uint32_t t = count > 1 ? static_cast<uint32_t>(i * 255 / (count - 1)) : 255;
+        uint32_t color = 0;
+        for (int shift = 0; shift < 32; shift += 8) {
+            uint32_t a = (from >> shift) & 0xFF;
+            uint32_t b = (to >> shift) & 0xFF;
+            color |= (MulDiv255(a, 255 - t) + MulDiv255(b, t)) << shift;
+        }
+        gradient[i] = color;
+    }
+}
+
+void RasterSurface::Clear()
+{
+    if (dirty_bottom > dirty_top) {
+        std::fill(pixels.begin() + static_cast<size_t>(dirty_top) * width,
+                  pixels.begin() + static_cast<size_t>(dirty_bottom) * width, 0u);
+    }
+    dirty_top = height;
+    dirty_bottom = 0;
+}
+
+void RasterSurface::BlendSpan(uint32_t* dest, size_t count, uint32_t color)
+{
+    const uint32_t alpha = color >> 24;
+    if (alpha == 255) {
+        std::fill(dest, dest + count, color);
+        return;
+    }
+    if (color == 0) {
+        return;
+    }
+
+    // Same arithmetic as BlendOver(): dest * (256 - alpha) / 256 + color
+    size_t i = 0;
+    const uint32_t inv = 256 - alpha;
+
+#if defined(__SSE2__) || defined(_M_X64)
+    const __m128i src = _mm_set1_epi32(static_cast<int>(color));
+    const __m128i inv16 = _mm_set1_epi16(static_cast<short>(inv));
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 4 <= count; i += 4) {
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dest + i));
+        __m128i lo = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), inv16), 8);
+        __m128i hi = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), inv16), 8);
+        __m128i result = _mm_add_epi8(_mm_packus_epi16(lo, hi), src);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), result);
+    }
+#elif defined(__ARM_NEON)
+    const uint8x16_t src = vreinterpretq_u8_u32(vdupq_n_u32(color));
+    const uint16_t inv16 = static_cast<uint16_t>(inv);
+    for (; i + 4 <= count; i += 4) {
+        uint8x16_t d = vld1q_u8(reinterpret_cast<const uint8_t*>(dest + i));
+        uint8x8_t lo = vshrn_n_u16(vmulq_n_u16(vmovl_u8(vget_low_u8(d)), inv16), 8);
+        uint8x8_t hi = vshrn_n_u16(vmulq_n_u16(vmovl_u8(vget_high_u8(d)), inv16), 8);
+        vst1q_u8(reinterpret_cast<uint8_t*>(dest + i), vaddq_u8(vcombine_u8(lo, hi), src));
+    }
+#endif
+
+    for (; i < count; i++) {
+        dest[i] = BlendOver(dest[i], color);
+    }
+}
+
+uint32_t RasterSurface::ScaleColor(uint32_t color, int coverage)
+{
+    if (coverage >= 255) {
+        return color;
+    }
+    return ScaleChannels(color, static_cast<uint32_t>(coverage) + 1);
+}
+
+void RasterSurface::BlendPixel(int x, int y, uint32_t color, int coverage)
+{
+    if (x < 0 || y < 0 || x >= width || y >= height || coverage <= 0) {
+        return;
+    }
+    uint32_t& dest = pixels[static_cast<size_t>(y) * width + x];
+    dest = BlendOver(dest, ScaleColor(color, coverage));
+    MarkRows(y, y + 1);
+}
+
+void RasterSurface::BlendRow(int y, double x0, double x1, uint32_t color)
+{
+    // Whole pixels go through the span blend; partially covered end pixels
+    // get coverage-scaled colour
+    if (y < 0 || y >= height || x1 <= x0) {
+        return;
+    }
+    x0 = std::max(0.0, x0);
+    x1 = std::min(static_cast<double>(width), x1);
+    if (x1 <= x0) {
+        return;
+    }
+
+    int first = static_cast<int>(std::ceil(x0));
+    int last = static_cast<int>(std::floor(x1));
+    if (last < first) {
+        // Both edges inside one pixel
+        BlendPixel(first - 1, y, color, static_cast<int>((x1 - x0) * 255.0));
+        return;
+    }
+
+    BlendPixel(first - 1, y, color, static_cast<int>((first - x0) * 255.0));
+    if (last > first) {
+        BlendSpan(&pixels[static_cast<size_t>(y) * width + first], last - first, color);
+        MarkRows(y, y + 1);
+    }
+    BlendPixel(last, y, color, static_cast<int>((x1 - last) * 255.0));
+}
+
+void RasterSurface::FillRect(double x, double y, double w, double h, uint32_t color)
+{
+    if (w <= 0 || h <= 0) {
+        return;
+    }
+
+    double y1 = std::min(static_cast<double>(height), y + h);
+    double y0 = std::max(0.0, y);
+    for (int row = static_cast<int>(std::floor(y0)); row < y1; row++) {
+        // Fractional top/bottom rows are blended with their coverage
+        double coverage = std::min<double>(row + 1, y1) - std::max<double>(row, y0);
+        BlendRow(row, x, x + w, coverage >= 1.0 ? color : ScaleColor(color, static_cast<int>(coverage * 255.0)));
+    }
+}
+
+void RasterSurface::FillRectGradient(double x, double y, double w, double h, const uint32_t* gradient, size_t count)
+{
+    if (w <= 0 || h <= 0 || count == 0) {
+        return;
+    }
+
+    double bottom = y + h;
+    double y1 = std::min(static_cast<double>(height), bottom);
+    double y0 = std::max(0.0, y);
+    double step = (count - 1) / std::max(1.0, h);
+    for (int row = static_cast<int>(std::floor(y0)); row < y1; row++) {
+        double centre = row + 0.5;
+        size_t index = static_cast<size_t>(std::max(0.0, std::min<double>(count - 1, (bottom - centre) * step)));
+        double coverage = std::min<double>(row + 1, y1) - std::max<double>(row, y0);
+        uint32_t color = gradient[index];
+        BlendRow(row, x, x + w, coverage >= 1.0 ? color : ScaleColor(color, static_cast<int>(coverage * 255.0)));
+    }
+}
+
+void RasterSurface::FillBars(const Bar* bars, size_t count, double bottom, const uint32_t* gradient, size_t gradient_count)
+{
+    if (count == 0 || width == 0) {
+        return;
+    }
+
+    // Horizontal extents and edge coverage do not change down a bar, so
+    // resolve them once rather than per row
+    if (bar_spans.size() < count) {
+        bar_spans.resize(count);
+    }
+    double highest = bottom;
+    for (size_t i = 0; i < count; i++) {
+        double left = std::max(0.0, bars[i].left);
+        double right = std::min(static_cast<double>(width), bars[i].right);
+        BarSpan& span = bar_spans[i];
+        span.first = static_cast<int>(std::ceil(left));
+        span.last = static_cast<int>(std::floor(right));
+        span.left_coverage = static_cast<int>((span.first - left) * 255.0);
+        span.right_coverage = static_cast<int>((right - span.last) * 255.0);
+        if (right <= left) {
+            span.first = span.last = 0;
+            span.left_coverage = span.right_coverage = 0;
+        } else if (span.last < span.first) {
+            // Narrower than a pixel
+            span.first = span.last = span.last;
+            span.left_coverage = 0;
+            span.right_coverage = static_cast<int>((right - left) * 255.0);
+        }
+        span.top = bars[i].top;
+        span.gradient_scale = gradient ? (gradient_count - 1) / std::max(1.0, bottom - bars[i].top) : 0.0;
+        if (span.left_coverage == 0 && span.right_coverage == 0 && span.last <= span.first) {
+            span.top = bottom;      // nothing to draw
+        }
+        highest = std::min(highest, span.top);
+    }
+
+    double y1 = std::min(static_cast<double>(height), bottom);
+    int first_row = std::max(0, static_cast<int>(std::floor(highest)));
+    MarkRows(first_row, static_cast<int>(std::ceil(y1)));
+    for (int row = first_row; row < y1; row++) {
+        uint32_t* line = &pixels[static_cast<size_t>(row) * width];
+        double distance = bottom - (row + 0.5);
+        double row_bottom = std::min<double>(row + 1, y1);
+
+        for (size_t i = 0; i < count; i++) {
+            const BarSpan& span = bar_spans[i];
+            double coverage = row_bottom - std::max<double>(row, span.top);
+            if (coverage <= 0.0) {
+                continue;
+            }
+
+            uint32_t color = bars[i].color;
+            if (gradient) {
+                double index = std::max(0.0, std::min<double>(gradient_count - 1, distance * span.gradient_scale));
+                color = gradient[static_cast<size_t>(index)];
+            }
+            if (coverage < 1.0) {
+                color = ScaleColor(color, static_cast<int>(coverage * 255.0));
+            }
+
+            if (span.left_coverage > 0 && span.first > 0) {
+                line[span.first - 1] = BlendOver(line[span.first - 1], ScaleColor(color, span.left_coverage));
+            }
+            if (span.last > span.first) {
+                BlendSpan(line + span.first, span.last - span.first, color);
+            }
+            if (span.right_coverage > 0 && span.last < width) {
+                line[span.last] = BlendOver(line[span.last], ScaleColor(color, span.right_coverage));
+            }
+        }
+    }
+}
+
+void RasterSurface::DrawLine(double x0, double y0, double x1, double y1, double thickness, uint32_t color)
+{
+    double dx = x1 - x0;
+    double dy = y1 - y0;
+    double half = thickness / 2.0;
+
+    if (std::fabs(dy) > std::fabs(dx)) {
+        // Steep: one horizontal span per row, widened so the perpendicular
+        // thickness stays constant
+        if (y1 < y0) {
+            std::swap(x0, x1);
+            std::swap(y0, y1);
+        }
+        double slope = dx / dy;
+        double span = half * std::sqrt(1.0 + slope * slope);
+        int first = std::max(0, static_cast<int>(std::floor(y0)));
+        int last = std::min(height - 1, static_cast<int>(std::ceil(y1)) - 1);
+        for (int row = first; row <= last; row++) {
+            double cx = x0 + (row + 0.5 - y0) * slope;
+            BlendRow(row, cx - span, cx + span, color);
+        }
+        return;
+    }
+
+    // Shallow: one vertical run per column
+    if (x1 < x0) {
+        std::swap(x0, x1);
+        std::swap(y0, y1);
+    }
+    double slope = dx != 0.0 ? dy / dx : 0.0;
+    double span = half * std::sqrt(1.0 + slope * slope);
+    int first = std::max(0, static_cast<int>(std::floor(x0)));
+    int last = std::min(width - 1, static_cast<int>(std::ceil(x1)) - 1);
+    for (int col = first; col <= last; col++) {
+        double cy = y0 + (col + 0.5 - x0) * slope;
+        double top = cy - span;
+        double bottom = cy + span;
+        int row_first = std::max(0, static_cast<int>(std::floor(top)));
+        int row_last = std::min(height - 1, static_cast<int>(std::ceil(bottom)) - 1);
+        for (int row = row_first; row <= row_last; row++) {
+            double coverage = std::min<double>(row + 1, bottom) - std::max<double>(row, top);
+            BlendPixel(col, row, color, static_cast<int>(coverage * 255.0));
+        }
+    }
+}
+
+void RasterSurface::FillCircle(double cx, double cy, double radius, uint32_t color)
+{
+    if (radius <= 0) {
+        return;
+    }
+
+    int first = std::max(0, static_cast<int>(std::floor(cy - radius)));
+    int last = std::min(height - 1, static_cast<int>(std::ceil(cy + radius)) - 1);
+    for (int row = first; row <= last; row++) {
+        double dy = row + 0.5 - cy;
+        double extent = radius * radius - dy * dy;
+        if (extent <= 0) {
+            continue;
+        }
+        double half = std::sqrt(extent);
+        BlendRow(row, cx - half, cx + half, color);
+    }
+}
+
+}
@@ -0,0 +1,96 @@
+#ifndef __RASTER_SURFACE_HPP
+#define __RASTER_SURFACE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace utils {
+
+// CPU pixel buffer with a few primitives for the visualizers.
+//
+// Pixels are premultiplied RGBA, one uint32_t each with bytes in R, G, B, A
+// memory order. Shapes are composited "over" with SIMD span blends, so a
+// frame of a few hundred bars costs a handful of memory passes instead of a
+// graphics-context call per element. The buffer only grows; resizing to a
+// smaller plot does not reallocate.
+class RasterSurface {
+public:
+    // Vertical bar standing on a shared baseline
+    struct Bar {
+        double left;
+        double right;
+        double top;
+        uint32_t color;     // used when no gradient is given
+    };
+
+    RasterSurface();
+
+    void Resize(int width, int height);
+    int GetWidth() const { return width; }
+    int GetHeight() const { return height; }
+    const uint32_t* GetRow(int y) const { return &pixels[static_cast<size_t>(y) * width]; }
+
+    // Rows touched since the last Clear(), as [top, bottom); empty when
+    // top >= bottom. Clear() only wipes these rows.
+    int GetDirtyTop() const { return dirty_top; }
+    int GetDirtyBottom() const { return dirty_bottom; }
+
+    // Packs a straight-alpha colour into the premultiplied pixel format
+    static uint32_t MakeColor(uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255);
+
+    // Fills gradient[0..count) from 'from' to 'to' (inclusive), for use
+    // with FillRectGradient()
+    static void BuildGradient(uint32_t* gradient, size_t count, uint32_t from, uint32_t to);
+
+    void Clear();
+    void FillRect(double x, double y, double w, double h, uint32_t color);
+
+    // Vertical gradient: gradient[0] at the bottom edge of the rectangle,
+    // gradient[count - 1] at its top, whatever the rectangle's height
+    void FillRectGradient(double x, double y, double w, double h, const uint32_t* gradient, size_t count);
+
+    // Fills all bars down to 'bottom' in scanline order, which keeps a tall
+    // surface in cache far better than drawing bar by bar. With a gradient,
+    // each bar spans the whole gradient over its own height.
+    void FillBars(const Bar* bars, size_t count, double bottom, const uint32_t* gradient = nullptr, size_t gradient_count = 0);
+
+    void DrawLine(double x0, double y0, double x1, double y1, double thickness, uint32_t color);
+    void FillCircle(double cx, double cy, double radius, uint32_t color);
+
+    // Composites color over count pixels; exposed for benchmarking
+    static void BlendSpan(uint32_t* dest, size_t count, uint32_t color);
+
+private:
+    std::vector<uint32_t> pixels;
+    int width;
+    int height;
+    int dirty_top;
+    int dirty_bottom;
+
+    void MarkRows(int top, int bottom)
+    {
+        dirty_top = std::min(dirty_top, std::max(0, top));
+        dirty_bottom = std::max(dirty_bottom, std::min(height, bottom));
+    }
+
+    // FillBars() scratch, grow-only
+    struct BarSpan {
+        int first;              // first fully covered column
+        int last;               // one past the last fully covered column
+        int left_coverage;      // of column first - 1
+        int right_coverage;     // of column last
+        double top;
+        double gradient_scale;  // gradient entries per pixel of height
+    };
+    std::vector<BarSpan> bar_spans;
+
+    void BlendPixel(int x, int y, uint32_t color, int coverage);
+    void BlendRow(int y, double x0, double x1, uint32_t color);
+    static uint32_t ScaleColor(uint32_t color, int coverage);
+};
+
+}
+
+#endif // __RASTER_SURFACE_HPP
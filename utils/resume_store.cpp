@@ -0,0 +1,244 @@
+#include "resume_store.hpp"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <vector>
+
+namespace utils {
+
+namespace {
+
+long long Now()
+{
+    return std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+}
+
+ResumeStore& ResumeStore::Get()
+{
+    static ResumeStore instance;
+    return instance;
+}
+
+ResumeStore::ResumeStore()
+    : dirty_count(0)
+    , log_records(0)
+    , running(false)
+    , log(nullptr)
+{
+}
+
+ResumeStore::~ResumeStore()
+{
+    Close();
+}
+
+bool ResumeStore::Open(const std::string& path)
+{
+    Close();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    file = path;
+    index.clear();
+    dirty_count = 0;
+    log_records = 0;
+
+    // Replay the log; a torn record at the end (crash mid-write) is ignored
+    if (FILE* in = fopen(path.c_str(), "rb")) {
+        LogRecord record;
+        while (fread(&record, sizeof(record), 1, in) == 1) {
+            if (record.position_ms < 0) {
+                index.erase(record.identity);
+            } else {
+                index[record.identity] = Entry{ record.position_ms, record.timestamp, false };
+            }
+            log_records++;
+        }
+        fclose(in);
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+    log = fopen(path.c_str(), "ab");
+
+    // Without a log the index still works for this session
+    running = true;
+    writer = std::thread(&ResumeStore::Run, this);
+    return log != nullptr;
+}
+
+void ResumeStore::Close()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!running) {
+            return;
+        }
+        running = false;
+    }
+    wake.notify_all();
+    writer.join();
+
+    if (log) {
+        fclose(log);
+        log = nullptr;
+    }
+}
+
+uint64_t ResumeStore::FileIdentity(const std::string& path)
+{
+    // FNV-1a over the path, then the size, so a replaced file starts over
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : path) {
+        hash = (hash ^ c) * 1099511628211ull;
+    }
+
+    std::error_code error;
+    uint64_t size = std::filesystem::file_size(path, error);
+    if (error) {
+        size = 0;
+    }
+    for (int i = 0; i < 8; i++) {
+        hash = (hash ^ ((size >> (i * 8)) & 0xff)) * 1099511628211ull;
+    }
+    return hash;
+}
+
+bool ResumeStore::Lookup(uint64_t identity, long long& position_ms) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = index.find(identity);
+    if (it == index.end() || it->second.position_ms < 0) {
+        return false;
+    }
+    position_ms = it->second.position_ms;
+    return true;
+}
+
+void ResumeStore::Record(uint64_t identity, long long position_ms)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Entry& entry = index.try_emplace(identity, Entry{ -1, 0, false }).first->second;
+    entry.position_ms = std::max(0LL, position_ms);
+    entry.timestamp = Now();
+    MarkDirty(entry);
+}
+
+void ResumeStore::Forget(uint64_t identity)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = index.find(identity);
+    if (it == index.end() || it->second.position_ms < 0) {
+        return;
+    }
+    it->second.position_ms = -1;
+    it->second.timestamp = Now();
+    MarkDirty(it->second);
+}
+
+void ResumeStore::MarkDirty(Entry& entry)
+{
+    if (!entry.dirty) {
+        entry.dirty = true;
+        dirty_count++;
+    }
+}
+
+void ResumeStore::Run()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait_for(lock, std::chrono::seconds(FLUSH_INTERVAL_SECONDS), [this] {
+            return !running;
+        });
+
+        if (dirty_count > 0) {
+            WriteDirty(lock);
+        }
+        if (log_records > 2 * index.size() + 256) {
+            Compact(lock);
+        }
+        if (!running) {
+            break;
+        }
+    }
+}
+
+void ResumeStore::WriteDirty(std::unique_lock<std::mutex>& lock)
+{
+    // Each key is written once per batch however often it was recorded
+    std::vector<LogRecord> batch;
+    batch.reserve(dirty_count);
+    for (auto it = index.begin(); it != index.end();) {
+        Entry& entry = it->second;
+        if (entry.dirty) {
+            batch.push_back(LogRecord{ it->first, entry.position_ms, entry.timestamp });
+            entry.dirty = false;
+        }
+        if (entry.position_ms < 0) {
+            it = index.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    dirty_count = 0;
+
+    lock.unlock();
+    size_t written = 0;
+    if (log) {
+        written = fwrite(batch.data(), sizeof(LogRecord), batch.size(), log);
+        fflush(log);
+    }
+    lock.lock();
+    log_records += written;
+}
+
+void ResumeStore::Compact(std::unique_lock<std::mutex>& lock)
+{
+    // Snapshot the live, clean entries; anything dirtied meanwhile is
+    // appended to the new log on the next flush
+    const long long cutoff = Now() - MAX_AGE_SECONDS;
+    std::vector<LogRecord> snapshot;
+    snapshot.reserve(index.size());
+    for (auto it = index.begin(); it != index.end();) {
+        if (!it->second.dirty && it->second.timestamp < cutoff) {
+            it = index.erase(it);
+            continue;
+        }
+        if (it->second.position_ms >= 0) {
+            snapshot.push_back(LogRecord{ it->first, it->second.position_ms, it->second.timestamp });
+        }
+        ++it;
+    }
+    const std::string path = file;
+
+    lock.unlock();
+    bool replaced = false;
+    std::string temporary = path + ".tmp";
+    if (FILE* out = fopen(temporary.c_str(), "wb")) {
+        bool ok = fwrite(snapshot.data(), sizeof(LogRecord), snapshot.size(), out) == snapshot.size();
+        ok = fclose(out) == 0 && ok;
+
+        std::error_code error;
+        if (ok) {
+            if (log) {
+                fclose(log);
+            }
+            std::filesystem::rename(temporary, path, error);
+            replaced = !error;
+            log = fopen(path.c_str(), "ab");
+        }
+        if (!replaced) {
+            std::filesystem::remove(temporary, error);
+        }
+    }
+    lock.lock();
+
+    if (replaced) {
+        log_records = snapshot.size();
+    }
+}
+
+}
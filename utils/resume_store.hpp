@@ -0,0 +1,75 @@
+#ifndef __RESUME_STORE_HPP
+#define __RESUME_STORE_HPP
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+namespace utils {
+
+// Last playback position per file, kept across sessions.
+//
+// Positions live in an in-memory hash index keyed by a file identity (path
+// and size). Record() only updates the index and marks the key dirty; a
+// writer thread appends the dirty keys to a binary log every few seconds, so
+// the GUI never waits on the disk. The log is replayed on Open() (the last
+// record for a key wins) and rewritten from the index on the writer thread
+// once it holds mostly superseded records.
+class ResumeStore {
+public:
+    static ResumeStore& Get();
+    ~ResumeStore();
+
+    bool Open(const std::string& file);
+    void Close();               // flushes pending records
+
+    static uint64_t FileIdentity(const std::string& path);
+
+    bool Lookup(uint64_t identity, long long& position_ms) const;
+    void Record(uint64_t identity, long long position_ms);
+    void Forget(uint64_t identity);
+
+    static constexpr int FLUSH_INTERVAL_SECONDS = 5;
+    static constexpr long long MAX_AGE_SECONDS = 365LL * 24 * 3600;   // dropped on compaction
+
+private:
+    struct Entry {
+        long long position_ms;  // -1 once forgotten
+        long long timestamp;    // seconds since the epoch
+        bool dirty;
+    };
+
+    // On-disk record, little-endian on every supported platform
+    struct LogRecord {
+        uint64_t identity;
+        int64_t position_ms;
+        int64_t timestamp;
+    };
+
+    ResumeStore();
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::unordered_map<uint64_t, Entry> index;
+    size_t dirty_count;
+    size_t log_records;
+    std::string file;
+    bool running;
+    std::thread writer;
+
+    // Writer thread only
+    FILE* log;
+
+    void Run();
+    void WriteDirty(std::unique_lock<std::mutex>& lock);
+    void MarkDirty(Entry& entry);
+    void Compact(std::unique_lock<std::mutex>& lock);
+};
+
+}
+
+#endif // __RESUME_STORE_HPP
@@ -0,0 +1,464 @@
+#include "search_index.hpp"
+#include "fuzzy_matcher.hpp"
+#include <algorithm>
+
+namespace utils {
+
+namespace {
+
+// Earlier fields weigh more; a match at a word start counts double
+const uint32_t FIELD_WEIGHTS[SearchIndex::FIELD_COUNT] = { 8, 6, 4, 2 };
+
+// Below this many candidates, checking them beats intersecting more lists
+const size_t MIN_INTERSECT_CANDIDATES = 32;
+
+bool IsWordChar(unsigned char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c >= 0x80;
+}
+
+void Split(std::string_view text, std::vector<std::string_view>& terms)
+{
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t end = text.find(' ', start);
+        if (end == std::string_view::npos) {
+            end = text.size();
+        }
+        if (end > start) {
+            terms.push_back(text.substr(start, end - start));
+        }
+        start = end + 1;
+    }
+}
+
+}
+
+SearchIndex::SearchIndex()
+    : live_count(0)
+    , dead_count(0)
+    , last_valid(false)
+{
+}
+
+uint32_t SearchIndex::Add(const Fields& fields)
+{
+    const uint32_t id = static_cast<uint32_t>(documents.size());
+
+    Document document;
+    document.offset = text.size();
+    document.live = true;
+    std::vector<uint32_t> grams;
+    for (int f = 0; f < FIELD_COUNT; f++) {
+        size_t start = text.size();
+        Fold(fields[f], text);
+
+        // Terms never hold spaces, so neither do the trigrams worth keeping
+        for (size_t i = start; i + 3 <= text.size(); i++) {
+            if (text[i] != ' ' && text[i + 1] != ' ' && text[i + 2] != ' ') {
+                grams.push_back(Trigram(text.data() + i));
+            }
+        }
+        document.field_end[f] = static_cast<uint32_t>(text.size() - document.offset);
+        if (f + 1 < FIELD_COUNT) {
+            text.push_back('\0');
+        }
+    }
+
+    std::sort(grams.begin(), grams.end());
+    grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+    for (uint32_t gram : grams) {
+        postings[gram].push_back(id);
+    }
+
+    documents.push_back(std::move(document));
+    live_count++;
+    last_valid = false;
+    return id;
+}
+
+bool SearchIndex::GetFields(uint32_t id, Fields& fields) const
+{
+    if (id >= documents.size() || !documents[id].live) {
+        return false;
+    }
+
+    const Document& document = documents[id];
+    std::string_view stored = GetText(document);
+    size_t start = 0;
+    for (int f = 0; f < FIELD_COUNT; f++) {
+        fields[f] = std::string(stored.substr(start, document.field_end[f] - start));
+        start = document.field_end[f] + 1;     // past the '\0'
+    }
+    return true;
+}
+
+void SearchIndex::Remove(uint32_t id)
+{
+    if (id >= documents.size() || !documents[id].live) {
+        return;
+    }
+
+    documents[id].live = false;
+    live_count--;
+    dead_count++;
+    last_valid = false;
+
+    if (dead_count >= PURGE_MIN_TOMBSTONES && dead_count > live_count) {
+        Purge();
+    }
+}
+
+void SearchIndex::Clear()
+{
+    documents.clear();
+    text.clear();
+    postings.clear();
+    live_count = 0;
+    dead_count = 0;
+    last_valid = false;
+}
+
+void SearchIndex::Purge()
+{
+    // Compact the text of the live documents
+    std::string compacted;
+    compacted.reserve(text.size());
+    for (Document& document : documents) {
+        if (document.live) {
+            std::string_view current = GetText(document);
+            document.offset = compacted.size();
+            compacted.append(current);
+        }
+    }
+    text.swap(compacted);
+
+    for (auto it = postings.begin(); it != postings.end();) {
+        std::vector<uint32_t>& ids = it->second;
+        ids.erase(std::remove_if(ids.begin(), ids.end(), [this](uint32_t id) {
+            return !documents[id].live;
+        }), ids.end());
+
+        if (ids.empty()) {
+            it = postings.erase(it);
+        } else {
+            ids.shrink_to_fit();
+            ++it;
+        }
+    }
+    dead_count = 0;
+}
+
+size_t SearchIndex::Search(const std::string& query, std::vector<uint32_t>& results, size_t limit)
+{
+    results.clear();
+
+    std::string folded;
+    Fold(query, folded);
+    std::vector<std::string_view> terms;
+    Split(folded, terms);
+    if (terms.empty()) {
+        last_valid = false;
+        return 0;
+    }
+
+    // Extending the previous query can only drop matches, though a rare
+    // trigram in the new text may still narrow things down faster
+    std::vector<uint32_t> candidates;
+    if (last_valid && !last_query.empty() && folded.compare(0, last_query.size(), last_query) == 0 &&
+        last_matches.size() <= EstimateCandidates(terms)) {
+        candidates.swap(last_matches);
+    } else {
+        FindCandidates(terms, candidates);
+    }
+
+    // Scoring doubles as the substring check; ids are unique, so ties fall
+    // back to insertion order
+    std::vector<uint32_t> matches;
+    std::vector<std::pair<uint32_t, uint32_t>> ranked;
+    matches.reserve(candidates.size());
+    ranked.reserve(candidates.size());
+    for (uint32_t id : candidates) {
+        const Document& document = documents[id];
+        uint32_t score = document.live ? Score(document, terms) : 0;
+        if (score > 0) {
+            matches.push_back(id);
+            ranked.emplace_back(score, id);
+        }
+    }
+    auto better = [](const std::pair<uint32_t, uint32_t>& a, const std::pair<uint32_t, uint32_t>& b) {
+        return a.first != b.first ? a.first > b.first : a.second < b.second;
+    };
+    size_t count = limit > 0 ? std::min(limit, ranked.size()) : ranked.size();
+    std::partial_sort(ranked.begin(), ranked.begin() + count, ranked.end(), better);
+
+    results.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        results.push_back(ranked[i].second);
+    }
+
+    last_query = std::move(folded);
+    last_matches = std::move(matches);
+    last_valid = true;
+    return last_matches.size();
+}
+
+size_t SearchIndex::SearchFuzzy(const std::string& query, std::vector<uint32_t>& results, size_t limit)
+{
+    results.clear();
+    last_valid = false;
+
+    std::string folded;
+    Fold(query, folded);
+    std::vector<std::string_view> terms;
+    Split(folded, terms);
+    if (terms.empty()) {
+        return 0;
+    }
+
+    std::vector<FuzzyMatcher> matchers;
+    std::vector<int> budgets;
+    for (std::string_view term : terms) {
+        matchers.emplace_back(term, true);
+        budgets.push_back(GetTypoBudget(matchers.back().GetLength()));
+    }
+
+    std::vector<uint32_t> candidates;
+    FindFuzzyCandidates(terms, budgets, candidates);
+
+    // Exact terms keep their Search() weight; a near match counts by field
+    // only, since its start is not known
+    struct Ranked {
+        uint32_t edits;
+        uint32_t score;
+        uint32_t id;
+    };
+    std::vector<Ranked> ranked;
+    for (uint32_t id : candidates) {
+        const Document& document = documents[id];
+        if (!document.live) {
+            continue;
+        }
+
+        std::string_view text = GetText(document);
+        Ranked entry = { 0, 0, id };
+        for (size_t t = 0; t < terms.size(); t++) {
+            size_t position = text.find(terms[t]);
+            if (position != std::string_view::npos) {
+                uint32_t weight = FIELD_WEIGHTS[FieldAt(document, position)];
+                if (position == 0 || !IsWordChar(static_cast<unsigned char>(text[position - 1]))) {
+                    weight *= 2;
+                }
+                entry.score += weight;
+                continue;
+            }
+
+            size_t end = 0;
+            int edits = budgets[t] > 0 ? matchers[t].SubstringDistance(text, &end) : budgets[t] + 1;
+            if (edits > budgets[t]) {
+                entry.edits = UINT32_MAX;
+                break;
+            }
+            entry.edits += static_cast<uint32_t>(edits);
+            entry.score += FIELD_WEIGHTS[FieldAt(document, end > 0 ? end - 1 : 0)];
+        }
+        if (entry.edits != UINT32_MAX) {
+            ranked.push_back(entry);
+        }
+    }
+
+    auto better = [](const Ranked& a, const Ranked& b) {
+        if (a.edits != b.edits) return a.edits < b.edits;
+        if (a.score != b.score) return a.score > b.score;
+        return a.id < b.id;
+    };
+    size_t count = limit > 0 ? std::min(limit, ranked.size()) : ranked.size();
+    std::partial_sort(ranked.begin(), ranked.begin() + count, ranked.end(), better);
+
+    results.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        results.push_back(ranked[i].id);
+    }
+    return ranked.size();
+}
+
+size_t SearchIndex::EstimateCandidates(const std::vector<std::string_view>& terms) const
+{
+    size_t smallest = documents.size();
+    for (std::string_view term : terms) {
+        for (size_t i = 0; i + 3 <= term.size(); i++) {
+            auto it = postings.find(Trigram(term.data() + i));
+            smallest = std::min(smallest, it == postings.end() ? 0 : it->second.size());
+        }
+    }
+    return smallest;
+}
+
+void SearchIndex::FindCandidates(const std::vector<std::string_view>& terms, std::vector<uint32_t>& candidates) const
+{
+    std::vector<const std::vector<uint32_t>*> lists;
+    for (std::string_view term : terms) {
+        for (size_t i = 0; i + 3 <= term.size(); i++) {
+            auto it = postings.find(Trigram(term.data() + i));
+            if (it == postings.end()) {
+                return;
+            }
+            lists.push_back(&it->second);
+        }
+    }
+
+    // Only short terms: every document is a candidate
+    if (lists.empty()) {
+        candidates.resize(documents.size());
+        for (size_t id = 0; id < documents.size(); id++) {
+            candidates[id] = static_cast<uint32_t>(id);
+        }
+        return;
+    }
+
+    std::sort(lists.begin(), lists.end(), [](const std::vector<uint32_t>* a, const std::vector<uint32_t>* b) {
+        return a->size() < b->size();
+    });
+    lists.erase(std::unique(lists.begin(), lists.end()), lists.end());
+
+    candidates = *lists[0];
+    std::vector<uint32_t> kept;
+    for (size_t l = 1; l < lists.size() && candidates.size() > MIN_INTERSECT_CANDIDATES; l++) {
+        // Candidates are far fewer than the list; search forward for each
+        const std::vector<uint32_t>& list = *lists[l];
+        auto from = list.begin();
+        kept.clear();
+        for (uint32_t id : candidates) {
+            from = std::lower_bound(from, list.end(), id);
+            if (from == list.end()) break;
+            if (*from == id) {
+                kept.push_back(id);
+            }
+        }
+        candidates.swap(kept);
+    }
+}
+
+void SearchIndex::FindFuzzyCandidates(const std::vector<std::string_view>& terms, const std::vector<int>& budgets,
+                                      std::vector<uint32_t>& candidates) const
+{
+    // An edit touching a character of b bytes breaks at most b + 2 of the
+    // term's trigrams, so a match within budget keeps the rest of them
+    bool filtered = false;
+    std::vector<uint16_t> counts;
+    std::vector<uint32_t> kept;
+    for (size_t t = 0; t < terms.size(); t++) {
+        std::string_view term = terms[t];
+        std::vector<uint32_t> grams;
+        for (size_t i = 0; i + 3 <= term.size(); i++) {
+            grams.push_back(Trigram(term.data() + i));
+        }
+        std::sort(grams.begin(), grams.end());
+        grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+
+        int widest = 1;
+        for (char c : term) {
+            unsigned char lead = static_cast<unsigned char>(c);
+            widest = std::max(widest, lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : lead >= 0xC0 ? 2 : 1);
+        }
+        int needed = static_cast<int>(grams.size()) - budgets[t] * (widest + 2);
+        if (needed < 1) {
+            continue;
+        }
+
+        counts.assign(documents.size(), 0);
+        for (uint32_t gram : grams) {
+            auto it = postings.find(gram);
+            if (it != postings.end()) {
+                for (uint32_t id : it->second) {
+                    counts[id]++;
+                }
+            }
+        }
+
+        kept.clear();
+        if (filtered) {
+            for (uint32_t id : candidates) {
+                if (counts[id] >= needed) {
+                    kept.push_back(id);
+                }
+            }
+        } else {
+            for (size_t id = 0; id < counts.size(); id++) {
+                if (counts[id] >= needed) {
+                    kept.push_back(static_cast<uint32_t>(id));
+                }
+            }
+        }
+        candidates.swap(kept);
+        filtered = true;
+    }
+
+    if (!filtered) {
+        candidates.resize(documents.size());
+        for (size_t id = 0; id < documents.size(); id++) {
+            candidates[id] = static_cast<uint32_t>(id);
+        }
+    }
+}
+
+std::string_view SearchIndex::GetText(const Document& document) const
+{
+    return std::string_view(text).substr(document.offset, document.field_end[FIELD_COUNT - 1]);
+}
+
+uint32_t SearchIndex::Score(const Document& document, const std::vector<std::string_view>& terms) const
+{
+    // 0 when a term is missing; every match scores at least the lowest weight
+    std::string_view text = GetText(document);
+    uint32_t score = 0;
+    for (std::string_view term : terms) {
+        size_t position = text.find(term);
+        if (position == std::string_view::npos) {
+            return 0;
+        }
+
+        uint32_t weight = FIELD_WEIGHTS[FieldAt(document, position)];
+        if (position == 0 || !IsWordChar(static_cast<unsigned char>(text[position - 1]))) {
+            weight *= 2;
+        }
+        score += weight;
+    }
+    return score;
+}
+
+int SearchIndex::FieldAt(const Document& document, size_t position) const
+{
+    int field = 0;
+    while (field + 1 < FIELD_COUNT && position >= document.field_end[field]) {
+        field++;
+    }
+    return field;
+}
+
+void SearchIndex::Fold(std::string_view text, std::string& folded)
+{
+    folded.reserve(folded.size() + text.size());
+    for (char c : text) {
+        if (c >= 'A' && c <= 'Z') {
+            c = static_cast<char>(c - 'A' + 'a');
+        } else if (c == '\t' || c == '\n' || c == '\r' || c == '\0') {
+            c = ' ';
+        }
+        folded.push_back(c);
+    }
+}
+
+uint32_t SearchIndex::Trigram(const char* p)
+{
+    return (static_cast<uint32_t>(static_cast<unsigned char>(p[0])) << 16) |
+           (static_cast<uint32_t>(static_cast<unsigned char>(p[1])) << 8) |
+           static_cast<uint32_t>(static_cast<unsigned char>(p[2]));
+}
+
+int SearchIndex::GetTypoBudget(size_t length)
+{
+    return length >= 8 ? 2 : length >= 4 ? 1 : 0;
+}
+
+}
@@ -0,0 +1,93 @@
+#ifndef __SEARCH_INDEX_HPP
+#define __SEARCH_INDEX_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace utils {
+
+// Incremental trigram index for search-as-you-type over track text.
+//
+// A document is a few UTF-8 fields (title, artist, album, file name),
+// ASCII case-folded once on Add(); callers fold anything wider beforehand.
+// Every distinct trigram of a field maps to an ascending list of document
+// ids, so a query intersects the lists of its terms' trigrams, rarest
+// first, and only verifies the survivors with a substring check. Terms
+// shorter than a trigram scan the stored text instead.
+//
+// Ids are handed out in increasing order and never reused until Clear().
+// Remove() leaves a tombstone; the posting lists are purged once tombstones
+// outnumber live documents. A query that extends the previous one (the
+// next keystroke) re-checks only the previous matches. Not thread-safe.
+class SearchIndex {
+public:
+    enum Field { TITLE, ARTIST, ALBUM, FILENAME, FIELD_COUNT };
+    using Fields = std::array<std::string, FIELD_COUNT>;
+
+    SearchIndex();
+
+    uint32_t Add(const Fields& fields);
+    void Remove(uint32_t id);
+    void Clear();
+    size_t GetCount() const { return live_count; }
+
+    // A live document's fields as stored, folded; false once removed
+    bool GetFields(uint32_t id, Fields& fields) const;
+
+    // Documents containing every whitespace-separated term of query, best
+    // first: earlier fields outrank later ones and matches at the start of
+    // a word outrank matches inside one; ties keep id order. Returns the
+    // number of matches, of which results receives at most limit (0 = all).
+    size_t Search(const std::string& query, std::vector<uint32_t>& results, size_t limit = 0);
+
+    // Search() tolerating typos: a term of 4+ characters may be one edit
+    // (including swapping two neighbours) away from the text, 8+ two. Fewer edits rank first. Candidates still
+    // come from the trigram lists where a term is long enough that its
+    // edits cannot destroy every trigram; otherwise every document is
+    // checked.
+    size_t SearchFuzzy(const std::string& query, std::vector<uint32_t>& results, size_t limit = 0);
+
+private:
+    // Folded fields, '\0' between them, stored back to back in text so
+    // scans walk memory in order
+    struct Document {
+        size_t offset;
+        uint32_t field_end[FIELD_COUNT];        // relative to offset
+        bool live;
+    };
+
+    std::vector<Document> documents;            // indexed by id
+    std::string text;
+    std::unordered_map<uint32_t, std::vector<uint32_t>> postings;
+    size_t live_count;
+    size_t dead_count;
+
+    // Matches of the previous query, valid until the index changes
+    std::string last_query;
+    std::vector<uint32_t> last_matches;
+    bool last_valid;
+
+    void Purge();
+    size_t EstimateCandidates(const std::vector<std::string_view>& terms) const;
+    void FindCandidates(const std::vector<std::string_view>& terms, std::vector<uint32_t>& candidates) const;
+    void FindFuzzyCandidates(const std::vector<std::string_view>& terms, const std::vector<int>& budgets,
+                             std::vector<uint32_t>& candidates) const;
+    std::string_view GetText(const Document& document) const;
+    uint32_t Score(const Document& document, const std::vector<std::string_view>& terms) const;
+    int FieldAt(const Document& document, size_t position) const;
+
+    static void Fold(std::string_view text, std::string& folded);
+    static uint32_t Trigram(const char* p);
+    static int GetTypoBudget(size_t length);
+
+    static const size_t PURGE_MIN_TOMBSTONES = 1024;
+};
+
+}
+
+#endif // __SEARCH_INDEX_HPP
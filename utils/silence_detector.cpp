@@ -0,0 +1,237 @@
+#include "silence_detector.hpp"
+#include "audio_decoder.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace utils {
+
+size_t SilenceDetector::FindFirstAbove(const float* samples, size_t count, float threshold)
+{
+    size_t i = 0;
+
+#if defined(__SSE2__) || defined(_M_X64)
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    const __m128 limit = _mm_set1_ps(threshold);
+    for (; i + 8 <= count; i += 8) {
+        __m128 a = _mm_andnot_ps(sign, _mm_loadu_ps(samples + i));
+        __m128 b = _mm_andnot_ps(sign, _mm_loadu_ps(samples + i + 4));
+        if (_mm_movemask_ps(_mm_or_ps(_mm_cmpgt_ps(a, limit), _mm_cmpgt_ps(b, limit))) != 0) {
+            break;
+        }
+    }
+#elif defined(__ARM_NEON)
+    const float32x4_t limit = vdupq_n_f32(threshold);
+    for (; i + 8 <= count; i += 8) {
+        uint32x4_t a = vcagtq_f32(vld1q_f32(samples + i), limit);
+        uint32x4_t b = vcagtq_f32(vld1q_f32(samples + i + 4), limit);
+        if (vmaxvq_u32(vorrq_u32(a, b)) != 0) {
+            break;
+        }
+    }
+#endif
+
+    for (; i < count; i++) {
+        if (std::abs(samples[i]) > threshold) {
+            return i;
+        }
+    }
+    return count;
+}
+
+size_t SilenceDetector::FindLastAbove(const float* samples, size_t count, float threshold)
+{
+    size_t end = count;
+
+#if defined(__SSE2__) || defined(_M_X64)
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    const __m128 limit = _mm_set1_ps(threshold);
+    for (; end >= 8; end -= 8) {
+        __m128 a = _mm_andnot_ps(sign, _mm_loadu_ps(samples + end - 8));
+        __m128 b = _mm_andnot_ps(sign, _mm_loadu_ps(samples + end - 4));
+        if (_mm_movemask_ps(_mm_or_ps(_mm_cmpgt_ps(a, limit), _mm_cmpgt_ps(b, limit))) != 0) {
+            break;
+        }
+    }
+#elif defined(__ARM_NEON)
+    const float32x4_t limit = vdupq_n_f32(threshold);
+    for (; end >= 8; end -= 8) {
+        uint32x4_t a = vcagtq_f32(vld1q_f32(samples + end - 8), limit);
+        uint32x4_t b = vcagtq_f32(vld1q_f32(samples + end - 4), limit);
+        if (vmaxvq_u32(vorrq_u32(a, b)) != 0) {
+            break;
+        }
+    }
+#endif
+
+    while (end > 0) {
+        end--;
+        if (std::abs(samples[end]) > threshold) {
+            return end;
+        }
+    }
+    return count;
+}
+
+bool SilenceDetector::AnalyzeFile(const std::string& path, TrimPoints& trim, float threshold_db)
+{
+    std::unique_ptr<AudioDecoder> decoder = AudioDecoder::Open(path);
+    if (!decoder) {
+        return false;
+    }
+
+    const int rate = decoder->GetSampleRate();
+    const int channels = decoder->GetChannels();
+    const float threshold = std::pow(10.0f, threshold_db / 20.0f);
+    const long long scan_frames = static_cast<long long>(MAX_SCAN_SECONDS * rate);
+    const size_t block_frames = 8192;
+    std::vector<float> block(block_frames * channels);
+
+    trim.start_ms = 0;
+    trim.end_ms = -1;
+
+    // Leading silence; last tracks the newest audible frame seen, which is
+    // all the trailing scan needs when the length is unknown
+    long long frame = 0;
+    long long first = -1;
+    long long last = -1;
+    bool end_of_stream = false;
+    while (first < 0 && frame < scan_frames) {
+        size_t frames = decoder->Read(block.data(), block_frames);
+        if (frames == 0) {
+            end_of_stream = true;
+            break;
+        }
+        size_t samples = frames * channels;
+        size_t index = FindFirstAbove(block.data(), samples, threshold);
+        if (index < samples) {
+            first = frame + static_cast<long long>(index / channels);
+            last = frame + static_cast<long long>(FindLastAbove(block.data(), samples, threshold) / channels);
+        }
+        frame += static_cast<long long>(frames);
+    }
+    if (first < 0) {
+        // Silent throughout, or a long intro we will not second-guess
+        return true;
+    }
+
+    // Trailing silence: jump to the last stretch when the length is known,
+    // otherwise keep decoding to the end
+    long long total = decoder->GetTotalFrames();
+    long long tail_start = frame;
+    if (total > 0 && total - scan_frames > frame && decoder->Seek(total - scan_frames)) {
+        tail_start = total - scan_frames;
+        frame = tail_start;
+        last = -1;
+    }
+    while (!end_of_stream) {
+        size_t frames = decoder->Read(block.data(), block_frames);
+        if (frames == 0) break;
+        size_t samples = frames * channels;
+        size_t index = FindLastAbove(block.data(), samples, threshold);
+        if (index < samples) {
+            last = frame + static_cast<long long>(index / channels);
+        }
+        frame += static_cast<long long>(frames);
+    }
+    const long long length = frame;
+
+    long long start_ms = first * 1000 / rate - PAD_MS;
+    if (start_ms >= MIN_TRIM_MS) {
+        trim.start_ms = start_ms;
+    }
+
+    // Nothing audible in the tail means at least that much silence
+    long long content_end = last >= 0 ? last + 1 : tail_start;
+    long long end_ms = content_end * 1000 / rate + PAD_MS;
+    if ((length - content_end) * 1000 / rate >= MIN_TRIM_MS + PAD_MS && end_ms > trim.start_ms) {
+        trim.end_ms = end_ms;
+    }
+    return true;
+}
+
+TrimCache& TrimCache::Get()
+{
+    static TrimCache instance;
+    return instance;
+}
+
+bool TrimCache::Load(const std::string& path)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return cache.Load(path);
+}
+
+bool TrimCache::Save()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return cache.Save();
+}
+
+bool TrimCache::Lookup(const std::string& path, TrimPoints& trim) const
+{
+    long long size;
+    long long modified;
+    if (!FileCacheBase::Stat(path, size, modified)) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    const TrimPoints* known = cache.Lookup(path, size, modified);
+    if (!known) {
+        return false;
+    }
+    trim = *known;
+    return true;
+}
+
+void TrimCache::Store(const std::string& path, const TrimPoints& trim)
+{
+    long long size;
+    long long modified;
+    if (!FileCacheBase::Stat(path, size, modified)) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    cache.Store(path, size, modified, trim);
+}
+
+void TrimCache::Rename(const std::string& from, const std::string& to, bool folder)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    cache.Rename(from, to, folder);
+}
+
+bool TrimCache::Queue(const std::string& path, ThreadPool& pool)
+{
+    TrimPoints trim;
+    if (Lookup(path, trim)) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!queued.insert(path).second) {
+            return false;
+        }
+    }
+
+    pool.Submit([this, path] {
+        TrimPoints result;
+        if (SilenceDetector::AnalyzeFile(path, result)) {
+            Store(path, result);
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        queued.erase(path);
+    });
+    return true;
+}
+
+}
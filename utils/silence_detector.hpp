@@ -0,0 +1,75 @@
+#ifndef __SILENCE_DETECTOR_HPP
+#define __SILENCE_DETECTOR_HPP
+
+#include "file_cache.hpp"
+#include <cstddef>
+#include <istream>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_set>
+
+namespace utils {
+
+class ThreadPool;
+
+// Where audible content starts and ends in a file, in milliseconds.
+// end_ms is -1 when the file does not end in silence worth trimming.
+struct TrimPoints {
+    long long start_ms;
+    long long end_ms;
+
+    bool Read(std::istream& fields) { return static_cast<bool>(fields >> start_ms >> end_ms); }
+    void Write(std::ostream& out) const { out << '\t' << start_ms << '\t' << end_ms; }
+};
+
+// Finds leading and trailing digital silence in decoded PCM.
+//
+// Only the first and last MAX_SCAN_SECONDS are decoded; the scans compare
+// whole vectors of samples against the threshold and only drop to scalar
+// code for the vector that holds the first (or last) audible sample.
+class SilenceDetector {
+public:
+    // Index of the first / last sample whose magnitude exceeds threshold,
+    // or count when there is none
+    static size_t FindFirstAbove(const float* samples, size_t count, float threshold);
+    static size_t FindLastAbove(const float* samples, size_t count, float threshold);
+
+    static bool AnalyzeFile(const std::string& path, TrimPoints& trim, float threshold_db = DEFAULT_THRESHOLD_DB);
+
+    static constexpr float DEFAULT_THRESHOLD_DB = -60.0f;
+    static constexpr double MAX_SCAN_SECONDS = 30.0;
+    static constexpr long long MIN_TRIM_MS = 250;    // shorter silences are left alone
+    static constexpr long long PAD_MS = 20;          // kept before and after the content
+};
+
+// Per-file trim points, persisted as a tab-separated file.
+//
+// Entries remember the file's size and modification time (see FileCache).
+// Queue() runs the analysis on a pool and skips files that are already
+// known or queued. All methods are thread-safe.
+class TrimCache {
+public:
+    static TrimCache& Get();
+
+    bool Load(const std::string& file);
+    bool Save();
+
+    bool Lookup(const std::string& path, TrimPoints& trim) const;
+    void Store(const std::string& path, const TrimPoints& trim);
+    void Rename(const std::string& from, const std::string& to, bool folder);   // see FileCache
+
+    // True if an analysis job was queued
+    bool Queue(const std::string& path, ThreadPool& pool);
+
+private:
+    TrimCache() = default;
+
+    mutable std::mutex mutex;
+    FileCache<TrimPoints> cache;
+    std::unordered_set<std::string> queued;
+};
+
+}
+
+#endif // __SILENCE_DETECTOR_HPP
@@ -0,0 +1,932 @@
+#include "smart_query.hpp"
+#include "multi_key_sort.hpp"
+#include "natural_sort.hpp"
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <limits>
+
+namespace utils {
+
+namespace {
+
+const uint64_t SIGN_BIT = 1ULL << 63;
+
+struct FieldName {
+    const char* name;
+    TrackTable::Field field;
+};
+
+const FieldName FIELD_NAMES[] = {
+    { "title", TrackTable::TITLE },
+    { "artist", TrackTable::ARTIST },
+    { "album", TrackTable::ALBUM },
+    { "genre", TrackTable::GENRE },
+    { "path", TrackTable::PATH },
+    { "file", TrackTable::PATH },
+    { "duration", TrackTable::DURATION },
+    { "length", TrackTable::DURATION },
+    { "playcount", TrackTable::PLAY_COUNT },
+    { "plays", TrackTable::PLAY_COUNT },
+    { "track", TrackTable::TRACK },
+    { "disc", TrackTable::DISC },
+    { "size", TrackTable::FILE_SIZE },
+    { "added", TrackTable::DATE_ADDED },
+};
+
+std::string FoldAscii(std::string_view text)
+{
+    std::string folded(text);
+    for (char& c : folded) {
+        if (c >= 'A' && c <= 'Z') {
+            c = static_cast<char>(c - 'A' + 'a');
+        }
+    }
+    return folded;
+}
+
+bool EqualsIgnoreCase(std::string_view a, std::string_view b)
+{
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+        return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y));
+    });
+}
+
+bool FindField(std::string_view name, TrackTable::Field& field)
+{
+    for (const FieldName& entry : FIELD_NAMES) {
+        if (EqualsIgnoreCase(name, entry.name)) {
+            field = entry.field;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Days since 1970-01-01 in the proleptic Gregorian calendar
+int64_t DaysFromCivil(int64_t year, int64_t month, int64_t day)
+{
+    year -= month <= 2;
+    int64_t era = (year >= 0 ? year : year - 399) / 400;
+    int64_t year_of_era = year - era * 400;
+    int64_t day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int64_t day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    return era * 146097 + day_of_era - 719468;
+}
+
+// A number with an optional unit suffix; false if it is not one
+bool SplitNumber(const std::string& value, double& number, std::string& unit)
+{
+    const char* begin = value.c_str();
+    char* end = nullptr;
+    number = std::strtod(begin, &end);
+    if (end == begin || number < 0) {
+        return false;
+    }
+    unit = FoldAscii(end);
+    return true;
+}
+
+// Numbers in a query stay below this, so that subtracting a relative age
+// from the current time cannot overflow
+const double MAX_NUMBER = 4611686018427387904.0;      // 2^62
+
+// A scaled number as a whole number; false if it is out of range
+bool ToWholeNumber(double number, int64_t& result)
+{
+    if (!(number < MAX_NUMBER)) {
+        return false;
+    }
+    result = static_cast<int64_t>(number);
+    return true;
+}
+
+// 64 rows per word, bit j of word w being row 64 * w + j
+template <typename Predicate>
+void FillBitmap(size_t rows, std::vector<uint64_t>& bitmap, Predicate predicate)
+{
+    bitmap.assign((rows + 63) / 64, 0);
+    for (size_t w = 0; w < bitmap.size(); w++) {
+        const size_t base = w * 64;
+        const size_t count = std::min<size_t>(64, rows - base);
+        uint64_t bits = 0;
+        for (size_t j = 0; j < count; j++) {
+            bits |= static_cast<uint64_t>(predicate(base + j)) << j;
+        }
+        bitmap[w] = bits;
+    }
+}
+
+template <typename Compare>
+void CompareColumn(const std::vector<int64_t>& column, int64_t bound, std::vector<uint64_t>& bitmap, Compare compare)
+{
+    const int64_t* values = column.data();
+    FillBitmap(column.size(), bitmap, [=](size_t row) { return compare(values[row], bound); });
+}
+
+}
+
+// TrackTable implementation
+uint32_t TrackTable::Add(const Row& row)
+{
+    const uint32_t id = static_cast<uint32_t>(row_count++);
+    if (GetWordCount() > live.size()) {
+        live.push_back(0);
+        for (TextColumn& column : text_columns) {
+            for (std::vector<uint64_t>& bitmap : column.bitmaps) {
+                bitmap.push_back(0);
+            }
+        }
+    }
+    live[id / 64] |= 1ULL << (id % 64);
+
+    for (int f = 0; f < TEXT_FIELDS; f++) {
+        SetText(static_cast<Field>(f), id, row.text[f]);
+    }
+    for (int n = 0; n < NUMBER_FIELDS; n++) {
+        number_columns[n].push_back(row.numbers[n]);
+    }
+    return id;
+}
+
+void TrackTable::Update(uint32_t id, const Row& row)
+{
+    if (id >= row_count) {
+        return;
+    }
+    for (int f = 0; f < TEXT_FIELDS; f++) {
+        SetText(static_cast<Field>(f), id, row.text[f]);
+    }
+    for (int n = 0; n < NUMBER_FIELDS; n++) {
+        number_columns[n][id] = row.numbers[n];
+    }
+}
+
+void TrackTable::Remove(uint32_t id)
+{
+    if (id < row_count) {
+        live[id / 64] &= ~(1ULL << (id % 64));
+    }
+}
+
+bool TrackTable::IsLive(uint32_t id) const
+{
+    return id < row_count && (live[id / 64] >> (id % 64)) & 1;
+}
+
+void TrackTable::SetText(Field field, uint32_t id, const std::string& text)
+{
+    TextColumn& column = text_columns[field];
+    auto [it, added] = column.lookup.try_emplace(FoldAscii(text), static_cast<uint32_t>(column.values.size()));
+    if (added) {
+        column.values.push_back(it->first);
+        column.ranks_valid = false;
+        if (column.bitmapped && column.values.size() > BITMAP_MAX_VALUES) {
+            // Too many values for a bitmap each; scan the ids instead
+            column.bitmapped = false;
+            column.bitmaps = {};
+        } else if (column.bitmapped) {
+            column.bitmaps.emplace_back(GetWordCount(), 0);
+        }
+    }
+
+    const uint32_t value = it->second;
+    if (id < column.ids.size()) {
+        if (column.bitmapped) {
+            column.bitmaps[column.ids[id]][id / 64] &= ~(1ULL << (id % 64));
+        }
+        column.ids[id] = value;
+    } else {
+        column.ids.push_back(value);
+    }
+    if (column.bitmapped) {
+        column.bitmaps[value][id / 64] |= 1ULL << (id % 64);
+    }
+}
+
+const std::vector<uint32_t>& TrackTable::GetRanks(Field field)
+{
+    TextColumn& column = text_columns[field];
+    if (!column.ranks_valid) {
+        std::vector<std::string> keys;
+        keys.reserve(column.values.size());
+        for (const std::string& value : column.values) {
+            keys.push_back(NaturalSort::MakeKey(value));
+        }
+        std::vector<uint32_t> order;
+        NaturalSort::Sort(keys, order);
+
+        // Values that collate alike share a rank
+        column.ranks.resize(keys.size());
+        uint32_t rank = 0;
+        for (size_t i = 0; i < order.size(); i++) {
+            if (i > 0 && keys[order[i]] != keys[order[i - 1]]) {
+                rank++;
+            }
+            column.ranks[order[i]] = rank;
+        }
+        column.ranks_valid = true;
+    }
+    return column.ranks;
+}
+
+// Recursive descent over the query text, emitting the filter in postfix
+struct SmartQuery::Parser {
+    std::string_view text;
+    size_t pos;
+    SmartQuery& query;
+    std::string error;
+
+    Parser(std::string_view text, SmartQuery& query)
+        : text(text)
+        , pos(0)
+        , query(query)
+    {
+    }
+
+    bool Fail(const std::string& message)
+    {
+        if (error.empty()) {
+            error = message + " at column " + std::to_string(pos + 1);
+        }
+        return false;
+    }
+
+    void SkipSpace()
+    {
+        while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos]))) {
+            pos++;
+        }
+    }
+
+    bool AtEnd()
+    {
+        SkipSpace();
+        return pos >= text.size();
+    }
+
+    static bool IsWordChar(char c)
+    {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+    }
+
+    std::string_view PeekWord()
+    {
+        SkipSpace();
+        size_t end = pos;
+        while (end < text.size() && IsWordChar(text[end])) {
+            end++;
+        }
+        return text.substr(pos, end - pos);
+    }
+
+    bool PeekKeyword(const char* keyword)
+    {
+        // A field named like a keyword is followed by its operator
+        std::string_view word = PeekWord();
+        size_t end = pos + word.size();
+        bool standalone = end >= text.size() || std::string_view(":=!<>").find(text[end]) == std::string_view::npos;
+        return standalone && EqualsIgnoreCase(word, keyword);
+    }
+
+    bool TakeKeyword(const char* keyword)
+    {
+        if (!PeekKeyword(keyword)) {
+            return false;
+        }
+        pos += std::string_view(keyword).size();
+        return true;
+    }
+
+    bool Parse()
+    {
+        if (!AtEnd() && !PeekKeyword("ORDER") && !PeekKeyword("LIMIT")) {
+            if (!ParseOr()) {
+                return false;
+            }
+        }
+
+        if (TakeKeyword("ORDER")) {
+            if (!TakeKeyword("BY")) {
+                return Fail("expected BY after ORDER");
+            }
+            while (true) {
+                std::string_view name = PeekWord();
+                OrderKey key = { TrackTable::TITLE, true };
+                if (!FindField(name, key.field)) {
+                    return Fail("unknown field '" + std::string(name) + "'");
+                }
+                pos += name.size();
+                if (TakeKeyword("DESC")) {
+                    key.ascending = false;
+                } else {
+                    TakeKeyword("ASC");
+                }
+                query.order.push_back(key);
+                SkipSpace();
+                if (pos >= text.size() || text[pos] != ',') {
+                    break;
+                }
+                pos++;
+            }
+        }
+
+        if (TakeKeyword("LIMIT")) {
+            std::string_view count = PeekWord();
+            if (count.empty() || !std::all_of(count.begin(), count.end(), ::isdigit)) {
+                return Fail("expected a number after LIMIT");
+            }
+            query.limit = std::strtoull(std::string(count).c_str(), nullptr, 10);
+            pos += count.size();
+        }
+
+        if (!AtEnd()) {
+            return Fail("unexpected '" + std::string(text.substr(pos, 16)) + "'");
+        }
+        return true;
+    }
+
+    bool ParseOr()
+    {
+        if (!ParseAnd()) {
+            return false;
+        }
+        while (TakeKeyword("OR")) {
+            if (!ParseAnd()) {
+                return false;
+            }
+            Emit(OpCode::OR);
+        }
+        return true;
+    }
+
+    // AND may be left out between terms
+    bool ParseAnd()
+    {
+        if (!ParseUnary()) {
+            return false;
+        }
+        while (!AtEnd() && text[pos] != ')' && !PeekKeyword("OR") && !PeekKeyword("ORDER") &&
+               !PeekKeyword("LIMIT")) {
+            TakeKeyword("AND");
+            if (!ParseUnary()) {
+                return false;
+            }
+            Emit(OpCode::AND);
+        }
+        return true;
+    }
+
+    bool ParseUnary()
+    {
+        if (TakeKeyword("NOT")) {
+            if (!ParseUnary()) {
+                return false;
+            }
+            Emit(OpCode::NOT);
+            return true;
+        }
+        if (AtEnd()) {
+            return Fail("expected a search term");
+        }
+        if (text[pos] == '(') {
+            pos++;
+            if (!ParseOr()) {
+                return false;
+            }
+            if (AtEnd() || text[pos] != ')') {
+                return Fail("expected ')'");
+            }
+            pos++;
+            return true;
+        }
+        return ParsePredicate();
+    }
+
+    bool ParsePredicate()
+    {
+        std::string_view name = PeekWord();
+        size_t after = pos + name.size();
+        bool has_operator = !name.empty() && after < text.size() &&
+                            std::string_view(":=!<>").find(text[after]) != std::string_view::npos;
+        if (!has_operator) {
+            std::string word;
+            if (!ParseValue(word)) {
+                return false;
+            }
+            for (const char* keyword : { "AND", "OR", "NOT", "ORDER", "LIMIT" }) {
+                if (EqualsIgnoreCase(word, keyword) && text[pos - 1] != '"') {
+                    return Fail("expected a search term before " + word);
+                }
+            }
+            return EmitAnyText(word);
+        }
+
+        TrackTable::Field field;
+        if (!FindField(name, field)) {
+            return Fail("unknown field '" + std::string(name) + "'");
+        }
+        pos = after;
+
+        Compare compare;
+        if (TakeOperator(":")) {
+            compare = Compare::CONTAINS;
+        } else if (TakeOperator("==") || TakeOperator("=")) {
+            compare = Compare::EQUAL;
+        } else if (TakeOperator("!=")) {
+            compare = Compare::NOT_EQUAL;
+        } else if (TakeOperator("<=")) {
+            compare = Compare::LESS_EQUAL;
+        } else if (TakeOperator("<")) {
+            compare = Compare::LESS;
+        } else if (TakeOperator(">=")) {
+            compare = Compare::GREATER_EQUAL;
+        } else if (TakeOperator(">")) {
+            compare = Compare::GREATER;
+        } else {
+            return Fail("expected an operator after " + std::string(name));
+        }
+
+        std::string value;
+        if (!ParseValue(value)) {
+            return false;
+        }
+
+        Op op = { OpCode::TEXT, field, compare, {}, 0, false, {} };
+        if (TrackTable::IsTextField(field)) {
+            if (compare != Compare::CONTAINS && compare != Compare::EQUAL && compare != Compare::NOT_EQUAL) {
+                return Fail(std::string(name) + " is text and only takes :, = or !=");
+            }
+            op.text = FoldAscii(value);
+        } else {
+            op.code = OpCode::NUMBER;
+            if (op.compare == Compare::CONTAINS) {
+                op.compare = Compare::EQUAL;
+            }
+            if (!ParseNumber(op, value)) {
+                if (field == TrackTable::DATE_ADDED) {
+                    return Fail("added takes an age like 30d or a date like 2024-01-31, not '" + value + "'");
+                }
+                return Fail("'" + value + "' is not a valid " + std::string(name));
+            }
+            if (op.relative) {
+                // An age below the bound is a time above it
+                switch (op.compare) {
+                case Compare::LESS: op.compare = Compare::GREATER; break;
+                case Compare::LESS_EQUAL: op.compare = Compare::GREATER_EQUAL; break;
+                case Compare::GREATER: op.compare = Compare::LESS; break;
+                case Compare::GREATER_EQUAL: op.compare = Compare::LESS_EQUAL; break;
+                default: return Fail("use < or > with an age like " + value);
+                }
+            }
+        }
+        query.program.push_back(std::move(op));
+        return true;
+    }
+
+    bool TakeOperator(std::string_view op)
+    {
+        if (text.substr(pos, op.size()) == op) {
+            pos += op.size();
+            return true;
+        }
+        return false;
+    }
+
+    // A "quoted string" or everything up to a space or parenthesis
+    bool ParseValue(std::string& value)
+    {
+        if (pos < text.size() && text[pos] == '"') {
+            size_t end = text.find('"', pos + 1);
+            if (end == std::string_view::npos) {
+                return Fail("unterminated quote");
+            }
+            value = text.substr(pos + 1, end - pos - 1);
+            pos = end + 1;
+            return true;
+        }
+        size_t end = pos;
+        while (end < text.size() && !std::isspace(static_cast<unsigned char>(text[end])) &&
+               text[end] != '(' && text[end] != ')') {
+            end++;
+        }
+        if (end == pos) {
+            return Fail("expected a value");
+        }
+        value = text.substr(pos, end - pos);
+        pos = end;
+        return true;
+    }
+
+    bool ParseNumber(Op& op, const std::string& value)
+    {
+        double number;
+        std::string unit;
+
+        switch (op.field) {
+        case TrackTable::DURATION: {
+            // h:mm:ss or m:ss
+            if (value.find(':') != std::string::npos) {
+                double seconds = 0;
+                size_t start = 0;
+                while (start <= value.size()) {
+                    size_t end = std::min(value.find(':', start), value.size());
+                    std::string part = value.substr(start, end - start);
+                    if (part.empty() || !std::all_of(part.begin(), part.end(), ::isdigit)) {
+                        return false;
+                    }
+                    seconds = seconds * 60 + std::strtod(part.c_str(), nullptr);
+                    start = end + 1;
+                }
+                return ToWholeNumber(seconds, op.number);
+            }
+            if (!SplitNumber(value, number, unit)) {
+                return false;
+            }
+            double scale = unit.empty() || unit == "s" ? 1 : unit == "m" || unit == "min" ? 60 : unit == "h" ? 3600 : 0;
+            return scale > 0 && ToWholeNumber(number * scale, op.number);
+        }
+        case TrackTable::FILE_SIZE: {
+            if (!SplitNumber(value, number, unit)) {
+                return false;
+            }
+            double scale = unit.empty() || unit == "b" ? 1
+                         : unit == "k" || unit == "kb" ? 1024.0
+                         : unit == "m" || unit == "mb" ? 1024.0 * 1024
+                         : unit == "g" || unit == "gb" ? 1024.0 * 1024 * 1024 : 0;
+            return scale > 0 && ToWholeNumber(number * scale, op.number);
+        }
+        case TrackTable::DATE_ADDED: {
+            int year, month, day;
+            char dash1, dash2;
+            if (value.size() == 10 && std::sscanf(value.c_str(), "%4d%c%2d%c%2d", &year, &dash1, &month, &dash2, &day) == 5 &&
+                dash1 == '-' && dash2 == '-' && month >= 1 && month <= 12 && day >= 1 && day <= 31) {
+                op.number = DaysFromCivil(year, month, day) * 86400;
+                return true;
+            }
+            if (!SplitNumber(value, number, unit)) {
+                return false;
+            }
+            double scale = unit == "h" ? 3600 : unit == "d" ? 86400 : unit == "w" ? 7 * 86400 : unit == "y" ? 365 * 86400 : 0;
+            op.relative = true;
+            return scale > 0 && ToWholeNumber(number * scale, op.number);
+        }
+        default:
+            if (value.empty() || !std::all_of(value.begin(), value.end(), ::isdigit)) {
+                return false;
+            }
+            return ToWholeNumber(std::strtod(value.c_str(), nullptr), op.number);
+        }
+    }
+
+    void Emit(OpCode code)
+    {
+        query.program.push_back({ code, TrackTable::TITLE, Compare::EQUAL, {}, 0, false, {} });
+    }
+
+    bool EmitAnyText(const std::string& word)
+    {
+        std::string folded = FoldAscii(word);
+        const TrackTable::Field fields[] = { TrackTable::TITLE, TrackTable::ARTIST, TrackTable::ALBUM };
+        for (size_t i = 0; i < std::size(fields); i++) {
+            query.program.push_back({ OpCode::TEXT, fields[i], Compare::CONTAINS, folded, 0, false, {} });
+            if (i > 0) {
+                Emit(OpCode::OR);
+            }
+        }
+        return true;
+    }
+};
+
+// SmartQuery implementation
+bool SmartQuery::Parse(std::string_view text, std::string& error)
+{
+    program.clear();
+    order.clear();
+    limit = 0;
+
+    Parser parser(text, *this);
+    if (!parser.Parse()) {
+        error = parser.error;
+        program.clear();
+        order.clear();
+        limit = 0;
+        return false;
+    }
+    return true;
+}
+
+const std::vector<uint8_t>& SmartQuery::GetValueMatches(TrackTable& table, Op& op)
+{
+    // Decided once per distinct value, as values appear
+    const std::vector<std::string>& values = table.text_columns[op.field].values;
+    for (size_t id = op.value_matches.size(); id < values.size(); id++) {
+        bool match = op.compare == Compare::CONTAINS ? values[id].find(op.text) != std::string::npos
+                   : op.compare == Compare::EQUAL    ? values[id] == op.text
+                                                     : values[id] != op.text;
+        op.value_matches.push_back(match);
+    }
+    return op.value_matches;
+}
+
+void SmartQuery::Evaluate(TrackTable& table, int64_t now, std::vector<uint64_t>& result)
+{
+    const size_t rows = table.GetRowCount();
+    const size_t words = table.GetWordCount();
+    std::vector<std::vector<uint64_t>> stack;
+
+    for (Op& op : program) {
+        switch (op.code) {
+        case OpCode::TEXT: {
+            const TrackTable::TextColumn& column = table.text_columns[op.field];
+            const std::vector<uint8_t>& matches = GetValueMatches(table, op);
+            stack.emplace_back();
+            std::vector<uint64_t>& bitmap = stack.back();
+            if (column.bitmapped) {
+                bitmap.assign(words, 0);
+                for (size_t id = 0; id < matches.size(); id++) {
+                    if (matches[id]) {
+                        const uint64_t* bits = column.bitmaps[id].data();
+                        for (size_t w = 0; w < words; w++) {
+                            bitmap[w] |= bits[w];
+                        }
+                    }
+                }
+            } else {
+                const uint32_t* ids = column.ids.data();
+                const uint8_t* match = matches.data();
+                FillBitmap(rows, bitmap, [=](size_t row) { return match[ids[row]] != 0; });
+            }
+            break;
+        }
+        case OpCode::NUMBER: {
+            const std::vector<int64_t>& column = table.number_columns[op.field - TrackTable::TEXT_FIELDS];
+            const int64_t bound = op.relative ? now - op.number : op.number;
+            stack.emplace_back();
+            std::vector<uint64_t>& bitmap = stack.back();
+            switch (op.compare) {
+            case Compare::LESS: CompareColumn(column, bound, bitmap, std::less<int64_t>()); break;
+            case Compare::LESS_EQUAL: CompareColumn(column, bound, bitmap, std::less_equal<int64_t>()); break;
+            case Compare::GREATER: CompareColumn(column, bound, bitmap, std::greater<int64_t>()); break;
+            case Compare::GREATER_EQUAL: CompareColumn(column, bound, bitmap, std::greater_equal<int64_t>()); break;
+            case Compare::NOT_EQUAL: CompareColumn(column, bound, bitmap, std::not_equal_to<int64_t>()); break;
+            default: CompareColumn(column, bound, bitmap, std::equal_to<int64_t>()); break;
+            }
+            break;
+        }
+        case OpCode::AND:
+        case OpCode::OR: {
+            std::vector<uint64_t> right = std::move(stack.back());
+            stack.pop_back();
+            std::vector<uint64_t>& left = stack.back();
+            for (size_t w = 0; w < words; w++) {
+                left[w] = op.code == OpCode::AND ? left[w] & right[w] : left[w] | right[w];
+            }
+            break;
+        }
+        case OpCode::NOT:
+            for (uint64_t& word : stack.back()) {
+                word = ~word;
+            }
+            break;
+        }
+    }
+
+    // NOT sets the bits past the last row too; the live mask clears them
+    result = table.live;
+    if (!stack.empty()) {
+        for (size_t w = 0; w < words; w++) {
+            result[w] &= stack.back()[w];
+        }
+    }
+}
+
+bool SmartQuery::Matches(TrackTable& table, uint32_t row, int64_t now)
+{
+    if (!table.IsLive(row)) {
+        return false;
+    }
+
+    std::vector<bool> stack;
+    for (Op& op : program) {
+        switch (op.code) {
+        case OpCode::TEXT:
+            stack.push_back(GetValueMatches(table, op)[table.text_columns[op.field].ids[row]] != 0);
+            break;
+        case OpCode::NUMBER: {
+            const int64_t value = table.number_columns[op.field - TrackTable::TEXT_FIELDS][row];
+            const int64_t bound = op.relative ? now - op.number : op.number;
+            bool match;
+            switch (op.compare) {
+            case Compare::LESS: match = value < bound; break;
+            case Compare::LESS_EQUAL: match = value <= bound; break;
+            case Compare::GREATER: match = value > bound; break;
+            case Compare::GREATER_EQUAL: match = value >= bound; break;
+            case Compare::NOT_EQUAL: match = value != bound; break;
+            default: match = value == bound; break;
+            }
+            stack.push_back(match);
+            break;
+        }
+        case OpCode::AND:
+        case OpCode::OR: {
+            bool right = stack.back();
+            stack.pop_back();
+            stack.back() = op.code == OpCode::AND ? stack.back() && right : stack.back() || right;
+            break;
+        }
+        case OpCode::NOT:
+            stack.back() = !stack.back();
+            break;
+        }
+    }
+    return stack.empty() || stack.back();
+}
+
+bool SmartQuery::Less(TrackTable& table, uint32_t a, uint32_t b)
+{
+    for (const OrderKey& key : order) {
+        int64_t value_a, value_b;
+        if (TrackTable::IsTextField(key.field)) {
+            const std::vector<uint32_t>& ranks = table.GetRanks(key.field);
+            const std::vector<uint32_t>& ids = table.text_columns[key.field].ids;
+            value_a = ranks[ids[a]];
+            value_b = ranks[ids[b]];
+        } else {
+            const std::vector<int64_t>& column = table.number_columns[key.field - TrackTable::TEXT_FIELDS];
+            value_a = column[a];
+            value_b = column[b];
+        }
+        if (value_a != value_b) {
+            return key.ascending ? value_a < value_b : value_a > value_b;
+        }
+    }
+    return a < b;
+}
+
+void SmartQuery::Sort(TrackTable& table, std::vector<uint32_t>& rows)
+{
+    if (order.empty()) {
+        return;
+    }
+
+    // The matching rows' sort columns, gathered once for the radix sort
+    std::vector<MultiKeySort::Key> keys(order.size());
+    for (size_t k = 0; k < order.size(); k++) {
+        std::vector<uint64_t>& values = keys[k].values;
+        keys[k].ascending = order[k].ascending;
+        values.resize(rows.size());
+        if (TrackTable::IsTextField(order[k].field)) {
+            const std::vector<uint32_t>& ranks = table.GetRanks(order[k].field);
+            const std::vector<uint32_t>& ids = table.text_columns[order[k].field].ids;
+            for (size_t i = 0; i < rows.size(); i++) {
+                values[i] = ranks[ids[rows[i]]];
+            }
+        } else {
+            const std::vector<int64_t>& column = table.number_columns[order[k].field - TrackTable::TEXT_FIELDS];
+            for (size_t i = 0; i < rows.size(); i++) {
+                values[i] = static_cast<uint64_t>(column[rows[i]]) ^ SIGN_BIT;
+            }
+        }
+    }
+
+    std::vector<uint32_t> positions;
+    MultiKeySort::Sort(keys, positions);
+    std::vector<uint32_t> sorted(rows.size());
+    for (size_t i = 0; i < positions.size(); i++) {
+        sorted[i] = rows[positions[i]];
+    }
+    rows = std::move(sorted);
+}
+
+void SmartQuery::Run(TrackTable& table, int64_t now, std::vector<uint32_t>& rows)
+{
+    std::vector<uint64_t> bitmap;
+    Evaluate(table, now, bitmap);
+
+    rows.clear();
+    for (size_t w = 0; w < bitmap.size(); w++) {
+        for (uint64_t bits = bitmap[w]; bits != 0; bits &= bits - 1) {
+            rows.push_back(static_cast<uint32_t>(w * 64 + std::countr_zero(bits)));
+        }
+    }
+    Sort(table, rows);
+    if (limit > 0 && rows.size() > limit) {
+        rows.resize(limit);
+    }
+}
+
+// SmartPlaylist implementation
+SmartPlaylist::SmartPlaylist(TrackTable& table, const SmartQuery& query)
+    : table(table)
+    , query(query)
+    , now(0)
+{
+}
+
+void SmartPlaylist::Refresh(int64_t now)
+{
+    this->now = now;
+
+    // Rows may age into or out of the result; what stays visible cancels
+    // out in TakeChanges()
+    for (size_t i = 0; i < GetVisibleCount(); i++) {
+        SetVisible(matches[i], false);
+    }
+
+    // The whole result, not just the limit, so rows can drop out later
+    const size_t limit = query.limit;
+    query.limit = 0;
+    query.Run(table, now, matches);
+    query.limit = limit;
+
+    is_match.assign(table.GetRowCount(), false);
+    for (uint32_t row : matches) {
+        is_match[row] = true;
+    }
+    for (size_t i = 0; i < GetVisibleCount(); i++) {
+        SetVisible(matches[i], true);
+    }
+}
+
+bool SmartPlaylist::Update(uint32_t row)
+{
+    const bool was = row < is_match.size() && is_match[row];
+    const bool is = query.Matches(table, row, now);
+    if (!was && !is) {
+        return false;
+    }
+
+    // Besides the row itself, the row at the edge of the limit may move in
+    // (when the row leaves the visible part) or out (when it enters it)
+    const size_t visible = query.limit > 0 ? query.limit : std::numeric_limits<size_t>::max();
+    size_t old_position = visible;
+    if (was) {
+        auto it = std::find(matches.begin(), matches.end(), row);
+        old_position = static_cast<size_t>(it - matches.begin());
+        matches.erase(it);
+        if (old_position < visible && matches.size() >= visible) {
+            SetVisible(matches[visible - 1], true);
+        }
+    }
+
+    size_t new_position = visible;
+    if (is) {
+        auto it = std::lower_bound(matches.begin(), matches.end(), row, [this](uint32_t a, uint32_t b) {
+            return query.Less(table, a, b);
+        });
+        new_position = static_cast<size_t>(it - matches.begin());
+        matches.insert(it, row);
+        if (new_position < visible && matches.size() > visible) {
+            SetVisible(matches[visible], false);
+        }
+    }
+
+    if (row >= is_match.size()) {
+        is_match.resize(row + 1, false);
+    }
+    is_match[row] = is;
+    SetVisible(row, new_position < visible);
+    return old_position < visible || new_position < visible;
+}
+
+void SmartPlaylist::GetRows(std::vector<uint32_t>& rows) const
+{
+    rows.assign(matches.begin(), matches.begin() + GetVisibleCount());
+}
+
+void SmartPlaylist::TakeChanges(std::vector<uint32_t>& added, std::vector<uint32_t>& removed)
+{
+    added.clear();
+    removed.clear();
+    for (uint32_t row : changed) {
+        if (is_visible[row] == was_visible[row]) {
+            continue;
+        }
+        was_visible[row] = is_visible[row];
+        (is_visible[row] ? added : removed).push_back(row);
+    }
+    changed.clear();
+}
+
+size_t SmartPlaylist::GetVisibleCount() const
+{
+    return query.limit > 0 ? std::min(query.limit, matches.size()) : matches.size();
+}
+
+void SmartPlaylist::SetVisible(uint32_t row, bool visible)
+{
+    if (row >= is_visible.size()) {
+        is_visible.resize(row + 1, false);
+        was_visible.resize(row + 1, false);
+    }
+    if (is_visible[row] != visible) {
+        is_visible[row] = visible;
+        changed.push_back(row);
+    }
+}
+
+}
@@ -0,0 +1,178 @@
+#ifndef __SMART_QUERY_HPP
+#define __SMART_QUERY_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace utils {
+
+// Column store of track metadata for smart playlist queries.
+//
+// Text is dictionary-encoded: a row holds a value id per text field, and a
+// predicate is decided once per distinct value. While a field has at most
+// BITMAP_MAX_VALUES distinct values (genres, usually) it also keeps a row
+// bitmap per value, so a predicate on it is an OR of a few bitmaps instead
+// of a scan. Numbers are plain int64 columns.
+//
+// Text is ASCII case-folded on the way in; callers fold anything wider.
+// Row ids are handed out in increasing order and never reused; Remove()
+// only clears the row's live bit. Not thread-safe.
+class TrackTable {
+public:
+    enum Field {
+        // Text
+        TITLE, ARTIST, ALBUM, GENRE, PATH,
+        // Numbers: seconds, a count, positions, bytes and a Unix time
+        DURATION, PLAY_COUNT, TRACK, DISC, FILE_SIZE, DATE_ADDED,
+        FIELD_COUNT
+    };
+    static const int TEXT_FIELDS = PATH + 1;
+    static const int NUMBER_FIELDS = FIELD_COUNT - TEXT_FIELDS;
+
+    struct Row {
+        std::array<std::string, TEXT_FIELDS> text;
+        std::array<int64_t, NUMBER_FIELDS> numbers = {};
+    };
+
+    uint32_t Add(const Row& row);
+    void Update(uint32_t id, const Row& row);
+    void Remove(uint32_t id);
+
+    size_t GetRowCount() const { return row_count; }     // including removed rows
+    bool IsLive(uint32_t id) const;
+
+    static bool IsTextField(Field field) { return field < TEXT_FIELDS; }
+
+    static const size_t BITMAP_MAX_VALUES = 64;
+
+private:
+    friend class SmartQuery;
+
+    struct TextColumn {
+        std::vector<uint32_t> ids;                  // value id per row
+        std::vector<std::string> values;            // by id
+        std::unordered_map<std::string, uint32_t> lookup;
+        std::vector<std::vector<uint64_t>> bitmaps; // rows per value id, while bitmapped
+        bool bitmapped = true;
+        std::vector<uint32_t> ranks;                // natural order of values, by id
+        bool ranks_valid = false;
+    };
+
+    std::array<TextColumn, TEXT_FIELDS> text_columns;
+    std::array<std::vector<int64_t>, NUMBER_FIELDS> number_columns;
+    std::vector<uint64_t> live;
+    size_t row_count = 0;
+
+    void SetText(Field field, uint32_t id, const std::string& text);
+    const std::vector<uint32_t>& GetRanks(Field field);
+    size_t GetWordCount() const { return (row_count + 63) / 64; }
+};
+
+// A compiled smart playlist query.
+//
+//   genre:jazz AND duration>300 AND added<30d ORDER BY playcount DESC LIMIT 100
+//
+// Predicates are field:value (text contains it, a number equals it),
+// field=value and field!=value (exact), and <, <=, >, >= on numbers; a
+// bare word or "quoted phrase" looks in title, artist and album. They
+// combine with AND (or just a space), OR, NOT and parentheses. Durations
+// take 90, 90s, 5m, 1h or 3:30; sizes 500k, 10mb, 1gb; added takes an age
+// (12h, 30d, 2w, 1y, where added<30d means within the last 30 days) or a
+// date (2024-01-31). Keywords are case-insensitive.
+//
+// Parse() turns the filter into a postfix program. Run() executes it a
+// whole column at a time into row bitmaps, 64 rows per word, combining
+// them with word-wide AND, OR and NOT; Matches() runs it for one row.
+class SmartQuery {
+public:
+    // false with a message on a syntax error; the query is then empty
+    bool Parse(std::string_view text, std::string& error);
+
+    // Matching live rows in query order, at most the limit; ages are
+    // measured back from now (Unix seconds)
+    void Run(TrackTable& table, int64_t now, std::vector<uint32_t>& rows);
+
+    bool Matches(TrackTable& table, uint32_t row, int64_t now);
+
+    // Query order, ties by row id
+    bool Less(TrackTable& table, uint32_t a, uint32_t b);
+
+    size_t GetLimit() const { return limit; }    // 0 = none
+
+private:
+    friend class SmartPlaylist;
+
+    enum class OpCode { TEXT, NUMBER, AND, OR, NOT };
+    enum class Compare { CONTAINS, EQUAL, NOT_EQUAL, LESS, LESS_EQUAL, GREATER, GREATER_EQUAL };
+
+    struct Op {
+        OpCode code;
+        TrackTable::Field field;
+        Compare compare;
+        std::string text;
+        int64_t number;
+        bool relative;                      // number is an age back from now
+        std::vector<uint8_t> value_matches; // TEXT: the decision per value id so far
+    };
+
+    struct OrderKey {
+        TrackTable::Field field;
+        bool ascending;
+    };
+
+    struct Parser;
+
+    std::vector<Op> program;
+    std::vector<OrderKey> order;
+    size_t limit = 0;
+
+    void Evaluate(TrackTable& table, int64_t now, std::vector<uint64_t>& result);
+    const std::vector<uint8_t>& GetValueMatches(TrackTable& table, Op& op);
+    void Sort(TrackTable& table, std::vector<uint32_t>& rows);
+};
+
+// A live smart playlist: the query's result, kept up to date row by row.
+//
+// Update() re-tests only the row that changed and moves it within the
+// ordered result, so edits to the library never rescan it. Ages are
+// measured from the last Refresh(). TakeChanges() tells which rows came
+// into or left GetRows() meanwhile, so a view of it can be patched rather
+// than rebuilt.
+class SmartPlaylist {
+public:
+    SmartPlaylist(TrackTable& table, const SmartQuery& query);
+
+    void Refresh(int64_t now);
+
+    // After a row was added, updated or removed; true if GetRows() changed
+    bool Update(uint32_t row);
+
+    void GetRows(std::vector<uint32_t>& rows) const;    // at most the limit
+    size_t GetMatchCount() const { return matches.size(); }
+
+    // Rows that entered and left GetRows() since the last call, each once;
+    // rows that left and came back are in neither
+    void TakeChanges(std::vector<uint32_t>& added, std::vector<uint32_t>& removed);
+
+private:
+    TrackTable& table;
+    SmartQuery query;
+    int64_t now;
+    std::vector<uint32_t> matches;      // every matching row, in query order
+    std::vector<bool> is_match;         // by row
+    std::vector<bool> is_visible;       // by row: in GetRows()
+    std::vector<bool> was_visible;      // by row: as of the last TakeChanges()
+    std::vector<uint32_t> changed;      // rows whose is_visible flipped since
+
+    size_t GetVisibleCount() const;
+    void SetVisible(uint32_t row, bool visible);
+};
+
+}
+
+#endif // __SMART_QUERY_HPP
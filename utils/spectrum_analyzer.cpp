@@ -0,0 +1,101 @@
+#include "spectrum_analyzer.hpp"
+#include <cmath>
+
+namespace utils {
+
+SpectrumAnalyzer::SpectrumAnalyzer()
+    : fft_size(0)
+    , half_size(0)
+    , scale(1.0f)
+{
+    Configure(1024);
+}
+
+void SpectrumAnalyzer::Configure(size_t size)
+{
+    size_t n = 64;
+    while (n < size) {
+        n *= 2;
+    }
+    if (n == fft_size) {
+        return;
+    }
+
+    fft_size = n;
+    half_size = n / 2;
+
+    // Periodic Hann; its coherent gain is 1/2, so a sine of amplitude A
+    // lands at A * n / 4 in its bin
+    window.resize(n);
+    for (size_t i = 0; i < n; i++) {
+        window[i] = 0.5f - 0.5f * static_cast<float>(std::cos(2.0 * M_PI * i / n));
+    }
+    scale = 4.0f / n;
+
+    size_t bits = 0;
+    while ((size_t(1) << bits) < half_size) {
+        bits++;
+    }
+    bit_reverse.resize(half_size);
+    for (size_t i = 0; i < half_size; i++) {
+        size_t r = 0;
+        for (size_t b = 0; b < bits; b++) {
+            r |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        bit_reverse[i] = r;
+    }
+
+    twiddles.resize(half_size / 2);
+    for (size_t i = 0; i < twiddles.size(); i++) {
+        double angle = -2.0 * M_PI * i / half_size;
+        twiddles[i] = std::complex<float>(std::cos(angle), std::sin(angle));
+    }
+
+    split_twiddles.resize(half_size);
+    for (size_t k = 0; k < half_size; k++) {
+        double angle = -2.0 * M_PI * k / n;
+        split_twiddles[k] = std::complex<float>(std::cos(angle), std::sin(angle));
+    }
+
+    work.assign(half_size, std::complex<float>());
+}
+
+void SpectrumAnalyzer::Compute(const float* samples, float* magnitudes)
+{
+    // Pack even/odd samples as real/imaginary parts, in bit-reversed order
+    for (size_t i = 0; i < half_size; i++) {
+        size_t j = bit_reverse[i];
+        work[j] = std::complex<float>(samples[2 * i] * window[2 * i],
+                                      samples[2 * i + 1] * window[2 * i + 1]);
+    }
+
+    Transform();
+
+    // Split the packed result into the spectrum of the real sequence
+    magnitudes[0] = std::abs(work[0].real() + work[0].imag()) * scale * 0.5f;
+    magnitudes[half_size] = std::abs(work[0].real() - work[0].imag()) * scale * 0.5f;
+    for (size_t k = 1; k < half_size; k++) {
+        std::complex<float> a = work[k];
+        std::complex<float> b = std::conj(work[half_size - k]);
+        std::complex<float> even = (a + b) * 0.5f;
+        std::complex<float> odd = (a - b) * std::complex<float>(0.0f, -0.5f);
+        magnitudes[k] = std::abs(even + split_twiddles[k] * odd) * scale;
+    }
+}
+
+void SpectrumAnalyzer::Transform()
+{
+    // Iterative radix-2 butterflies over bit-reversed input
+    for (size_t span = 1; span < half_size; span *= 2) {
+        size_t stride = half_size / (span * 2);
+        for (size_t start = 0; start < half_size; start += span * 2) {
+            for (size_t i = 0; i < span; i++) {
+                std::complex<float> t = twiddles[i * stride] * work[start + i + span];
+                work[start + i + span] = work[start + i] - t;
+                work[start + i] += t;
+            }
+        }
+    }
+}
+
+}
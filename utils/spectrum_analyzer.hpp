@@ -0,0 +1,49 @@
+#ifndef __SPECTRUM_ANALYZER_HPP
+#define __SPECTRUM_ANALYZER_HPP
+
+#include <complex>
+#include <cstddef>
+#include <vector>
+
+namespace utils {
+
+// Windowed magnitude spectrum of real PCM.
+//
+// Uses a radix-2 complex FFT of half the frame length with the usual real
+// input packing. Twiddles, the bit-reversal table and the Hann window are
+// built in Configure(); Compute() does not allocate.
+class SpectrumAnalyzer {
+public:
+    SpectrumAnalyzer();
+
+    // fft_size is rounded up to a power of two (minimum 64)
+    void Configure(size_t fft_size);
+    size_t GetSize() const { return fft_size; }
+    size_t GetBinCount() const { return fft_size / 2 + 1; }
+
+    // Reads fft_size samples and writes GetBinCount() linear magnitudes,
+    // normalised so a full-scale sine peaks near 1.0
+    void Compute(const float* samples, float* magnitudes);
+
+    static double BinFrequency(size_t bin, size_t fft_size, int sample_rate)
+    {
+        return static_cast<double>(bin) * sample_rate / fft_size;
+    }
+
+private:
+    size_t fft_size;
+    size_t half_size;
+    float scale;
+
+    std::vector<float> window;
+    std::vector<size_t> bit_reverse;
+    std::vector<std::complex<float>> twiddles;        // half_size / 2 entries
+    std::vector<std::complex<float>> split_twiddles;  // half_size entries
+    std::vector<std::complex<float>> work;
+
+    void Transform();
+};
+
+}
+
+#endif // __SPECTRUM_ANALYZER_HPP
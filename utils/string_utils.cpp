@@ -1,4 +1,7 @@
 #include "string_utils.hpp"
+#include "checksum.hpp"
+#include "fuzzy_matcher.hpp"
+#include "natural_sort.hpp"
 #include <wx/regex.h>
 #include <wx/base64.h>
 #include <algorithm>
@@ -572,7 +575,10 @@ wxString StringUtils::UrlEncode(const wxString& str) { return str; }
 wxString StringUtils::UrlDecode(const wxString& str) { return str; }
 int StringUtils::Compare(const wxString& str1, const wxString& str2) { return str1.Cmp(str2); }
 int StringUtils::CompareIgnoreCase(const wxString& str1, const wxString& str2) { return str1.CmpNoCase(str2); }
-int StringUtils::CompareNatural(const wxString& str1, const wxString& str2) { return str1.Cmp(str2); }
+int StringUtils::CompareNatural(const wxString& str1, const wxString& str2)
+{
+    return NaturalSort::Compare(std::string(str1.Lower().utf8_str()), std::string(str2.Lower().utf8_str()));
+}
 bool StringUtils::Equals(const wxString& str1, const wxString& str2) { return str1 == str2; }
 bool StringUtils::EqualsIgnoreCase(const wxString& str1, const wxString& str2) { return str1.CmpNoCase(str2) == 0; }
 wxString StringUtils::FormatList(const wxArrayString& items, const wxString& separator, const wxString& last_separator) { return Join(items, separator); }
@@ -582,20 +588,104 @@ wxString StringUtils::FromBase64(const wxString& base64_str) {
     wxMemoryBuffer buf = wxBase64Decode(base64_str);
     return wxString((const char*)buf.GetData(), wxConvUTF8, buf.GetDataLen());
 }
-double StringUtils::CalculateSimilarity(const wxString& str1, const wxString& str2) { return 0.0; }
-int StringUtils::LevenshteinDistance(const wxString& str1, const wxString& str2) { return 0; }
-wxString StringUtils::GetCommonPrefix(const wxString& str1, const wxString& str2) { return wxEmptyString; }
-wxString StringUtils::GetCommonSuffix(const wxString& str1, const wxString& str2) { return wxEmptyString; }
 wxArrayString StringUtils::WrapLines(const wxString& text, size_t line_width) { return SplitLines(text); }
 wxString StringUtils::UnwrapLines(const wxString& text) { return ReplaceAll(text, "\n", " "); }
 wxString StringUtils::IndentLines(const wxString& text, const wxString& indent) { return text; }
 wxString StringUtils::UnindentLines(const wxString& text) { return text; }
-wxString StringUtils::GetMD5Hash(const wxString& str) { return wxEmptyString; }
-wxString StringUtils::GetSHA1Hash(const wxString& str) { return wxEmptyString; }
-wxUint32 StringUtils::GetCRC32(const wxString& str) { return 0; }
+wxString StringUtils::GetMD5Hash(const wxString& str) { wxScopedCharBuffer utf8 = str.utf8_str(); return wxString(Checksum::Md5(utf8.data(), utf8.length())); }
+wxString StringUtils::GetSHA1Hash(const wxString& str) { wxScopedCharBuffer utf8 = str.utf8_str(); return wxString(Checksum::Sha1(utf8.data(), utf8.length())); }
+wxUint32 StringUtils::GetCRC32(const wxString& str) { wxScopedCharBuffer utf8 = str.utf8_str(); return Checksum::Crc32(utf8.data(), utf8.length()); }
 bool StringUtils::IsValidEmailChar(wxChar ch) { return wxIsalnum(ch) || ch == '@' || ch == '.' || ch == '_' || ch == '-'; }
 bool StringUtils::IsValidFilenameChar(wxChar ch) { return ch >= 32 && wxString("<>:\"/\\|?*").find(ch) == wxString::npos; }
 wxString StringUtils::GenerateRandomString(size_t length, const wxString& charset) { return GenerateRandom(length, charset); }
-double StringUtils::JaccardSimilarity(const wxString& str1, const wxString& str2) { return 0.0; }
+
+// String similarity and distance
+double StringUtils::CalculateSimilarity(const wxString& str1, const wxString& str2)
+{
+    size_t longer = std::max(str1.length(), str2.length());
+    if (longer == 0) {
+        return 1.0;
+    }
+    return 1.0 - static_cast<double>(LevenshteinDistance(str1, str2)) / longer;
+}
+
+int StringUtils::LevenshteinDistance(const wxString& str1, const wxString& str2)
+{
+    return FuzzyMatcher::Distance(std::string(str1.utf8_str()), std::string(str2.utf8_str()));
+}
+
+std::vector<int> StringUtils::LevenshteinDistances(const wxString& query, const wxArrayString& candidates,
+                                                   int max_distance)
+{
+    std::vector<std::string> texts;
+    texts.reserve(candidates.size());
+    for (const auto& candidate : candidates) {
+        texts.push_back(std::string(candidate.utf8_str()));
+    }
+
+    // The query's masks are built once for the whole batch
+    std::vector<int> distances;
+    FuzzyMatcher(std::string(query.utf8_str())).Distances(texts, distances, max_distance);
+    return distances;
+}
+
+wxString StringUtils::GetCommonPrefix(const wxString& str1, const wxString& str2)
+{
+    auto a = str1.begin();
+    auto b = str2.begin();
+    while (a != str1.end() && b != str2.end() && *a == *b) {
+        ++a;
+        ++b;
+    }
+    return wxString(str1.begin(), a);
+}
+
+wxString StringUtils::GetCommonSuffix(const wxString& str1, const wxString& str2)
+{
+    size_t count = 0;
+    auto a = str1.rbegin();
+    auto b = str2.rbegin();
+    while (a != str1.rend() && b != str2.rend() && *a == *b) {
+        ++a;
+        ++b;
+        ++count;
+    }
+    return str1.Right(count);
+}
+
+double StringUtils::JaccardSimilarity(const wxString& str1, const wxString& str2)
+{
+    // Over the sets of adjacent character pairs, ignoring case
+    auto bigrams = [](const wxString& str) {
+        wxString lower = str.Lower();
+        std::vector<std::pair<wxUint32, wxUint32>> pairs;
+        for (size_t i = 1; i < lower.length(); ++i) {
+            pairs.emplace_back(lower[i - 1].GetValue(), lower[i].GetValue());
+        }
+        std::sort(pairs.begin(), pairs.end());
+        pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+        return pairs;
+    };
+
+    auto first = bigrams(str1);
+    auto second = bigrams(str2);
+    if (first.empty() && second.empty()) {
+        return str1.CmpNoCase(str2) == 0 ? 1.0 : 0.0;
+    }
+
+    size_t shared = 0;
+    for (auto a = first.begin(), b = second.begin(); a != first.end() && b != second.end();) {
+        if (*a < *b) {
+            ++a;
+        } else if (*b < *a) {
+            ++b;
+        } else {
+            ++shared;
+            ++a;
+            ++b;
+        }
+    }
+    return static_cast<double>(shared) / (first.size() + second.size() - shared);
+}
 
 }
\ No newline at end of file
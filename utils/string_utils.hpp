@@ -115,8 +115,11 @@ public:
     static wxString FromBase64(const wxString& base64_str);
     
     // String similarity and distance
-    static double CalculateSimilarity(const wxString& str1, const wxString& str2);
+    static double CalculateSimilarity(const wxString& str1, const wxString& str2);     // 1 - edits / longer length
     static int LevenshteinDistance(const wxString& str1, const wxString& str2);
+    // One query against many candidates; max_distance >= 0 caps each result at max_distance + 1
+    static std::vector<int> LevenshteinDistances(const wxString& query, const wxArrayString& candidates,
+                                                 int max_distance = -1);
     static wxString GetCommonPrefix(const wxString& str1, const wxString& str2);
     static wxString GetCommonSuffix(const wxString& str1, const wxString& str2);
     
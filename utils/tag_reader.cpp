@@ -0,0 +1,1063 @@
+#include "tag_reader.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace utils {
+
+namespace {
+
+// ID3v1 genres, which ID3v2 "(n)" references and MP4 gnre items number from
+const char* const GENRES[] = {
+    "Blues", "Classic Rock", "Country", "Dance", "Disco", "Funk", "Grunge", "Hip-Hop",
+    "Jazz", "Metal", "New Age", "Oldies", "Other", "Pop", "R&B", "Rap",
+    "Reggae", "Rock", "Techno", "Industrial", "Alternative", "Ska", "Death Metal", "Pranks",
+    "Soundtrack", "Euro-Techno", "Ambient", "Trip-Hop", "Vocal", "Jazz+Funk", "Fusion", "Trance",
+    "Classical", "Instrumental", "Acid", "House", "Game", "Sound Clip", "Gospel", "Noise",
+    "AlternRock", "Bass", "Soul", "Punk", "Space", "Meditative", "Instrumental Pop", "Instrumental Rock",
+    "Ethnic", "Gothic", "Darkwave", "Techno-Industrial", "Electronic", "Pop-Folk", "Eurodance", "Dream",
+    "Southern Rock", "Comedy", "Cult", "Gangsta", "Top 40", "Christian Rap", "Pop/Funk", "Jungle",
+    "Native American", "Cabaret", "New Wave", "Psychadelic", "Rave", "Showtunes", "Trailer", "Lo-Fi",
+    "Tribal", "Acid Punk", "Acid Jazz", "Polka", "Retro", "Musical", "Rock & Roll", "Hard Rock"
+};
+const size_t GENRE_COUNT = sizeof(GENRES) / sizeof(GENRES[0]);
+
+// How far into the audio an MPEG stream's first frame is looked for
+const size_t MPEG_SCAN_BYTES = 64 * 1024;
+
+uint32_t BigEndian16(const unsigned char* p) { return (uint32_t(p[0]) << 8) | p[1]; }
+uint32_t BigEndian24(const unsigned char* p) { return (uint32_t(p[0]) << 16) | (uint32_t(p[1]) << 8) | p[2]; }
+uint32_t BigEndian32(const unsigned char* p) { return (uint32_t(p[0]) << 24) | BigEndian24(p + 1); }
+uint64_t BigEndian64(const unsigned char* p) { return (uint64_t(BigEndian32(p)) << 32) | BigEndian32(p + 4); }
+uint32_t LittleEndian16(const unsigned char* p) { return uint32_t(p[0]) | (uint32_t(p[1]) << 8); }
+uint32_t LittleEndian32(const unsigned char* p) { return LittleEndian16(p) | (LittleEndian16(p + 2) << 16); }
+uint64_t LittleEndian64(const unsigned char* p) { return LittleEndian32(p) | (uint64_t(LittleEndian32(p + 4)) << 32); }
+
+// ID3v2 sizes keep the top bit of every byte clear
+uint32_t SyncSafe(const unsigned char* p)
+{
+    return (uint32_t(p[0] & 0x7F) << 21) | (uint32_t(p[1] & 0x7F) << 14) | (uint32_t(p[2] & 0x7F) << 7) | (p[3] & 0x7F);
+}
+
+// Undoes ID3v2 unsynchronisation, which puts a zero after every 0xFF
+void Resynchronise(const unsigned char* data, size_t size, std::vector<unsigned char>& out)
+{
+    out.resize(size);
+    size_t length = 0;
+    for (size_t i = 0; i < size; i++) {
+        out[length++] = data[i];
+        if (data[i] == 0xFF && i + 1 < size && data[i + 1] == 0) {
+            i++;
+        }
+    }
+    out.resize(length);
+}
+
+bool EqualsIgnoreCase(std::string_view a, std::string_view b)
+{
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+        return (x >= 'a' && x <= 'z' ? x - 32 : x) == (y >= 'a' && y <= 'z' ? y - 32 : y);
+    });
+}
+
+void AppendUtf8(std::string& out, uint32_t code)
+{
+    if (code < 0x80) {
+        out += static_cast<char>(code);
+    } else if (code < 0x800) {
+        out += static_cast<char>(0xC0 | (code >> 6));
+        out += static_cast<char>(0x80 | (code & 0x3F));
+    } else if (code < 0x10000) {
+        out += static_cast<char>(0xE0 | (code >> 12));
+        out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (code >> 18));
+        out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code & 0x3F));
+    }
+}
+
+// Up to the first NUL; ISO-8859-1 maps straight onto the first 256 code points
+void AppendLatin1(std::string& out, const unsigned char* data, size_t size)
+{
+    for (size_t i = 0; i < size && data[i] != 0; i++) {
+        AppendUtf8(out, data[i]);
+    }
+}
+
+// Up to the first NUL; a byte order mark overrides big_endian
+void AppendUtf16(std::string& out, const unsigned char* data, size_t size, bool big_endian)
+{
+    size_t i = 0;
+    if (size >= 2 && ((data[0] == 0xFF && data[1] == 0xFE) || (data[0] == 0xFE && data[1] == 0xFF))) {
+        big_endian = data[0] == 0xFE;
+        i = 2;
+    }
+    for (; i + 1 < size; i += 2) {
+        uint32_t unit = big_endian ? BigEndian16(data + i) : LittleEndian16(data + i);
+        if (unit == 0) {
+            break;
+        }
+        if (unit >= 0xD800 && unit < 0xDC00 && i + 3 < size) {
+            uint32_t low = big_endian ? BigEndian16(data + i + 2) : LittleEndian16(data + i + 2);
+            if (low >= 0xDC00 && low < 0xE000) {
+                unit = 0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00);
+                i += 2;
+            }
+        }
+        AppendUtf8(out, unit);
+    }
+}
+
+// Standard alphabet; padding and anything outside it is skipped
+bool DecodeBase64(std::string_view text, std::vector<unsigned char>& out)
+{
+    out.clear();
+    out.reserve(text.size() / 4 * 3);
+    uint32_t bits = 0;
+    int count = 0;
+    for (char c : text) {
+        int value = c >= 'A' && c <= 'Z' ? c - 'A'
+                  : c >= 'a' && c <= 'z' ? c - 'a' + 26
+                  : c >= '0' && c <= '9' ? c - '0' + 52
+                  : c == '+' ? 62 : c == '/' ? 63 : -1;
+        if (value < 0) {
+            continue;
+        }
+        bits = (bits << 6) | static_cast<uint32_t>(value);
+        if (++count == 4) {
+            out.push_back(static_cast<unsigned char>(bits >> 16));
+            out.push_back(static_cast<unsigned char>(bits >> 8));
+            out.push_back(static_cast<unsigned char>(bits));
+            bits = 0;
+            count = 0;
+        }
+    }
+    if (count >= 2) {
+        bits <<= 6 * (4 - count);
+        out.push_back(static_cast<unsigned char>(bits >> 16));
+        if (count == 3) {
+            out.push_back(static_cast<unsigned char>(bits >> 8));
+        }
+    }
+    return !out.empty();
+}
+
+std::string_view UpToNul(const unsigned char* data, size_t size)
+{
+    const char* text = reinterpret_cast<const char*>(data);
+    return std::string_view(text, std::find(text, text + size, '\0') - text);
+}
+
+// ID3v1 pads its fixed-width fields with NULs or spaces
+std::string_view TrimPadding(const unsigned char* data, size_t size)
+{
+    std::string_view text = UpToNul(data, size);
+    while (!text.empty() && text.back() == ' ') {
+        text.remove_suffix(1);
+    }
+    return text;
+}
+
+struct MpegHeader {
+    bool lsf;                   // MPEG-2 or 2.5, with half the samples per layer III frame
+    int layer;
+    int bitrate;                // kbit/s
+    int sample_rate;
+    int samples;
+    bool mono;
+    size_t frame_size;
+};
+
+bool ParseMpegHeader(const unsigned char* p, MpegHeader& header)
+{
+    static const int BITRATES[2][3][15] = {
+        { { 0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448 },
+          { 0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384 },
+          { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320 } },
+        { { 0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256 },
+          { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 },
+          { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 } }
+    };
+    static const int SAMPLE_RATES[3] = { 44100, 48000, 32000 };
+
+    if (p[0] != 0xFF || (p[1] & 0xE0) != 0xE0) {
+        return false;
+    }
+    int version = (p[1] >> 3) & 3;          // 0: 2.5, 1: reserved, 2: 2, 3: 1
+    int layer_bits = (p[1] >> 1) & 3;
+    int bitrate_index = p[2] >> 4;
+    int rate_index = (p[2] >> 2) & 3;
+    // Free-format streams have no bitrate to size their frames by
+    if (version == 1 || layer_bits == 0 || bitrate_index == 0 || bitrate_index == 15 || rate_index == 3) {
+        return false;
+    }
+
+    header.lsf = version != 3;
+    header.layer = 4 - layer_bits;
+    header.bitrate = BITRATES[header.lsf][header.layer - 1][bitrate_index];
+    header.sample_rate = SAMPLE_RATES[rate_index] >> (version == 3 ? 0 : version == 2 ? 1 : 2);
+    header.samples = header.layer == 1 ? 384 : header.layer == 3 && header.lsf ? 576 : 1152;
+    header.mono = (p[3] >> 6) == 3;
+    int padding = (p[2] >> 1) & 1;
+    if (header.layer == 1) {
+        header.frame_size = (12 * header.bitrate * 1000 / header.sample_rate + padding) * 4;
+    } else {
+        header.frame_size = header.samples / 8 * header.bitrate * 1000 / header.sample_rate + padding;
+    }
+    return true;
+}
+
+}
+
+TagReader::TagReader()
+    : fd(-1)
+    , file_size(0)
+    , window_start(0)
+    , window_length(0)
+    , track(0)
+    , disc(0)
+    , duration(0.0)
+    , picture(nullptr)
+    , picture_type(-1)
+{
+    window.resize(WINDOW_SIZE);
+}
+
+TagReader::~TagReader()
+{
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+bool TagReader::Read(const std::string& path, Tags& tags)
+{
+    tags = Tags();
+    bool known = ReadFile(path);
+
+    std::string_view all(text);
+    for (size_t field = 0; field < FIELDS; field++) {
+        if (has_text[field]) {
+            tags.text[field] = all.substr(text_offsets[field], text_lengths[field]);
+        }
+    }
+    tags.track = track;
+    tags.disc = disc;
+    tags.duration = duration;
+    return known;
+}
+
+bool TagReader::ReadPicture(const std::string& path, std::vector<unsigned char>& image)
+{
+    image.clear();
+    picture = &image;
+    picture_type = -1;
+    bool known = ReadFile(path);
+    picture = nullptr;
+    return known && !image.empty();
+}
+
+bool TagReader::ReadFile(const std::string& path)
+{
+    text.clear();
+    has_text.fill(false);
+    track = 0;
+    disc = 0;
+    duration = 0.0;
+    window_length = 0;
+    if (window.size() > WINDOW_SIZE) {
+        window.resize(WINDOW_SIZE);
+        window.shrink_to_fit();
+    }
+
+    fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        close(fd);
+        fd = -1;
+        return false;
+    }
+    file_size = static_cast<uint64_t>(info.st_size);
+
+    bool known = false;
+    if (const unsigned char* magic = Fetch(0, 12)) {
+        if (std::memcmp(magic, "ID3", 3) == 0) {
+            uint64_t offset = ReadId3v2(0);
+            const unsigned char* next = Fetch(offset, 4);
+            known = next && std::memcmp(next, "fLaC", 4) == 0 ? ReadFlac(offset) : ReadMpeg(offset);
+            known = known || !text.empty();
+        } else if (std::memcmp(magic, "fLaC", 4) == 0) {
+            known = ReadFlac(0);
+        } else if (std::memcmp(magic, "OggS", 4) == 0) {
+            known = ReadOgg();
+        } else if (std::memcmp(magic + 4, "ftyp", 4) == 0) {
+            known = ReadMp4();
+        } else {
+            known = ReadMpeg(0) || !text.empty();
+        }
+    }
+    close(fd);
+    fd = -1;
+    return known;
+}
+
+const unsigned char* TagReader::Fetch(uint64_t offset, size_t count)
+{
+    if (offset > file_size || count > file_size - offset || count > MAX_BLOCK_SIZE) {
+        return nullptr;
+    }
+    if (offset >= window_start && offset + count <= window_start + window_length) {
+        return window.data() + (offset - window_start);
+    }
+
+    // Read ahead: the next header is usually close behind
+    size_t length = static_cast<size_t>(std::min<uint64_t>(std::max(count, WINDOW_SIZE), file_size - offset));
+    if (window.size() < length) {
+        window.resize(length);
+    }
+    size_t done = 0;
+    while (done < length) {
+        ssize_t got = pread(fd, window.data() + done, length - done, static_cast<off_t>(offset + done));
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) break;
+        done += static_cast<size_t>(got);
+    }
+    window_start = offset;
+    window_length = done;
+    return done >= count ? window.data() : nullptr;
+}
+
+void TagReader::SetText(Field field, std::string_view utf8)
+{
+    while (!utf8.empty() && (utf8.back() == '\0' || utf8.back() == ' ')) {
+        utf8.remove_suffix(1);
+    }
+    if (has_text[field] || utf8.empty()) {
+        return;
+    }
+    text_offsets[field] = static_cast<uint32_t>(text.size());
+    text_lengths[field] = static_cast<uint32_t>(utf8.size());
+    text.append(utf8);
+    has_text[field] = true;
+}
+
+void TagReader::SetGenre(std::string_view genre)
+{
+    // ID3 writes genres as "(17)", "(17)Rock" or "17" as well as by name
+    std::string_view number = genre;
+    if (genre.size() > 2 && genre.front() == '(') {
+        size_t close = genre.find(')');
+        if (close != std::string_view::npos && close + 1 < genre.size()) {
+            SetText(GENRE, genre.substr(close + 1));
+            return;
+        }
+        number = genre.substr(1, close == std::string_view::npos ? 0 : close - 1);
+    }
+    if (!number.empty() && std::all_of(number.begin(), number.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+        unsigned int index = 0;
+        SetNumber(index, number);
+        if (number.size() <= 3 && index < GENRE_COUNT) {
+            SetText(GENRE, GENRES[index]);
+        }
+        return;
+    }
+    SetText(GENRE, genre);
+}
+
+void TagReader::SetNumber(unsigned int& number, std::string_view value)
+{
+    // "3" or "3/12"; the first value found wins
+    if (number != 0) {
+        return;
+    }
+    size_t i = 0;
+    while (i < value.size() && value[i] == ' ') {
+        i++;
+    }
+    unsigned int parsed = 0;
+    for (; i < value.size() && value[i] >= '0' && value[i] <= '9' && parsed < 100000; i++) {
+        parsed = parsed * 10 + static_cast<unsigned int>(value[i] - '0');
+    }
+    number = parsed;
+}
+
+uint64_t TagReader::ReadId3v2(uint64_t offset)
+{
+    const unsigned char* header = Fetch(offset, 10);
+    if (!header || std::memcmp(header, "ID3", 3) != 0) {
+        return offset;
+    }
+    int version = header[3];
+    int flags = header[5];
+    uint64_t size = SyncSafe(header + 6);
+    uint64_t end = std::min(offset + 10 + size + (version == 4 && (flags & 0x10) ? 10 : 0), file_size);
+    if (version < 2 || version > 4 || offset + 10 + size > file_size) {
+        return end;
+    }
+
+    // Pictures can make a tag megabytes long, so frames are normally
+    // fetched one at a time and only the text ones read. A tag that was
+    // unsynchronised as a whole (before 2.4) has to be undone as a whole.
+    uint64_t begin = offset + 10;
+    bool unsynchronised = version < 4 && (flags & 0x80);
+    if (unsynchronised) {
+        const unsigned char* data = Fetch(begin, static_cast<size_t>(size));
+        if (!data) {
+            return end;
+        }
+        Resynchronise(data, static_cast<size_t>(size), scratch);
+        size = scratch.size();
+    }
+    auto get = [&](uint64_t position, size_t count) -> const unsigned char* {
+        if (position > size || count > size - position) {
+            return nullptr;
+        }
+        return unsynchronised ? scratch.data() + position : Fetch(begin + position, count);
+    };
+
+    uint64_t position = 0;
+    if (version >= 3 && (flags & 0x40)) {
+        const unsigned char* extended = get(0, 4);
+        if (!extended) {
+            return end;
+        }
+        // 2.3 counts the size field out, 2.4 in
+        position = version == 3 ? 4 + BigEndian32(extended) : SyncSafe(extended);
+    }
+
+    size_t id_size = version == 2 ? 3 : 4;
+    size_t header_size = version == 2 ? 6 : 10;
+    while (const unsigned char* frame = get(position, header_size)) {
+        if (frame[0] == 0) {
+            break;                              // padding
+        }
+        char id[5] = {};
+        std::memcpy(id, frame, id_size);
+        uint64_t frame_size = version == 2 ? BigEndian24(frame + 3)
+                            : version == 3 ? BigEndian32(frame + 4) : SyncSafe(frame + 4);
+        int frame_flags = version == 2 ? 0 : frame[9];
+        position += header_size;
+        if (frame_size > size - position) {
+            break;
+        }
+
+        // Compressed and encrypted frames are left alone
+        bool readable = version == 3 ? (frame_flags & 0xC0) == 0 : (frame_flags & 0x0C) == 0;
+        bool text_frame = id[0] == 'T' && std::strcmp(id, "TXXX") != 0 && std::strcmp(id, "TXX") != 0;
+        bool picture_frame = picture && (std::strcmp(id, "APIC") == 0 || std::strcmp(id, "PIC") == 0);
+        if (readable && ((text_frame && frame_size <= WINDOW_SIZE) || picture_frame)) {
+            const unsigned char* data = get(position, static_cast<size_t>(frame_size));
+            if (!data) {
+                break;
+            }
+            size_t length = static_cast<size_t>(frame_size);
+            if (version == 4 && (frame_flags & 0x01) && length >= 4) {
+                data += 4;                      // data length indicator
+                length -= 4;
+            }
+            if (version == 4 && (frame_flags & 0x02)) {
+                Resynchronise(data, length, scratch);
+                data = scratch.data();
+                length = scratch.size();
+            }
+            if (picture_frame) {
+                ParseId3Picture(data, length, version == 2);
+            } else {
+                ParseId3Frame(id, data, length);
+            }
+        }
+        position += frame_size;
+    }
+    return end;
+}
+
+void TagReader::ParseId3Frame(const char* id, const unsigned char* data, size_t size)
+{
+    if (size < 2) {
+        return;
+    }
+
+    // A text frame is an encoding byte, then the text; 2.4 separates
+    // several values with NULs, of which the first is taken
+    std::string_view value;
+    int encoding = data[0];
+    if (encoding == 3) {
+        value = UpToNul(data + 1, size - 1);
+    } else {
+        decoded.clear();
+        if (encoding == 0) {
+            AppendLatin1(decoded, data + 1, size - 1);
+        } else {
+            AppendUtf16(decoded, data + 1, size - 1, encoding == 2);
+        }
+        value = decoded;
+    }
+
+    std::string_view name(id);
+    if (name == "TIT2" || name == "TT2") {
+        SetText(TITLE, value);
+    } else if (name == "TPE1" || name == "TP1") {
+        SetText(ARTIST, value);
+    } else if (name == "TALB" || name == "TAL") {
+        SetText(ALBUM, value);
+    } else if (name == "TPE2" || name == "TP2") {
+        SetText(ALBUM_ARTIST, value);
+    } else if (name == "TCON" || name == "TCO") {
+        SetGenre(value);
+    } else if (name == "TDRC" || name == "TYER" || name == "TYE") {
+        SetText(DATE, value);
+    } else if (name == "TRCK" || name == "TRK") {
+        SetNumber(track, value);
+    } else if (name == "TPOS" || name == "TPA") {
+        SetNumber(disc, value);
+    }
+}
+
+void TagReader::ParseId3Picture(const unsigned char* data, size_t size, bool version_2_2)
+{
+    // Encoding, MIME type (2.2: a three-letter format), picture type,
+    // description in the encoding, then the image
+    if (size < 4) {
+        return;
+    }
+    int encoding = data[0];
+    size_t i = 1;
+    if (version_2_2) {
+        i += 3;
+    } else {
+        while (i < size && data[i] != 0) {
+            i++;
+        }
+        i++;
+    }
+    if (i >= size) {
+        return;
+    }
+    int type = data[i++];
+    if (encoding == 1 || encoding == 2) {
+        while (i + 1 < size && (data[i] != 0 || data[i + 1] != 0)) {
+            i += 2;
+        }
+        i += 2;
+    } else {
+        while (i < size && data[i] != 0) {
+            i++;
+        }
+        i++;
+    }
+    if (i < size) {
+        SetPicture(type, data + i, size - i);
+    }
+}
+
+void TagReader::ParseFlacPicture(const unsigned char* data, size_t size)
+{
+    // Picture type, MIME type and description with their lengths, four
+    // numbers describing the image, then its length and bytes
+    if (size < 32) {
+        return;
+    }
+    uint32_t type = BigEndian32(data);
+    uint64_t position = 8 + uint64_t(BigEndian32(data + 4));
+    if (position + 4 > size) {
+        return;
+    }
+    position += 4 + uint64_t(BigEndian32(data + position)) + 16;
+    if (position + 4 > size) {
+        return;
+    }
+    uint32_t length = BigEndian32(data + position);
+    position += 4;
+    if (length > size - position) {
+        return;
+    }
+    SetPicture(static_cast<int>(std::min<uint32_t>(type, 255)), data + position, length);
+}
+
+void TagReader::SetPicture(int type, const unsigned char* data, size_t size)
+{
+    // The front cover if there is one, otherwise the first picture
+    const int FRONT_COVER = 3;
+    if (!picture || size == 0 || picture_type == FRONT_COVER || (picture_type >= 0 && type != FRONT_COVER)) {
+        return;
+    }
+    picture->assign(data, data + size);
+    picture_type = type;
+}
+
+void TagReader::ParseVorbisComment(const unsigned char* data, size_t size)
+{
+    const unsigned char* end = data + size;
+    if (size < 8) {
+        return;
+    }
+    uint32_t vendor = LittleEndian32(data);
+    if (vendor > size - 8) {
+        return;
+    }
+    data += 4 + vendor;
+    uint32_t count = LittleEndian32(data);
+    data += 4;
+
+    // Each comment is its length, then "NAME=value" in UTF-8
+    for (uint32_t i = 0; i < count && end - data >= 4; i++) {
+        uint32_t length = LittleEndian32(data);
+        data += 4;
+        if (length > static_cast<size_t>(end - data)) {
+            break;
+        }
+        std::string_view comment(reinterpret_cast<const char*>(data), length);
+        data += length;
+
+        size_t equals = comment.find('=');
+        if (equals == std::string_view::npos) {
+            continue;
+        }
+        std::string_view key = comment.substr(0, equals);
+        std::string_view value = comment.substr(equals + 1);
+        if (EqualsIgnoreCase(key, "TITLE")) {
+            SetText(TITLE, value);
+        } else if (EqualsIgnoreCase(key, "ARTIST")) {
+            SetText(ARTIST, value);
+        } else if (EqualsIgnoreCase(key, "ALBUM")) {
+            SetText(ALBUM, value);
+        } else if (EqualsIgnoreCase(key, "ALBUMARTIST") || EqualsIgnoreCase(key, "ALBUM ARTIST")) {
+            SetText(ALBUM_ARTIST, value);
+        } else if (EqualsIgnoreCase(key, "GENRE")) {
+            SetText(GENRE, value);
+        } else if (EqualsIgnoreCase(key, "DATE")) {
+            SetText(DATE, value);
+        } else if (EqualsIgnoreCase(key, "TRACKNUMBER")) {
+            SetNumber(track, value);
+        } else if (EqualsIgnoreCase(key, "DISCNUMBER")) {
+            SetNumber(disc, value);
+        } else if (picture && EqualsIgnoreCase(key, "METADATA_BLOCK_PICTURE")) {
+            // A FLAC picture block, base64-encoded
+            if (DecodeBase64(value, block)) {
+                ParseFlacPicture(block.data(), block.size());
+            }
+        }
+    }
+}
+
+void TagReader::ParseApeItems(const unsigned char* data, size_t size, uint32_t count)
+{
+    // Each item is the value's size and flags, the key and a NUL, then the value
+    const unsigned char* end = data + size;
+    for (uint32_t i = 0; i < count && end - data >= 9; i++) {
+        uint32_t length = LittleEndian32(data);
+        uint32_t flags = LittleEndian32(data + 4);
+        data += 8;
+        std::string_view key = UpToNul(data, static_cast<size_t>(end - data));
+        data += key.size() + 1;
+        if (data > end || length > static_cast<size_t>(end - data)) {
+            break;
+        }
+        std::string_view value(reinterpret_cast<const char*>(data), length);
+        data += length;
+
+        if ((flags & 0x06) == 0x02 && picture && EqualsIgnoreCase(key, "Cover Art (Front)")) {
+            // A file name, a NUL, then the image
+            size_t name = value.find('\0');
+            if (name != std::string_view::npos) {
+                SetPicture(3, reinterpret_cast<const unsigned char*>(value.data()) + name + 1, value.size() - name - 1);
+            }
+        }
+        if ((flags & 0x06) != 0) {
+            continue;                           // binary, or a link
+        }
+        value = value.substr(0, value.find('\0'));
+        if (EqualsIgnoreCase(key, "Title")) {
+            SetText(TITLE, value);
+        } else if (EqualsIgnoreCase(key, "Artist")) {
+            SetText(ARTIST, value);
+        } else if (EqualsIgnoreCase(key, "Album")) {
+            SetText(ALBUM, value);
+        } else if (EqualsIgnoreCase(key, "Album Artist") || EqualsIgnoreCase(key, "AlbumArtist")) {
+            SetText(ALBUM_ARTIST, value);
+        } else if (EqualsIgnoreCase(key, "Genre")) {
+            SetGenre(value);
+        } else if (EqualsIgnoreCase(key, "Year")) {
+            SetText(DATE, value);
+        } else if (EqualsIgnoreCase(key, "Track")) {
+            SetNumber(track, value);
+        } else if (EqualsIgnoreCase(key, "Disc")) {
+            SetNumber(disc, value);
+        }
+    }
+}
+
+bool TagReader::ReadMpeg(uint64_t audio_start)
+{
+    uint64_t audio_end = ReadTrailingTags();
+    if (audio_start >= audio_end) {
+        return false;
+    }
+
+    // The first frame whose successor is where its size says; a lone sync
+    // pattern in leftover junk or in a tag's padding is not enough
+    size_t scan = static_cast<size_t>(std::min<uint64_t>(MPEG_SCAN_BYTES, audio_end - audio_start));
+    const unsigned char* data = Fetch(audio_start, scan);
+    if (!data) {
+        return false;
+    }
+    MpegHeader header;
+    size_t first = scan;
+    for (size_t i = 0; i + 4 <= scan; i++) {
+        if (!ParseMpegHeader(data + i, header)) {
+            continue;
+        }
+        size_t next = i + header.frame_size;
+        MpegHeader following;
+        if (next + 4 > scan ? audio_start + next >= audio_end
+                            : ParseMpegHeader(data + next, following) && following.lsf == header.lsf &&
+                              following.layer == header.layer && following.sample_rate == header.sample_rate) {
+            first = i;
+            break;
+        }
+    }
+    if (first == scan) {
+        return false;
+    }
+
+    // A VBR stream counts its frames in a Xing (or, from LAME, Info) header
+    // after the side information of its first frame, or in a VBRI header
+    const unsigned char* frame = data + first;
+    size_t available = scan - first;
+    size_t xing = 4 + (header.lsf ? (header.mono ? 9 : 17) : (header.mono ? 17 : 32));
+    uint32_t frames = 0;
+    if (available >= xing + 12 && (std::memcmp(frame + xing, "Xing", 4) == 0 ||
+                                   std::memcmp(frame + xing, "Info", 4) == 0)) {
+        if (BigEndian32(frame + xing + 4) & 0x01) {
+            frames = BigEndian32(frame + xing + 8);
+        }
+    } else if (available >= 36 + 18 && std::memcmp(frame + 36, "VBRI", 4) == 0) {
+        frames = BigEndian32(frame + 36 + 14);
+    }
+
+    if (frames > 0) {
+        duration = static_cast<double>(frames) * header.samples / header.sample_rate;
+    } else {
+        duration = static_cast<double>(audio_end - audio_start - first) * 8.0 / (header.bitrate * 1000.0);
+    }
+    return true;
+}
+
+uint64_t TagReader::ReadTrailingTags()
+{
+    // From the end: ID3v1 last, an APE tag before it. APE is preferred to
+    // ID3v1, whose fields are short and Latin-1, so it is read first.
+    uint64_t end = file_size;
+    bool has_id3v1 = false;
+    if (const unsigned char* tag = end >= 128 ? Fetch(end - 128, 128) : nullptr) {
+        if (std::memcmp(tag, "TAG", 3) == 0) {
+            has_id3v1 = true;
+            end -= 128;
+        }
+    }
+
+    if (const unsigned char* footer = end >= 32 ? Fetch(end - 32, 32) : nullptr) {
+        if (std::memcmp(footer, "APETAGEX", 8) == 0) {
+            uint32_t size = LittleEndian32(footer + 12);       // items and footer
+            uint32_t count = LittleEndian32(footer + 16);
+            bool has_header = (LittleEndian32(footer + 20) & 0x80000000u) != 0;
+            if (size >= 32 && size <= end) {
+                if (const unsigned char* items = Fetch(end - size, size - 32)) {
+                    ParseApeItems(items, size - 32, count);
+                }
+                end -= size;
+                if (has_header && end >= 32) {
+                    end -= 32;
+                }
+            }
+        }
+    }
+
+    if (has_id3v1) {
+        if (const unsigned char* tag = Fetch(file_size - 128, 128)) {
+            std::string_view fields[] = { TrimPadding(tag + 3, 30), TrimPadding(tag + 33, 30),
+                                          TrimPadding(tag + 63, 30), TrimPadding(tag + 93, 4) };
+            Field names[] = { TITLE, ARTIST, ALBUM, DATE };
+            for (size_t i = 0; i < 4; i++) {
+                decoded.clear();
+                AppendLatin1(decoded, reinterpret_cast<const unsigned char*>(fields[i].data()), fields[i].size());
+                SetText(names[i], decoded);
+            }
+            // ID3v1.1 keeps the track number in the comment's last byte
+            if (tag[125] == 0 && tag[126] != 0 && track == 0) {
+                track = tag[126];
+            }
+            if (tag[127] < GENRE_COUNT) {
+                SetText(GENRE, GENRES[tag[127]]);
+            }
+        }
+    }
+    return end;
+}
+
+bool TagReader::ReadFlac(uint64_t offset)
+{
+    const unsigned char* magic = Fetch(offset, 4);
+    if (!magic || std::memcmp(magic, "fLaC", 4) != 0) {
+        return false;
+    }
+
+    // Metadata blocks: last-block flag and type, a 24-bit length, the body
+    uint64_t position = offset + 4;
+    while (const unsigned char* header = Fetch(position, 4)) {
+        bool last = (header[0] & 0x80) != 0;
+        int type = header[0] & 0x7F;
+        uint32_t length = BigEndian24(header + 1);
+        position += 4;
+        if (type == 127) {
+            break;                              // invalid
+        }
+
+        if (type == 0 && length >= 18) {
+            // STREAMINFO: 20 bits of sample rate and 36 of total samples
+            if (const unsigned char* info = Fetch(position, 18)) {
+                uint32_t rate = (uint32_t(info[10]) << 12) | (uint32_t(info[11]) << 4) | (info[12] >> 4);
+                uint64_t samples = (uint64_t(info[13] & 0x0F) << 32) | BigEndian32(info + 14);
+                if (rate > 0) {
+                    duration = static_cast<double>(samples) / rate;
+                }
+            }
+        } else if (type == 4) {
+            if (const unsigned char* comment = Fetch(position, length)) {
+                ParseVorbisComment(comment, length);
+            }
+        } else if (type == 6 && picture) {
+            if (const unsigned char* block = Fetch(position, length)) {
+                ParseFlacPicture(block, length);
+            }
+        }
+
+        position += length;
+        if (last) {
+            break;
+        }
+    }
+    return true;
+}
+
+bool TagReader::ReadOgg()
+{
+    // The first two packets of the first stream are its identification
+    // header and its comments; they may share a page or span several
+    uint64_t offset = 0;
+    uint32_t serial = 0;
+    bool opus = false;
+    uint32_t rate = 0;
+    uint64_t pre_skip = 0;
+    int packets = 0;
+    scratch.clear();
+    while (packets < 2) {
+        const unsigned char* page = Fetch(offset, 27);
+        if (!page || std::memcmp(page, "OggS", 4) != 0) {
+            break;
+        }
+        uint32_t page_serial = LittleEndian32(page + 14);
+        size_t segments = page[26];
+        const unsigned char* table = Fetch(offset + 27, segments);
+        if (!table) {
+            break;
+        }
+        unsigned char lacing[255];
+        std::memcpy(lacing, table, segments);
+        size_t body = 0;
+        for (size_t i = 0; i < segments; i++) {
+            body += lacing[i];
+        }
+        bool first_page = offset == 0;
+        uint64_t body_offset = offset + 27 + segments;
+        offset = body_offset + body;
+        if (first_page) {
+            serial = page_serial;
+        } else if (page_serial != serial) {
+            continue;                           // another multiplexed stream
+        }
+
+        const unsigned char* data = Fetch(body_offset, body);
+        if (!data) {
+            break;
+        }
+        for (size_t i = 0; i < segments && packets < 2; i++) {
+            if (scratch.size() + lacing[i] > MAX_BLOCK_SIZE) {
+                return packets > 0;
+            }
+            scratch.insert(scratch.end(), data, data + lacing[i]);
+            data += lacing[i];
+            if (lacing[i] == 255) {
+                continue;                       // the packet goes on
+            }
+
+            const unsigned char* packet = scratch.data();
+            size_t size = scratch.size();
+            if (packets == 0) {
+                if (size >= 16 && std::memcmp(packet, "\x01vorbis", 7) == 0) {
+                    rate = LittleEndian32(packet + 12);
+                } else if (size >= 19 && std::memcmp(packet, "OpusHead", 8) == 0) {
+                    opus = true;
+                    rate = 48000;               // granule positions always count at 48 kHz
+                    pre_skip = LittleEndian16(packet + 10);
+                } else {
+                    return false;
+                }
+            } else if (!opus && size >= 7 && std::memcmp(packet, "\x03vorbis", 7) == 0) {
+                ParseVorbisComment(packet + 7, size - 7);
+            } else if (opus && size >= 8 && std::memcmp(packet, "OpusTags", 8) == 0) {
+                ParseVorbisComment(packet + 8, size - 8);
+            }
+            packets++;
+            scratch.clear();
+        }
+    }
+    if (packets == 0) {
+        return false;
+    }
+
+    // The last page of the stream carries its final sample position
+    size_t tail = static_cast<size_t>(std::min<uint64_t>(file_size, WINDOW_SIZE));
+    const unsigned char* data = tail >= 27 ? Fetch(file_size - tail, tail) : nullptr;
+    for (size_t i = tail - 27 + 1; data && i-- > 0;) {
+        if (std::memcmp(data + i, "OggS", 4) == 0 && LittleEndian32(data + i + 14) == serial) {
+            uint64_t granule = LittleEndian64(data + i + 6);
+            if (granule != UINT64_MAX && granule > pre_skip && rate > 0) {
+                duration = static_cast<double>(granule - pre_skip) / rate;
+            }
+            break;
+        }
+    }
+    return true;
+}
+
+bool TagReader::ReadMp4()
+{
+    ReadMp4Atoms(0, file_size, 0);
+    return true;
+}
+
+void TagReader::ReadMp4Atoms(uint64_t offset, uint64_t end, int depth)
+{
+    // Atoms are a 32-bit size (1: a 64-bit one follows, 0: to the end) and
+    // a type. Only moov and the boxes leading to its metadata are entered,
+    // so the sample tables and mdat are stepped over whatever their size.
+    while (end - offset >= 8 && depth < 8) {
+        const unsigned char* header = Fetch(offset, static_cast<size_t>(std::min<uint64_t>(16, end - offset)));
+        if (!header) {
+            return;
+        }
+        char type[4];
+        std::memcpy(type, header + 4, 4);
+        uint64_t size = BigEndian32(header);
+        uint64_t header_size = 8;
+        if (size == 1) {
+            if (end - offset < 16) {
+                return;
+            }
+            size = BigEndian64(header + 8);
+            header_size = 16;
+        } else if (size == 0) {
+            size = end - offset;
+        }
+        if (size < header_size || size > end - offset) {
+            return;
+        }
+        uint64_t body = offset + header_size;
+        uint64_t body_end = offset + size;
+
+        if (std::memcmp(type, "moov", 4) == 0 || std::memcmp(type, "udta", 4) == 0) {
+            ReadMp4Atoms(body, body_end, depth + 1);
+        } else if (std::memcmp(type, "meta", 4) == 0) {
+            // A full box, with version and flags first, except as QuickTime writes it
+            const unsigned char* start = Fetch(body, 8);
+            bool quicktime = start && std::memcmp(start + 4, "hdlr", 4) == 0;
+            ReadMp4Atoms(quicktime ? body : body + 4, body_end, depth + 1);
+        } else if (std::memcmp(type, "ilst", 4) == 0) {
+            ReadMp4Items(body, body_end);
+        } else if (std::memcmp(type, "mvhd", 4) == 0) {
+            if (const unsigned char* movie = Fetch(body, 32)) {
+                uint32_t timescale = BigEndian32(movie + (movie[0] == 1 ? 20 : 12));
+                uint64_t length = movie[0] == 1 ? BigEndian64(movie + 24) : BigEndian32(movie + 16);
+                if (timescale > 0) {
+                    duration = static_cast<double>(length) / timescale;
+                }
+            }
+        }
+        offset = body_end;
+    }
+}
+
+void TagReader::ReadMp4Items(uint64_t offset, uint64_t end)
+{
+    // Each item is named by its atom type and holds a data atom: a type
+    // code, a locale, then the value. Cover art is the one large item and
+    // is only fetched for ReadPicture().
+    while (end - offset >= 8) {
+        const unsigned char* header = Fetch(offset, 8);
+        if (!header) {
+            return;
+        }
+        uint64_t size = BigEndian32(header);
+        if (size < 8 || size > end - offset) {
+            return;
+        }
+        char name[4];
+        std::memcpy(name, header + 4, 4);
+        bool cover = std::memcmp(name, "covr", 4) == 0;
+        const unsigned char* item = (cover ? picture != nullptr : size <= WINDOW_SIZE)
+                                  ? Fetch(offset, static_cast<size_t>(size)) : nullptr;
+        offset += size;
+        if (!item || size < 24 || std::memcmp(item + 12, "data", 4) != 0) {
+            continue;
+        }
+        uint32_t data_size = std::min<uint32_t>(BigEndian32(item + 8), static_cast<uint32_t>(size - 8));
+        if (data_size < 16) {
+            continue;
+        }
+        uint32_t kind = BigEndian32(item + 16) & 0xFFFFFF;
+        const unsigned char* value = item + 24;
+        size_t length = data_size - 16;
+        std::string_view text(reinterpret_cast<const char*>(value), length);
+
+        std::string_view key(name, 4);
+        if (cover) {
+            SetPicture(3, value, length);
+        } else if (key == "\xA9" "nam") {
+            SetText(TITLE, text);
+        } else if (key == "\xA9" "ART") {
+            SetText(ARTIST, text);
+        } else if (key == "\xA9" "alb") {
+            SetText(ALBUM, text);
+        } else if (key == "aART") {
+            SetText(ALBUM_ARTIST, text);
+        } else if (key == "\xA9" "gen") {
+            SetText(GENRE, text);
+        } else if (key == "gnre" && length >= 2) {
+            // An ID3v1 genre, counted from one
+            uint32_t genre = BigEndian16(value);
+            if (genre >= 1 && genre <= GENRE_COUNT) {
+                SetText(GENRE, GENRES[genre - 1]);
+            }
+        } else if (key == "\xA9" "day") {
+            SetText(DATE, text);
+        } else if ((key == "trkn" || key == "disk") && kind == 0 && length >= 4) {
+            // Binary: two reserved bytes, the number, then the total
+            unsigned int& number = key == "trkn" ? track : disc;
+            if (number == 0) {
+                number = BigEndian16(value + 2);
+            }
+        }
+    }
+}
+
+}
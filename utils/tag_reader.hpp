@@ -0,0 +1,108 @@
+#ifndef __TAG_READER_HPP
+#define __TAG_READER_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace utils {
+
+// Reads a file's tags and duration from its container headers, without a
+// media library and without decoding audio.
+//
+// Understood are ID3v2.2-2.4 (with APE and ID3v1 behind it) on MPEG audio,
+// FLAC with its STREAMINFO and Vorbis comment, Ogg Vorbis and Opus, and
+// MP4/M4A (moov/mvhd and the iTunes items under moov/udta/meta/ilst).
+// Duration comes from the Xing, Info or VBRI header of an MPEG stream, or
+// from its bitrate if it has none, from the sample count in STREAMINFO,
+// from the last Ogg page's granule position or from mvhd.
+//
+// Only the regions holding metadata are read, through a window of
+// WINDOW_SIZE bytes that most files never leave; pictures and other large
+// frames are stepped over, not read, except by ReadPicture(). Text is converted to UTF-8 into one
+// buffer that is reused from file to file, so reading a file allocates
+// nothing once the reader has warmed up. One reader per thread.
+class TagReader {
+public:
+    enum Field { TITLE, ARTIST, ALBUM, ALBUM_ARTIST, GENRE, DATE, FIELDS };
+
+    struct Tags {
+        std::array<std::string_view, FIELDS> text;     // empty if absent
+        unsigned int track = 0;
+        unsigned int disc = 0;
+        double duration = 0.0;                          // seconds, 0 if unknown
+    };
+
+    TagReader();
+    ~TagReader();
+
+    TagReader(const TagReader&) = delete;
+    TagReader& operator=(const TagReader&) = delete;
+
+    // False if the file cannot be opened or is in no format known here.
+    // The views in tags hold until the next call.
+    bool Read(const std::string& path, Tags& tags);
+
+    // The embedded front cover (or else the first picture) as the encoded
+    // image, from APIC, a FLAC PICTURE block, METADATA_BLOCK_PICTURE, covr
+    // or an APE cover item; false if there is none
+    bool ReadPicture(const std::string& path, std::vector<unsigned char>& image);
+
+    static constexpr size_t WINDOW_SIZE = 64 * 1024;
+    static constexpr size_t MAX_BLOCK_SIZE = 16 * 1024 * 1024;     // largest piece of metadata read whole
+
+private:
+    int fd;
+    uint64_t file_size;
+    std::vector<unsigned char> window;
+    uint64_t window_start;
+    size_t window_length;
+    std::vector<unsigned char> scratch;         // unsynchronised ID3 data, Ogg packets
+
+    std::string text;
+    std::string decoded;                        // a value being converted to UTF-8
+    std::array<uint32_t, FIELDS> text_offsets;
+    std::array<uint32_t, FIELDS> text_lengths;
+    std::array<bool, FIELDS> has_text;
+    unsigned int track;
+    unsigned int disc;
+    double duration;
+
+    std::vector<unsigned char>* picture;        // set during ReadPicture()
+    int picture_type;                           // ID3 picture type, -1 before the first
+    std::vector<unsigned char> block;           // a decoded base64 picture
+
+    bool ReadFile(const std::string& path);
+
+    // count bytes at offset, or nullptr past the end of the file; the
+    // pointer holds until the next call
+    const unsigned char* Fetch(uint64_t offset, size_t count);
+
+    // The first value found for a field wins
+    void SetText(Field field, std::string_view utf8);
+    void SetGenre(std::string_view genre);
+    static void SetNumber(unsigned int& number, std::string_view value);
+
+    uint64_t ReadId3v2(uint64_t offset);        // the offset after the tag
+    void ParseId3Frame(const char* id, const unsigned char* data, size_t size);
+    void ParseId3Picture(const unsigned char* data, size_t size, bool version_2_2);
+    void ParseFlacPicture(const unsigned char* data, size_t size);
+    void SetPicture(int type, const unsigned char* data, size_t size);
+    void ParseVorbisComment(const unsigned char* data, size_t size);
+    void ParseApeItems(const unsigned char* data, size_t size, uint32_t count);
+
+    bool ReadMpeg(uint64_t audio_start);
+    uint64_t ReadTrailingTags();                // the offset where they start
+    bool ReadFlac(uint64_t offset);
+    bool ReadOgg();
+    bool ReadMp4();
+    void ReadMp4Atoms(uint64_t offset, uint64_t end, int depth);
+    void ReadMp4Items(uint64_t offset, uint64_t end);
+};
+
+}
+
+#endif // __TAG_READER_HPP
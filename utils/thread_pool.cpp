@@ -0,0 +1,83 @@
+#include "thread_pool.hpp"
+#include <algorithm>
+
+namespace utils {
+
+ThreadPool::ThreadPool(size_t threads)
+    : running_tasks(0)
+    , stopping(false)
+{
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    workers.reserve(threads);
+    for (size_t i = 0; i < threads; i++) {
+        workers.emplace_back(&ThreadPool::Run, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        tasks.clear();
+    }
+    task_available.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::Submit(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(std::move(task));
+    }
+    task_available.notify_one();
+}
+
+bool ThreadPool::WaitIdle(std::chrono::milliseconds timeout)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    return idle.wait_for(lock, timeout, [this] { return tasks.empty() && running_tasks == 0; });
+}
+
+void ThreadPool::WaitIdle()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this] { return tasks.empty() && running_tasks == 0; });
+}
+
+size_t ThreadPool::GetPendingCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return tasks.size() + running_tasks;
+}
+
+void ThreadPool::Run()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        task_available.wait(lock, [this] { return stopping || !tasks.empty(); });
+        if (stopping) {
+            break;
+        }
+
+        std::function<void()> task = std::move(tasks.front());
+        tasks.pop_front();
+        running_tasks++;
+
+        lock.unlock();
+        task();
+        lock.lock();
+
+        running_tasks--;
+        if (tasks.empty() && running_tasks == 0) {
+            idle.notify_all();
+        }
+    }
+}
+
+}
@@ -0,0 +1,53 @@
+#ifndef __THREAD_POOL_HPP
+#define __THREAD_POOL_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace utils {
+
+// Fixed set of worker threads running queued tasks in FIFO order.
+//
+// Meant for batch jobs over many files: submit everything, then poll
+// WaitIdle() from the GUI thread so it can keep a progress dialog alive.
+// The destructor drops tasks that have not started and joins the workers.
+class ThreadPool {
+public:
+    // 0 picks one thread per hardware thread
+    explicit ThreadPool(size_t threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void Submit(std::function<void()> task);
+
+    // True once the queue is empty and no task is running; false if the
+    // timeout expired first
+    bool WaitIdle(std::chrono::milliseconds timeout);
+    void WaitIdle();
+
+    size_t GetThreadCount() const { return workers.size(); }
+    size_t GetPendingCount() const;
+
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    mutable std::mutex mutex;
+    std::condition_variable task_available;
+    std::condition_variable idle;
+    size_t running_tasks;
+    bool stopping;
+
+    void Run();
+};
+
+}
+
+#endif // __THREAD_POOL_HPP
@@ -0,0 +1,285 @@
+#include "time_stretch.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace utils {
+
+TimeStretcher::TimeStretcher()
+    : sample_rate(0)
+    , channels(0)
+    , frame_frames(0)
+    , hop_frames(0)
+    , search_frames(0)
+    , rate(1.0)
+    , input_capacity(0)
+    , input_start(0)
+    , input_end(0)
+    , output_pos(0)
+    , output_count(0)
+    , nominal_pos(0.0)
+    , natural_pos(0)
+    , first_frame(true)
+{
+}
+
+void TimeStretcher::Configure(int rate_hz, int channel_count, size_t max_block_frames)
+{
+    sample_rate = std::max(8000, rate_hz);
+    channels = std::max(1, channel_count);
+
+    // ~20 ms windows (power of two) with a ~5 ms similarity search
+    frame_frames = 256;
+    while (frame_frames < static_cast<size_t>(sample_rate / 50)) {
+        frame_frames *= 2;
+    }
+    hop_frames = frame_frames / 2;
+    search_frames = static_cast<size_t>(sample_rate / 200) & ~static_cast<size_t>(3);
+
+    input_capacity = max_block_frames + frame_frames * 3 + search_frames * 2;
+    input.assign(input_capacity * channels, 0.0f);
+    input_mono.assign(input_capacity, 0.0f);
+
+    // Periodic Hann window: overlap-adds to exactly 1.0 at 50% overlap
+    window.resize(frame_frames);
+    for (size_t i = 0; i < frame_frames; i++) {
+        window[i] = static_cast<float>(0.5 - 0.5 * cos(2.0 * M_PI * i / frame_frames));
+    }
+
+    overlap.assign(frame_frames * channels, 0.0f);
+    output.assign(hop_frames * channels, 0.0f);
+
+    Reset();
+}
+
+void TimeStretcher::Reset()
+{
+    std::fill(overlap.begin(), overlap.end(), 0.0f);
+    output_pos = 0;
+    output_count = 0;
+
+    // Prime with half a window of silence so the first hop fades in cleanly
+    std::fill(input.begin(), input.begin() + hop_frames * channels, 0.0f);
+    std::fill(input_mono.begin(), input_mono.begin() + hop_frames, 0.0f);
+    input_start = 0;
+    input_end = hop_frames;
+
+    nominal_pos = 0.0;
+    natural_pos = 0;
+    first_frame = true;
+}
+
+void TimeStretcher::SetRate(double new_rate)
+{
+    rate.store(std::max(MIN_RATE, std::min(MAX_RATE, new_rate)), std::memory_order_relaxed);
+}
+
+size_t TimeStretcher::Write(const float* interleaved, size_t frames)
+{
+    if (!IsConfigured() || frames == 0) {
+        return 0;
+    }
+
+    if (input_capacity - input_end < frames) {
+        CompactInput();
+    }
+
+    size_t count = std::min(frames, input_capacity - input_end);
+    std::memcpy(&input[input_end * channels], interleaved, count * channels * sizeof(float));
+
+    const float scale = 1.0f / channels;
+    for (size_t i = 0; i < count; i++) {
+        float sum = 0.0f;
+        for (int c = 0; c < channels; c++) {
+            sum += interleaved[i * channels + c];
+        }
+        input_mono[input_end + i] = sum * scale;
+    }
+
+    input_end += count;
+    return count;
+}
+
+size_t TimeStretcher::Read(float* interleaved, size_t frames)
+{
+    if (!IsConfigured()) {
+        return 0;
+    }
+
+    size_t produced = 0;
+    while (produced < frames) {
+        if (output_count > 0) {
+            size_t count = std::min(frames - produced, output_count);
+            std::memcpy(interleaved + produced * channels,
+                        &output[output_pos * channels],
+                        count * channels * sizeof(float));
+            output_pos += count;
+            output_count -= count;
+            produced += count;
+        } else if (CanSynthesize()) {
+            SynthesizeHop();
+        } else {
+            break;
+        }
+    }
+
+    return produced;
+}
+
+size_t TimeStretcher::GetWritableFrames() const
+{
+    if (!IsConfigured()) {
+        return 0;
+    }
+
+    size_t nominal = static_cast<size_t>(nominal_pos);
+    size_t floor = first_frame ? nominal : std::min(natural_pos, nominal > search_frames ? nominal - search_frames : 0);
+    return input_capacity - (input_end - std::max(floor, input_start));
+}
+
+float TimeStretcher::DotProduct(const float* a, const float* b, size_t count)
+{
+    size_t i = 0;
+    float result = 0.0f;
+
+#if defined(__AVX__)
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    for (; i + 16 <= count; i += 16) {
+        acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+        acc1 = _mm256_add_ps(acc1, _mm256_mul_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8)));
+    }
+    alignas(32) float lanes[8];
+    _mm256_store_ps(lanes, _mm256_add_ps(acc0, acc1));
+    for (float lane : lanes) {
+        result += lane;
+    }
+#elif defined(__SSE__) || defined(_M_X64)
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    __m128 acc2 = _mm_setzero_ps();
+    __m128 acc3 = _mm_setzero_ps();
+    for (; i + 16 <= count; i += 16) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+        acc2 = _mm_add_ps(acc2, _mm_mul_ps(_mm_loadu_ps(a + i + 8), _mm_loadu_ps(b + i + 8)));
+        acc3 = _mm_add_ps(acc3, _mm_mul_ps(_mm_loadu_ps(a + i + 12), _mm_loadu_ps(b + i + 12)));
+    }
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, _mm_add_ps(_mm_add_ps(acc0, acc1), _mm_add_ps(acc2, acc3)));
+    result = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#elif defined(__ARM_NEON)
+    float32x4_t acc0 = vdupq_n_f32(0.0f);
+    float32x4_t acc1 = vdupq_n_f32(0.0f);
+    for (; i + 8 <= count; i += 8) {
+        acc0 = vmlaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+        acc1 = vmlaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+    }
+    float32x4_t acc = vaddq_f32(acc0, acc1);
+    result = vgetq_lane_f32(acc, 0) + vgetq_lane_f32(acc, 1) + vgetq_lane_f32(acc, 2) + vgetq_lane_f32(acc, 3);
+#endif
+
+    for (; i < count; i++) {
+        result += a[i] * b[i];
+    }
+    return result;
+}
+
+bool TimeStretcher::CanSynthesize() const
+{
+    size_t nominal = static_cast<size_t>(nominal_pos);
+    size_t reach = first_frame ? 0 : search_frames;
+    return nominal + reach + frame_frames <= input_end;
+}
+
+void TimeStretcher::SynthesizeHop()
+{
+    size_t nominal = static_cast<size_t>(nominal_pos);
+    size_t start = first_frame ? nominal : FindBestOffset(nominal);
+    first_frame = false;
+
+    // Overlap-add the windowed segment
+    const float* segment = &input[start * channels];
+    for (size_t i = 0; i < frame_frames; i++) {
+        const float w = window[i];
+        float* dst = &overlap[i * channels];
+        const float* src = segment + i * channels;
+        for (int c = 0; c < channels; c++) {
+            dst[c] += src[c] * w;
+        }
+    }
+
+    // The first hop is now complete; shift the accumulator
+    const size_t hop_samples = hop_frames * channels;
+    std::memcpy(output.data(), overlap.data(), hop_samples * sizeof(float));
+    std::memmove(overlap.data(), overlap.data() + hop_samples, (overlap.size() - hop_samples) * sizeof(float));
+    std::fill(overlap.end() - hop_samples, overlap.end(), 0.0f);
+    output_pos = 0;
+    output_count = hop_frames;
+
+    natural_pos = start + hop_frames;
+    nominal_pos += hop_frames * rate.load(std::memory_order_relaxed);
+}
+
+size_t TimeStretcher::FindBestOffset(size_t nominal) const
+{
+    size_t lo = nominal > search_frames ? nominal - search_frames : 0;
+    lo = std::max(lo, input_start);
+    size_t hi = std::min(nominal + search_frames, input_end - frame_frames);
+    if (lo >= hi) {
+        return std::min(std::max(nominal, input_start), input_end - frame_frames);
+    }
+
+    // Normalised cross-correlation of each candidate against the natural
+    // continuation of the previous segment, over the overlapping half window
+    const float* reference = &input_mono[natural_pos];
+    const size_t length = hop_frames;
+
+    float energy = DotProduct(&input_mono[lo], &input_mono[lo], length);
+    size_t best = lo;
+    float best_score = -1e30f;
+
+    for (size_t candidate = lo; candidate <= hi; candidate++) {
+        float corr = DotProduct(&input_mono[candidate], reference, length);
+        float score = corr / std::sqrt(std::max(energy, 1e-9f));
+        if (score > best_score) {
+            best_score = score;
+            best = candidate;
+        }
+
+        float leaving = input_mono[candidate];
+        float entering = input_mono[candidate + length];
+        energy += entering * entering - leaving * leaving;
+    }
+
+    return best;
+}
+
+void TimeStretcher::CompactInput()
+{
+    size_t nominal = static_cast<size_t>(nominal_pos);
+    size_t floor = first_frame ? nominal : std::min(natural_pos, nominal > search_frames ? nominal - search_frames : 0);
+    floor = std::min(std::max(floor, input_start), input_end);
+    if (floor == 0) {
+        return;
+    }
+
+    size_t remaining = input_end - floor;
+    std::memmove(input.data(), &input[floor * channels], remaining * channels * sizeof(float));
+    std::memmove(input_mono.data(), &input_mono[floor], remaining * sizeof(float));
+
+    input_start = 0;
+    input_end = remaining;
+    nominal_pos -= static_cast<double>(floor);
+    natural_pos = natural_pos > floor ? natural_pos - floor : 0;
+}
+
+}
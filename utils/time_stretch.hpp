@@ -0,0 +1,85 @@
+#ifndef __TIME_STRETCH_HPP
+#define __TIME_STRETCH_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace utils {
+
+// Pitch-preserving time stretch (WSOLA) for interleaved float PCM.
+//
+// All buffers are sized in Configure(); Write()/Read() never allocate, so the
+// stretcher can run on an audio thread. The playback rate can be changed at
+// any time from another thread and takes effect on the next synthesis hop,
+// without flushing buffered audio.
+class TimeStretcher {
+public:
+    static constexpr double MIN_RATE = 0.5;
+    static constexpr double MAX_RATE = 3.0;
+
+    TimeStretcher();
+
+    // Allocates internal buffers. max_block_frames is the largest block the
+    // caller will pass to Write() in one call.
+    void Configure(int sample_rate, int channels, size_t max_block_frames = 4096);
+    void Reset();
+    bool IsConfigured() const { return channels > 0; }
+
+    // Rate control (thread-safe)
+    void SetRate(double rate);
+    double GetRate() const { return rate.load(std::memory_order_relaxed); }
+
+    // Streaming interface. Write() returns the number of frames accepted,
+    // Read() the number of frames produced.
+    size_t Write(const float* interleaved, size_t frames);
+    size_t Read(float* interleaved, size_t frames);
+    size_t GetWritableFrames() const;
+
+    // Frames of delay between input and output at rate 1.0
+    size_t GetLatencyFrames() const { return hop_frames; }
+    int GetSampleRate() const { return sample_rate; }
+    int GetChannels() const { return channels; }
+
+    // SIMD dot product used by the correlation search; exposed for reuse by
+    // other analysis code.
+    static float DotProduct(const float* a, const float* b, size_t count);
+
+private:
+    int sample_rate;
+    int channels;
+
+    // Frame geometry (in frames)
+    size_t frame_frames;    // analysis/synthesis window length
+    size_t hop_frames;      // synthesis hop, frame_frames / 2
+    size_t search_frames;   // +/- tolerance of the similarity search
+
+    std::atomic<double> rate;
+
+    // Input FIFO: interleaved samples plus a mono mixdown for the search
+    std::vector<float> input;
+    std::vector<float> input_mono;
+    size_t input_capacity;  // frames
+    size_t input_start;     // first valid frame
+    size_t input_end;       // one past last valid frame
+
+    // Synthesis state
+    std::vector<float> window;
+    std::vector<float> overlap;     // frame_frames * channels accumulator
+    std::vector<float> output;      // hop_frames * channels ready to read
+    size_t output_pos;
+    size_t output_count;
+
+    double nominal_pos;     // ideal analysis position, relative to input_start
+    size_t natural_pos;     // continuation of the previous chosen segment
+    bool first_frame;
+
+    bool CanSynthesize() const;
+    void SynthesizeHop();
+    size_t FindBestOffset(size_t nominal) const;
+    void CompactInput();
+};
+
+}
+
+#endif // __TIME_STRETCH_HPP
@@ -0,0 +1,33 @@
+#include "triple_buffer.hpp"
+
+namespace utils {
+
+TripleBuffer::TripleBuffer()
+    : shared(1)
+    , write_index(0)
+    , read_index(2)
+    , has_frame(false)
+{
+}
+
+void TripleBuffer::Publish()
+{
+    // Release makes the frame contents visible to whoever swaps it out
+    unsigned previous = shared.exchange(static_cast<unsigned>(write_index) | FRESH, std::memory_order_acq_rel);
+    write_index = static_cast<int>(previous & INDEX_MASK);
+}
+
+bool TripleBuffer::Acquire()
+{
+    if (!(shared.load(std::memory_order_relaxed) & FRESH)) {
+        return false;
+    }
+
+    // The producer may publish again in between; then we get that frame
+    unsigned previous = shared.exchange(static_cast<unsigned>(read_index), std::memory_order_acq_rel);
+    read_index = static_cast<int>(previous & INDEX_MASK);
+    has_frame = true;
+    return true;
+}
+
+}
@@ -0,0 +1,42 @@
+#ifndef __TRIPLE_BUFFER_HPP
+#define __TRIPLE_BUFFER_HPP
+
+#include <atomic>
+
+namespace utils {
+
+// Lock-free handoff of the latest frame between one producer and one consumer.
+//
+// Only slot indices are exchanged; the caller owns three frame objects and
+// indexes them with GetWriteIndex() and GetReadIndex(). The producer always
+// has a slot to draw into and never waits for the consumer, and the consumer
+// always sees the newest completed frame. Frames the consumer was too slow
+// to pick up are dropped.
+class TripleBuffer {
+public:
+    TripleBuffer();
+
+    // Producer side
+    int GetWriteIndex() const { return write_index; }
+    void Publish();
+
+    // Consumer side: swaps in the newest published slot, if any. Returns
+    // false when nothing was published since the last call.
+    bool Acquire();
+    int GetReadIndex() const { return read_index; }
+    bool HasFrame() const { return has_frame; }
+
+private:
+    // Middle slot index, plus FRESH when it holds an unread frame
+    std::atomic<unsigned> shared;
+    int write_index;
+    int read_index;
+    bool has_frame;
+
+    static const unsigned INDEX_MASK = 3;
+    static const unsigned FRESH = 4;
+};
+
+}
+
+#endif // __TRIPLE_BUFFER_HPP
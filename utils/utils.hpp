@@ -9,6 +9,34 @@
 #include "gui_utils.hpp"
 #include "log_utils.hpp"
 #include "string_utils.hpp"
+#include "time_stretch.hpp"
+#include "audio_decoder.hpp"
+#include "audio_sink.hpp"
+#include "pcm_tap.hpp"
+#include "audio_engine.hpp"
+#include "spectrum_analyzer.hpp"
+#include "raster_surface.hpp"
+#include "triple_buffer.hpp"
+#include "level_meter.hpp"
+#include "thread_pool.hpp"
+#include "beat_tracker.hpp"
+#include "file_cache.hpp"
+#include "bpm_cache.hpp"
+#include "silence_detector.hpp"
+#include "resume_store.hpp"
+#include "fuzzy_matcher.hpp"
+#include "search_index.hpp"
+#include "natural_sort.hpp"
+#include "multi_key_sort.hpp"
+#include "smart_query.hpp"
+#include "mapped_file.hpp"
+#include "content_hash.hpp"
+#include "duplicate_finder.hpp"
+#include "checksum.hpp"
+#include "library_watcher.hpp"
+#include "library_store.hpp"
+#include "tag_reader.hpp"
+#include "art_cache.hpp"
 
 namespace utils {
 
@@ -20,6 +48,41 @@ using PerformanceUtils = PerformanceUtils;
 using GuiUtils = GuiUtils;
 using LogUtils = LogUtils;
 using StringUtils = StringUtils;
+using TimeStretcher = TimeStretcher;
+using AudioDecoder = AudioDecoder;
+using AudioSink = AudioSink;
+using NullSink = NullSink;
+using WavSink = WavSink;
+using PcmTap = PcmTap;
+using AudioEngine = AudioEngine;
+using SpectrumAnalyzer = SpectrumAnalyzer;
+using RasterSurface = RasterSurface;
+using TripleBuffer = TripleBuffer;
+using LevelTap = LevelTap;
+using LevelMeter = LevelMeter;
+using ThreadPool = ThreadPool;
+using BeatTracker = BeatTracker;
+using BpmCache = BpmCache;
+using SilenceDetector = SilenceDetector;
+using TrimCache = TrimCache;
+using ResumeStore = ResumeStore;
+using FuzzyMatcher = FuzzyMatcher;
+using SearchIndex = SearchIndex;
+using NaturalSort = NaturalSort;
+using MultiKeySort = MultiKeySort;
+using SortDictionary = SortDictionary;
+using TrackTable = TrackTable;
+using SmartQuery = SmartQuery;
+using SmartPlaylist = SmartPlaylist;
+using MappedFile = MappedFile;
+using ContentHash = ContentHash;
+using DuplicateFinder = DuplicateFinder;
+using Checksum = Checksum;
+using LibraryWatcher = LibraryWatcher;
+using LibraryChange = LibraryChange;
+using LibraryStore = LibraryStore;
+using TagReader = TagReader;
+using ArtCache = ArtCache;
 
 // Utility initialization and cleanup
 class UtilsManager {